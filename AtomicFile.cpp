@@ -0,0 +1,81 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+#include "AtomicFile.h"
+
+AtomicFile::AtomicFile(const std::string &path) : m_path(path), m_tmpPath(path + ".tmp") {
+  m_fd = ::open(m_tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_fd == -1) {
+    BOOST_LOG_TRIVIAL(error) << "unable to create " << m_tmpPath << ": " << strerror(errno);
+  }
+}
+
+AtomicFile::~AtomicFile() {
+  if (m_fd != -1) {
+    ::close(m_fd);
+    unlink(m_tmpPath.c_str());
+  }
+}
+
+void AtomicFile::reserve(uint64_t size) {
+  posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+}
+
+bool AtomicFile::writev(uint64_t offset, std::vector<iovec> &iov) {
+  size_t first = 0;
+  while (first < iov.size()) {
+    const int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    const ssize_t written = pwritev(m_fd, iov.data() + first, count, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      BOOST_LOG_TRIVIAL(error) << "write to " << m_tmpPath << " failed: " << strerror(errno);
+      return false;
+    }
+    offset += written;
+    size_t left = static_cast<size_t>(written);
+    while ((first < iov.size()) && (left >= iov[first].iov_len)) {
+      left -= iov[first].iov_len;
+      first++;
+    }
+    if (left > 0) {
+      iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + left;
+      iov[first].iov_len -= left;
+    }
+  }
+  return true;
+}
+
+bool AtomicFile::sync() {
+  if (fsync(m_fd) != 0) {
+    BOOST_LOG_TRIVIAL(error) << "fsync of " << m_tmpPath << " failed: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool AtomicFile::commit() {
+  const int fd = m_fd;
+  m_fd = -1;
+  if (::close(fd) != 0) {
+    BOOST_LOG_TRIVIAL(error) << "close of " << m_tmpPath << " failed: " << strerror(errno);
+    unlink(m_tmpPath.c_str());
+    return false;
+  }
+  if (rename(m_tmpPath.c_str(), m_path.c_str()) != 0) {
+    BOOST_LOG_TRIVIAL(error) << "rename " << m_tmpPath << " to " << m_path << " failed: " << strerror(errno);
+    unlink(m_tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
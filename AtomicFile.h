@@ -0,0 +1,43 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_ATOMICFILE_H
+#define MATCH_MANUALLY_ATOMICFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+/* written to <path>.tmp, renamed over path by commit(), removed when never committed */
+class AtomicFile {
+public:
+  explicit AtomicFile(const std::string &path);
+
+  AtomicFile(const AtomicFile &) = delete;
+
+  AtomicFile &operator=(const AtomicFile &) = delete;
+
+  ~AtomicFile();
+
+  bool ok() const { return m_fd != -1; }
+
+  /* lets the filesystem allocate extents up front, not supported everywhere and only a hint */
+  void reserve(uint64_t size);
+
+  /* iov is consumed, partial writes continue where they stopped */
+  bool writev(uint64_t offset, std::vector<iovec> &iov);
+
+  bool sync();
+
+  bool commit();
+
+private:
+  std::string m_path;
+  std::string m_tmpPath;
+  int m_fd = -1;
+};
+
+
+#endif //MATCH_MANUALLY_ATOMICFILE_H
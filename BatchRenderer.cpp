@@ -0,0 +1,93 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <QThreadPool>
+#include <QDebug>
+#include "BatchRenderer.h"
+#include "MatchComparison.h"
+
+BatchRenderer::BatchRenderer(QVulkanInstance *inst, ImageGraphModel *graphModel, const QSize &size) :
+        m_graphModel(graphModel), m_target(inst, size), m_written(0),
+        m_encodeSlots(2 * QThreadPool::globalInstance()->maxThreadCount()) {
+  m_renderer = std::make_unique<VulkanRenderer>(&m_target, m_graphModel, nullptr);
+  m_target.setFrameCallback([this](const QImage &image, const QString &tag) {
+    encodeFrame(image, tag);
+  });
+}
+
+BatchRenderer::~BatchRenderer() {
+  m_target.release();
+  QThreadPool::globalInstance()->waitForDone();
+}
+
+bool BatchRenderer::initialize() {
+  return m_target.initialize(m_renderer.get());
+}
+
+void BatchRenderer::setLayout(BatchRenderer::Layout layout, bool drawKeypoints) {
+  m_layout = layout;
+  m_drawKeypoints = drawKeypoints;
+}
+
+size_t BatchRenderer::render(const std::vector<Job> &jobs) {
+  m_renderer->setKeypointsVisible((m_layout == LAYOUT_KEYPOINTS) || m_drawKeypoints);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const auto &job = jobs[i];
+    showImages(job.images);
+    m_renderer->placeImages(job.images);
+    if ((m_layout == LAYOUT_PAIR) && (job.images.size() == 2)) {
+      m_renderer->setLines(matchLines(job.images[0], job.images[1]));
+    } else {
+      m_renderer->setLines({});
+    }
+    m_target.renderFrame(job.output);
+    if ((i + 1) % 100 == 0) {
+      qInfo() << "rendered" << i + 1 << "/" << jobs.size();
+    }
+  }
+  m_target.finish();
+  QThreadPool::globalInstance()->waitForDone();
+  return m_written;
+}
+
+/* images shared with the previous job keep their texture, sorted pair lists upload each image about once */
+void BatchRenderer::showImages(const std::vector<Image_ID_T> &images) {
+  for (auto image_id: m_shownImages) {
+    if (std::find(images.begin(), images.end(), image_id) == images.end()) {
+      m_renderer->removeImage(image_id);
+    }
+  }
+  for (auto image_id: images) {
+    if (std::find(m_shownImages.begin(), m_shownImages.end(), image_id) == m_shownImages.end()) {
+      m_renderer->addImage(image_id);
+    }
+  }
+  m_shownImages = images;
+}
+
+std::vector<VulkanRenderer::LineSegment>
+BatchRenderer::matchLines(Image_ID_T image_id1, Image_ID_T image_id2) const {
+  std::vector<VulkanRenderer::LineSegment> segments;
+  const auto &imgInfo1 = m_graphModel->imageInfos.at(image_id1);
+  const auto &imgInfo2 = m_graphModel->imageInfos.at(image_id2);
+  for (const auto &m: MatchComparison::trackMatches(*m_graphModel, image_id1, image_id2)) {
+    segments.push_back({{image_id1, image_id2},
+                        {imgInfo1.keyPoints[m.first].pos, imgInfo2.keyPoints.at(m.second).pos},
+                        Eigen::Vector3f(0.f, 1.f, 0.f)});
+  }
+  return segments;
+}
+
+void BatchRenderer::encodeFrame(const QImage &image, const QString &path) {
+  /* bound the number of frames waiting for the encoder, otherwise fast gpus queue up gigabytes */
+  m_encodeSlots.acquire();
+  QThreadPool::globalInstance()->start([this, image, path]() {
+    if (image.save(path, "PNG")) {
+      m_written++;
+    } else {
+      qWarning("can not write %s", qPrintable(path));
+    }
+    m_encodeSlots.release();
+  });
+}
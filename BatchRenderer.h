@@ -0,0 +1,59 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_BATCHRENDERER_H
+#define MATCH_MANUALLY_BATCHRENDERER_H
+
+#include <atomic>
+#include <memory>
+#include <QSemaphore>
+#include "OffscreenTarget.h"
+#include "VulkanRenderer.h"
+
+/*
+ * renders match inspection images without a window, every job is one set of images laid out side by side,
+ * png encoding runs on the global thread pool while the next frames are rendered
+ */
+class BatchRenderer {
+public:
+  enum Layout {
+    LAYOUT_PAIR,      // images side by side, lines between keypoints of shared tracks
+    LAYOUT_KEYPOINTS  // images side by side, keypoints drawn on top
+  };
+
+  struct Job {
+    std::vector<Image_ID_T> images;
+    QString output;
+  };
+
+  BatchRenderer(QVulkanInstance *inst, ImageGraphModel *graphModel, const QSize &size);
+
+  ~BatchRenderer();
+
+  bool initialize();
+
+  void setLayout(Layout layout, bool drawKeypoints);
+
+  /* returns the number of png files written */
+  size_t render(const std::vector<Job> &jobs);
+
+private:
+  ImageGraphModel *m_graphModel;
+  OffscreenTarget m_target;
+  std::unique_ptr<VulkanRenderer> m_renderer;
+  Layout m_layout = LAYOUT_PAIR;
+  bool m_drawKeypoints = false;
+  std::vector<Image_ID_T> m_shownImages;
+  std::atomic<size_t> m_written;
+  QSemaphore m_encodeSlots;
+
+  void showImages(const std::vector<Image_ID_T> &images);
+
+  std::vector<VulkanRenderer::LineSegment> matchLines(Image_ID_T image_id1, Image_ID_T image_id2) const;
+
+  void encodeFrame(const QImage &image, const QString &path);
+};
+
+
+#endif //MATCH_MANUALLY_BATCHRENDERER_H
@@ -0,0 +1,112 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "BenchBaseline.h"
+
+bool BenchBaseline::read(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "can not read baseline %s\n", path.c_str());
+    return false;
+  }
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string name;
+    fields >> name;
+    if (name == "dataset") {
+      std::getline(fields >> std::ws, dataset);
+      continue;
+    }
+    Entry entry = {};
+    std::string rss;
+    if (!(fields >> entry.itemsPerSecond >> entry.minRatio >> rss >> entry.maxRatio)) {
+      fprintf(stderr, "%s:%d: expected <case> <items/s> <min ratio> <peak rss MB> <max ratio>\n", path.c_str(),
+              lineNo);
+      return false;
+    }
+    /* "-" leaves the memory of a case unchecked */
+    entry.peakRssMb = rss == "-" ? -1. : std::stod(rss);
+    entries[name] = entry;
+  }
+  return true;
+}
+
+bool BenchBaseline::write(const std::string &path, const std::vector<BenchResult> &results) const {
+  std::ofstream out(path);
+  out << "# match_bench baseline, a case fails below items/s * min ratio or above peak rss * max ratio\n"
+      << "# peak rss \"-\" leaves the memory of a case unchecked, a case that runs without a line fails.\n"
+      << "# numbers of the machine that recorded it, another machine class records its own with the ctest\n"
+      << "# arguments plus --update-baseline <file> and configures -DMATCH_BENCH_BASELINE=<file>\n"
+      << "dataset " << dataset << '\n'
+      << "# case            items/s  min_ratio  peak_rss_mb  max_ratio\n";
+  /* cases that did not run keep their old line, tolerances and "-" edited by hand survive an update */
+  auto merged = entries;
+  for (const auto &r: results) {
+    auto it = entries.find(r.name);
+    const bool known = it != entries.end();
+    merged[r.name] = {r.itemsPerSecond(), known ? it->second.minRatio : defaultMinRatio,
+                      known && (it->second.peakRssMb < 0) ? -1. : r.peakRssKb / 1024.,
+                      known ? it->second.maxRatio : defaultMaxRatio};
+  }
+  char buf[256];
+  char rss[32];
+  for (const auto &it: merged) {
+    if (it.second.peakRssMb >= 0) {
+      snprintf(rss, sizeof(rss), "%.1f", it.second.peakRssMb);
+    } else {
+      snprintf(rss, sizeof(rss), "-");
+    }
+    snprintf(buf, sizeof(buf), "%-16s %10.4g %10.2f %12s %10.2f\n", it.first.c_str(), it.second.itemsPerSecond,
+             it.second.minRatio, rss, it.second.maxRatio);
+    out << buf;
+  }
+  out.close();
+  if (!out) {
+    fprintf(stderr, "can not write baseline %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool BenchBaseline::compare(const std::vector<BenchResult> &results) const {
+  bool ok = true;
+  printf("\n%-16s %12s %12s %8s | %10s %10s %8s\n", "case", "base item/s", "item/s", "change", "base MB",
+         "MB", "change");
+  for (const auto &r: results) {
+    auto it = entries.find(r.name);
+    /* a case that ran unchecked would hide its regressions, it needs a line before it can be selected */
+    if (it == entries.end()) {
+      printf("%-16s %12s %12.4g %8s | %10s %10.1f %8s  FAIL no baseline\n", r.name.c_str(), "-",
+             r.itemsPerSecond(), "", "-", r.peakRssKb / 1024., "");
+      ok = false;
+      continue;
+    }
+    const auto &e = it->second;
+    const double mb = r.peakRssKb / 1024.;
+    const bool slow = r.itemsPerSecond() < e.itemsPerSecond * e.minRatio;
+    /* a few MB of allocator noise is not a regression on small datasets */
+    const bool big = (e.peakRssMb >= 0) && (mb > std::max(e.peakRssMb * e.maxRatio, e.peakRssMb + 8.));
+    std::string status = "ok";
+    if (slow || big) {
+      status = std::string("FAIL") + (slow ? " throughput" : "") + (big ? " memory" : "");
+      ok = false;
+    }
+    char baseMb[32];
+    snprintf(baseMb, sizeof(baseMb), e.peakRssMb >= 0 ? "%.1f" : "-", e.peakRssMb);
+    printf("%-16s %12.4g %12.4g %+7.1f%% | %10s %10.1f %+7.1f%%  %s\n", r.name.c_str(), e.itemsPerSecond,
+           r.itemsPerSecond(), 100. * (r.itemsPerSecond() / e.itemsPerSecond - 1.), baseMb, mb,
+           e.peakRssMb > 0 ? 100. * (mb / e.peakRssMb - 1.) : 0., status.c_str());
+  }
+  return ok;
+}
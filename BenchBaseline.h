@@ -0,0 +1,54 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_BENCHBASELINE_H
+#define MATCH_MANUALLY_BENCHBASELINE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+  std::string name;
+  double seconds;
+  uint64_t items;
+  uint64_t bytes;
+  /* peak rss growth over the rss at the start of the case, earlier cases and shared libraries do not count */
+  long peakRssKb;
+
+  double itemsPerSecond() const { return items / std::max(seconds, 1e-9); }
+};
+
+/*
+ * checked in performance expectations of match_bench, one line per case
+ *   dataset <the synthetic model arguments the numbers belong to>
+ *   <case> <items/s> <min ratio> <peak rss MB> <max ratio>
+ * a case fails when its throughput drops below items/s * min ratio or its memory grows above MB * max ratio, or
+ * when it ran without a line
+ */
+class BenchBaseline {
+public:
+  struct Entry {
+    double itemsPerSecond;
+    double minRatio;
+    double peakRssMb;
+    double maxRatio;
+  };
+
+  bool read(const std::string &path);
+
+  bool write(const std::string &path, const std::vector<BenchResult> &results) const;
+
+  /* prints a table of baseline against measured values, false if any case regressed or has no line */
+  bool compare(const std::vector<BenchResult> &results) const;
+
+  std::string dataset;
+  std::map<std::string, Entry> entries;
+  double defaultMinRatio = 0.5;
+  double defaultMaxRatio = 1.3;
+};
+
+
+#endif //MATCH_MANUALLY_BENCHBASELINE_H
@@ -0,0 +1,455 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+#ifdef MATCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "BinaryReader.h"
+
+namespace {
+/* large enough that a 10k keypoint image record rarely spans two chunks, small enough to start parsing early */
+const size_t chunkBytes = 4 << 20;
+
+/* little endian 28 b5 2f fd */
+const uint32_t zstdMagic = 0xFD2FB528u;
+/* decompressed bytes per compressed byte at most, a 128 KiB run length block is 4 bytes */
+const uint64_t maxZstdRatio = (128 << 10) / 4;
+
+/* the whole file as one chunk, pages are faulted in by the parser with sequential readahead */
+class MmapSource : public ByteSource {
+public:
+  MmapSource(int fd, uint64_t size) : m_size(size) {
+    if (size > 0) {
+      m_data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m_data == MAP_FAILED) {
+        m_data = nullptr;
+        m_failed = true;
+      } else {
+        madvise(m_data, size, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  ~MmapSource() override {
+    if (m_data) {
+      munmap(m_data, m_size);
+    }
+  }
+
+  bool next(const char **data, size_t *size) override {
+    if (m_done || (m_data == nullptr)) {
+      return false;
+    }
+    m_done = true;
+    *data = static_cast<const char *>(m_data);
+    *size = m_size;
+    return true;
+  }
+
+  bool failed() const override { return m_failed; }
+
+private:
+  void *m_data = nullptr;
+  uint64_t m_size;
+  bool m_done = false;
+  bool m_failed = false;
+};
+
+/* reads [offset, offset + size), false on errors and when the file ends early */
+bool preadFully(int fd, char *dst, size_t size, uint64_t offset) {
+  while (size > 0) {
+    const ssize_t n = pread(fd, dst, size, offset);
+    if ((n < 0) && (errno == EINTR)) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    dst += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+/*
+ * a producer thread fills one buffer while the parser works on the other. subclasses implement produce() and call
+ * start() at the end of their constructor and stop() at the start of their destructor
+ */
+class ThreadedSource : public ByteSource {
+public:
+  explicit ThreadedSource(size_t bufferBytes) {
+    for (auto &buffer: m_buffers) {
+      buffer.data.resize(bufferBytes);
+    }
+  }
+
+  bool next(const char **data, size_t *size) override {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_held) {
+      m_buffers[m_consumed % 2].state = FREE;
+      m_consumed++;
+      m_held = false;
+      m_cv.notify_all();
+    }
+    auto &buffer = m_buffers[m_consumed % 2];
+    m_cv.wait(lock, [&]() { return buffer.state != FREE; });
+    if (buffer.state != READY) {
+      return false;
+    }
+    m_held = true;
+    *data = buffer.data.data();
+    *size = buffer.size;
+    return true;
+  }
+
+  bool failed() const override { return m_failed; }
+
+protected:
+  /* fills dst with up to capacity bytes, size 0 at the end, false on errors */
+  virtual bool produce(char *dst, size_t capacity, size_t *size) = 0;
+
+  void start() {
+    m_thread = std::thread([this]() { fill(); });
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+private:
+  enum State {
+    FREE,
+    READY,
+    END,
+    ERROR
+  };
+
+  struct Buffer {
+    std::vector<char> data;
+    size_t size = 0;
+    State state = FREE;
+  };
+
+  Buffer m_buffers[2];
+  size_t m_consumed = 0;
+  bool m_held = false;
+  bool m_stop = false;
+  std::atomic<bool> m_failed{false};
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::thread m_thread;
+
+  void fill() {
+    for (size_t i = 0;; i++) {
+      auto &buffer = m_buffers[i % 2];
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return m_stop || (buffer.state == FREE); });
+        if (m_stop) {
+          return;
+        }
+      }
+      /* the parser does not touch a free buffer, no lock while producing */
+      size_t size = 0;
+      const bool ok = produce(buffer.data.data(), buffer.data.size(), &size);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffer.size = size;
+        buffer.state = !ok ? ERROR : (size == 0 ? END : READY);
+        m_failed = !ok;
+      }
+      m_cv.notify_all();
+      if (!ok || (size == 0)) {
+        return;
+      }
+    }
+  }
+};
+
+class PreadSource : public ThreadedSource {
+public:
+  PreadSource(int fd, uint64_t size) : ThreadedSource(std::min<uint64_t>(chunkBytes, size)), m_fd(fd), m_size(size) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    start();
+  }
+
+  ~PreadSource() override {
+    stop();
+    close(m_fd);
+  }
+
+protected:
+  bool produce(char *dst, size_t capacity, size_t *size) override {
+    *size = std::min<uint64_t>(capacity, m_size - m_offset);
+    if (!preadFully(m_fd, dst, *size, m_offset)) {
+      return false;
+    }
+    m_offset += *size;
+    return true;
+  }
+
+private:
+  int m_fd;
+  uint64_t m_size;
+  uint64_t m_offset = 0;
+};
+
+#ifdef MATCH_HAVE_ZSTD
+/*
+ * decompresses on its own thread, the compressed input comes from any other source (so with pread io, decoding
+ * and parsing all run concurrently). only two decompressed chunks exist at a time
+ */
+class ZstdSource : public ThreadedSource {
+public:
+  explicit ZstdSource(std::unique_ptr<ByteSource> input)
+      : ThreadedSource(ZSTD_DStreamOutSize() * 32), m_input(std::move(input)), m_stream(ZSTD_createDStream()) {
+    ZSTD_initDStream(m_stream);
+    start();
+  }
+
+  ~ZstdSource() override {
+    stop();
+    ZSTD_freeDStream(m_stream);
+  }
+
+protected:
+  bool produce(char *dst, size_t capacity, size_t *size) override {
+    ZSTD_outBuffer out = {dst, capacity, 0};
+    while (out.pos < out.size) {
+      if (m_in.pos == m_in.size) {
+        /* the decoder may still hold output of input it already took, more input is only needed without progress */
+        if (m_pending != 0) {
+          const size_t before = out.pos;
+          if (!decompress(&out)) {
+            return false;
+          }
+          if (out.pos != before) {
+            continue;
+          }
+        }
+        const char *data = nullptr;
+        size_t n = 0;
+        if (!m_input->next(&data, &n)) {
+          /* a frame cut off in the middle is an error, not the end of the data */
+          if (m_input->failed() || (m_pending != 0)) {
+            BOOST_LOG_TRIVIAL(error) << "compressed input ends inside a zstd frame";
+            return false;
+          }
+          break;
+        }
+        m_in = {data, n, 0};
+      }
+      if (!decompress(&out)) {
+        return false;
+      }
+    }
+    *size = out.pos;
+    return true;
+  }
+
+private:
+  std::unique_ptr<ByteSource> m_input;
+  ZSTD_DStream *m_stream;
+  ZSTD_inBuffer m_in = {nullptr, 0, 0};
+  size_t m_pending = 0;
+
+  bool decompress(ZSTD_outBuffer *out) {
+    const size_t ret = ZSTD_decompressStream(m_stream, out, &m_in);
+    if (ZSTD_isError(ret)) {
+      BOOST_LOG_TRIVIAL(error) << "zstd: " << ZSTD_getErrorName(ret);
+      return false;
+    }
+    m_pending = ret;
+    return true;
+  }
+};
+#endif
+
+}
+
+const char *BinaryReader::strategyName(Strategy strategy) {
+  switch (strategy) {
+    case MMAP:
+      return "mmap";
+    case PREAD:
+      return "pread";
+  }
+  return "unknown";
+}
+
+bool BinaryReader::parseStrategy(const std::string &name, Strategy *strategy) {
+  for (const auto s: {MMAP, PREAD}) {
+    if (name == strategyName(s)) {
+      *strategy = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+BinaryReader::Strategy BinaryReader::defaultStrategy() {
+  static const Strategy strategy = []() {
+    Strategy s = MMAP;
+    const char *env = std::getenv("MATCH_IO");
+    if ((env != nullptr) && !parseStrategy(env, &s)) {
+      BOOST_LOG_TRIVIAL(warning) << "unknown MATCH_IO " << env << ", using mmap";
+    }
+    return s;
+  }();
+  return strategy;
+}
+
+bool BinaryReader::open(const std::string &path, Strategy strategy) {
+  m_source.reset();
+  m_chunk = nullptr;
+  m_chunkSize = 0;
+  m_chunkPos = 0;
+  m_position = 0;
+  m_size = 0;
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st = {};
+  if ((fd == -1) || (fstat(fd, &st) != 0)) {
+    if (fd != -1) {
+      close(fd);
+    }
+    return false;
+  }
+  m_size = st.st_size;
+  /* detected by content, an archive may be renamed */
+  uint32_t magic = 0;
+  const bool compressed = (pread(fd, &magic, sizeof(magic), 0) == sizeof(magic)) && (magic == zstdMagic);
+#ifndef MATCH_HAVE_ZSTD
+  if (compressed) {
+    BOOST_LOG_TRIVIAL(error) << path << " is zstd compressed, but built without zstd";
+    close(fd);
+    return false;
+  }
+#else
+  /* the size of the frame when its header has it, colmap files are compressed as one frame */
+  uint64_t decompressedSize = 0;
+  if (compressed) {
+    char frameHeader[18];
+    const ssize_t n = pread(fd, frameHeader, sizeof(frameHeader), 0);
+    const unsigned long long contentSize = n > 0 ? ZSTD_getFrameContentSize(frameHeader, n) : ZSTD_CONTENTSIZE_ERROR;
+    if ((contentSize != ZSTD_CONTENTSIZE_UNKNOWN) && (contentSize != ZSTD_CONTENTSIZE_ERROR)) {
+      decompressedSize = contentSize;
+    } else {
+      /* streamed without a size: every block of at most 128 KiB takes at least 4 compressed bytes */
+      decompressedSize = std::min(m_size, std::numeric_limits<uint64_t>::max() / maxZstdRatio) * maxZstdRatio;
+    }
+  }
+#endif
+  switch (strategy) {
+    case MMAP:
+      m_source = std::make_unique<MmapSource>(fd, m_size);
+      break;
+    case PREAD:
+      m_source = std::make_unique<PreadSource>(fd, m_size);
+      break;
+  }
+#ifdef MATCH_HAVE_ZSTD
+  if (compressed && !m_source->failed()) {
+    m_source = std::make_unique<ZstdSource>(std::move(m_source));
+    m_size = decompressedSize;
+  }
+#endif
+  return !m_source->failed();
+}
+
+bool BinaryReader::nextChunk() {
+  m_chunkPos = 0;
+  m_chunkSize = 0;
+  while (m_source && m_source->next(&m_chunk, &m_chunkSize)) {
+    if (m_chunkSize > 0) {
+      return true;
+    }
+  }
+  m_chunk = nullptr;
+  m_chunkSize = 0;
+  return false;
+}
+
+bool BinaryReader::read(void *dst, size_t n) {
+  auto *out = static_cast<char *>(dst);
+  while (n > 0) {
+    if ((m_chunkPos == m_chunkSize) && !nextChunk()) {
+      return false;
+    }
+    const size_t k = std::min(n, m_chunkSize - m_chunkPos);
+    memcpy(out, m_chunk + m_chunkPos, k);
+    out += k;
+    n -= k;
+    m_chunkPos += k;
+    m_position += k;
+  }
+  return true;
+}
+
+bool BinaryReader::readString(std::string *s) {
+  s->clear();
+  while (true) {
+    if ((m_chunkPos == m_chunkSize) && !nextChunk()) {
+      return false;
+    }
+    const char *begin = m_chunk + m_chunkPos;
+    const auto *end = static_cast<const char *>(memchr(begin, 0, m_chunkSize - m_chunkPos));
+    const size_t k = end ? end - begin : m_chunkSize - m_chunkPos;
+    s->append(begin, k);
+    m_chunkPos += k;
+    m_position += k;
+    if (end) {
+      m_chunkPos++;
+      m_position++;
+      return true;
+    }
+  }
+}
+
+const char *BinaryReader::view(size_t n) {
+  static const char empty = 0;
+  if (n == 0) {
+    return &empty;
+  }
+  if (m_chunkSize - m_chunkPos >= n) {
+    const char *data = m_chunk + m_chunkPos;
+    m_chunkPos += n;
+    m_position += n;
+    return data;
+  }
+  /* a corrupt count must not turn into a huge allocation */
+  if (n > remaining()) {
+    return nullptr;
+  }
+  m_scratch.resize(n);
+  return read(m_scratch.data(), n) ? m_scratch.data() : nullptr;
+}
+
+bool BinaryReader::atEnd() {
+  return (m_chunkPos == m_chunkSize) && !nextChunk();
+}
+
+bool BinaryReader::failed() const {
+  return (m_source == nullptr) || m_source->failed();
+}
@@ -0,0 +1,82 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_BINARYREADER_H
+#define MATCH_MANUALLY_BINARYREADER_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* a file as consecutive chunks, a chunk stays valid until the next call to next() */
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+
+  /* false at the end of the file and on errors, failed() tells them apart */
+  virtual bool next(const char **data, size_t *size) = 0;
+
+  virtual bool failed() const = 0;
+};
+
+/*
+ * sequential reader for the colmap binary files. the parser pulls records while the backend is still reading, so
+ * io of cold or network mounted files overlaps with parsing instead of faulting in the whole file first
+ *   MMAP      whole file mapped with MADV_SEQUENTIAL, kernel readahead, best on a warm page cache
+ *   PREAD     chunks read by a background thread into two buffers, one is parsed while the other is filled
+ * zstd compressed files (MATCH_HAVE_ZSTD) are read the same way and decompressed chunk by chunk on another thread
+ */
+class BinaryReader {
+public:
+  enum Strategy {
+    MMAP,
+    PREAD
+  };
+
+  static const char *strategyName(Strategy strategy);
+
+  static bool parseStrategy(const std::string &name, Strategy *strategy);
+
+  /* MATCH_IO=mmap|pread, mmap otherwise */
+  static Strategy defaultStrategy();
+
+  bool open(const std::string &path, Strategy strategy);
+
+  bool read(void *dst, size_t n);
+
+  template<typename T>
+  bool read(T *value) { return read(value, sizeof(T)); }
+
+  /* NUL terminated */
+  bool readString(std::string *s);
+
+  /* n contiguous bytes, only copied when they span two chunks. valid until the next call, nullptr past the end */
+  const char *view(size_t n);
+
+  /* also true after an error, check failed() */
+  bool atEnd();
+
+  bool failed() const;
+
+  uint64_t position() const { return m_position; }
+
+  /* bytes left to parse, an upper bound for compressed files whose frame header does not store the size */
+  uint64_t remaining() const { return m_position < m_size ? m_size - m_position : 0; }
+
+private:
+  std::unique_ptr<ByteSource> m_source;
+  const char *m_chunk = nullptr;
+  size_t m_chunkSize = 0;
+  size_t m_chunkPos = 0;
+  uint64_t m_position = 0;
+  uint64_t m_size = 0;
+  std::vector<char> m_scratch;
+
+  bool nextChunk();
+};
+
+
+#endif //MATCH_MANUALLY_BINARYREADER_H
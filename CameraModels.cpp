@@ -0,0 +1,62 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include "CameraModels.h"
+
+const char *CameraModel::name(int model_id) {
+  switch (model_id) {
+    case SimplePinholeCameraModel::kModelId:
+      return "SIMPLE_PINHOLE";
+    case PinholeCameraModel::kModelId:
+      return "PINHOLE";
+    case SimpleRadialCameraModel::kModelId:
+      return "SIMPLE_RADIAL";
+    case RadialCameraModel::kModelId:
+      return "RADIAL";
+    case OpenCVCameraModel::kModelId:
+      return "OPENCV";
+    case OpenCVFisheyeCameraModel::kModelId:
+      return "OPENCV_FISHEYE";
+    case FullOpenCVCameraModel::kModelId:
+      return "FULL_OPENCV";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+int CameraModel::numParams(int model_id) {
+  switch (model_id) {
+    case SimplePinholeCameraModel::kModelId:
+      return SimplePinholeCameraModel::kNumParams;
+    case PinholeCameraModel::kModelId:
+      return PinholeCameraModel::kNumParams;
+    case SimpleRadialCameraModel::kModelId:
+      return SimpleRadialCameraModel::kNumParams;
+    case RadialCameraModel::kModelId:
+      return RadialCameraModel::kNumParams;
+    case OpenCVCameraModel::kModelId:
+      return OpenCVCameraModel::kNumParams;
+    case OpenCVFisheyeCameraModel::kModelId:
+      return OpenCVFisheyeCameraModel::kNumParams;
+    case FullOpenCVCameraModel::kModelId:
+      return FullOpenCVCameraModel::kNumParams;
+    default:
+      return -1;
+  }
+}
+
+bool CameraModel::project(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector3d *points,
+                          Eigen::Vector2d *pixels, size_t n) {
+  return visit(camera, [&](const auto &model) { projectPoints(model, points, pixels, n); });
+}
+
+bool CameraModel::distort(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector2d *normalized,
+                          Eigen::Vector2d *pixels, size_t n) {
+  return visit(camera, [&](const auto &model) { distortPoints(model, normalized, pixels, n); });
+}
+
+bool CameraModel::undistort(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector2d *pixels,
+                            Eigen::Vector2d *normalized, size_t n) {
+  return visit(camera, [&](const auto &model) { undistortPoints(model, pixels, normalized, n); });
+}
@@ -0,0 +1,337 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_CAMERAMODELS_H
+#define MATCH_MANUALLY_CAMERAMODELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <Eigen/Eigen>
+#include "colampParser.h"
+
+/*
+ * colmap camera models, one class per model_id with colmap's parameter layout. the batch kernels below are
+ * templates over the model, a caller picks the model once per camera (CameraModel::visit) and the per point work
+ * is inlined straight line code. points go through the kernels in fixed size blocks copied into plain arrays, so
+ * the inner loops have a constant trip count, no aliasing and no branches, and gcc -O2 vectorizes them for the
+ * polynomial models. the fisheye model branches on the radius and calls atan, its loops stay scalar
+ *   project    camera coordinates to pixels, points behind the camera become NaN
+ *   distort    normalized image coordinates (x / z, y / z) to pixels
+ *   undistort  pixels to normalized image coordinates, newton iterations as in colmap for the distorted models
+ */
+struct CameraIntrinsics {
+  double fx, fy, cx, cy;
+};
+
+struct SimplePinholeCameraModel : CameraIntrinsics {
+  static const int kModelId = 0;
+  static const int kNumParams = 3;
+  static const bool kDistorted = false;
+
+  explicit SimplePinholeCameraModel(const double *p) : CameraIntrinsics{p[0], p[0], p[1], p[2]} {}
+
+  void distortion(double, double, double *du, double *dv) const {
+    *du = 0;
+    *dv = 0;
+  }
+};
+
+struct PinholeCameraModel : CameraIntrinsics {
+  static const int kModelId = 1;
+  static const int kNumParams = 4;
+  static const bool kDistorted = false;
+
+  explicit PinholeCameraModel(const double *p) : CameraIntrinsics{p[0], p[1], p[2], p[3]} {}
+
+  void distortion(double, double, double *du, double *dv) const {
+    *du = 0;
+    *dv = 0;
+  }
+};
+
+struct SimpleRadialCameraModel : CameraIntrinsics {
+  static const int kModelId = 2;
+  static const int kNumParams = 4;
+  static const bool kDistorted = true;
+  double k;
+
+  explicit SimpleRadialCameraModel(const double *p) : CameraIntrinsics{p[0], p[0], p[1], p[2]}, k(p[3]) {}
+
+  void distortion(double u, double v, double *du, double *dv) const {
+    const double radial = k * (u * u + v * v);
+    *du = u * radial;
+    *dv = v * radial;
+  }
+};
+
+struct RadialCameraModel : CameraIntrinsics {
+  static const int kModelId = 3;
+  static const int kNumParams = 5;
+  static const bool kDistorted = true;
+  double k1, k2;
+
+  explicit RadialCameraModel(const double *p) : CameraIntrinsics{p[0], p[0], p[1], p[2]}, k1(p[3]), k2(p[4]) {}
+
+  void distortion(double u, double v, double *du, double *dv) const {
+    const double r2 = u * u + v * v;
+    const double radial = k1 * r2 + k2 * r2 * r2;
+    *du = u * radial;
+    *dv = v * radial;
+  }
+};
+
+struct OpenCVCameraModel : CameraIntrinsics {
+  static const int kModelId = 4;
+  static const int kNumParams = 8;
+  static const bool kDistorted = true;
+  double k1, k2, p1, p2;
+
+  explicit OpenCVCameraModel(const double *p)
+      : CameraIntrinsics{p[0], p[1], p[2], p[3]}, k1(p[4]), k2(p[5]), p1(p[6]), p2(p[7]) {}
+
+  void distortion(double u, double v, double *du, double *dv) const {
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double radial = k1 * r2 + k2 * r2 * r2;
+    *du = u * radial + 2 * p1 * uv + p2 * (r2 + 2 * u2);
+    *dv = v * radial + 2 * p2 * uv + p1 * (r2 + 2 * v2);
+  }
+};
+
+struct OpenCVFisheyeCameraModel : CameraIntrinsics {
+  static const int kModelId = 5;
+  static const int kNumParams = 8;
+  static const bool kDistorted = true;
+  double k1, k2, k3, k4;
+
+  explicit OpenCVFisheyeCameraModel(const double *p)
+      : CameraIntrinsics{p[0], p[1], p[2], p[3]}, k1(p[4]), k2(p[5]), k3(p[6]), k4(p[7]) {}
+
+  /* no branch on the image center, the scale goes to 1 there instead */
+  void distortion(double u, double v, double *du, double *dv) const {
+    const double r = std::sqrt(u * u + v * v);
+    const double theta = std::atan(r);
+    const double theta2 = theta * theta;
+    const double theta4 = theta2 * theta2;
+    const double thetad = theta * (1 + k1 * theta2 + k2 * theta4 + k3 * theta2 * theta4 + k4 * theta4 * theta4);
+    const double scale = r > std::numeric_limits<double>::epsilon() ? thetad / r - 1 : 0.;
+    *du = u * scale;
+    *dv = v * scale;
+  }
+};
+
+struct FullOpenCVCameraModel : CameraIntrinsics {
+  static const int kModelId = 6;
+  static const int kNumParams = 12;
+  static const bool kDistorted = true;
+  double k1, k2, p1, p2, k3, k4, k5, k6;
+
+  explicit FullOpenCVCameraModel(const double *p)
+      : CameraIntrinsics{p[0], p[1], p[2], p[3]}, k1(p[4]), k2(p[5]), p1(p[6]), p2(p[7]), k3(p[8]), k4(p[9]),
+        k5(p[10]), k6(p[11]) {}
+
+  void distortion(double u, double v, double *du, double *dv) const {
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double r4 = r2 * r2;
+    const double r6 = r4 * r2;
+    const double radial = (1 + k1 * r2 + k2 * r4 + k3 * r6) / (1 + k4 * r2 + k5 * r4 + k6 * r6);
+    *du = u * radial + 2 * p1 * uv + p2 * (r2 + 2 * u2) - u;
+    *dv = v * radial + 2 * p2 * uv + p1 * (r2 + 2 * v2) - v;
+  }
+};
+
+namespace camera_kernels {
+const size_t kBlock = 16;
+const int kUndistortIterations = 100;
+const double kUndistortMaxStepNorm = 1e-10;
+const double kUndistortRelStepSize = 1e-6;
+
+/* normalized to pixel in place */
+template<typename Model>
+inline void distortBlock(const Model &model, double *u, double *v) {
+  for (size_t j = 0; j < kBlock; j++) {
+    double du, dv;
+    model.distortion(u[j], v[j], &du, &dv);
+    u[j] = model.fx * (u[j] + du) + model.cx;
+    v[j] = model.fy * (v[j] + dv) + model.cy;
+  }
+}
+
+/*
+ * pixel to normalized in place, newton with a numeric jacobian. the step loop runs on every point of the block
+ * without branches so it vectorizes, a point is taken out as it is after its first step below the threshold, as
+ * colmap stops there. the block iterates until every point settled
+ */
+template<typename Model>
+inline void undistortBlock(const Model &model, double *u, double *v) {
+  for (size_t j = 0; j < kBlock; j++) {
+    u[j] = (u[j] - model.cx) / model.fx;
+    v[j] = (v[j] - model.cy) / model.fy;
+  }
+  if (!Model::kDistorted) {
+    return;
+  }
+  /* local copies, the compiler need not check u and v for aliasing */
+  double x[kBlock], y[kBlock], u0[kBlock], v0[kBlock], step[kBlock];
+  bool moving[kBlock];
+  for (size_t j = 0; j < kBlock; j++) {
+    x[j] = u0[j] = u[j];
+    y[j] = v0[j] = v[j];
+    moving[j] = true;
+  }
+  for (int iteration = 0; iteration < kUndistortIterations; iteration++) {
+    for (size_t j = 0; j < kBlock; j++) {
+      const double hu = std::max(std::numeric_limits<double>::epsilon(), std::abs(x[j]) * kUndistortRelStepSize);
+      const double hv = std::max(std::numeric_limits<double>::epsilon(), std::abs(y[j]) * kUndistortRelStepSize);
+      double du, dv, duu, dvu, duv, dvv;
+      model.distortion(x[j], y[j], &du, &dv);
+      model.distortion(x[j] + hu, y[j], &duu, &dvu);
+      model.distortion(x[j], y[j] + hv, &duv, &dvv);
+      const double j00 = 1 + (duu - du) / hu;
+      const double j01 = (duv - du) / hv;
+      const double j10 = (dvu - dv) / hu;
+      const double j11 = 1 + (dvv - dv) / hv;
+      const double ru = x[j] + du - u0[j];
+      const double rv = y[j] + dv - v0[j];
+      const double det = j00 * j11 - j01 * j10;
+      const double su = (j11 * ru - j01 * rv) / det;
+      const double sv = (j00 * rv - j10 * ru) / det;
+      x[j] -= su;
+      y[j] -= sv;
+      step[j] = su * su + sv * sv;
+    }
+    size_t left = 0;
+    for (size_t j = 0; j < kBlock; j++) {
+      if (moving[j] && (step[j] < kUndistortMaxStepNorm)) {
+        moving[j] = false;
+        u[j] = x[j];
+        v[j] = y[j];
+      }
+      left += moving[j];
+    }
+    if (left == 0) {
+      break;
+    }
+  }
+  for (size_t j = 0; j < kBlock; j++) {
+    if (moving[j]) {
+      u[j] = x[j];
+      v[j] = y[j];
+    }
+  }
+}
+
+/* the tail block repeats the last point, so every block runs the full width */
+template<typename In, typename Load, typename Kernel, typename Store>
+inline void forBlocks(const In *in, size_t n, Load &&load, Kernel &&kernel, Store &&store) {
+  double u[kBlock], v[kBlock];
+  for (size_t begin = 0; begin < n; begin += kBlock) {
+    const size_t m = std::min(kBlock, n - begin);
+    for (size_t j = 0; j < kBlock; j++) {
+      load(in[begin + std::min(j, m - 1)], &u[j], &v[j], j);
+    }
+    kernel(u, v);
+    for (size_t j = 0; j < m; j++) {
+      store(begin + j, u[j], v[j], j);
+    }
+  }
+}
+}
+
+template<typename Model>
+void projectPoints(const Model &model, const Eigen::Vector3d *points, Eigen::Vector2d *pixels, size_t n) {
+  bool front[camera_kernels::kBlock];
+  camera_kernels::forBlocks(points, n, [&](const Eigen::Vector3d &p, double *u, double *v, size_t j) {
+    front[j] = p.z() > 0;
+    *u = p.x() / p.z();
+    *v = p.y() / p.z();
+  }, [&](double *u, double *v) { camera_kernels::distortBlock(model, u, v); },
+                            [&](size_t i, double u, double v, size_t j) {
+    pixels[i] = front[j] ? Eigen::Vector2d(u, v) :
+                Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN());
+  });
+}
+
+template<typename Model>
+void distortPoints(const Model &model, const Eigen::Vector2d *normalized, Eigen::Vector2d *pixels, size_t n) {
+  camera_kernels::forBlocks(normalized, n, [](const Eigen::Vector2d &p, double *u, double *v, size_t) {
+    *u = p.x();
+    *v = p.y();
+  }, [&](double *u, double *v) { camera_kernels::distortBlock(model, u, v); },
+                            [&](size_t i, double u, double v, size_t) { pixels[i] = Eigen::Vector2d(u, v); });
+}
+
+template<typename Model>
+void undistortPoints(const Model &model, const Eigen::Vector2d *pixels, Eigen::Vector2d *normalized, size_t n) {
+  camera_kernels::forBlocks(pixels, n, [](const Eigen::Vector2d &p, double *u, double *v, size_t) {
+    *u = p.x();
+    *v = p.y();
+  }, [&](double *u, double *v) { camera_kernels::undistortBlock(model, u, v); },
+                            [&](size_t i, double u, double v, size_t) { normalized[i] = Eigen::Vector2d(u, v); });
+}
+
+/* runtime side, the model of a camera is looked up once and the whole batch runs in the specialized kernel */
+class CameraModel {
+public:
+  static const int kModelCount = 7;
+
+  static bool supported(int model_id) { return (model_id >= 0) && (model_id < kModelCount); }
+
+  static const char *name(int model_id);
+
+  /* -1 for unknown models */
+  static int numParams(int model_id);
+
+  /* calls f(model) with the model class of the camera, false for unknown models or a wrong parameter count */
+  template<typename F>
+  static bool visit(const ColmapLoader::SceneCameraInfo &camera, F &&f) {
+    if (static_cast<int>(camera.params.size()) != numParams(camera.model_id)) {
+      return false;
+    }
+    const double *p = camera.params.data();
+    switch (camera.model_id) {
+      case SimplePinholeCameraModel::kModelId:
+        f(SimplePinholeCameraModel(p));
+        return true;
+      case PinholeCameraModel::kModelId:
+        f(PinholeCameraModel(p));
+        return true;
+      case SimpleRadialCameraModel::kModelId:
+        f(SimpleRadialCameraModel(p));
+        return true;
+      case RadialCameraModel::kModelId:
+        f(RadialCameraModel(p));
+        return true;
+      case OpenCVCameraModel::kModelId:
+        f(OpenCVCameraModel(p));
+        return true;
+      case OpenCVFisheyeCameraModel::kModelId:
+        f(OpenCVFisheyeCameraModel(p));
+        return true;
+      case FullOpenCVCameraModel::kModelId:
+        f(FullOpenCVCameraModel(p));
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool project(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector3d *points,
+                      Eigen::Vector2d *pixels, size_t n);
+
+  static bool distort(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector2d *normalized,
+                      Eigen::Vector2d *pixels, size_t n);
+
+  static bool undistort(const ColmapLoader::SceneCameraInfo &camera, const Eigen::Vector2d *pixels,
+                        Eigen::Vector2d *normalized, size_t n);
+};
+
+
+#endif //MATCH_MANUALLY_CAMERAMODELS_H
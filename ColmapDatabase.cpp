@@ -0,0 +1,291 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <cstring>
+#include <sqlite3.h>
+#include <boost/log/trivial.hpp>
+#include "ColmapDatabase.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+/* finalizes on every return path */
+struct Statement {
+  sqlite3_stmt *stmt;
+
+  explicit Statement(sqlite3_stmt *s) : stmt(s) {}
+
+  Statement(const Statement &) = delete;
+
+  Statement &operator=(const Statement &) = delete;
+
+  ~Statement() { sqlite3_finalize(stmt); }
+};
+
+struct KeypointBlob {
+  int rows;
+  int cols;
+  std::vector<float> data;
+};
+
+/* matches blobs are rows x 2 uint32, swapped selects the column order */
+void decodeMatches(const void *blob, int bytes, int rows, bool swapped,
+                   std::vector<std::pair<ColmapDatabase::point2D_t, ColmapDatabase::point2D_t>> *result) {
+  result->clear();
+  if ((blob == nullptr) || (rows <= 0) || (bytes < rows * 2 * static_cast<int>(sizeof(uint32_t)))) {
+    return;
+  }
+  std::vector<uint32_t> data(static_cast<size_t>(rows) * 2);
+  memcpy(data.data(), blob, data.size() * sizeof(uint32_t));
+  result->resize(rows);
+  for (int i = 0; i < rows; i++) {
+    (*result)[i] = swapped ? std::make_pair(data[2 * i + 1], data[2 * i])
+                           : std::make_pair(data[2 * i], data[2 * i + 1]);
+  }
+}
+}
+
+ColmapDatabase::~ColmapDatabase() {
+  close();
+}
+
+ColmapDatabase::image_pair_t ColmapDatabase::pairId(image_t image_id1, image_t image_id2) {
+  if (image_id1 > image_id2) {
+    std::swap(image_id1, image_id2);
+  }
+  return kMaxNumImages * image_id1 + image_id2;
+}
+
+void ColmapDatabase::pairIdToImages(image_pair_t pair_id, image_t *image_id1, image_t *image_id2) {
+  *image_id2 = static_cast<image_t>(pair_id % kMaxNumImages);
+  *image_id1 = static_cast<image_t>((pair_id - *image_id2) / kMaxNumImages);
+}
+
+bool ColmapDatabase::open(const std::string &path, size_t threads) {
+  TRACE_SCOPE("ColmapDatabase::open");
+  close();
+  if (sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "unable to open colmap database " << path << ": " << sqlite3_errmsg(m_db);
+    close();
+    return false;
+  }
+  m_path = path;
+  if (!readCameras() || !readImages() || !readKeypoints(threads)) {
+    close();
+    return false;
+  }
+  updateMemoryGauge();
+  BOOST_LOG_TRIVIAL(info) << "database " << path << ": " << cameras.size() << " cameras, " << images.size()
+                          << " images";
+  return true;
+}
+
+void ColmapDatabase::close() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_db != nullptr) {
+    sqlite3_close(m_db);
+    m_db = nullptr;
+  }
+  m_path.clear();
+  cameras.clear();
+  images.clear();
+  keypoints.clear();
+  m_memory.set(0);
+}
+
+sqlite3_stmt *ColmapDatabase::prepare(const char *sql) const {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "database " << m_path << ": " << sqlite3_errmsg(m_db) << " in " << sql;
+    sqlite3_finalize(stmt);
+    return nullptr;
+  }
+  return stmt;
+}
+
+bool ColmapDatabase::readCameras() {
+  Statement s(prepare("SELECT camera_id, model, width, height, params FROM cameras"));
+  if (s.stmt == nullptr) {
+    return false;
+  }
+  while (sqlite3_step(s.stmt) == SQLITE_ROW) {
+    Camera camera = {
+        .camera_id = static_cast<camera_t>(sqlite3_column_int64(s.stmt, 0)),
+        .model_id = sqlite3_column_int(s.stmt, 1),
+        .width = static_cast<uint64_t>(sqlite3_column_int64(s.stmt, 2)),
+        .height = static_cast<uint64_t>(sqlite3_column_int64(s.stmt, 3))
+    };
+    const int bytes = sqlite3_column_bytes(s.stmt, 4);
+    camera.params.resize(bytes / sizeof(double));
+    if (bytes > 0) {
+      memcpy(camera.params.data(), sqlite3_column_blob(s.stmt, 4), camera.params.size() * sizeof(double));
+    }
+    cameras.push_back(std::move(camera));
+  }
+  return true;
+}
+
+bool ColmapDatabase::readImages() {
+  Statement s(prepare("SELECT image_id, name, camera_id FROM images ORDER BY image_id"));
+  if (s.stmt == nullptr) {
+    return false;
+  }
+  while (sqlite3_step(s.stmt) == SQLITE_ROW) {
+    Image image = {
+        .image_id = static_cast<image_t>(sqlite3_column_int64(s.stmt, 0)),
+        .camera_id = static_cast<camera_t>(sqlite3_column_int64(s.stmt, 2)),
+        .name = reinterpret_cast<const char *>(sqlite3_column_text(s.stmt, 1))
+    };
+    images.push_back(std::move(image));
+  }
+  return true;
+}
+
+bool ColmapDatabase::readKeypoints(size_t threads) {
+  TRACE_SCOPE("ColmapDatabase::readKeypoints");
+  std::map<image_t, size_t> imageRows;
+  for (size_t i = 0; i < images.size(); i++) {
+    imageRows[images[i].image_id] = i;
+  }
+
+  /* sqlite is single threaded per connection, copy the blobs out first and decode them afterwards */
+  std::vector<KeypointBlob> blobs(images.size());
+  {
+    TRACE_SCOPE("ColmapDatabase::fetchKeypointBlobs");
+    Statement s(prepare("SELECT image_id, rows, cols, data FROM keypoints"));
+    if (s.stmt == nullptr) {
+      return false;
+    }
+    while (sqlite3_step(s.stmt) == SQLITE_ROW) {
+      auto it = imageRows.find(static_cast<image_t>(sqlite3_column_int64(s.stmt, 0)));
+      if (it == imageRows.end()) {
+        continue;
+      }
+      auto &blob = blobs[it->second];
+      blob.rows = sqlite3_column_int(s.stmt, 1);
+      blob.cols = sqlite3_column_int(s.stmt, 2);
+      const int bytes = sqlite3_column_bytes(s.stmt, 3);
+      if ((blob.rows < 0) || (blob.cols < 2) ||
+          (static_cast<size_t>(bytes) < static_cast<size_t>(blob.rows) * blob.cols * sizeof(float))) {
+        BOOST_LOG_TRIVIAL(warning) << "bad keypoint blob of image " << it->first << ": " << blob.rows << "x"
+                                   << blob.cols << " in " << bytes << " bytes";
+        blob.rows = 0;
+        continue;
+      }
+      blob.data.resize(static_cast<size_t>(blob.rows) * blob.cols);
+      memcpy(blob.data.data(), sqlite3_column_blob(s.stmt, 3), blob.data.size() * sizeof(float));
+    }
+  }
+
+  /* rows are x, y followed by the affine shape (scale, orientation or a 2x2 matrix), only the position is kept */
+  keypoints.assign(images.size(), {});
+  parallelFor(blobs.size(), [&](size_t i) {
+    auto &blob = blobs[i];
+    auto &kps = keypoints[i];
+    kps.resize(blob.rows);
+    for (int r = 0; r < blob.rows; r++) {
+      kps[r] = Eigen::Vector2f(blob.data[r * blob.cols], blob.data[r * blob.cols + 1]);
+    }
+    std::vector<float>().swap(blob.data);
+  }, threads);
+  return true;
+}
+
+void ColmapDatabase::updateMemoryGauge() {
+  uint64_t bytes = cameras.capacity() * sizeof(Camera) + images.capacity() * sizeof(Image) +
+                   keypoints.capacity() * sizeof(keypoints[0]);
+  for (const auto &camera: cameras) {
+    bytes += camera.params.capacity() * sizeof(double);
+  }
+  for (const auto &image: images) {
+    bytes += image.name.capacity();
+  }
+  for (const auto &kps: keypoints) {
+    bytes += kps.capacity() * sizeof(Eigen::Vector2f);
+  }
+  m_memory.set(bytes);
+}
+
+bool ColmapDatabase::readMatches(image_t image_id1, image_t image_id2, MatchKind kind, PairMatches *result) const {
+  TRACE_SCOPE("ColmapDatabase::readMatches");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_db == nullptr) {
+    return false;
+  }
+  Statement s(prepare(kind == RAW_MATCHES ?
+                      "SELECT rows, cols, data FROM matches WHERE pair_id = ?" :
+                      "SELECT rows, cols, data, config, F FROM two_view_geometries WHERE pair_id = ?"));
+  if (s.stmt == nullptr) {
+    return false;
+  }
+  sqlite3_bind_int64(s.stmt, 1, static_cast<sqlite3_int64>(pairId(image_id1, image_id2)));
+  if (sqlite3_step(s.stmt) != SQLITE_ROW) {
+    return false;
+  }
+  /* the blob is stored in ascending image id order */
+  const bool swapped = image_id1 > image_id2;
+  result->image_id1 = image_id1;
+  result->image_id2 = image_id2;
+  decodeMatches(sqlite3_column_blob(s.stmt, 2), sqlite3_column_bytes(s.stmt, 2), sqlite3_column_int(s.stmt, 0),
+                swapped, &result->matches);
+  result->config = 0;
+  result->F.setZero();
+  if (kind == VERIFIED_MATCHES) {
+    result->config = sqlite3_column_int(s.stmt, 3);
+    if (sqlite3_column_bytes(s.stmt, 4) == 9 * sizeof(double)) {
+      Eigen::Matrix<double, 3, 3, Eigen::RowMajor> F;
+      memcpy(F.data(), sqlite3_column_blob(s.stmt, 4), 9 * sizeof(double));
+      result->F = swapped ? Eigen::Matrix3d(F.transpose()) : Eigen::Matrix3d(F);
+    }
+  }
+  return true;
+}
+
+std::vector<std::pair<ColmapDatabase::image_t, ColmapDatabase::image_t>>
+ColmapDatabase::listPairs(MatchKind kind) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<std::pair<image_t, image_t>> pairs;
+  if (m_db == nullptr) {
+    return pairs;
+  }
+  Statement s(prepare(kind == RAW_MATCHES ?
+                      "SELECT pair_id FROM matches WHERE rows > 0" :
+                      "SELECT pair_id FROM two_view_geometries WHERE rows > 0"));
+  if (s.stmt == nullptr) {
+    return pairs;
+  }
+  while (sqlite3_step(s.stmt) == SQLITE_ROW) {
+    image_t image_id1, image_id2;
+    pairIdToImages(static_cast<image_pair_t>(sqlite3_column_int64(s.stmt, 0)), &image_id1, &image_id2);
+    pairs.emplace_back(image_id1, image_id2);
+  }
+  return pairs;
+}
+
+bool ColmapDatabase::readDescriptors(image_t image_id, Descriptors *result) const {
+  TRACE_SCOPE("ColmapDatabase::readDescriptors");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_db == nullptr) {
+    return false;
+  }
+  Statement s(prepare("SELECT rows, cols, data FROM descriptors WHERE image_id = ?"));
+  if (s.stmt == nullptr) {
+    return false;
+  }
+  sqlite3_bind_int64(s.stmt, 1, image_id);
+  if (sqlite3_step(s.stmt) != SQLITE_ROW) {
+    return false;
+  }
+  const int rows = sqlite3_column_int(s.stmt, 0);
+  const int cols = sqlite3_column_int(s.stmt, 1);
+  if ((rows < 0) || (cols < 0) || (sqlite3_column_bytes(s.stmt, 2) < rows * cols)) {
+    BOOST_LOG_TRIVIAL(warning) << "bad descriptor blob of image " << image_id;
+    return false;
+  }
+  result->resize(rows, cols);
+  if (rows * cols > 0) {
+    memcpy(result->data(), sqlite3_column_blob(s.stmt, 2), static_cast<size_t>(rows) * cols);
+  }
+  return true;
+}
@@ -0,0 +1,122 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_COLMAPDATABASE_H
+#define MATCH_MANUALLY_COLMAPDATABASE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Eigen/Eigen>
+#include "MemoryAccounting.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/*
+ * reader of the colmap feature database (database.db). cameras, images and keypoints are read up front, the
+ * keypoint blobs are fetched in one pass and decoded in parallel. match lists are only read when a pair is
+ * asked for, a database of a few thousand images holds millions of pairs
+ */
+class ColmapDatabase {
+public:
+  typedef uint32_t camera_t;
+  typedef uint32_t image_t;
+  typedef uint32_t point2D_t;
+  typedef uint64_t image_pair_t;
+
+  /* same limit colmap uses to pack two image ids into a pair id */
+  static const image_pair_t kMaxNumImages = 2147483647;
+
+  enum MatchKind {
+    /* matches table, everything the matcher produced */
+    RAW_MATCHES,
+    /* two_view_geometries table, inliers of the geometric verification */
+    VERIFIED_MATCHES
+  };
+
+  struct Camera {
+    camera_t camera_id;
+    int model_id;
+    uint64_t width;
+    uint64_t height;
+    std::vector<double> params;
+  };
+
+  struct Image {
+    image_t image_id;
+    camera_t camera_id;
+    std::string name;
+  };
+
+  struct PairMatches {
+    image_t image_id1;
+    image_t image_id2;
+    /* keypoint index in image_id1, keypoint index in image_id2, in the order the pair was asked for */
+    std::vector<std::pair<point2D_t, point2D_t>> matches;
+    /* two view geometry type (colmap TwoViewGeometry::ConfigurationType), 0 for raw matches */
+    int config = 0;
+    /* fundamental matrix mapping image_id1 points to image_id2 lines, zero when not estimated */
+    Eigen::Matrix3d F = Eigen::Matrix3d::Zero();
+  };
+
+  ColmapDatabase() = default;
+
+  ColmapDatabase(const ColmapDatabase &) = delete;
+
+  ColmapDatabase &operator=(const ColmapDatabase &) = delete;
+
+  ~ColmapDatabase();
+
+  static image_pair_t pairId(image_t image_id1, image_t image_id2);
+
+  static void pairIdToImages(image_pair_t pair_id, image_t *image_id1, image_t *image_id2);
+
+  /* opens read only and reads cameras, images and keypoints, threads 0 decodes on every hardware thread */
+  bool open(const std::string &path, size_t threads = 0);
+
+  void close();
+
+  bool isOpen() const { return m_db != nullptr; }
+
+  const std::string &path() const { return m_path; }
+
+  /* false when the pair has no row, matches of an empty row are a valid empty list */
+  bool readMatches(image_t image_id1, image_t image_id2, MatchKind kind, PairMatches *result) const;
+
+  /* pairs with at least one match of this kind */
+  std::vector<std::pair<image_t, image_t>> listPairs(MatchKind kind) const;
+
+  /* rows are keypoints */
+  typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Descriptors;
+
+  /* descriptors are not needed for display, they are only read on request */
+  bool readDescriptors(image_t image_id, Descriptors *result) const;
+
+  std::vector<Camera> cameras;
+  std::vector<Image> images;
+  /* pixel positions, keypoint i of images[j] is keypoints[j][i] */
+  std::vector<std::vector<Eigen::Vector2f>> keypoints;
+
+private:
+  sqlite3 *m_db = nullptr;
+  std::string m_path;
+  /* one connection, lazy reads may come from the gui and from worker threads */
+  mutable std::mutex m_mutex;
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::COLMAP_LOADER, MemoryAccounting::HOST};
+
+  bool readCameras();
+
+  bool readImages();
+
+  bool readKeypoints(size_t threads);
+
+  void updateMemoryGauge();
+
+  sqlite3_stmt *prepare(const char *sql) const;
+};
+
+
+#endif //MATCH_MANUALLY_COLMAPDATABASE_H
@@ -0,0 +1,374 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <sqlite3.h>
+#include <boost/log/trivial.hpp>
+#include "ColmapDatabase.h"
+#include "ColmapDatabaseWriter.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+/* prepared once, reset between rows */
+class Statement {
+public:
+  Statement(sqlite3 *db, const char *sql) {
+    if (sqlite3_prepare_v2(db, sql, -1, &m_stmt, nullptr) != SQLITE_OK) {
+      BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db) << " in " << sql;
+      sqlite3_finalize(m_stmt);
+      m_stmt = nullptr;
+    }
+  }
+
+  Statement(const Statement &) = delete;
+
+  Statement &operator=(const Statement &) = delete;
+
+  ~Statement() { sqlite3_finalize(m_stmt); }
+
+  sqlite3_stmt *get() { return m_stmt; }
+
+  sqlite3_stmt *reset() {
+    sqlite3_reset(m_stmt);
+    sqlite3_clear_bindings(m_stmt);
+    return m_stmt;
+  }
+
+private:
+  sqlite3_stmt *m_stmt = nullptr;
+};
+
+bool exec(sqlite3 *db, const char *sql) {
+  char *error = nullptr;
+  if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "database: " << (error ? error : "unknown error") << " in " << sql;
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+struct PairMatch {
+  ColmapDatabase::image_pair_t pair_id;
+  ColmapDatabase::point2D_t kp1;
+  ColmapDatabase::point2D_t kp2;
+
+  bool operator<(const PairMatch &other) const {
+    return std::tie(pair_id, kp1, kp2) < std::tie(other.pair_id, other.kp1, other.kp2);
+  }
+
+  bool operator==(const PairMatch &other) const {
+    return (pair_id == other.pair_id) && (kp1 == other.kp1) && (kp2 == other.kp2);
+  }
+};
+
+/* existing rows x 2 uint32 blob and the sorted new matches of the same pair, returns the sorted union */
+std::vector<uint32_t> mergeMatches(const void *blob, int rows, const PairMatch *begin, const PairMatch *end,
+                                   uint64_t *added) {
+  std::vector<uint64_t> existing(std::max(rows, 0));
+  for (int i = 0; i < rows; i++) {
+    uint32_t m[2];
+    memcpy(m, static_cast<const uint32_t *>(blob) + 2 * i, sizeof(m));
+    existing[i] = (static_cast<uint64_t>(m[0]) << 32) | m[1];
+  }
+  std::sort(existing.begin(), existing.end());
+  std::vector<uint32_t> result;
+  result.reserve(2 * (existing.size() + (end - begin)));
+  size_t i = 0;
+  auto push = [&](uint64_t m) {
+    result.push_back(static_cast<uint32_t>(m >> 32));
+    result.push_back(static_cast<uint32_t>(m & 0xFFFFFFFFu));
+  };
+  for (auto it = begin; it != end; ++it) {
+    const uint64_t m = (static_cast<uint64_t>(it->kp1) << 32) | it->kp2;
+    while ((i < existing.size()) && (existing[i] < m)) {
+      push(existing[i++]);
+    }
+    if ((i < existing.size()) && (existing[i] == m)) {
+      i++;
+    } else {
+      (*added)++;
+    }
+    push(m);
+  }
+  while (i < existing.size()) {
+    push(existing[i++]);
+  }
+  return result;
+}
+}
+
+bool ColmapDatabaseWriter::exportTrackMatches(const ImageGraphModel &model, const std::string &databasePath,
+                                              const Options &options, Summary *summary) {
+  TRACE_SCOPE("ColmapDatabaseWriter::exportTrackMatches");
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(databasePath.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "unable to open colmap database " << databasePath << ": " << sqlite3_errmsg(db);
+    sqlite3_close(db);
+    return false;
+  }
+  std::unique_ptr<sqlite3, int (*)(sqlite3 *)> dbGuard(db, sqlite3_close);
+
+  /* model image id -> database image id, matched by name */
+  std::map<std::string, ColmapDatabase::image_t> nameIds;
+  {
+    Statement s(db, "SELECT image_id, name FROM images");
+    if (s.get() == nullptr) {
+      return false;
+    }
+    while (sqlite3_step(s.get()) == SQLITE_ROW) {
+      nameIds[reinterpret_cast<const char *>(sqlite3_column_text(s.get(), 1))] =
+          static_cast<ColmapDatabase::image_t>(sqlite3_column_int64(s.get(), 0));
+    }
+  }
+  const auto invalid = std::numeric_limits<ColmapDatabase::image_t>::max();
+  std::vector<ColmapDatabase::image_t> databaseIds(model.imageInfos.empty() ? 0 : model.imageInfos.rbegin()->first + 1,
+                                                   invalid);
+  /* an image registered in several reconstructions is one model image per copy, all of them share its row */
+  std::map<ColmapDatabase::image_t, std::vector<const ImageInfo *>> copies;
+  for (const auto &it: model.imageInfos) {
+    auto name = nameIds.find(it.second.colmap.name);
+    if (name != nameIds.end()) {
+      databaseIds[it.first] = name->second;
+      copies[name->second].push_back(&it.second);
+    }
+  }
+
+  Summary result;
+  /* one transaction for the whole export, a failure leaves the database as it was */
+  if (!exec(db, "BEGIN")) {
+    return false;
+  }
+  auto fail = [&]() {
+    exec(db, "ROLLBACK");
+    return false;
+  };
+
+  /*
+   * hand added keypoints are past the end of the blobs, append them with an identity affine shape. the copies of
+   * one image may have added different keypoints: their keypoints take the id of the row at their position, those
+   * at no row are appended. keypointIds maps their model keypoint ids, it is empty for images with one copy
+   */
+  std::vector<std::vector<ColmapDatabase::point2D_t>> keypointIds(databaseIds.size());
+  {
+    TRACE_SCOPE("ColmapDatabaseWriter::appendKeypoints");
+    Statement selectKeypoints(db, "SELECT rows, cols, data FROM keypoints WHERE image_id = ?");
+    Statement selectDescriptors(db, "SELECT rows, cols, data FROM descriptors WHERE image_id = ?");
+    Statement upsertKeypoints(db, "INSERT OR REPLACE INTO keypoints(image_id, rows, cols, data) VALUES(?, ?, ?, ?)");
+    Statement updateDescriptors(db, "UPDATE descriptors SET rows = ?, data = ? WHERE image_id = ?");
+    if (!selectKeypoints.get() || !selectDescriptors.get() || !upsertKeypoints.get() || !updateDescriptors.get()) {
+      return fail();
+    }
+    for (const auto &group: copies) {
+      const auto image_id = group.first;
+      auto *s = selectKeypoints.reset();
+      sqlite3_bind_int64(s, 1, image_id);
+      size_t rows = 0;
+      size_t cols = 6;
+      std::vector<float> data;
+      if (sqlite3_step(s) == SQLITE_ROW) {
+        rows = std::max(sqlite3_column_int(s, 0), 0);
+        cols = std::max(sqlite3_column_int(s, 1), 2);
+        data.resize(rows * cols);
+        if (static_cast<size_t>(sqlite3_column_bytes(s, 2)) < data.size() * sizeof(float)) {
+          BOOST_LOG_TRIVIAL(error) << "bad keypoint blob of database image " << image_id;
+          return fail();
+        }
+        memcpy(data.data(), sqlite3_column_blob(s, 2), data.size() * sizeof(float));
+      }
+      const size_t rowsBefore = rows;
+      /* rows by exact position, the rows appended by an earlier export have the positions written here */
+      std::map<std::pair<float, float>, ColmapDatabase::point2D_t> rowAt;
+      auto append = [&](float x, float y) {
+        const float shape6[] = {x, y, 1.f, 0.f, 0.f, 1.f};
+        const float shape4[] = {x, y, 1.f, 0.f};
+        const float *row = cols == 4 ? shape4 : shape6;
+        for (size_t c = 0; c < cols; c++) {
+          data.push_back(c < 6 ? row[c] : 0.f);
+        }
+        rowAt.emplace(std::make_pair(x, y), rows);
+        return static_cast<ColmapDatabase::point2D_t>(rows++);
+      };
+      if (group.second.size() == 1) {
+        const auto &info = *group.second.front();
+        for (size_t k = rows; k < info.keyPoints.size(); k++) {
+          append(info.keyPoints[k].pos.x() * info.size.width(), info.keyPoints[k].pos.y() * info.size.height());
+        }
+      } else {
+        for (size_t r = 0; r < rows; r++) {
+          rowAt.emplace(std::make_pair(data[r * cols], data[r * cols + 1]), r);
+        }
+        for (const auto *info: group.second) {
+          auto &ids = keypointIds[info->image_id];
+          ids.resize(info->keyPoints.size());
+          for (size_t k = 0; k < ids.size(); k++) {
+            const float x = info->keyPoints[k].pos.x() * info->size.width();
+            const float y = info->keyPoints[k].pos.y() * info->size.height();
+            /* database features, up to the float precision of the normalized model positions */
+            if ((k < rowsBefore) && (std::abs(data[k * cols] - x) < 1e-2f) &&
+                (std::abs(data[k * cols + 1] - y) < 1e-2f)) {
+              ids[k] = static_cast<ColmapDatabase::point2D_t>(k);
+              continue;
+            }
+            auto row = rowAt.find(std::make_pair(x, y));
+            ids[k] = row != rowAt.end() ? row->second : append(x, y);
+          }
+        }
+      }
+      if (rows == rowsBefore) {
+        continue;
+      }
+      result.keypointsAppended += rows - rowsBefore;
+      s = upsertKeypoints.reset();
+      sqlite3_bind_int64(s, 1, image_id);
+      sqlite3_bind_int(s, 2, static_cast<int>(rows));
+      sqlite3_bind_int(s, 3, static_cast<int>(cols));
+      sqlite3_bind_blob(s, 4, data.data(), static_cast<int>(data.size() * sizeof(float)), SQLITE_STATIC);
+      if (sqlite3_step(s) != SQLITE_DONE) {
+        BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db);
+        return fail();
+      }
+
+      /* descriptors are not used by the mapper, but colmap expects one row per keypoint */
+      s = selectDescriptors.reset();
+      sqlite3_bind_int64(s, 1, image_id);
+      if (sqlite3_step(s) == SQLITE_ROW) {
+        const int descriptorCols = sqlite3_column_int(s, 1);
+        std::vector<uint8_t> descriptors(rows * descriptorCols, 0);
+        memcpy(descriptors.data(), sqlite3_column_blob(s, 2),
+               std::min<size_t>(sqlite3_column_bytes(s, 2), descriptors.size()));
+        auto *u = updateDescriptors.reset();
+        sqlite3_bind_int(u, 1, static_cast<int>(rows));
+        sqlite3_bind_blob(u, 2, descriptors.data(), static_cast<int>(descriptors.size()), SQLITE_STATIC);
+        sqlite3_bind_int64(u, 3, image_id);
+        if (sqlite3_step(u) != SQLITE_DONE) {
+          BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db);
+          return fail();
+        }
+      }
+    }
+  }
+  auto keypointId = [&](Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+    const auto &ids = keypointIds[image_id];
+    return ids.empty() ? kp_id : ids[kp_id];
+  };
+
+  /* every track gives the matches between all pairs of its observations, expanded per chunk in parallel */
+  std::vector<const Track *> tracks;
+  tracks.reserve(model.tracks.size());
+  for (const auto &it: model.tracks) {
+    tracks.push_back(&it.second);
+  }
+  const size_t chunkCount = std::min<size_t>(tracks.size(), parallelThreadCount(options.threads) * 8);
+  std::vector<std::vector<PairMatch>> chunks(chunkCount);
+  {
+    TRACE_SCOPE("ColmapDatabaseWriter::expandTracks");
+    parallelFor(chunkCount, [&](size_t c) {
+      auto &out = chunks[c];
+      for (size_t t = tracks.size() * c / chunkCount; t < tracks.size() * (c + 1) / chunkCount; t++) {
+        const auto &tr = *tracks[t];
+        for (size_t a = 0; a < tr.images.size(); a++) {
+          for (size_t b = a + 1; b < tr.images.size(); b++) {
+            auto id1 = tr.images[a] < databaseIds.size() ? databaseIds[tr.images[a]] : invalid;
+            auto id2 = tr.images[b] < databaseIds.size() ? databaseIds[tr.images[b]] : invalid;
+            if ((id1 == invalid) || (id2 == invalid) || (id1 == id2)) {
+              continue;
+            }
+            const auto kp1 = keypointId(tr.images[a], tr.kps[a]);
+            const auto kp2 = keypointId(tr.images[b], tr.kps[b]);
+            /* colmap keeps the columns in ascending image id order */
+            if (id1 < id2) {
+              out.push_back({ColmapDatabase::pairId(id1, id2), kp1, kp2});
+            } else {
+              out.push_back({ColmapDatabase::pairId(id1, id2), kp2, kp1});
+            }
+          }
+        }
+      }
+    }, options.threads, 1);
+  }
+  std::vector<PairMatch> matches;
+  {
+    size_t total = 0;
+    for (const auto &c: chunks) {
+      total += c.size();
+    }
+    matches.reserve(total);
+    for (auto &c: chunks) {
+      matches.insert(matches.end(), c.begin(), c.end());
+      std::vector<PairMatch>().swap(c);
+    }
+    TRACE_SCOPE("ColmapDatabaseWriter::sortMatches");
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+  }
+  result.matches = matches.size();
+
+  {
+    TRACE_SCOPE("ColmapDatabaseWriter::upsertMatches");
+    Statement selectRaw(db, "SELECT rows, data FROM matches WHERE pair_id = ?");
+    Statement upsertRaw(db, "INSERT OR REPLACE INTO matches(pair_id, rows, cols, data) VALUES(?, ?, 2, ?)");
+    Statement selectVerified(db, "SELECT rows, data FROM two_view_geometries WHERE pair_id = ?");
+    /* geometry columns of existing rows are kept, pairs the verification gave up on become uncalibrated */
+    Statement upsertVerified(db, "INSERT INTO two_view_geometries(pair_id, rows, cols, data, config) "
+                                 "VALUES(?, ?, 2, ?, 3) ON CONFLICT(pair_id) DO UPDATE SET "
+                                 "rows = excluded.rows, cols = 2, data = excluded.data, "
+                                 "config = CASE WHEN config < 2 THEN 3 ELSE config END");
+    if (!selectRaw.get() || !upsertRaw.get() || !selectVerified.get() || !upsertVerified.get()) {
+      return fail();
+    }
+    auto upsert = [&](Statement &select, Statement &insert, const PairMatch *begin, const PairMatch *end,
+                      uint64_t *added) {
+      auto *s = select.reset();
+      sqlite3_bind_int64(s, 1, static_cast<sqlite3_int64>(begin->pair_id));
+      int rows = 0;
+      const void *blob = nullptr;
+      if (sqlite3_step(s) == SQLITE_ROW) {
+        rows = sqlite3_column_int(s, 0);
+        blob = sqlite3_column_blob(s, 1);
+        if ((blob == nullptr) || (sqlite3_column_bytes(s, 1) < rows * 2 * static_cast<int>(sizeof(uint32_t)))) {
+          rows = 0;
+        }
+      }
+      const auto merged = mergeMatches(blob, rows, begin, end, added);
+      auto *i = insert.reset();
+      sqlite3_bind_int64(i, 1, static_cast<sqlite3_int64>(begin->pair_id));
+      sqlite3_bind_int(i, 2, static_cast<int>(merged.size() / 2));
+      sqlite3_bind_blob(i, 3, merged.data(), static_cast<int>(merged.size() * sizeof(uint32_t)), SQLITE_STATIC);
+      if (sqlite3_step(i) != SQLITE_DONE) {
+        BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db);
+        return false;
+      }
+      return true;
+    };
+    uint64_t verifiedAdded = 0;
+    for (size_t begin = 0; begin < matches.size();) {
+      size_t end = begin;
+      while ((end < matches.size()) && (matches[end].pair_id == matches[begin].pair_id)) {
+        end++;
+      }
+      if (!upsert(selectRaw, upsertRaw, &matches[begin], matches.data() + end, &result.newMatches) ||
+          (options.verified &&
+           !upsert(selectVerified, upsertVerified, &matches[begin], matches.data() + end, &verifiedAdded))) {
+        return fail();
+      }
+      result.pairs++;
+      begin = end;
+    }
+  }
+  if (!exec(db, "COMMIT")) {
+    return fail();
+  }
+  BOOST_LOG_TRIVIAL(info) << "exported " << result.matches << " matches of " << result.pairs << " pairs, "
+                          << result.newMatches << " new, to " << databasePath;
+  if (summary) {
+    *summary = result;
+  }
+  return true;
+}
@@ -0,0 +1,38 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_COLMAPDATABASEWRITER_H
+#define MATCH_MANUALLY_COLMAPDATABASEWRITER_H
+
+#include <string>
+#include "ImageGraphModel.h"
+
+/*
+ * feeds the tracks of the model back into a colmap database so the mapper can be run on them. every track is
+ * expanded into the matches between all its observations, these are merged into the matches and
+ * two_view_geometries rows of their pairs. keypoints added by hand are appended to the keypoint blobs (and
+ * zero descriptors to the descriptor blobs) so their ids stay valid. copies of one image from several
+ * reconstructions share its row, their keypoints are matched by position. the export is a single transaction
+ */
+class ColmapDatabaseWriter {
+public:
+  struct Options {
+    /* also write the matches as verified inliers, the mapper only reads two_view_geometries */
+    bool verified = true;
+    size_t threads = 0;
+  };
+
+  struct Summary {
+    uint64_t pairs = 0;
+    uint64_t matches = 0;
+    uint64_t newMatches = 0;
+    uint64_t keypointsAppended = 0;
+  };
+
+  static bool exportTrackMatches(const ImageGraphModel &model, const std::string &databasePath,
+                                 const Options &options, Summary *summary = nullptr);
+};
+
+
+#endif //MATCH_MANUALLY_COLMAPDATABASEWRITER_H
@@ -0,0 +1,319 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <cstring>
+#include <set>
+#include <unordered_set>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include "AtomicFile.h"
+#include "ColmapWriter.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+struct BinaryImageInfoWriteHelper1 {
+  ColmapLoader::image_t image_id;
+  double QVec[4];
+  double TVec[3];
+  ColmapLoader::camera_t camera_id;
+} __attribute__((packed));
+
+struct BinaryImageInfoWriteHelper2 {
+  double x;
+  double y;
+  ColmapLoader::point3D_t point3D_id;
+} __attribute__((packed));
+
+struct BinaryCameraInfoWriteHelper {
+  ColmapLoader::camera_t camera_id;
+  int model_id;
+  uint64_t width;
+  uint64_t height;
+} __attribute__((packed));
+
+struct BinaryPoints3DInfoWriteHelper {
+  ColmapLoader::point3D_t point3D_id;
+  double XYZ[3];
+  uint8_t Color[3];
+  double error;
+  uint64_t track_length;
+} __attribute__((packed));
+
+struct BinaryTrackElementWriteHelper {
+  ColmapLoader::image_t image_id;
+  ColmapLoader::point2D_t point2D_idx;
+} __attribute__((packed));
+
+/* shards are cut at item boundaries once they reach this size */
+const uint64_t shardBytes = 32 << 20;
+
+/*
+ * header followed by items [0, n) of itemSize(i) bytes each, writeItem(i, dst) serializes one item. consecutive
+ * items are grouped into shards, a wave of one shard per thread is filled in parallel and written with one
+ * pwritev, so memory stays at about threads * shardBytes whatever the model size. returns the file size, 0 on
+ * error
+ */
+template<typename SizeF, typename WriteF>
+uint64_t writeItems(AtomicFile &file, const std::vector<char> &header, size_t n, SizeF &&itemSize,
+                    WriteF &&writeItem, size_t threads) {
+  std::vector<uint64_t> offsets(n + 1);
+  parallelFor(n, [&](size_t i) { offsets[i + 1] = itemSize(i); }, threads);
+  offsets[0] = header.size();
+  for (size_t i = 0; i < n; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  file.reserve(offsets[n]);
+
+  std::vector<iovec> iov = {{const_cast<char *>(header.data()), header.size()}};
+  if (!file.writev(0, iov)) {
+    return 0;
+  }
+
+  std::vector<size_t> shardStarts;
+  for (size_t i = 0; i < n; i++) {
+    if (shardStarts.empty() || (offsets[i] - offsets[shardStarts.back()] >= shardBytes)) {
+      shardStarts.push_back(i);
+    }
+  }
+  shardStarts.push_back(n);
+
+  const size_t shardCount = shardStarts.size() - 1;
+  const size_t waveSize = parallelThreadCount(threads);
+  std::vector<std::vector<char>> buffers(std::min(waveSize, shardCount));
+  for (size_t wave = 0; wave < shardCount; wave += waveSize) {
+    const size_t shards = std::min(waveSize, shardCount - wave);
+    parallelFor(shards, [&](size_t k) {
+      const size_t begin = shardStarts[wave + k];
+      const size_t end = shardStarts[wave + k + 1];
+      auto &buffer = buffers[k];
+      buffer.resize(offsets[end] - offsets[begin]);
+      for (size_t i = begin; i < end; i++) {
+        writeItem(i, buffer.data() + (offsets[i] - offsets[begin]));
+      }
+    }, threads, 1);
+    iov.clear();
+    for (size_t k = 0; k < shards; k++) {
+      iov.push_back({buffers[k].data(), buffers[k].size()});
+    }
+    if (!file.writev(offsets[shardStarts[wave]], iov)) {
+      return 0;
+    }
+  }
+  return file.sync() ? offsets[n] : 0;
+}
+
+std::vector<char> countHeader(uint64_t count) {
+  std::vector<char> header(sizeof(count));
+  memcpy(header.data(), &count, sizeof(count));
+  return header;
+}
+}
+
+bool ColmapWriter::writeBinary(const ImageGraphModel &model, const std::string &dir, Summary *summary,
+                               size_t threads) {
+  TRACE_SCOPE("ColmapWriter::writeBinary");
+  if (model.origins.size() <= 1) {
+    return writeOrigin(model, dir, -1, summary, threads);
+  }
+  Summary total;
+  for (size_t origin = 0; origin < model.origins.size(); origin++) {
+    Summary part;
+    if (!writeOrigin(model, dir + "/" + model.origins[origin].toStdString(), static_cast<int>(origin), &part,
+                     threads)) {
+      return false;
+    }
+    total.cameras += part.cameras;
+    total.images += part.images;
+    total.points3D += part.points3D;
+    total.observations += part.observations;
+    total.bytes += part.bytes;
+  }
+  if (summary) {
+    *summary = total;
+  }
+  return true;
+}
+
+bool ColmapWriter::writeOrigin(const ImageGraphModel &model, const std::string &dir, int origin, Summary *summary,
+                               size_t threads) {
+  boost::system::error_code ec;
+  fs::create_directories(dir, ec);
+  if (!fs::is_directory(dir)) {
+    BOOST_LOG_TRIVIAL(error) << "unable to create output directory " << dir;
+    return false;
+  }
+
+  /* flat lookups by image id, the per observation checks would otherwise be map lookups */
+  std::vector<const ImageInfo *> images;
+  Image_ID_T maxImageId = 0;
+  for (const auto &it: model.imageInfos) {
+    if (!it.second.colmap.registered || ((origin >= 0) && (it.second.colmap.origin != origin))) {
+      continue;
+    }
+    if (model.cameras.count(it.second.colmap.camera_id) == 0) {
+      BOOST_LOG_TRIVIAL(warning) << "image " << it.first << " has no camera " << it.second.colmap.camera_id
+                                 << ", not written";
+      continue;
+    }
+    images.push_back(&it.second);
+    maxImageId = std::max(maxImageId, it.first);
+  }
+  std::vector<uint32_t> keypointCounts(images.empty() ? 0 : maxImageId + 1, 0);
+  std::vector<uint8_t> written(keypointCounts.size(), 0);
+  /* ids of the colmap model, images added without colmap keep their model id */
+  std::vector<ColmapLoader::image_t> colmapIds(keypointCounts.size(), 0);
+  for (const auto *img: images) {
+    keypointCounts[img->image_id] = img->keyPoints.size();
+    written[img->image_id] = 1;
+    colmapIds[img->image_id] = img->colmap.image_id != 0 ? img->colmap.image_id : img->image_id;
+  }
+  auto observationWritten = [&](Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+    return (image_id < written.size()) && written[image_id] && (kp_id < keypointCounts[image_id]);
+  };
+
+  std::vector<const Track *> tracks;
+  tracks.reserve(model.tracks.size());
+  for (const auto &it: model.tracks) {
+    if ((origin < 0) || (it.second.origin == origin)) {
+      tracks.push_back(&it.second);
+    }
+  }
+  std::vector<uint32_t> trackLengths(tracks.size());
+  parallelFor(tracks.size(), [&](size_t i) {
+    uint32_t length = 0;
+    for (size_t k = 0; k < tracks[i]->images.size(); k++) {
+      length += observationWritten(tracks[i]->images[k], tracks[i]->kps[k]);
+    }
+    trackLengths[i] = length >= 2 ? length : 0;
+  }, threads);
+  std::unordered_set<Track_ID_T> droppedTracks;
+  uint64_t observations = 0;
+  for (size_t i = 0; i < tracks.size(); i++) {
+    if (trackLengths[i] == 0) {
+      droppedTracks.insert(tracks[i]->track_id);
+    }
+    observations += trackLengths[i];
+  }
+  if (!droppedTracks.empty()) {
+    BOOST_LOG_TRIVIAL(info) << droppedTracks.size() << " tracks with less than two registered observations dropped";
+  }
+
+  /* caches of older versions may hold tracks merged across reconstructions, they belong to the surviving one */
+  auto trackWritten = [&](Track_ID_T track_id) {
+    if ((track_id == std::numeric_limits<Track_ID_T>::max()) ||
+        (!droppedTracks.empty() && (droppedTracks.count(track_id) != 0))) {
+      return false;
+    }
+    if (origin < 0) {
+      return true;
+    }
+    auto it = model.tracks.find(track_id);
+    return (it != model.tracks.end()) && (it->second.origin == origin);
+  };
+
+  AtomicFile camerasFile(dir + "/cameras.bin");
+  AtomicFile imagesFile(dir + "/images.bin");
+  AtomicFile pointsFile(dir + "/points3D.bin");
+  if (!camerasFile.ok() || !imagesFile.ok() || !pointsFile.ok()) {
+    return false;
+  }
+
+  /* a sub-model only gets the cameras of its images, the camera ids of different origins may be the same */
+  std::vector<const ColmapLoader::SceneCameraInfo *> cameras;
+  if (origin < 0) {
+    for (const auto &it: model.cameras) {
+      cameras.push_back(&it.second);
+    }
+  } else {
+    std::set<ColmapLoader::camera_t> used;
+    for (const auto *img: images) {
+      used.insert(img->colmap.camera_id);
+    }
+    for (const auto camera_id: used) {
+      cameras.push_back(&model.cameras.at(camera_id));
+    }
+  }
+  const uint64_t camerasBytes = writeItems(camerasFile, countHeader(cameras.size()), cameras.size(), [&](size_t i) {
+    return sizeof(BinaryCameraInfoWriteHelper) + cameras[i]->params.size() * sizeof(double);
+  }, [&](size_t i, char *dst) {
+    const auto &camera = *cameras[i];
+    const BinaryCameraInfoWriteHelper helper = {camera.camera_id, camera.model_id, camera.width, camera.height};
+    memcpy(dst, &helper, sizeof(helper));
+    memcpy(dst + sizeof(helper), camera.params.data(), camera.params.size() * sizeof(double));
+  }, 1);
+
+  const uint64_t imagesBytes = writeItems(imagesFile, countHeader(images.size()), images.size(), [&](size_t i) {
+    return sizeof(BinaryImageInfoWriteHelper1) + images[i]->colmap.name.size() + 1 + sizeof(uint64_t) +
+           images[i]->keyPoints.size() * sizeof(BinaryImageInfoWriteHelper2);
+  }, [&](size_t i, char *dst) {
+    const auto &img = *images[i];
+    BinaryImageInfoWriteHelper1 helper1 = {.image_id = colmapIds[img.image_id],
+                                           .camera_id = model.cameras.at(img.colmap.camera_id).camera_id};
+    memcpy(helper1.QVec, img.colmap.qvec.data(), sizeof(helper1.QVec));
+    memcpy(helper1.TVec, img.colmap.tvec.data(), sizeof(helper1.TVec));
+    memcpy(dst, &helper1, sizeof(helper1));
+    dst += sizeof(helper1);
+    memcpy(dst, img.colmap.name.c_str(), img.colmap.name.size() + 1);
+    dst += img.colmap.name.size() + 1;
+    const uint64_t count = img.keyPoints.size();
+    memcpy(dst, &count, sizeof(count));
+    dst += sizeof(count);
+    const double width = img.size.width();
+    const double height = img.size.height();
+    for (const auto &kp: img.keyPoints) {
+      BinaryImageInfoWriteHelper2 helper2 = {kp.pos.x() * width, kp.pos.y() * height, ColmapLoader::kInvalidPoint3DId};
+      if (trackWritten(kp.track_id)) {
+        helper2.point3D_id = kp.track_id;
+      }
+      memcpy(dst, &helper2, sizeof(helper2));
+      dst += sizeof(helper2);
+    }
+  }, threads);
+
+  const uint64_t pointsBytes = writeItems(pointsFile, countHeader(tracks.size() - droppedTracks.size()),
+                                          tracks.size(), [&](size_t i) -> uint64_t {
+    return trackLengths[i] == 0 ? 0 : sizeof(BinaryPoints3DInfoWriteHelper) +
+                                      trackLengths[i] * sizeof(BinaryTrackElementWriteHelper);
+  }, [&](size_t i, char *dst) {
+    if (trackLengths[i] == 0) {
+      return;
+    }
+    const auto &tr = *tracks[i];
+    const BinaryPoints3DInfoWriteHelper helper = {
+        .point3D_id = tr.track_id,
+        .XYZ = {tr.pos.x(), tr.pos.y(), tr.pos.z()},
+        .Color = {tr.color.x(), tr.color.y(), tr.color.z()},
+        .error = tr.error,
+        .track_length = trackLengths[i]
+    };
+    memcpy(dst, &helper, sizeof(helper));
+    dst += sizeof(helper);
+    for (size_t k = 0; k < tr.images.size(); k++) {
+      if (!observationWritten(tr.images[k], tr.kps[k])) {
+        continue;
+      }
+      const BinaryTrackElementWriteHelper element = {colmapIds[tr.images[k]], tr.kps[k]};
+      memcpy(dst, &element, sizeof(element));
+      dst += sizeof(element);
+    }
+  }, threads);
+
+  if ((camerasBytes == 0) || (imagesBytes == 0) || (pointsBytes == 0) ||
+      !camerasFile.commit() || !imagesFile.commit() || !pointsFile.commit()) {
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "wrote " << images.size() << " images and " << tracks.size() - droppedTracks.size()
+                          << " points to " << dir;
+  if (summary) {
+    summary->cameras = cameras.size();
+    summary->images = images.size();
+    summary->points3D = tracks.size() - droppedTracks.size();
+    summary->observations = observations;
+    summary->bytes = camerasBytes + imagesBytes + pointsBytes;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_COLMAPWRITER_H
+#define MATCH_MANUALLY_COLMAPWRITER_H
+
+#include <string>
+#include "ImageGraphModel.h"
+
+/*
+ * writes the model as colmap sparse model (cameras.bin, images.bin, points3D.bin), manual keypoints and merged
+ * tracks included. images and tracks are serialized in parallel into shard buffers that go out with one pwritev
+ * per wave, every file is written next to its target and renamed over it once all three are complete
+ */
+class ColmapWriter {
+public:
+  struct Summary {
+    uint64_t cameras = 0;
+    uint64_t images = 0;
+    uint64_t points3D = 0;
+    uint64_t observations = 0;
+    uint64_t bytes = 0;
+  };
+
+  /*
+   * only registered images are written. observations in other images are dropped, and so are tracks left with
+   * less than two observations, their keypoints are written without point. threads 0 uses every hardware thread.
+   * a model loaded from several reconstructions is written as dir/<origin name>/, one sparse model per origin
+   */
+  static bool writeBinary(const ImageGraphModel &model, const std::string &dir, Summary *summary = nullptr,
+                          size_t threads = 0);
+
+private:
+  /* origin -1 writes every image and track */
+  static bool writeOrigin(const ImageGraphModel &model, const std::string &dir, int origin, Summary *summary,
+                          size_t threads);
+};
+
+
+#endif //MATCH_MANUALLY_COLMAPWRITER_H
@@ -0,0 +1,140 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "CameraModels.h"
+#include "EpipolarGeometry.h"
+
+namespace {
+/* segments of a line in a distorted image, enough for the curvature of strong wide angle lenses */
+const int kDistortedSegments = 32;
+
+Eigen::Matrix3d skew(const Eigen::Vector3d &v) {
+  Eigen::Matrix3d m;
+  m << 0, -v.z(), v.y(),
+      v.z(), 0, -v.x(),
+      -v.y(), v.x(), 0;
+  return m;
+}
+}
+
+const EpipolarGeometry::ImageGeometry &EpipolarGeometry::imageGeometry(const ImageGraphModel &model,
+                                                                       Image_ID_T image_id) {
+  auto cached = m_images.find(image_id);
+  if (cached != m_images.end()) {
+    return cached->second;
+  }
+  auto &g = m_images[image_id];
+  const auto &info = model.imageInfos.at(image_id);
+  auto camera = model.cameras.find(info.colmap.camera_id);
+  auto distorted = [&](const auto &m) { g.distorted = std::decay_t<decltype(m)>::kDistorted; };
+  if (!info.colmap.registered || (camera == model.cameras.end()) || !CameraModel::visit(camera->second, distorted)) {
+    return g;
+  }
+  const auto &q = info.colmap.qvec;
+  g.R = Eigen::Quaterniond(q(0), q(1), q(2), q(3)).normalized().toRotationMatrix();
+  g.t = info.colmap.tvec;
+  /* corners and edge midpoints, barrel distortion bulges the edges out of the corner box */
+  const double w = info.size.width();
+  const double h = info.size.height();
+  Eigen::Vector2d border[8] = {{0, 0}, {w / 2, 0}, {w, 0}, {w, h / 2}, {w, h}, {w / 2, h}, {0, h}, {0, h / 2}};
+  Eigen::Vector2d normalized[8];
+  CameraModel::undistort(camera->second, border, normalized, 8);
+  for (const auto &p: normalized) {
+    if (p.allFinite()) {
+      g.bounds.extend(p);
+    }
+  }
+  g.valid = !g.bounds.isEmpty();
+  return g;
+}
+
+bool EpipolarGeometry::essential(const ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2,
+                                 Eigen::Matrix3d *E) {
+  const uint64_t key = (static_cast<uint64_t>(image_id1) << 32) | image_id2;
+  auto cached = m_essentials.find(key);
+  if (cached != m_essentials.end()) {
+    *E = cached->second;
+    return true;
+  }
+  /* poses of different reconstructions are in unrelated frames */
+  if (model.imageInfos.at(image_id1).colmap.origin != model.imageInfos.at(image_id2).colmap.origin) {
+    return false;
+  }
+  const auto &g1 = imageGeometry(model, image_id1);
+  const auto &g2 = imageGeometry(model, image_id2);
+  if (!g1.valid || !g2.valid) {
+    return false;
+  }
+  /* x2 = R x1 + t between the two camera frames */
+  const Eigen::Matrix3d R = g2.R * g1.R.transpose();
+  const Eigen::Vector3d t = g2.t - R * g1.t;
+  *E = skew(t) * R;
+  m_essentials.emplace(key, *E);
+  return true;
+}
+
+bool EpipolarGeometry::line(const ImageGraphModel &model, Image_ID_T image_id1, const Eigen::Vector2f &pos1,
+                            Image_ID_T image_id2, std::vector<Eigen::Vector2f> *polyline) {
+  polyline->clear();
+  Eigen::Matrix3d E;
+  if (!essential(model, image_id1, image_id2, &E)) {
+    return false;
+  }
+  const auto &info1 = model.imageInfos.at(image_id1);
+  const auto &info2 = model.imageInfos.at(image_id2);
+  const auto &camera1 = model.cameras.at(info1.colmap.camera_id);
+  const auto &camera2 = model.cameras.at(info2.colmap.camera_id);
+  const Eigen::Vector2d pixel1(pos1.x() * info1.size.width(), pos1.y() * info1.size.height());
+  Eigen::Vector2d x1;
+  if (!CameraModel::undistort(camera1, &pixel1, &x1, 1)) {
+    return false;
+  }
+
+  /* a x + b y + c = 0 in normalized coordinates of image 2, clipped to its bounds by the slab test */
+  const Eigen::Vector3d l = E * x1.homogeneous();
+  const double n2 = l.x() * l.x() + l.y() * l.y();
+  if (n2 < 1e-24) {
+    return false;
+  }
+  const Eigen::Vector2d dir = Eigen::Vector2d(l.y(), -l.x()) / std::sqrt(n2);
+  const Eigen::Vector2d p0 = -l.z() * l.head<2>() / n2;
+  const auto &bounds = imageGeometry(model, image_id2).bounds;
+  double smin = -std::numeric_limits<double>::infinity();
+  double smax = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < 2; i++) {
+    if (std::abs(dir(i)) < 1e-12) {
+      if ((p0(i) < bounds.min()(i)) || (p0(i) > bounds.max()(i))) {
+        return false;
+      }
+      continue;
+    }
+    const double s1 = (bounds.min()(i) - p0(i)) / dir(i);
+    const double s2 = (bounds.max()(i) - p0(i)) / dir(i);
+    smin = std::max(smin, std::min(s1, s2));
+    smax = std::min(smax, std::max(s1, s2));
+  }
+  if (smin >= smax) {
+    return false;
+  }
+
+  const int segments = imageGeometry(model, image_id2).distorted ? kDistortedSegments : 1;
+  std::vector<Eigen::Vector2d> normalized(segments + 1), pixels(segments + 1);
+  for (int i = 0; i <= segments; i++) {
+    normalized[i] = p0 + dir * (smin + (smax - smin) * i / segments);
+  }
+  CameraModel::distort(camera2, normalized.data(), pixels.data(), pixels.size());
+  const Eigen::Vector2d size(info2.size.width(), info2.size.height());
+  for (const auto &p: pixels) {
+    polyline->push_back(p.cwiseQuotient(size).cast<float>());
+  }
+  return true;
+}
+
+void EpipolarGeometry::clear() {
+  m_images.clear();
+  m_essentials.clear();
+}
@@ -0,0 +1,53 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_EPIPOLARGEOMETRY_H
+#define MATCH_MANUALLY_EPIPOLARGEOMETRY_H
+
+#include <unordered_map>
+#include <vector>
+#include "ImageGraphModel.h"
+
+/*
+ * epipolar lines between registered images from their colmap poses. the relative geometry of a pair (essential
+ * matrix, the fundamental matrix without the intrinsics) and the normalized bounds of every image are computed
+ * once and cached. a line is clipped in normalized coordinates of the other image and sampled through its camera
+ * model, so it bends with the lens distortion, undistorted cameras get one straight segment
+ */
+class EpipolarGeometry {
+public:
+  /*
+   * x2^T E x1 = 0 for normalized coordinates x1, x2. false when an image has no pose, a camera is unknown or the
+   * images come from different reconstructions
+   */
+  bool essential(const ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2, Eigen::Matrix3d *E);
+
+  /*
+   * epipolar line of pos1 (normalized image coordinate as in KeyPoint::pos) of image 1 in image 2 as polyline in
+   * the same coordinates of image 2, false when there is no line or it misses the image
+   */
+  bool line(const ImageGraphModel &model, Image_ID_T image_id1, const Eigen::Vector2f &pos1, Image_ID_T image_id2,
+            std::vector<Eigen::Vector2f> *polyline);
+
+  /* poses or images changed */
+  void clear();
+
+private:
+  struct ImageGeometry {
+    bool valid = false;
+    bool distorted = false;
+    Eigen::Matrix3d R;
+    Eigen::Vector3d t;
+    /* image rectangle undistorted into normalized coordinates */
+    Eigen::AlignedBox2d bounds;
+  };
+
+  std::unordered_map<Image_ID_T, ImageGeometry> m_images;
+  std::unordered_map<uint64_t, Eigen::Matrix3d> m_essentials;
+
+  const ImageGeometry &imageGeometry(const ImageGraphModel &model, Image_ID_T image_id);
+};
+
+
+#endif //MATCH_MANUALLY_EPIPOLARGEOMETRY_H
@@ -0,0 +1,86 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <QFile>
+#include <QTextStream>
+#include "FrameProfiler.h"
+
+FrameProfiler::FrameProfiler(size_t capacity) : m_capacity(capacity) {
+  for (auto &ring: m_rings) {
+    ring.samples.reserve(m_capacity);
+  }
+}
+
+const char *FrameProfiler::phaseName(FrameProfiler::Phase phase) {
+  static const char *names[PHASE_COUNT] = {
+          "cpu frame",
+          "cpu updateResources",
+          "cpu stage flush",
+          "cpu addImage",
+          "cpu selectObject",
+          "cpu epipolarLines",
+          "cpu suggestions",
+          "cpu refine",
+          "cpu review",
+          "gpu stage copy",
+          "gpu pick pass",
+          "gpu image draw",
+          "gpu keypoint draw",
+          "gpu line draw"
+  };
+  return names[phase];
+}
+
+void FrameProfiler::record(FrameProfiler::Phase phase, double ms) {
+  auto &ring = m_rings[phase];
+  if (ring.samples.size() < m_capacity) {
+    ring.samples.push_back({m_frame, ms});
+  } else {
+    ring.samples[ring.next] = {m_frame, ms};
+  }
+  ring.next = (ring.next + 1) % m_capacity;
+}
+
+FrameProfiler::Summary FrameProfiler::summary(FrameProfiler::Phase phase) const {
+  const auto &ring = m_rings[phase];
+  Summary s = {ring.samples.size(), 0., 0., 0., 0.};
+  if (ring.samples.empty()) {
+    return s;
+  }
+  std::vector<double> ms(ring.samples.size());
+  std::transform(ring.samples.begin(), ring.samples.end(), ms.begin(), [](const Sample &sample) {
+    return sample.ms;
+  });
+  auto percentile = [&ms](double p) {
+    auto nth = ms.begin() + static_cast<size_t>(p * (ms.size() - 1));
+    std::nth_element(ms.begin(), nth, ms.end());
+    return *nth;
+  };
+  s.p50 = percentile(0.50);
+  s.p95 = percentile(0.95);
+  s.p99 = percentile(0.99);
+  s.max = *std::max_element(ms.begin(), ms.end());
+  return s;
+}
+
+bool FrameProfiler::dumpCsv(const QString &path) const {
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    return false;
+  }
+  QTextStream out(&file);
+  out << "phase,frame,ms\n";
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    const auto &ring = m_rings[phase];
+    /* oldest sample first */
+    const size_t start = ring.samples.size() < m_capacity ? 0 : ring.next;
+    for (size_t i = 0; i < ring.samples.size(); i++) {
+      const auto &sample = ring.samples[(start + i) % ring.samples.size()];
+      out << phaseName(static_cast<Phase>(phase)) << ',' << sample.frame << ',' << QString::number(sample.ms, 'f', 4)
+          << '\n';
+    }
+  }
+  return true;
+}
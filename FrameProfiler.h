@@ -0,0 +1,92 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_FRAMEPROFILER_H
+#define MATCH_MANUALLY_FRAMEPROFILER_H
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <QString>
+
+/*
+ * keeps the last samples of every cpu phase and gpu pass in a ring buffer, the renderer shows the
+ * percentiles as overlay and the csv dump goes into bug reports
+ */
+class FrameProfiler {
+public:
+  enum Phase {
+    CPU_FRAME,
+    CPU_UPDATE_RESOURCES,
+    CPU_STAGE_FLUSH,
+    CPU_ADD_IMAGE,
+    CPU_SELECT_OBJECT,
+    CPU_EPIPOLAR_LINES,
+    CPU_SUGGESTIONS,
+    CPU_REFINE,
+    CPU_REVIEW,
+    GPU_STAGE_COPY,
+    GPU_PICK_PASS,
+    GPU_IMAGE_DRAW,
+    GPU_KEYPOINT_DRAW,
+    GPU_LINE_DRAW,
+    PHASE_COUNT
+  };
+
+  struct Summary {
+    size_t count;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+  };
+
+  class ScopedTimer {
+  public:
+    ScopedTimer(FrameProfiler &profiler, Phase phase) : m_profiler(profiler), m_phase(phase),
+                                                         m_start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+      m_profiler.record(m_phase, std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - m_start).count());
+    }
+
+  private:
+    FrameProfiler &m_profiler;
+    Phase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  explicit FrameProfiler(size_t capacity = 1024);
+
+  static const char *phaseName(Phase phase);
+
+  void nextFrame() { m_frame++; }
+
+  uint64_t frame() const { return m_frame; }
+
+  void record(Phase phase, double ms);
+
+  Summary summary(Phase phase) const;
+
+  bool dumpCsv(const QString &path) const;
+
+private:
+  struct Sample {
+    uint64_t frame;
+    double ms;
+  };
+
+  struct Ring {
+    std::vector<Sample> samples;
+    size_t next = 0;
+  };
+
+  size_t m_capacity;
+  uint64_t m_frame = 0;
+  std::array<Ring, PHASE_COUNT> m_rings;
+};
+
+
+#endif //MATCH_MANUALLY_FRAMEPROFILER_H
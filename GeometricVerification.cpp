@@ -0,0 +1,320 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+#include "CameraModels.h"
+#include "GeometricVerification.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+/* matches scored together, the coordinates are padded to whole blocks with NaN which never counts as inlier */
+const size_t kBlock = 16;
+const size_t kSampleSize = 8;
+
+/* coordinates of one pair as plain arrays, pixels for F, normalized coordinates for E */
+struct Problem {
+  size_t n = 0;
+  std::vector<double> u1, v1, u2, v2;
+  /* hartley normalization of the samples, identity for E */
+  Eigen::Matrix3d T1 = Eigen::Matrix3d::Identity();
+  Eigen::Matrix3d T2 = Eigen::Matrix3d::Identity();
+  bool essential = false;
+  /* squared sampson distance of an inlier in the units of the coordinates */
+  double threshold2 = 0;
+};
+
+/* centroid to the origin, mean distance sqrt(2) */
+Eigen::Matrix3d hartley(const std::vector<double> &u, const std::vector<double> &v, size_t n) {
+  double cu = 0, cv = 0;
+  for (size_t i = 0; i < n; i++) {
+    cu += u[i];
+    cv += v[i];
+  }
+  cu /= n;
+  cv /= n;
+  double distance = 0;
+  for (size_t i = 0; i < n; i++) {
+    distance += std::hypot(u[i] - cu, v[i] - cv);
+  }
+  const double scale = distance > 0 ? std::sqrt(2.) * n / distance : 1.;
+  Eigen::Matrix3d T;
+  T << scale, 0, -scale * cu,
+          0, scale, -scale * cv,
+          0, 0, 1;
+  return T;
+}
+
+/* least squares 8 point solution of x2^T M x1 = 0 over the given matches, rank 2 or essential enforced */
+bool eightPoint(const Problem &p, const size_t *indices, size_t count, Eigen::Matrix3d *M) {
+  auto row = [&](size_t i) {
+    const Eigen::Vector3d x1 = p.T1 * Eigen::Vector3d(p.u1[i], p.v1[i], 1);
+    const Eigen::Vector3d x2 = p.T2 * Eigen::Vector3d(p.u2[i], p.v2[i], 1);
+    Eigen::Matrix<double, 9, 1> a;
+    a << x2.x() * x1.x(), x2.x() * x1.y(), x2.x(),
+            x2.y() * x1.x(), x2.y() * x1.y(), x2.y(),
+            x1.x(), x1.y(), 1;
+    return a;
+  };
+  Eigen::Matrix<double, 9, 1> f;
+  if (count == kSampleSize) {
+    /* the null vector of the 8 rows is the last column of Q of their transpose, cheaper than an eigen solver */
+    Eigen::Matrix<double, 9, kSampleSize> At;
+    for (size_t k = 0; k < kSampleSize; k++) {
+      At.col(k) = row(indices[k]);
+    }
+    const Eigen::Matrix<double, 9, 9> Q = At.householderQr().householderQ();
+    f = Q.col(8);
+  } else {
+    Eigen::Matrix<double, 9, 9> AtA = Eigen::Matrix<double, 9, 9>::Zero();
+    for (size_t k = 0; k < count; k++) {
+      const auto a = row(indices[k]);
+      AtA.noalias() += a * a.transpose();
+    }
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 9, 9>> solver(AtA);
+    if (solver.info() != Eigen::Success) {
+      return false;
+    }
+    f = solver.eigenvectors().col(0);
+  }
+  Eigen::Matrix3d F;
+  F << f(0), f(1), f(2),
+          f(3), f(4), f(5),
+          f(6), f(7), f(8);
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(F, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Vector3d s = svd.singularValues();
+  if (p.essential) {
+    s(0) = s(1) = (s(0) + s(1)) / 2;
+  }
+  s(2) = 0;
+  *M = p.T2.transpose() * svd.matrixU() * s.asDiagonal() * svd.matrixV().transpose() * p.T1;
+  return std::isfinite(M->sum());
+}
+
+/*
+ * inliers of M, without a mask the scoring stops and returns 0 once the remaining matches can not reach best.
+ * the block loop has a constant trip count and no branches so it becomes vector code
+ */
+size_t score(const Problem &p, const Eigen::Matrix3d &M, size_t best, uint8_t *mask) {
+  const double m00 = M(0, 0), m01 = M(0, 1), m02 = M(0, 2);
+  const double m10 = M(1, 0), m11 = M(1, 1), m12 = M(1, 2);
+  const double m20 = M(2, 0), m21 = M(2, 1), m22 = M(2, 2);
+  const double t2 = p.threshold2;
+  size_t inliers = 0;
+  for (size_t begin = 0; begin < p.n; begin += kBlock) {
+    const double *u1 = p.u1.data() + begin;
+    const double *v1 = p.v1.data() + begin;
+    const double *u2 = p.u2.data() + begin;
+    const double *v2 = p.v2.data() + begin;
+    /* double like the coordinates, a narrower flag type keeps the loop scalar */
+    double in[kBlock];
+    for (size_t j = 0; j < kBlock; j++) {
+      const double l0 = m00 * u1[j] + m01 * v1[j] + m02;
+      const double l1 = m10 * u1[j] + m11 * v1[j] + m12;
+      const double l2 = m20 * u1[j] + m21 * v1[j] + m22;
+      const double k0 = m00 * u2[j] + m10 * v2[j] + m20;
+      const double k1 = m01 * u2[j] + m11 * v2[j] + m21;
+      const double e = u2[j] * l0 + v2[j] * l1 + l2;
+      in[j] = e * e < t2 * (l0 * l0 + l1 * l1 + k0 * k0 + k1 * k1) ? 1. : 0.;
+    }
+    double count = 0;
+    for (size_t j = 0; j < kBlock; j++) {
+      count += in[j];
+    }
+    inliers += static_cast<size_t>(count);
+    if (mask != nullptr) {
+      for (size_t j = 0; j < std::min(kBlock, p.n - begin); j++) {
+        mask[begin + j] = in[j] != 0.;
+      }
+    } else if (inliers + (p.n - std::min(p.n, begin + kBlock)) < best) {
+      return 0;
+    }
+  }
+  return inliers;
+}
+
+/* keypoints of the pair in the units of the geometry */
+void buildProblem(const ImageGraphModel &model, const GeometricVerification::Pair &pair, double maxError,
+                  Problem *p) {
+  const auto &img1 = model.imageInfos.at(pair.image_id1);
+  const auto &img2 = model.imageInfos.at(pair.image_id2);
+  p->n = pair.matches.size();
+  std::vector<Eigen::Vector2d> x1(p->n), x2(p->n);
+  for (size_t i = 0; i < p->n; i++) {
+    const auto &k1 = img1.keyPoints[pair.matches[i].first].pos;
+    const auto &k2 = img2.keyPoints[pair.matches[i].second].pos;
+    x1[i] = Eigen::Vector2d(k1.x() * img1.size.width(), k1.y() * img1.size.height());
+    x2[i] = Eigen::Vector2d(k2.x() * img2.size.width(), k2.y() * img2.size.height());
+  }
+
+  auto camera1 = model.cameras.find(img1.colmap.camera_id);
+  auto camera2 = model.cameras.find(img2.colmap.camera_id);
+  double focal = 0;
+  if (img1.colmap.registered && img2.colmap.registered && (camera1 != model.cameras.end()) &&
+      (camera2 != model.cameras.end())) {
+    const auto addFocal = [&](const auto &camera) { focal += (camera.fx + camera.fy) / 4; };
+    std::vector<Eigen::Vector2d> n1(p->n), n2(p->n);
+    if (CameraModel::visit(camera1->second, addFocal) && CameraModel::visit(camera2->second, addFocal) &&
+        CameraModel::undistort(camera1->second, x1.data(), n1.data(), p->n) &&
+        CameraModel::undistort(camera2->second, x2.data(), n2.data(), p->n)) {
+      x1.swap(n1);
+      x2.swap(n2);
+      p->essential = true;
+    }
+  }
+  p->threshold2 = p->essential ? (maxError / focal) * (maxError / focal) : maxError * maxError;
+
+  const size_t padded = (p->n + kBlock - 1) / kBlock * kBlock;
+  for (auto *v: {&p->u1, &p->v1, &p->u2, &p->v2}) {
+    v->assign(padded, std::numeric_limits<double>::quiet_NaN());
+  }
+  for (size_t i = 0; i < p->n; i++) {
+    p->u1[i] = x1[i].x();
+    p->v1[i] = x1[i].y();
+    p->u2[i] = x2[i].x();
+    p->v2[i] = x2[i].y();
+  }
+  if (!p->essential) {
+    p->T1 = hartley(p->u1, p->v1, p->n);
+    p->T2 = hartley(p->u2, p->v2, p->n);
+  }
+}
+}
+
+std::vector<GeometricVerification::Pair> GeometricVerification::trackPairs(const ImageGraphModel &model,
+                                                                           const std::vector<Image_ID_T> &images) {
+  TRACE_SCOPE("GeometricVerification::trackPairs");
+  std::unordered_map<Image_ID_T, size_t> selected;
+  for (size_t i = 0; i < images.size(); i++) {
+    selected.emplace(images[i], i);
+  }
+  /* one pass over the tracks, every two selected observations of a track are a match of their pair */
+  std::unordered_map<uint64_t, size_t> pairIndex;
+  std::vector<Pair> pairs;
+  std::vector<std::pair<size_t, KeyPoint_ID_T>> observed;
+  for (const auto &it: model.tracks) {
+    const auto &track = it.second;
+    observed.clear();
+    for (size_t k = 0; k < track.images.size(); k++) {
+      auto s = selected.find(track.images[k]);
+      if (s != selected.end()) {
+        observed.emplace_back(s->second, track.kps[k]);
+      }
+    }
+    std::sort(observed.begin(), observed.end());
+    for (size_t a = 0; a < observed.size(); a++) {
+      for (size_t b = a + 1; b < observed.size(); b++) {
+        const uint64_t key = (static_cast<uint64_t>(observed[a].first) << 32) | observed[b].first;
+        auto inserted = pairIndex.emplace(key, pairs.size());
+        if (inserted.second) {
+          pairs.push_back({images[observed[a].first], images[observed[b].first], {}});
+        }
+        pairs[inserted.first->second].matches.emplace_back(observed[a].second, observed[b].second);
+      }
+    }
+  }
+  return pairs;
+}
+
+std::vector<GeometricVerification::Pair> GeometricVerification::databasePairs(const ImageGraphModel &model,
+                                                                              const std::vector<Image_ID_T> &images,
+                                                                              ColmapDatabase::MatchKind kind) {
+  TRACE_SCOPE("GeometricVerification::databasePairs");
+  std::vector<Pair> pairs;
+  ColmapDatabase::PairMatches matches;
+  for (const auto &pair: model.matchedPairs(images, kind)) {
+    const auto image_id1 = images[pair.first], image_id2 = images[pair.second];
+    if (model.readPairMatches(image_id1, image_id2, kind, &matches) && !matches.matches.empty()) {
+      pairs.push_back({image_id1, image_id2, {matches.matches.begin(), matches.matches.end()}});
+    }
+  }
+  return pairs;
+}
+
+GeometricVerification::Result GeometricVerification::verify(const ImageGraphModel &model, const Pair &pair) const {
+  Result result;
+  result.image_id1 = pair.image_id1;
+  result.image_id2 = pair.image_id2;
+  result.inliers.assign(pair.matches.size(), 0);
+  if (pair.matches.size() < kSampleSize) {
+    return result;
+  }
+  Problem p;
+  buildProblem(model, pair, options.maxError, &p);
+  result.geometry = p.essential ? ESSENTIAL : FUNDAMENTAL;
+
+  std::mt19937_64 rng(options.seed ^ (static_cast<uint64_t>(pair.image_id1) << 32) ^ pair.image_id2);
+  std::uniform_int_distribution<size_t> pick(0, p.n - 1);
+  size_t best = 0;
+  Eigen::Matrix3d bestModel = Eigen::Matrix3d::Zero();
+  size_t iterations = options.maxIterations;
+  size_t sample[kSampleSize];
+  const double logFailure = std::log(1 - std::min(options.confidence, 1 - 1e-9));
+  for (result.iterations = 0; result.iterations < iterations; result.iterations++) {
+    for (size_t k = 0; k < kSampleSize; k++) {
+      do {
+        sample[k] = pick(rng);
+      } while (std::find(sample, sample + k, sample[k]) != sample + k);
+    }
+    Eigen::Matrix3d M;
+    if (!eightPoint(p, sample, kSampleSize, &M)) {
+      continue;
+    }
+    const size_t inliers = score(p, M, best + 1, nullptr);
+    if (inliers <= best) {
+      continue;
+    }
+    best = inliers;
+    bestModel = M;
+    /* samples needed to draw one outlier free sample with the confidence at the current inlier ratio */
+    const double allInliers = std::pow(static_cast<double>(best) / p.n, kSampleSize);
+    if (allInliers >= 1) {
+      iterations = result.iterations + 1;
+    } else if (allInliers > 0) {
+      iterations = std::min(iterations, static_cast<size_t>(std::ceil(logFailure / std::log(1 - allInliers))));
+    }
+  }
+  if (best < kSampleSize) {
+    return result;
+  }
+
+  /* the least squares fit to all inliers is usually better than the minimal sample, kept when it is */
+  std::vector<uint8_t> mask(p.u1.size());
+  score(p, bestModel, 0, mask.data());
+  std::vector<size_t> inlierIndices;
+  for (size_t i = 0; i < p.n; i++) {
+    if (mask[i]) {
+      inlierIndices.push_back(i);
+    }
+  }
+  Eigen::Matrix3d refined;
+  if (eightPoint(p, inlierIndices.data(), inlierIndices.size(), &refined)) {
+    std::vector<uint8_t> refinedMask(p.u1.size());
+    if (score(p, refined, 0, refinedMask.data()) >= best) {
+      bestModel = refined;
+      mask.swap(refinedMask);
+    }
+  }
+  result.inlierCount = 0;
+  for (size_t i = 0; i < p.n; i++) {
+    result.inliers[i] = mask[i];
+    result.inlierCount += mask[i];
+  }
+  result.model = bestModel / bestModel.norm();
+  result.verified = result.inlierCount >= options.minInliers;
+  return result;
+}
+
+std::vector<GeometricVerification::Result> GeometricVerification::verifyPairs(const ImageGraphModel &model,
+                                                                              const std::vector<Pair> &pairs,
+                                                                              size_t threads) const {
+  TRACE_SCOPE("GeometricVerification::verifyPairs");
+  std::vector<Result> results(pairs.size());
+  /* pairs differ a lot in size, hand them out one by one */
+  parallelFor(pairs.size(), [&](size_t i) { results[i] = verify(model, pairs[i]); }, threads, 1);
+  return results;
+}
@@ -0,0 +1,78 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_GEOMETRICVERIFICATION_H
+#define MATCH_MANUALLY_GEOMETRICVERIFICATION_H
+
+#include <vector>
+#include "ImageGraphModel.h"
+#include "MatchComparison.h"
+
+/*
+ * checks the correspondences of image pairs against two view geometry without colmap. pairs of two registered
+ * images with known cameras get an essential matrix on undistorted normalized coordinates, the others a
+ * fundamental matrix on pixels. hypotheses come from the normalized 8 point algorithm and are scored by the
+ * sampson distance in blocks of fixed width the compiler vectorizes; a hypothesis is dropped as soon as it can no
+ * longer beat the best one and the iteration count shrinks with the inlier ratio. the best model is refitted to
+ * its inliers. pairs run in parallel, one pair per task
+ */
+class GeometricVerification {
+public:
+  enum Geometry {
+    FUNDAMENTAL,
+    ESSENTIAL
+  };
+
+  struct Options {
+    /* px, sampson distance of an inlier, in the images of the pair for both geometries */
+    double maxError = 4.0;
+    /* probability that the best sample was found when the loop stops early */
+    double confidence = 0.999;
+    size_t maxIterations = 2000;
+    /* fewer inliers leave the pair unverified */
+    size_t minInliers = 15;
+    uint64_t seed = 1;
+  };
+
+  typedef MatchComparison::Match Match;
+
+  struct Pair {
+    Image_ID_T image_id1;
+    Image_ID_T image_id2;
+    std::vector<Match> matches;
+  };
+
+  struct Result {
+    Image_ID_T image_id1 = 0;
+    Image_ID_T image_id2 = 0;
+    Geometry geometry = FUNDAMENTAL;
+    bool verified = false;
+    /* F maps pixels of image 1 to lines in image 2, E normalized coordinates, zero without a model */
+    Eigen::Matrix3d model = Eigen::Matrix3d::Zero();
+    /* 1 for the inliers, in the order of Pair::matches */
+    std::vector<uint8_t> inliers;
+    size_t inlierCount = 0;
+    size_t iterations = 0;
+  };
+
+  Options options;
+
+  /* correspondences through common tracks of every pair of the images, pairs without any are left out */
+  static std::vector<Pair> trackPairs(const ImageGraphModel &model, const std::vector<Image_ID_T> &images);
+
+  /*
+   * database matches of every pair of the images, pairs that were never matched are left out without a read.
+   * the match cache of the model is bypassed, a few hundred images are tens of thousands of pairs
+   */
+  static std::vector<Pair> databasePairs(const ImageGraphModel &model, const std::vector<Image_ID_T> &images,
+                                         ColmapDatabase::MatchKind kind);
+
+  Result verify(const ImageGraphModel &model, const Pair &pair) const;
+
+  std::vector<Result> verifyPairs(const ImageGraphModel &model, const std::vector<Pair> &pairs,
+                                  size_t threads = 0) const;
+};
+
+
+#endif //MATCH_MANUALLY_GEOMETRICVERIFICATION_H
@@ -0,0 +1,109 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <cmath>
+#include <cstring>
+#include "GrayPyramids.h"
+#include "Trace.h"
+
+void GrayPyramids::setImage(Image_ID_T image_id, const uint8_t *gray, int width, int height, int stride) {
+  TRACE_SCOPE("GrayPyramids::setImage");
+  auto &pyramid = m_pyramids[image_id];
+  pyramid.assign(1, Level{.width = width, .height = height, .pixels = {}});
+  auto &base = pyramid.front();
+  base.pixels.resize(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; y++) {
+    memcpy(base.pixels.data() + static_cast<size_t>(y) * width, gray + static_cast<size_t>(y) * stride, width);
+  }
+  /* stop before a level gets too small to hold a patch */
+  while ((static_cast<int>(pyramid.size()) < m_levels) && (pyramid.back().width >= 64) &&
+         (pyramid.back().height >= 64)) {
+    const auto &fine = pyramid.back();
+    Level coarse{.width = fine.width / 2, .height = fine.height / 2, .pixels = {}};
+    coarse.pixels.resize(static_cast<size_t>(coarse.width) * coarse.height);
+    for (int y = 0; y < coarse.height; y++) {
+      const uint8_t *r0 = fine.row(2 * y);
+      const uint8_t *r1 = fine.row(2 * y + 1);
+      uint8_t *out = coarse.pixels.data() + static_cast<size_t>(y) * coarse.width;
+      for (int x = 0; x < coarse.width; x++) {
+        out[x] = static_cast<uint8_t>((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) / 4);
+      }
+    }
+    pyramid.push_back(std::move(coarse));
+  }
+  updateMemoryGauge();
+}
+
+void GrayPyramids::removeImage(Image_ID_T image_id) {
+  m_pyramids.erase(image_id);
+  updateMemoryGauge();
+}
+
+void GrayPyramids::clear() {
+  m_pyramids.clear();
+  updateMemoryGauge();
+}
+
+std::vector<Image_ID_T> GrayPyramids::images() const {
+  std::vector<Image_ID_T> ids;
+  ids.reserve(m_pyramids.size());
+  for (const auto &it: m_pyramids) {
+    ids.push_back(it.first);
+  }
+  return ids;
+}
+
+const GrayPyramids::Pyramid *GrayPyramids::pyramid(Image_ID_T image_id) const {
+  auto it = m_pyramids.find(image_id);
+  return it == m_pyramids.end() ? nullptr : &it->second;
+}
+
+bool GrayPyramids::patch(Image_ID_T image_id, const Eigen::Vector2f &pos, int radius, std::vector<float> &out) const {
+  const auto *pyramid = this->pyramid(image_id);
+  if (pyramid == nullptr) {
+    return false;
+  }
+  const auto &img = pyramid->front();
+  const int r = radius;
+  const int cx = static_cast<int>(pos.x() * img.width);
+  const int cy = static_cast<int>(pos.y() * img.height);
+  if ((cx < r) || (cy < r) || (cx + r >= img.width) || (cy + r >= img.height)) {
+    return false;
+  }
+  out.resize((2 * r + 1) * (2 * r + 1));
+  float mean = 0.f;
+  size_t i = 0;
+  for (int y = cy - r; y <= cy + r; y++) {
+    const uint8_t *row = img.row(y);
+    for (int x = cx - r; x <= cx + r; x++) {
+      out[i] = row[x];
+      mean += out[i++];
+    }
+  }
+  mean /= out.size();
+  float norm = 0.f;
+  for (auto &v: out) {
+    v -= mean;
+    norm += v * v;
+  }
+  if (norm < 1e-6f) {
+    return false;
+  }
+  norm = 1.f / std::sqrt(norm);
+  for (auto &v: out) {
+    v *= norm;
+  }
+  return true;
+}
+
+void GrayPyramids::updateMemoryGauge() {
+  size_t bytes = 0;
+  for (const auto &it: m_pyramids) {
+    bytes += sizeof(it);
+    for (const auto &level: it.second) {
+      bytes += sizeof(level) + level.pixels.capacity();
+    }
+  }
+  m_memory.set(bytes);
+}
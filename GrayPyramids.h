@@ -0,0 +1,62 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_GRAYPYRAMIDS_H
+#define MATCH_MANUALLY_GRAYPYRAMIDS_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "ImageGraphModel.h"
+#include "MemoryAccounting.h"
+
+/*
+ * 8 bit gray copies of images for the patch based tools (track suggestions, sub-pixel refinement), every image
+ * with its 2x2 box filtered levels. level 0 is the full image, level l + 1 has half the size of level l, so a
+ * pixel center c of level l is at (c + 0.5) * 2 - 0.5 in level l - 1. the pixels are handed in by the caller,
+ * they may be smaller than the image size of the model and count as MemoryAccounting::TRACK_PATCHES
+ */
+class GrayPyramids {
+public:
+  struct Level {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+
+    const uint8_t *row(int y) const { return pixels.data() + static_cast<size_t>(y) * width; }
+  };
+
+  typedef std::vector<Level> Pyramid;
+
+  explicit GrayPyramids(int levels = 3) : m_levels(std::max(levels, 1)) {}
+
+  void setImage(Image_ID_T image_id, const uint8_t *gray, int width, int height, int stride);
+
+  bool hasImage(Image_ID_T image_id) const { return m_pyramids.count(image_id) != 0; }
+
+  std::vector<Image_ID_T> images() const;
+
+  void removeImage(Image_ID_T image_id);
+
+  void clear();
+
+  /* nullptr for images that were never set */
+  const Pyramid *pyramid(Image_ID_T image_id) const;
+
+  /*
+   * zero mean, unit length level 0 patch of (2 radius + 1)^2 pixels around pos (normalized image coordinate), the
+   * dot product of two is their correlation. false near the border, when flat or for images that were never set
+   */
+  bool patch(Image_ID_T image_id, const Eigen::Vector2f &pos, int radius, std::vector<float> &out) const;
+
+private:
+  int m_levels;
+  std::unordered_map<Image_ID_T, Pyramid> m_pyramids;
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::TRACK_PATCHES, MemoryAccounting::HOST};
+
+  void updateMemoryGauge();
+};
+
+
+#endif //MATCH_MANUALLY_GRAYPYRAMIDS_H
@@ -0,0 +1,73 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <QDebug>
+#include "ImageCache.h"
+#include "MemoryAccounting.h"
+#include "Trace.h"
+
+ImageCache::ImageCache(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)) {
+  /* the image just decoded is in use, never drop the last one */
+  m_evictionCallback = MemoryAccounting::instance().addEvictionCallback(
+          MemoryAccounting::IMAGE_CACHE, [this](uint64_t, uint64_t) {
+            while ((m_lru.size() > 1) &&
+                   MemoryAccounting::instance().overBudget(MemoryAccounting::IMAGE_CACHE, MemoryAccounting::HOST)) {
+              dropOldest();
+            }
+          });
+}
+
+ImageCache::~ImageCache() {
+  MemoryAccounting::instance().removeEvictionCallback(m_evictionCallback);
+  clear();
+}
+
+QImage ImageCache::image(const ImageInfo &info) {
+  auto it = m_entries.find(info.image_id);
+  if (it != m_entries.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+  }
+
+  QImage img;
+  {
+    TRACE_SCOPE("ImageCache::decode");
+    img = QImage(info.path);
+  }
+  if (img.isNull()) {
+    qWarning() << "can not decode" << info.path;
+    return img;
+  }
+  insert(info, img);
+  return img;
+}
+
+void ImageCache::insert(const ImageInfo &info, const QImage &img) {
+  if (img.isNull() || (m_entries.count(info.image_id) != 0)) {
+    return;
+  }
+  if (img.size() != info.size) {
+    qWarning() << info.path << "is" << img.size() << "but the camera says" << info.size;
+  }
+
+  m_lru.emplace_front(info.image_id, img);
+  m_entries[info.image_id] = m_lru.begin();
+  if (m_lru.size() > m_capacity) {
+    dropOldest();
+  }
+  MemoryAccounting::instance().add(MemoryAccounting::IMAGE_CACHE, MemoryAccounting::HOST, img.sizeInBytes());
+}
+
+void ImageCache::dropOldest() {
+  MemoryAccounting::instance().add(MemoryAccounting::IMAGE_CACHE, MemoryAccounting::HOST,
+                                   -static_cast<int64_t>(m_lru.back().second.sizeInBytes()));
+  m_entries.erase(m_lru.back().first);
+  m_lru.pop_back();
+}
+
+void ImageCache::clear() {
+  while (!m_lru.empty()) {
+    dropOldest();
+  }
+}
@@ -0,0 +1,46 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_IMAGECACHE_H
+#define MATCH_MANUALLY_IMAGECACHE_H
+
+#include <list>
+#include <map>
+#include <QImage>
+#include "ImageGraphModel.h"
+
+/*
+ * decodes images on first use and keeps the most recently used ones, QImage is shared so copies are cheap.
+ * the decoded bytes count as MemoryAccounting::IMAGE_CACHE, over its host budget the oldest images are dropped
+ */
+class ImageCache {
+public:
+  explicit ImageCache(size_t capacity = 32);
+
+  ~ImageCache();
+
+  ImageCache(const ImageCache &) = delete;
+
+  ImageCache &operator=(const ImageCache &) = delete;
+
+  /* null image when the file can not be decoded */
+  QImage image(const ImageInfo &info);
+
+  /* an image decoded elsewhere, e.g. on a worker thread, as if image() had decoded it. a cached one is kept */
+  void insert(const ImageInfo &info, const QImage &img);
+
+  void clear();
+
+private:
+  typedef std::list<std::pair<Image_ID_T, QImage>> LruList;
+  size_t m_capacity;
+  int m_evictionCallback;
+  LruList m_lru;
+  std::map<Image_ID_T, LruList::iterator> m_entries;
+
+  void dropOldest();
+};
+
+
+#endif //MATCH_MANUALLY_IMAGECACHE_H
@@ -3,9 +3,13 @@
 //
 
 #include "ImageGraphModel.h"
+#include "ProjectCache.h"
+#include "Trace.h"
 #include <QFileInfo>
 #include <QMetaEnum>
 #include <QDebug>
+#include <algorithm>
+#include <unordered_map>
 
 static const float depthDecederStep = std::numeric_limits<float>::epsilon() * 10;
 
@@ -53,8 +57,6 @@ QVariant ImageGraphModel::data(const QModelIndex &index, int role) const {
         return QFileInfo(imageInfos.at(image_id).path).baseName();
       } else if (role == Qt::CheckStateRole) {
         return imageInfos.at(image_id).checkState;
-      } else if (role == Qt::DisplayPropertyRole) {
-        return imageInfos.at(image_id).data;
       } else if (role == Qt::UserRole + 1) {
         return imageInfos.at(image_id).path;
       } else if (role == Qt::UserRole + 2) {
@@ -90,62 +92,397 @@ QVariant ImageGraphModel::headerData(int section, Qt::Orientation orientation, i
   return QAbstractItemModel::headerData(section, orientation, role);
 }
 
-bool ImageGraphModel::appendImages(const std::vector<QString> &img_paths) {
+bool ImageGraphModel::appendImages(const std::vector<QString> &img_paths, const std::vector<QSize> &img_sizes) {
+  TRACE_SCOPE("ImageGraphModel::appendImages");
+  if (img_paths.size() != img_sizes.size()) {
+    qWarning("image path and size count mismatch");
+    return false;
+  }
   beginInsertRows(QModelIndex(), imageInfos.size(), imageInfos.size() + img_paths.size() - 1);
-  for (const auto &img_path: img_paths) {
-    addImage(img_path);
+  for (size_t i = 0; i < img_paths.size(); i++) {
+    addImage(img_paths[i], img_sizes[i]);
   }
   endInsertRows();
+  updateMemoryGauge();
   return true;
 }
 
-bool ImageGraphModel::appendColmapData(const QString &image_dir, const ColmapLoader &loader){
+bool ImageGraphModel::appendColmapData(const QString &image_dir, const ColmapLoader &loader, const QString &origin){
+  TRACE_SCOPE("ImageGraphModel::appendColmapData");
+  /* image size comes from the camera, keypoints are normalized without decoding any image */
+  std::map<ColmapLoader::camera_t, QSize> cameraSizes;
+  for (const auto &camera: loader.camerasInfo) {
+    cameraSizes[camera.camera_id] = QSize(static_cast<int>(camera.width), static_cast<int>(camera.height));
+  }
+  for (const auto &img_info: loader.imagesInfo) {
+    auto it = cameraSizes.find(img_info.camera_id);
+    if ((it == cameraSizes.end()) || it->second.isEmpty()) {
+      qWarning() << "image" << img_info.image_id << "has no valid camera" << img_info.camera_id;
+      return false;
+    }
+  }
+  if (origins.size() > std::numeric_limits<uint16_t>::max()) {
+    qWarning("too many reconstructions");
+    return false;
+  }
+  const auto originId = static_cast<uint16_t>(origins.size());
+  /* the names become directories when the model is written back, so they have to be unique */
+  QString name = origin.isEmpty() ? QString::number(originId) : origin;
+  for (int suffix = 1; std::find(origins.begin(), origins.end(), name) != origins.end(); suffix++) {
+    name = (origin.isEmpty() ? QString::number(originId) : origin) + "_" + QString::number(suffix);
+  }
+  origins.push_back(name);
+
+  /* sub-models number their points from 1, so all of them move past the used ids when one collides. image ids
+   * come from the shared database and only the images registered in several sub-models get new ones */
+  Track_ID_T trackOffset = 0;
+  for (const auto &p: loader.points3D) {
+    if (tracks.count(p.point3D_id) != 0) {
+      trackOffset = track_id_max;
+      break;
+    }
+  }
+  std::unordered_map<ColmapLoader::image_t, Image_ID_T> remappedImages;
+  Image_ID_T nextImageId = image_id_max;
+  for (const auto &img_info: loader.imagesInfo) {
+    nextImageId = std::max(nextImageId, img_info.image_id + 1);
+  }
+  for (const auto &img_info: loader.imagesInfo) {
+    if (imageInfos.count(img_info.image_id) != 0) {
+      remappedImages[img_info.image_id] = nextImageId++;
+    }
+  }
+  auto modelImageId = [&](ColmapLoader::image_t image_id) -> Image_ID_T {
+    if (remappedImages.empty()) {
+      return image_id;
+    }
+    auto it = remappedImages.find(image_id);
+    return it == remappedImages.end() ? image_id : it->second;
+  };
+  if (!remappedImages.empty()) {
+    qInfo() << remappedImages.size() << "images of reconstruction" << origins.back()
+            << "are already in the model and get new ids";
+  }
+  /* sub-models share the camera ids of the database but refine their own intrinsics, so they must not
+   * overwrite each other. the camera keeps its colmap id, only the key in cameras is new */
+  std::unordered_map<ColmapLoader::camera_t, ColmapLoader::camera_t> remappedCameras;
+  ColmapLoader::camera_t nextCameraId = cameras.empty() ? 1 : cameras.rbegin()->first + 1;
+  for (const auto &camera: loader.camerasInfo) {
+    nextCameraId = std::max(nextCameraId, camera.camera_id + 1);
+  }
+  for (const auto &camera: loader.camerasInfo) {
+    const auto camera_id = cameras.count(camera.camera_id) != 0 ? nextCameraId++ : camera.camera_id;
+    if (camera_id != camera.camera_id) {
+      remappedCameras[camera.camera_id] = camera_id;
+    }
+    cameras[camera_id] = camera;
+  }
+  auto modelCameraId = [&](ColmapLoader::camera_t camera_id) {
+    auto it = remappedCameras.find(camera_id);
+    return it == remappedCameras.end() ? camera_id : it->second;
+  };
   for(const auto &p: loader.points3D){
+    const Track_ID_T track_id = p.point3D_id + trackOffset;
     Track tr = {
         .pos = p.XYZ.cast<float>(),
         .error = static_cast<float>(p.error),
-        .track_id = p.point3D_id
+        .track_id = track_id,
+        .color = p.Color,
+        .origin = originId
     };
-    tracks.emplace(p.point3D_id,std::move(tr));
-    auto &images = tracks.at(p.point3D_id).images;
-    auto &kps = tracks.at(p.point3D_id).kps;
+    auto &added = tracks.emplace(track_id, std::move(tr)).first->second;
+    added.images.reserve(p.track.size());
+    added.kps.reserve(p.track.size());
     for(const auto &it: p.track){
-      images.push_back(it.first);
-      kps.push_back(it.second);
+      added.images.push_back(modelImageId(it.first));
+      added.kps.push_back(it.second);
     }
-    track_id_max = std::max(track_id_max, p.point3D_id);
+    track_id_max = std::max(track_id_max, track_id + 1);
+  }
+  if (!loader.imagesInfo.empty()) {
+    beginInsertRows(QModelIndex(), imageInfos.size(), imageInfos.size() + loader.imagesInfo.size() - 1);
   }
-  beginInsertRows(QModelIndex(), imageInfos.size(), imageInfos.size() + loader.imagesInfo.size() - 1);
   for (const auto &img_info: loader.imagesInfo) {
+    const Image_ID_T image_id = modelImageId(img_info.image_id);
     QString image_path = image_dir + "/" +QString::fromStdString(img_info.name);
     ImageInfo imageInfo = {
         .path = image_path,
         .checkState = Qt::Unchecked,
-        .data = QImage(image_path),
-        .image_id = img_info.image_id
+        .size = cameraSizes.at(img_info.camera_id),
+        .image_id = image_id,
+        .colmap = {
+            .registered = true,
+            .image_id = img_info.image_id,
+            .origin = originId,
+            .camera_id = modelCameraId(img_info.camera_id),
+            .qvec = img_info.Qvec,
+            .tvec = img_info.Tvec,
+            .name = img_info.name
+        }
     };
-    const auto &img_size = imageInfo.data.size();
-    imageInfos.emplace(img_info.image_id, std::move(imageInfo));
-    imageIndex.push_back(img_info.image_id);
-    auto &kps = imageInfos.at(img_info.image_id).keyPoints;
+    const auto img_size = imageInfo.size;
+    imageInfos.emplace(image_id, std::move(imageInfo));
+    imageIndex.push_back(image_id);
+    auto &kps = imageInfos.at(image_id).keyPoints;
     for(uint32_t i = 0; i < img_info.points2D.size(); i++){
       Eigen::Vector2f kp_pos(img_info.points2D[i].x()/img_size.width(), img_info.points2D[i].y()/img_size.height());
       KeyPoint kp = {
           .pos = kp_pos,
-          .track_id = img_info.point3D_ids[i],
-          .image_id = img_info.image_id,
+          .track_id = img_info.point3D_ids[i] == ColmapLoader::kInvalidPoint3DId ? img_info.point3D_ids[i] :
+                      img_info.point3D_ids[i] + trackOffset,
+          .image_id = image_id,
           .kp_id = i
       };
 
       kps.push_back(kp);
     }
-    image_id_max = std::max(img_info.image_id, image_id_max);
+    image_id_max = std::max(image_id + 1, image_id_max);
   }
-  endInsertRows();
+  if (!loader.imagesInfo.empty()) {
+    endInsertRows();
+  }
+  updateMemoryGauge();
+  return true;
+}
+
+bool ImageGraphModel::appendColmapSparseDir(const QString &image_dir, const std::string &sparse_dir) {
+  TRACE_SCOPE("ImageGraphModel::appendColmapSparseDir");
+  const auto dirs = ColmapLoader::subModelDirs(sparse_dir);
+  if (dirs.empty()) {
+    qWarning() << "no colmap sparse model in" << QString::fromStdString(sparse_dir);
+    return false;
+  }
+  const auto loaders = ColmapLoader::loadParallel(dirs);
+  bool ok = true;
+  for (size_t i = 0; i < dirs.size(); i++) {
+    const QString name = QFileInfo(QString::fromStdString(dirs[i])).fileName();
+    if (loaders[i] == nullptr) {
+      qWarning() << "can not load colmap sparse model" << QString::fromStdString(dirs[i]);
+      ok = false;
+      continue;
+    }
+    ok = appendColmapData(image_dir, *loaders[i], dirs.size() > 1 ? name : QString()) && ok;
+  }
+  return ok;
+}
+
+bool ImageGraphModel::appendColmapDatabase(const QString &image_dir,
+                                           const std::shared_ptr<ColmapDatabase> &database) {
+  TRACE_SCOPE("ImageGraphModel::appendColmapDatabase");
+  if ((database == nullptr) || !database->isOpen()) {
+    return false;
+  }
+  std::map<ColmapDatabase::camera_t, QSize> cameraSizes;
+  for (const auto &camera: database->cameras) {
+    cameraSizes[camera.camera_id] = QSize(static_cast<int>(camera.width), static_cast<int>(camera.height));
+  }
+  /* an image registered in several reconstructions has one model image per reconstruction */
+  std::map<QString, std::vector<Image_ID_T>> pathIds;
+  for (const auto &it: imageInfos) {
+    pathIds[it.second.path].push_back(it.first);
+  }
+
+  for (const auto &camera: database->cameras) {
+    if (cameras.count(camera.camera_id) == 0) {
+      cameras[camera.camera_id] = {camera.camera_id, camera.model_id, camera.width, camera.height, camera.params};
+    }
+  }
+  m_databaseImageIds.clear();
+  std::vector<size_t> newImages;
+  for (size_t i = 0; i < database->images.size(); i++) {
+    const auto &img = database->images[i];
+    auto it = pathIds.find(image_dir + "/" + QString::fromStdString(img.name));
+    if (it == pathIds.end()) {
+      auto camera = cameraSizes.find(img.camera_id);
+      if ((camera == cameraSizes.end()) || camera->second.isEmpty()) {
+        qWarning() << "skip database image" << img.image_id << "without valid camera" << img.camera_id;
+        continue;
+      }
+      newImages.push_back(i);
+      continue;
+    }
+    /* the sparse model keeps every keypoint, so keypoint ids of both sources agree */
+    for (const auto image_id: it->second) {
+      if (imageInfos.at(image_id).keyPoints.size() != database->keypoints[i].size()) {
+        qWarning() << "image" << QString::fromStdString(img.name) << "has" << imageInfos.at(image_id).keyPoints.size()
+                   << "keypoints in the model and" << database->keypoints[i].size()
+                   << "in the database, matches are ignored";
+        continue;
+      }
+      m_databaseImageIds[image_id] = img.image_id;
+    }
+  }
+
+  if (!newImages.empty()) {
+    beginInsertRows(QModelIndex(), imageInfos.size(), imageInfos.size() + newImages.size() - 1);
+    for (const auto i: newImages) {
+      const auto &img = database->images[i];
+      const QSize size = cameraSizes.at(img.camera_id);
+      auto &imageInfo = addImage(image_dir + "/" + QString::fromStdString(img.name), size);
+      imageInfo.colmap.image_id = img.image_id;
+      imageInfo.colmap.camera_id = img.camera_id;
+      imageInfo.colmap.name = img.name;
+      const auto &positions = database->keypoints[i];
+      imageInfo.keyPoints.reserve(positions.size());
+      for (size_t k = 0; k < positions.size(); k++) {
+        KeyPoint kp = {
+            .pos = Eigen::Vector2f(positions[k].x() / size.width(), positions[k].y() / size.height()),
+            .track_id = std::numeric_limits<Track_ID_T>::max(),
+            .image_id = imageInfo.image_id,
+            .kp_id = static_cast<KeyPoint_ID_T>(k)
+        };
+        imageInfo.keyPoints.push_back(kp);
+      }
+      m_databaseImageIds[imageInfo.image_id] = img.image_id;
+    }
+    endInsertRows();
+  }
+
+  m_database = database;
+  m_matchCache.clear();
+  m_matchCacheOrder.clear();
+  updateMemoryGauge();
+  updateMatchMemoryGauge();
   return true;
 }
 
+bool ImageGraphModel::loadProjectCache(const std::string &path, const std::string &source) {
+  TRACE_SCOPE("ImageGraphModel::loadProjectCache");
+  beginResetModel();
+  imageInfos.clear();
+  imageIndex.clear();
+  tracks.clear();
+  cameras.clear();
+  origins.clear();
+  image_id_max = 0;
+  track_id_max = 0;
+  m_database.reset();
+  m_databaseImageIds.clear();
+  m_matchCache.clear();
+  m_matchCacheOrder.clear();
+  const bool loaded = ProjectCache::read(path, source, this);
+  endResetModel();
+  updateMemoryGauge();
+  updateMatchMemoryGauge();
+  return loaded;
+}
+
+bool ImageGraphModel::saveProjectCache(const std::string &path, const std::string &source) const {
+  return ProjectCache::write(*this, path, source);
+}
+
+const ColmapDatabase::PairMatches *ImageGraphModel::pairMatches(Image_ID_T image_id1, Image_ID_T image_id2,
+                                                                ColmapDatabase::MatchKind kind) {
+  if (m_database == nullptr) {
+    return nullptr;
+  }
+  const PairMatchKey key(image_id1, image_id2, kind);
+  auto cached = m_matchCache.find(key);
+  if (cached != m_matchCache.end()) {
+    m_matchCacheOrder.remove(key);
+    m_matchCacheOrder.push_back(key);
+    return &cached->second;
+  }
+
+  ColmapDatabase::PairMatches result;
+  if (!readPairMatches(image_id1, image_id2, kind, &result)) {
+    return nullptr;
+  }
+
+  if (m_matchCache.size() >= matchCacheSize) {
+    m_matchCache.erase(m_matchCacheOrder.front());
+    m_matchCacheOrder.pop_front();
+  }
+  m_matchCacheOrder.push_back(key);
+  auto &entry = m_matchCache[key];
+  entry = std::move(result);
+  updateMatchMemoryGauge();
+  return &entry;
+}
+
+bool ImageGraphModel::readPairMatches(Image_ID_T image_id1, Image_ID_T image_id2, ColmapDatabase::MatchKind kind,
+                                      ColmapDatabase::PairMatches *result) const {
+  if (m_database == nullptr) {
+    return false;
+  }
+  auto db1 = m_databaseImageIds.find(image_id1);
+  auto db2 = m_databaseImageIds.find(image_id2);
+  if ((db1 == m_databaseImageIds.end()) || (db2 == m_databaseImageIds.end())) {
+    return false;
+  }
+  if (!m_database->readMatches(db1->second, db2->second, kind, result)) {
+    return false;
+  }
+  result->image_id1 = image_id1;
+  result->image_id2 = image_id2;
+  const size_t kpCount1 = imageInfos.at(image_id1).keyPoints.size();
+  const size_t kpCount2 = imageInfos.at(image_id2).keyPoints.size();
+  const auto valid = std::remove_if(result->matches.begin(), result->matches.end(), [&](const auto &m) {
+    return (m.first >= kpCount1) || (m.second >= kpCount2);
+  });
+  if (valid != result->matches.end()) {
+    qWarning() << "dropped" << std::distance(valid, result->matches.end()) << "matches with invalid keypoints";
+    result->matches.erase(valid, result->matches.end());
+  }
+  return true;
+}
+
+std::vector<std::pair<size_t, size_t>> ImageGraphModel::matchedPairs(const std::vector<Image_ID_T> &images,
+                                                                     ColmapDatabase::MatchKind kind) const {
+  TRACE_SCOPE("ImageGraphModel::matchedPairs");
+  std::vector<std::pair<size_t, size_t>> pairs;
+  if (m_database == nullptr) {
+    return pairs;
+  }
+  /* an image of the database can be several model images, one per reconstruction */
+  std::unordered_map<ColmapDatabase::image_t, std::vector<size_t>> selected;
+  for (size_t i = 0; i < images.size(); i++) {
+    auto db = m_databaseImageIds.find(images[i]);
+    if (db != m_databaseImageIds.end()) {
+      selected[db->second].push_back(i);
+    }
+  }
+  for (const auto &pair: m_database->listPairs(kind)) {
+    auto a = selected.find(pair.first);
+    auto b = selected.find(pair.second);
+    if ((a == selected.end()) || (b == selected.end())) {
+      continue;
+    }
+    for (const auto i: a->second) {
+      for (const auto j: b->second) {
+        pairs.emplace_back(std::min(i, j), std::max(i, j));
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+void ImageGraphModel::updateMatchMemoryGauge() {
+  uint64_t bytes = 0;
+  for (const auto &it: m_matchCache) {
+    bytes += sizeof(it) + it.second.matches.capacity() * sizeof(it.second.matches[0]);
+  }
+  m_matchMemory.set(bytes);
+}
+
+void ImageGraphModel::updateMemoryGauge() {
+  /* std::map nodes carry about four pointers of overhead */
+  const uint64_t nodeOverhead = 4 * sizeof(void *);
+  uint64_t bytes = imageIndex.capacity() * sizeof(Image_ID_T);
+  for (const auto &it: imageInfos) {
+    bytes += sizeof(it) + nodeOverhead + it.second.keyPoints.capacity() * sizeof(KeyPoint) +
+             it.second.path.capacity() * sizeof(QChar) + it.second.colmap.name.capacity();
+  }
+  for (const auto &it: tracks) {
+    bytes += sizeof(it) + nodeOverhead + it.second.images.capacity() * sizeof(Image_ID_T) +
+             it.second.kps.capacity() * sizeof(KeyPoint_ID_T) + it.second.shapes.capacity() * sizeof(int);
+  }
+  m_memory.set(bytes);
+}
+
 KeyPoint_ID_T ImageGraphModel::appendImageKeyPoint(Image_ID_T imgIdx, const Eigen::Vector2f &keyPoint) {
+  TRACE_SCOPE("ImageGraphModel::appendImageKeyPoint");
   KeyPoint kp = {
           .pos = keyPoint,
           .track_id = std::numeric_limits<Track_ID_T>::max(),
@@ -158,19 +495,40 @@ KeyPoint_ID_T ImageGraphModel::appendImageKeyPoint(Image_ID_T imgIdx, const Eige
   return kp.kp_id;
 }
 
+void ImageGraphModel::setKeyPointPosition(Image_ID_T image_id, KeyPoint_ID_T kp_id, const Eigen::Vector2f &pos) {
+  auto &kp = imageInfos.at(image_id).keyPoints.at(kp_id);
+  kp.pos = pos;
+  emit keyPointsInserted(image_id);
+  if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+    emit trackChanged(kp.track_id);
+  }
+}
+
+void ImageGraphModel::setTrackPoint(Track_ID_T track_id, const Eigen::Vector3f &pos, float error) {
+  auto &tr = tracks.at(track_id);
+  tr.pos = pos;
+  tr.error = error;
+  emit trackPointChanged(track_id);
+}
+
 Track_ID_T ImageGraphModel::getOrCreateTrackForKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  TRACE_SCOPE("ImageGraphModel::getOrCreateTrackForKeypoint");
   auto &kp = imageInfos.at(image_id).keyPoints.at(kp_id);
   if(kp.track_id == std::numeric_limits<Track_ID_T>::max()){
     auto &tr = addTrack();
+    /* triangulation, export and review only look at the images of the reconstruction of the track */
+    tr.origin = imageInfos.at(image_id).colmap.origin;
     kp.track_id = tr.track_id;
     tr.images.emplace_back(image_id);
     tr.kps.emplace_back(kp_id);
+    emit trackChanged(tr.track_id);
   }
 
   return kp.track_id;
 }
 
 bool ImageGraphModel::addKeypoint2Track(Track_ID_T track_id, Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  TRACE_SCOPE("ImageGraphModel::addKeypoint2Track");
   auto &kp = imageInfos.at(image_id).keyPoints.at(kp_id);
   auto &tr = tracks.at(track_id);
 
@@ -181,6 +539,23 @@ bool ImageGraphModel::addKeypoint2Track(Track_ID_T track_id, Image_ID_T image_id
     }
   }
 
+  /* the poses of two reconstructions are in unrelated frames, one track can not observe both */
+  const auto &colmap = imageInfos.at(image_id).colmap;
+  const int trackOrigin = registeredOrigin(tr);
+  int kpOrigin = colmap.registered ? colmap.origin : -1;
+  if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+    kpOrigin = registeredOrigin(tracks.at(kp.track_id));
+  }
+  if ((trackOrigin >= 0) && (kpOrigin >= 0) && (trackOrigin != kpOrigin)) {
+    qWarning() << "track" << tr.track_id << "is in reconstruction" << origins.at(trackOrigin) << ", the keypoint in"
+               << origins.at(kpOrigin);
+    return false;
+  }
+  /* a track of unregistered images only takes the reconstruction of its first registered one */
+  if ((trackOrigin < 0) && (kpOrigin >= 0)) {
+    tr.origin = static_cast<uint16_t>(kpOrigin);
+  }
+
   if (kp.track_id == std::numeric_limits<Track_ID_T>::max()) {
     kp.track_id = tr.track_id;
     tr.kps.emplace_back(kp.kp_id);
@@ -189,7 +564,9 @@ bool ImageGraphModel::addKeypoint2Track(Track_ID_T track_id, Image_ID_T image_id
     qWarning("kp already in the track");
   } else {
     qWarning() << "merge track " << kp.track_id << " and " << tr.track_id;
-    const auto &kp_tr = tracks.at(kp.track_id);
+    /* kp itself is renumbered below, keep the id of the track that goes away */
+    const Track_ID_T merged_id = kp.track_id;
+    const auto &kp_tr = tracks.at(merged_id);
     if(checkVectorDuplicate(kp_tr.images, tr.images)){
       qFatal("there is duplicate image in these two track");
       return false;
@@ -199,17 +576,18 @@ bool ImageGraphModel::addKeypoint2Track(Track_ID_T track_id, Image_ID_T image_id
     }
     tr.kps.insert(tr.kps.end(), kp_tr.kps.begin(), kp_tr.kps.end());
     tr.images.insert(tr.images.end(), kp_tr.images.begin(), kp_tr.images.end());
-    tracks.erase(kp.track_id);
+    tracks.erase(merged_id);
   }
+  emit trackChanged(tr.track_id);
   return true;
 }
 
-ImageInfo &ImageGraphModel::addImage(const QString &image_path)
+ImageInfo &ImageGraphModel::addImage(const QString &image_path, const QSize &image_size)
 {
   ImageInfo imageInfo = {
           .path = image_path,
           .checkState = Qt::Unchecked,
-          .data = QImage(image_path),
+          .size = image_size,
           .image_id = image_id_max
   };
   imageIndex.push_back(imageInfo.image_id);
@@ -229,6 +607,16 @@ Track &ImageGraphModel::addTrack()
   return tracks[track_id_max++];
 }
 
+int ImageGraphModel::registeredOrigin(const Track &tr) const {
+  for (const auto image_id: tr.images) {
+    const auto &colmap = imageInfos.at(image_id).colmap;
+    if (colmap.registered) {
+      return colmap.origin;
+    }
+  }
+  return -1;
+}
+
 bool ImageGraphModel::checkVectorDuplicate(std::vector<Image_ID_T> v1, std::vector<Image_ID_T> v2)
 {
   std::sort(v1.begin(), v1.end());
@@ -236,7 +624,7 @@ bool ImageGraphModel::checkVectorDuplicate(std::vector<Image_ID_T> v1, std::vect
   size_t i = 0;
   size_t j = 0;
   while (true){
-    if((i == v1.size()) || (j = v2.size())){
+    if((i == v1.size()) || (j == v2.size())){
       return false;
     }
     if(v1[i] == v2[j]){
@@ -6,11 +6,16 @@
 #define MATCH_MANUALLY_IMAGEGRAPHMODEL_H
 
 #include <QAbstractItemModel>
-#include <QImage>
+#include <QSize>
+#include <list>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <Eigen/Eigen>
 #include "colampParser.h"
+#include "ColmapDatabase.h"
+#include "MemoryAccounting.h"
 
 typedef uint64_t Track_ID_T;
 typedef uint32_t KeyPoint_ID_T;
@@ -24,6 +29,9 @@ struct Track {
   std::vector<int> shapes;
   float error;
   Track_ID_T track_id;
+  Eigen::Matrix<uint8_t, 3, 1> color = Eigen::Matrix<uint8_t, 3, 1>::Zero();
+  /* index into ImageGraphModel::origins of the reconstruction the track came from */
+  uint16_t origin = 0;
 };
 
 struct KeyPoint {
@@ -33,12 +41,28 @@ struct KeyPoint {
   KeyPoint_ID_T kp_id;
 };
 
+/* what colmap knows about an image beyond its keypoints, kept so edits can be written back */
+struct ColmapImageMeta {
+  /* only registered images have a pose and go into images.bin */
+  bool registered = false;
+  /* id in the colmap model and database, differs from the model id when several reconstructions share the image */
+  ColmapLoader::image_t image_id = 0;
+  uint16_t origin = 0;
+  /* key into ImageGraphModel::cameras, the colmap id is the camera_id of the camera itself */
+  ColmapLoader::camera_t camera_id = 0;
+  Eigen::Vector4d qvec = Eigen::Vector4d(1, 0, 0, 0);
+  Eigen::Vector3d tvec = Eigen::Vector3d::Zero();
+  std::string name;
+};
+
+/* pixels are not kept here, the gui decodes them on demand through ImageCache */
 struct ImageInfo {
   QString path;
   Qt::CheckState checkState;
-  QImage data;
+  QSize size;
   std::vector<KeyPoint> keyPoints;
   Image_ID_T image_id;
+  ColmapImageMeta colmap;
 };
 
 class ImageGraphModel : public QAbstractItemModel {
@@ -48,7 +72,12 @@ public:
   std::vector<Image_ID_T> imageIndex;
   Image_ID_T image_id_max = 0;
   std::map<Track_ID_T, Track> tracks;
+  /* next free ids */
   Track_ID_T track_id_max = 0;
+  /* keyed by model camera id, reconstructions whose camera ids are taken get new keys like their images */
+  std::map<ColmapLoader::camera_t, ColmapLoader::SceneCameraInfo> cameras;
+  /* names of the loaded reconstructions, tracks and colmap images carry an index into it */
+  std::vector<QString> origins;
 
   enum ColumnLabelMeta {
     name,
@@ -75,25 +104,95 @@ public:
 
   bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 
-  bool appendImages(const std::vector<QString> &img_paths);
+  bool appendImages(const std::vector<QString> &img_paths, const std::vector<QSize> &img_sizes);
+
+  /*
+   * adds one reconstruction as a new origin. image and track ids already taken by an earlier reconstruction are
+   * remapped to free ones, an image registered in two sub-models becomes two model images
+   */
+  bool appendColmapData(const QString &image_dir, const ColmapLoader &loader, const QString &origin = QString());
+
+  /* loads the sparse model, or every numbered sub-model (sparse/0..N) in parallel, one origin each */
+  bool appendColmapSparseDir(const QString &image_dir, const std::string &sparse_dir);
+
+  /*
+   * attaches the feature database as match layer, images are matched by name and images that are not in the
+   * model yet are added with the database keypoints. match lists are read per pair on first use
+   */
+  bool appendColmapDatabase(const QString &image_dir, const std::shared_ptr<ColmapDatabase> &database);
+
+  bool hasMatchDatabase() const { return m_database != nullptr; }
+
+  /* replaces the whole model by a snapshot written by saveProjectCache, the match database is detached */
+  bool loadProjectCache(const std::string &path, const std::string &source);
+
+  bool saveProjectCache(const std::string &path, const std::string &source) const;
+
+  /*
+   * raw or verified matches between two model images, image ids and keypoint ids are the model ones and
+   * ordered as asked. nullptr when there is no database or the pair was never matched
+   */
+  const ColmapDatabase::PairMatches *pairMatches(Image_ID_T image_id1, Image_ID_T image_id2,
+                                                 ColmapDatabase::MatchKind kind);
 
-  bool appendColmapData(const QString &image_dir, const ColmapLoader &loader);
+  /* as pairMatches without the cache, for reads of many pairs that would only flush it. false as nullptr there */
+  bool readPairMatches(Image_ID_T image_id1, Image_ID_T image_id2, ColmapDatabase::MatchKind kind,
+                       ColmapDatabase::PairMatches *result) const;
+
+  /*
+   * pairs of the images that have matches of this kind in the database, indices into images with first < second
+   * in ascending order. one query for all pairs instead of one per pair
+   */
+  std::vector<std::pair<size_t, size_t>> matchedPairs(const std::vector<Image_ID_T> &images,
+                                                      ColmapDatabase::MatchKind kind) const;
 
   KeyPoint_ID_T appendImageKeyPoint(Image_ID_T imgIdx, const Eigen::Vector2f &keyPoint);
 
+  /* moves a keypoint (normalized image coordinate), its track counts as changed */
+  void setKeyPointPosition(Image_ID_T image_id, KeyPoint_ID_T kp_id, const Eigen::Vector2f &pos);
+
+  /* writes a triangulation result, pos zero marks a track that could not be triangulated */
+  void setTrackPoint(Track_ID_T track_id, const Eigen::Vector3f &pos, float error);
+
   Track_ID_T getOrCreateTrackForKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id);
 
+  /* fails when the keypoint or its track has registered images of another reconstruction than the track */
   bool addKeypoint2Track(Track_ID_T track_id, Image_ID_T image_id, KeyPoint_ID_T kp_id);
 
   QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
 signals:
 
+  /* keypoints of the image were appended or moved */
   void keyPointsInserted(int imgIdx);
 
+  /* the track was created or got observations, merged tracks report the surviving one */
+  void trackChanged(Track_ID_T track_id);
+
+  /* the 3d point or error of the track was updated, its observations stayed the same */
+  void trackPointChanged(Track_ID_T track_id);
+
 private:
-  ImageInfo &addImage(const QString &image_path);
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::MODEL, MemoryAccounting::HOST};
+
+  /* rescans after bulk loads, single edits are too small to matter */
+  void updateMemoryGauge();
+
+  typedef std::tuple<Image_ID_T, Image_ID_T, ColmapDatabase::MatchKind> PairMatchKey;
+  /* recently viewed pairs, a pair of two 10k keypoint images can carry 100k raw matches */
+  static const size_t matchCacheSize = 64;
+  std::shared_ptr<ColmapDatabase> m_database;
+  std::map<Image_ID_T, ColmapDatabase::image_t> m_databaseImageIds;
+  std::map<PairMatchKey, ColmapDatabase::PairMatches> m_matchCache;
+  std::list<PairMatchKey> m_matchCacheOrder;
+  MemoryAccounting::Gauge m_matchMemory{MemoryAccounting::MODEL, MemoryAccounting::HOST};
+
+  void updateMatchMemoryGauge();
+
+  ImageInfo &addImage(const QString &image_path, const QSize &image_size);
   Track &addTrack();
+  /* origin of the registered images of the track, -1 when it has none */
+  int registeredOrigin(const Track &tr) const;
   bool checkVectorDuplicate(std::vector<Image_ID_T> v1, std::vector<Image_ID_T> v2);
 };
 
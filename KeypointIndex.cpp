@@ -0,0 +1,115 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <cmath>
+#include "KeypointIndex.h"
+
+void KeypointIndex::build(const std::vector<KeyPoint> &keyPoints, float keypointsPerCell) {
+  const size_t n = keyPoints.size();
+  const int side = std::max(1, static_cast<int>(std::sqrt(n / std::max(keypointsPerCell, 1.f))));
+  m_cols = side;
+  m_rows = side;
+  m_positions.resize(n);
+  m_ids.resize(n);
+  m_cellStart.assign(static_cast<size_t>(m_cols) * m_rows + 1, 0);
+
+  std::vector<uint32_t> cells(n);
+  for (size_t i = 0; i < n; i++) {
+    m_positions[i] = keyPoints[i].pos;
+    cells[i] = cellOf(keyPoints[i].pos.y(), m_rows) * m_cols + cellOf(keyPoints[i].pos.x(), m_cols);
+    m_cellStart[cells[i] + 1]++;
+  }
+  for (size_t c = 1; c < m_cellStart.size(); c++) {
+    m_cellStart[c] += m_cellStart[c - 1];
+  }
+  std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+  for (size_t i = 0; i < n; i++) {
+    m_ids[fill[cells[i]]++] = static_cast<KeyPoint_ID_T>(i);
+  }
+}
+
+template<typename F>
+void KeypointIndex::forEachInRadius(const Eigen::Vector2f &pos, float radius, F &&f) const {
+  if (m_positions.empty()) {
+    return;
+  }
+  const int x0 = cellOf(pos.x() - radius, m_cols);
+  const int x1 = cellOf(pos.x() + radius, m_cols);
+  const int y0 = cellOf(pos.y() - radius, m_rows);
+  const int y1 = cellOf(pos.y() + radius, m_rows);
+  const float r2 = radius * radius;
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      const size_t cell = static_cast<size_t>(y) * m_cols + x;
+      for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++) {
+        const KeyPoint_ID_T id = m_ids[i];
+        const float d2 = (m_positions[id] - pos).squaredNorm();
+        if (d2 <= r2) {
+          f(id, d2);
+        }
+      }
+    }
+  }
+}
+
+KeyPoint_ID_T KeypointIndex::nearest(const Eigen::Vector2f &pos, float radius) const {
+  KeyPoint_ID_T best = npos;
+  float bestD2 = std::numeric_limits<float>::max();
+  forEachInRadius(pos, radius, [&](KeyPoint_ID_T id, float d2) {
+    if (d2 < bestD2) {
+      bestD2 = d2;
+      best = id;
+    }
+  });
+  return best;
+}
+
+void KeypointIndex::radiusSearch(const Eigen::Vector2f &pos, float radius, std::vector<KeyPoint_ID_T> &result) const {
+  result.clear();
+  forEachInRadius(pos, radius, [&](KeyPoint_ID_T id, float) {
+    result.push_back(id);
+  });
+}
+
+void KeypointIndex::segmentSearch(const Eigen::Vector2f &a, const Eigen::Vector2f &b, float radius,
+                                  std::vector<KeyPoint_ID_T> &result) const {
+  result.clear();
+  if (m_positions.empty()) {
+    return;
+  }
+  const Eigen::Vector2f d = b - a;
+  const float len2 = d.squaredNorm();
+  const float r2 = radius * radius;
+  const int y0 = cellOf(std::min(a.y(), b.y()) - radius, m_rows);
+  const int y1 = cellOf(std::max(a.y(), b.y()) + radius, m_rows);
+  for (int y = y0; y <= y1; y++) {
+    /* part of the segment that comes within radius of this row of cells */
+    float t0 = 0.f;
+    float t1 = 1.f;
+    if (std::abs(d.y()) > 1e-12f) {
+      const float s0 = (static_cast<float>(y) / m_rows - radius - a.y()) / d.y();
+      const float s1 = (static_cast<float>(y + 1) / m_rows + radius - a.y()) / d.y();
+      t0 = std::max(t0, std::min(s0, s1));
+      t1 = std::min(t1, std::max(s0, s1));
+      if (t0 > t1) {
+        continue;
+      }
+    }
+    const float xa = a.x() + t0 * d.x();
+    const float xb = a.x() + t1 * d.x();
+    const int x0 = cellOf(std::min(xa, xb) - radius, m_cols);
+    const int x1 = cellOf(std::max(xa, xb) + radius, m_cols);
+    for (int x = x0; x <= x1; x++) {
+      const size_t cell = static_cast<size_t>(y) * m_cols + x;
+      for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++) {
+        const KeyPoint_ID_T id = m_ids[i];
+        const Eigen::Vector2f p = m_positions[id] - a;
+        const float t = len2 > 0.f ? std::min(std::max(p.dot(d) / len2, 0.f), 1.f) : 0.f;
+        if ((p - t * d).squaredNorm() <= r2) {
+          result.push_back(id);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,51 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_KEYPOINTINDEX_H
+#define MATCH_MANUALLY_KEYPOINTINDEX_H
+
+#include <vector>
+#include <Eigen/Eigen>
+#include "ImageGraphModel.h"
+
+/*
+ * uniform grid over the normalized keypoint positions of one image, keypoint ids are bucketed by a counting
+ * sort so a build is two passes over the keypoints and the grid is two flat arrays
+ */
+class KeypointIndex {
+public:
+  static const KeyPoint_ID_T npos = std::numeric_limits<KeyPoint_ID_T>::max();
+
+  /* about keypointsPerCell keypoints per cell on average */
+  void build(const std::vector<KeyPoint> &keyPoints, float keypointsPerCell = 4.f);
+
+  /* nearest keypoint within radius (normalized coordinates), npos if there is none */
+  KeyPoint_ID_T nearest(const Eigen::Vector2f &pos, float radius) const;
+
+  /* all keypoints within radius, unordered */
+  void radiusSearch(const Eigen::Vector2f &pos, float radius, std::vector<KeyPoint_ID_T> &result) const;
+
+  /* all keypoints within radius of the segment a b, unordered, only the cells along the segment are visited */
+  void segmentSearch(const Eigen::Vector2f &a, const Eigen::Vector2f &b, float radius,
+                     std::vector<KeyPoint_ID_T> &result) const;
+
+  size_t size() const { return m_positions.size(); }
+
+private:
+  int m_cols = 0;
+  int m_rows = 0;
+  std::vector<uint32_t> m_cellStart;
+  std::vector<KeyPoint_ID_T> m_ids;
+  std::vector<Eigen::Vector2f> m_positions;
+
+  int cellOf(float v, int n) const {
+    return std::min(std::max(static_cast<int>(v * n), 0), n - 1);
+  }
+
+  template<typename F>
+  void forEachInRadius(const Eigen::Vector2f &pos, float radius, F &&f) const;
+};
+
+
+#endif //MATCH_MANUALLY_KEYPOINTINDEX_H
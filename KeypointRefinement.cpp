@@ -0,0 +1,222 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "KeypointRefinement.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+/* zero mean, unit length patch sampled bilinearly around the pixel center c, false near the border or when flat */
+bool referencePatch(const GrayPyramids::Level &level, const Eigen::Vector2f &c, int r, std::vector<float> &out) {
+  const int n = 2 * r + 1;
+  const float x0 = c.x() - r;
+  const float y0 = c.y() - r;
+  if ((x0 < 0.f) || (y0 < 0.f) || (c.x() + r >= level.width - 1) || (c.y() + r >= level.height - 1)) {
+    return false;
+  }
+  const int ix = static_cast<int>(x0);
+  const int iy = static_cast<int>(y0);
+  const float fx = x0 - ix;
+  const float fy = y0 - iy;
+  const float w00 = (1 - fx) * (1 - fy), w01 = fx * (1 - fy), w10 = (1 - fx) * fy, w11 = fx * fy;
+  out.resize(n * n);
+  float mean = 0.f;
+  for (int py = 0; py < n; py++) {
+    const uint8_t *r0 = level.row(iy + py) + ix;
+    const uint8_t *r1 = level.row(iy + py + 1) + ix;
+    for (int px = 0; px < n; px++) {
+      const float v = w00 * r0[px] + w01 * r0[px + 1] + w10 * r1[px] + w11 * r1[px + 1];
+      out[py * n + px] = v;
+      mean += v;
+    }
+  }
+  mean /= n * n;
+  float norm = 0.f;
+  for (auto &v: out) {
+    v -= mean;
+    norm += v * v;
+  }
+  if (norm < 1e-3f) {
+    return false;
+  }
+  norm = 1.f / std::sqrt(norm);
+  for (auto &v: out) {
+    v *= norm;
+  }
+  return true;
+}
+
+/* offsets of a window row correlated together, fixed so the lane loops have a constant trip count */
+const int kLanes = 8;
+
+/*
+ * ncc of the reference with the patches centered at (cx + dx, cy + dy), |dx|, |dy| <= R, row major. the offsets
+ * of a window row are done in blocks of kLanes independent accumulators, which the compiler turns into vector
+ * code. the window is padded with zeros to whole blocks, padded lanes are never read back
+ */
+bool correlate(const GrayPyramids::Level &level, const std::vector<float> &ref, int r, int cx, int cy, int R,
+               std::vector<float> &scores) {
+  const int n = 2 * r + 1;
+  const int m = 2 * R + 1;
+  if ((cx - R - r < 0) || (cy - R - r < 0) || (cx + R + r >= level.width) || (cy + R + r >= level.height)) {
+    return false;
+  }
+  const int blocks = (m + kLanes - 1) / kLanes;
+  const int w = n + blocks * kLanes - 1;
+  std::vector<float> window(static_cast<size_t>(n + m - 1) * w, 0.f);
+  for (int y = 0; y < n + m - 1; y++) {
+    const uint8_t *row = level.row(cy - R - r + y) + cx - R - r;
+    for (int x = 0; x < n + m - 1; x++) {
+      window[y * w + x] = row[x];
+    }
+  }
+  scores.resize(m * m);
+  const float area = static_cast<float>(n * n);
+  for (int dy = 0; dy < m; dy++) {
+    for (int block = 0; block < blocks; block++) {
+      float dot[kLanes] = {}, sum[kLanes] = {}, sq[kLanes] = {};
+      for (int py = 0; py < n; py++) {
+        const float *wrow = window.data() + (dy + py) * w + block * kLanes;
+        const float *rrow = ref.data() + py * n;
+        for (int px = 0; px < n; px++) {
+          const float a = rrow[px];
+          const float *wp = wrow + px;
+          for (int k = 0; k < kLanes; k++) {
+            dot[k] += a * wp[k];
+            sum[k] += wp[k];
+            sq[k] += wp[k] * wp[k];
+          }
+        }
+      }
+      /* the reference has zero mean, its dot product with the raw window equals the one with the centered one */
+      for (int k = 0; (k < kLanes) && (block * kLanes + k < m); k++) {
+        const float var = sq[k] - sum[k] * sum[k] / area;
+        scores[dy * m + block * kLanes + k] = var > 1e-3f ? dot[k] / std::sqrt(var) : -1.f;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * maximum of the quadratic fitted to the 3x3 scores s around a peak (least squares), a fit per axis would be
+ * pulled off by oblique texture. false when the fit has no maximum near the peak
+ */
+bool quadraticPeak(const float s[9], Eigen::Vector2f *offset) {
+  auto at = [&](int x, int y) { return s[(y + 1) * 3 + x + 1]; };
+  float col[3] = {}, row[3] = {};
+  for (int i = -1; i <= 1; i++) {
+    for (int j = -1; j <= 1; j++) {
+      col[i + 1] += at(i, j);
+      row[j + 1] += at(i, j);
+    }
+  }
+  const Eigen::Vector2f gradient((col[2] - col[0]) / 6, (row[2] - row[0]) / 6);
+  Eigen::Matrix2f hessian;
+  hessian(0, 0) = (col[0] + col[2] - 2 * col[1]) / 3;
+  hessian(1, 1) = (row[0] + row[2] - 2 * row[1]) / 3;
+  hessian(0, 1) = hessian(1, 0) = (at(1, 1) - at(1, -1) - at(-1, 1) + at(-1, -1)) / 4;
+  if ((hessian(0, 0) >= 0.f) || (hessian.determinant() <= 0.f)) {
+    return false;
+  }
+  *offset = -hessian.inverse() * gradient;
+  return offset->cwiseAbs().maxCoeff() <= 1.f;
+}
+}
+
+KeypointRefinement::Result KeypointRefinement::refine(const GrayPyramids &pyramids, Image_ID_T ref_image_id,
+                                                      const Eigen::Vector2f &ref_pos, Image_ID_T image_id,
+                                                      const Eigen::Vector2f &pos) const {
+  Result result;
+  const auto *refPyramid = pyramids.pyramid(ref_image_id);
+  const auto *pyramid = pyramids.pyramid(image_id);
+  if ((refPyramid == nullptr) || (pyramid == nullptr)) {
+    return result;
+  }
+  int top = static_cast<int>(std::min(refPyramid->size(), pyramid->size())) - 1;
+  while ((top > 0) && ((options.searchRadius >> top) < 2)) {
+    top--;
+  }
+
+  const int r = options.patchRadius;
+  std::vector<float> ref, scores;
+  int cx = 0;
+  int cy = 0;
+  int R = 0;
+  for (int l = top; l >= 0; l--) {
+    const auto &refLevel = (*refPyramid)[l];
+    const auto &level = (*pyramid)[l];
+    const Eigen::Vector2f refCenter(ref_pos.x() * refLevel.width - 0.5f, ref_pos.y() * refLevel.height - 0.5f);
+    if (!referencePatch(refLevel, refCenter, r, ref)) {
+      return result;
+    }
+    if (l == top) {
+      cx = static_cast<int>(std::lround(pos.x() * level.width - 0.5f));
+      cy = static_cast<int>(std::lround(pos.y() * level.height - 0.5f));
+      R = std::max(options.searchRadius >> top, 1);
+    } else {
+      /* center c of level l + 1 is at 2 c + 0.5 here, the +-2 window covers the rounding */
+      cx = 2 * cx;
+      cy = 2 * cy;
+      R = 2;
+    }
+    /* a peak on the border of the window lies further out, the coarser level was off along a flat ridge */
+    const int m = 2 * R + 1;
+    long best = 0;
+    int bx = 0;
+    int by = 0;
+    for (int moves = 0; moves < 4; moves++) {
+      if (!correlate(level, ref, r, cx, cy, R, scores)) {
+        return result;
+      }
+      best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+      bx = static_cast<int>(best % m);
+      by = static_cast<int>(best / m);
+      cx += bx - R;
+      cy += by - R;
+      if ((bx > 0) && (bx < m - 1) && (by > 0) && (by < m - 1)) {
+        break;
+      }
+    }
+    if (l == 0) {
+      result.ncc = scores[best];
+      Eigen::Vector2f offset = Eigen::Vector2f::Zero();
+      if ((bx > 0) && (bx < m - 1) && (by > 0) && (by < m - 1)) {
+        float around[9];
+        for (int y = -1; y <= 1; y++) {
+          for (int x = -1; x <= 1; x++) {
+            around[(y + 1) * 3 + x + 1] = scores[best + y * m + x];
+          }
+        }
+        if (!quadraticPeak(around, &offset)) {
+          offset.setZero();
+        }
+      }
+      result.pos = Eigen::Vector2f((cx + offset.x() + 0.5f) / level.width, (cy + offset.y() + 0.5f) / level.height);
+      result.valid = result.ncc >= options.minNcc;
+    }
+  }
+  return result;
+}
+
+std::vector<KeypointRefinement::Result> KeypointRefinement::refineTrack(const ImageGraphModel &model,
+                                                                        const GrayPyramids &pyramids,
+                                                                        Track_ID_T track_id, size_t threads) const {
+  TRACE_SCOPE("KeypointRefinement::refineTrack");
+  std::vector<Result> results;
+  auto tr = model.tracks.find(track_id);
+  if ((tr == model.tracks.end()) || tr->second.images.empty()) {
+    return results;
+  }
+  const auto &track = tr->second;
+  results.resize(track.images.size());
+  const auto &ref_pos = model.imageInfos.at(track.images[0]).keyPoints[track.kps[0]].pos;
+  parallelFor(track.images.size() - 1, [&](size_t i) {
+    const auto &pos = model.imageInfos.at(track.images[i + 1]).keyPoints[track.kps[i + 1]].pos;
+    results[i + 1] = refine(pyramids, track.images[0], ref_pos, track.images[i + 1], pos);
+  }, threads);
+  return results;
+}
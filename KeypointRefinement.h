@@ -0,0 +1,49 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_KEYPOINTREFINEMENT_H
+#define MATCH_MANUALLY_KEYPOINTREFINEMENT_H
+
+#include <vector>
+#include "GrayPyramids.h"
+#include "ImageGraphModel.h"
+
+/*
+ * moves keypoints to the sub-pixel position where their patch matches a reference patch best. the search runs
+ * coarse to fine over the gray pyramids: the whole window at the coarsest level, +-2 px around the peak of the
+ * coarser level on every finer one, then the maximum of a quadratic fitted to the 3x3 scores of the level 0 peak.
+ * the reference is sampled bilinearly at its exact position, the correlation of all offsets of a window row is
+ * accumulated in contiguous arrays so the compiler vectorizes it
+ */
+class KeypointRefinement {
+public:
+  struct Options {
+    /* patches are (2 r + 1)^2 pixels around the keypoint on every level */
+    int patchRadius = 7;
+    /* px at level 0 the keypoint may move */
+    int searchRadius = 16;
+    /* matches below this correlation leave the keypoint where it is */
+    float minNcc = 0.6f;
+  };
+
+  struct Result {
+    bool valid = false;
+    /* normalized image coordinate as KeyPoint::pos */
+    Eigen::Vector2f pos = Eigen::Vector2f::Zero();
+    float ncc = 0.f;
+  };
+
+  Options options;
+
+  /* pos of image is the start of the search, both positions in normalized image coordinates */
+  Result refine(const GrayPyramids &pyramids, Image_ID_T ref_image_id, const Eigen::Vector2f &ref_pos,
+                Image_ID_T image_id, const Eigen::Vector2f &pos) const;
+
+  /* every observation of the track against the first one, in track order, the first result is never valid */
+  std::vector<Result> refineTrack(const ImageGraphModel &model, const GrayPyramids &pyramids, Track_ID_T track_id,
+                                  size_t threads = 0) const;
+};
+
+
+#endif //MATCH_MANUALLY_KEYPOINTREFINEMENT_H
@@ -21,6 +21,12 @@ LoadProjectDialog::LoadProjectDialog() {
   colmapPathButton = new QPushButton("...");
   connect(colmapPathButton, &QPushButton::clicked, this, &LoadProjectDialog::getColmapDirectoryPath);
 
+  /* optional, raw and verified matches are read from it */
+  databaseLabel = new QLabel(tr("colmap database:"));
+  databasePathEdit = new QLineEdit();
+  databasePathButton = new QPushButton("...");
+  connect(databasePathButton, &QPushButton::clicked, this, &LoadProjectDialog::getDatabaseFilePath);
+
   okButton = new QPushButton("Ok");
   connect(okButton, &QPushButton::clicked, this, &LoadProjectDialog::setResultOk);
   cancelButton = new QPushButton("Cancel");
@@ -33,8 +39,11 @@ LoadProjectDialog::LoadProjectDialog() {
   mainLayout->addWidget(pathLabel, 1, 0);
   mainLayout->addWidget(ColmapPathEdit, 1, 1);
   mainLayout->addWidget(colmapPathButton, 1, 2);
-  mainLayout->addWidget(cancelButton, 2, 0);
-  mainLayout->addWidget(okButton, 2, 2);
+  mainLayout->addWidget(databaseLabel, 2, 0);
+  mainLayout->addWidget(databasePathEdit, 2, 1);
+  mainLayout->addWidget(databasePathButton, 2, 2);
+  mainLayout->addWidget(cancelButton, 3, 0);
+  mainLayout->addWidget(okButton, 3, 2);
   setLayout(mainLayout);
 }
 
@@ -48,8 +57,13 @@ void LoadProjectDialog::getColmapDirectoryPath() {
   ColmapPathEdit->setText(dirPath);
 }
 
+void LoadProjectDialog::getDatabaseFilePath() {
+  auto filePath = QFileDialog::getOpenFileName(this, "open colmap database", QString(), "colmap database (*.db)");
+  databasePathEdit->setText(filePath);
+}
+
 void LoadProjectDialog::setResultOk(){
-  if(imagePathEdit->text().isEmpty() or ColmapPathEdit->text().isEmpty()){
+  if(imagePathEdit->text().isEmpty() or (ColmapPathEdit->text().isEmpty() and databasePathEdit->text().isEmpty())){
     return;
   }
   accept();
@@ -62,3 +76,7 @@ QString LoadProjectDialog::getImagePath(){
 QString LoadProjectDialog::getColmapPath(){
   return ColmapPathEdit->text();
 }
+
+QString LoadProjectDialog::getDatabasePath(){
+  return databasePathEdit->text();
+}
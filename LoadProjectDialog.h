@@ -20,10 +20,12 @@ public:
   LoadProjectDialog();
   QString getImagePath();
   QString getColmapPath();
+  QString getDatabasePath();
 
 private:
   void getImageDirectoryPath();
   void getColmapDirectoryPath();
+  void getDatabaseFilePath();
   void setResultOk();
 
   QLabel *fileNameLabel;
@@ -34,6 +36,10 @@ private:
   QLineEdit *ColmapPathEdit;
   QPushButton *colmapPathButton;
 
+  QLabel *databaseLabel;
+  QLineEdit *databasePathEdit;
+  QPushButton *databasePathButton;
+
   QPushButton *okButton;
   QPushButton *cancelButton;
 };
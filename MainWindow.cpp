@@ -8,15 +8,31 @@
 #include <QFileDialog>
 #include <QSortFilterProxyModel>
 #include <QHeaderView>
+#include <QMessageBox>
+#include <QStatusBar>
+#include <QLabel>
+#include <QMenu>
+#include <QElapsedTimer>
 #include "LoadProjectDialog.h"
 #include "graphwidget.h"
 #include "ImageGraphModel.h"
 #include "VulkanWindow.h"
+#include "VulkanRenderer.h"
 #include "colampParser.h"
+#include "ColmapDatabase.h"
+#include "ColmapWriter.h"
+#include "ColmapDatabaseWriter.h"
+#include "GeometricVerification.h"
+#include "ProjectCache.h"
+#include "ReconstructionDiff.h"
+#include "Trace.h"
+#include "TrackTriangulator.h"
 #include "MainWindow.h"
+#include "MemoryPanel.h"
 
 MainWindow::MainWindow(VulkanWindow *vulkanWindow)
-        : QMainWindow(), m_window(vulkanWindow), m_graphModel(new ImageGraphModel) {
+        : QMainWindow(), m_window(vulkanWindow), m_graphModel(new ImageGraphModel),
+          m_triangulator(new TrackTriangulator(m_graphModel, this)) {
   auto *imageTable = new QTableView;
 
   imageTable->setModel(m_graphModel);
@@ -40,12 +56,132 @@ MainWindow::MainWindow(VulkanWindow *vulkanWindow)
   auto *toolBar = addToolBar("file operation");
   auto *loadAction = toolBar->addAction("load");
   connect(loadAction, &QAction::triggered, this, &MainWindow::loadImages);
+  auto *saveProjectAction = toolBar->addAction("save project");
+  connect(saveProjectAction, &QAction::triggered, this, &MainWindow::saveProject);
+  auto *saveAction = toolBar->addAction("save colmap");
+  connect(saveAction, &QAction::triggered, this, &MainWindow::saveColmapModel);
+  auto *exportMatchesAction = toolBar->addAction("export matches");
+  connect(exportMatchesAction, &QAction::triggered, this, &MainWindow::exportMatches);
+
+  /* one entry per loaded reconstruction, unchecked hides the keypoints of its tracks */
+  m_modelsMenu = new QMenu("models", this);
+  toolBar->addAction(m_modelsMenu->menuAction());
+
+  auto *profileBar = addToolBar("profile");
+  auto *timingsAction = profileBar->addAction("timings");
+  timingsAction->setCheckable(true);
+  connect(timingsAction, &QAction::toggled, this, &MainWindow::showTimings);
+  auto *dumpTimingsAction = profileBar->addAction("dump timings");
+  connect(dumpTimingsAction, &QAction::triggered, this, &MainWindow::dumpTimings);
+  auto *traceAction = profileBar->addAction("trace");
+  traceAction->setCheckable(true);
+  traceAction->setChecked(Trace::enabled());
+  connect(traceAction, &QAction::toggled, this, &MainWindow::recordTrace);
+  auto *saveTraceAction = profileBar->addAction("save trace");
+  connect(saveTraceAction, &QAction::triggered, this, &MainWindow::saveTrace);
+
+  /* rejected red, verified but not reconstructed cyan, reconstructed green */
+  auto *matchBar = addToolBar("matches");
+  m_compareAction = matchBar->addAction("compare matches");
+  m_compareAction->setCheckable(true);
+  connect(m_compareAction, &QAction::toggled, this, &MainWindow::compareMatches);
+  m_rejectedAction = matchBar->addAction("rejected");
+  m_verifiedAction = matchBar->addAction("verified");
+  m_reconstructedAction = matchBar->addAction("reconstructed");
+  for (auto *action: {m_rejectedAction, m_verifiedAction, m_reconstructedAction}) {
+    action->setCheckable(true);
+    action->setChecked(true);
+    connect(action, &QAction::toggled, this, [this]() {
+      if (m_compareAction->isChecked()) {
+        showMatchComparison();
+      }
+    });
+  }
+
+  m_verifyAction = matchBar->addAction("verify pairs");
+  m_verifyAction->setCheckable(true);
+  connect(m_verifyAction, &QAction::toggled, this, &MainWindow::verifyPairs);
+
+  /* keypoints colored by what happened to their track in the other reconstruction, see ReconstructionDiff */
+  m_diffAction = matchBar->addAction("diff model");
+  m_diffAction->setCheckable(true);
+  connect(m_diffAction, &QAction::toggled, this, &MainWindow::diffModel);
+
+  /* green to red up to 4 px, updated while tracks are edited */
+  m_errorsAction = matchBar->addAction("reprojection errors");
+  m_errorsAction->setCheckable(true);
+  connect(m_errorsAction, &QAction::toggled, this, &MainWindow::showReprojectionErrors);
+  connect(m_graphModel, &ImageGraphModel::trackChanged, this, &MainWindow::updateTrackErrors);
+  connect(m_graphModel, &ImageGraphModel::trackPointChanged, this, &MainWindow::updateTrackErrors);
+
+  /* edited tracks are triangulated again in the background, this redoes all of them */
+  auto *triangulateAction = matchBar->addAction("triangulate");
+  connect(triangulateAction, &QAction::triggered, this, &MainWindow::triangulateTracks);
+
+  /* track mode, the hovered point of one image draws its epipolar line in every other registered image */
+  auto *epipolarAction = matchBar->addAction("epipolar lines");
+  epipolarAction->setCheckable(true);
+  epipolarAction->setChecked(true);
+  connect(epipolarAction, &QAction::toggled, this, [this](bool enable) {
+    if (m_window->renderer()) {
+      m_window->renderer()->setEpipolarLinesVisible(enable);
+    }
+  });
+
+  /* track mode, candidates near the epipolar lines of the track, the best one per image bright green */
+  auto *suggestionsAction = matchBar->addAction("suggestions");
+  suggestionsAction->setCheckable(true);
+  suggestionsAction->setChecked(true);
+  connect(suggestionsAction, &QAction::toggled, this, [this](bool enable) {
+    if (m_window->renderer()) {
+      m_window->renderer()->setSuggestionsVisible(enable);
+    }
+  });
+
+  /* track mode, same as key R */
+  auto *refineAction = matchBar->addAction("refine track");
+  connect(refineAction, &QAction::triggered, this, [this]() {
+    if (m_window->renderer()) {
+      statusBar()->showMessage(QString("refined %1 keypoints").arg(m_window->renderer()->refineCurrentTrack()));
+    }
+  });
+
+  /* suspicious track observations ranked by reprojection, epipolar and patch consistency with their track */
+  m_reviewAction = matchBar->addAction("review outliers");
+  m_reviewAction->setCheckable(true);
+  connect(m_reviewAction, &QAction::toggled, this, &MainWindow::reviewOutliers);
+
+  /* same as key N */
+  auto *nextOutlierAction = matchBar->addAction("next outlier");
+  connect(nextOutlierAction, &QAction::triggered, this, [this]() {
+    auto *renderer = m_window->renderer();
+    if (renderer && m_reviewAction->isChecked() && renderer->outlierReviewScoring()) {
+      statusBar()->showMessage("still scoring the observations");
+    } else if (renderer && m_reviewAction->isChecked()) {
+      statusBar()->showMessage(renderer->reviewNextOutlier()
+                               ? QString("%1 suspicious observations left").arg(renderer->outlierCount())
+                               : QString("no suspicious observations left"));
+    }
+  });
 
   auto *trackWidget = new GraphWidget;
   auto *trackDock = new QDockWidget;
   trackDock->setWidget(trackWidget);
   addDockWidget(Qt::BottomDockWidgetArea, trackDock);
 
+  auto *memoryPanel = new MemoryPanel;
+  auto *memoryDock = new QDockWidget("memory");
+  memoryDock->setWidget(memoryPanel);
+  addDockWidget(Qt::RightDockWidgetArea, memoryDock);
+  memoryDock->hide();
+  profileBar->addAction(memoryDock->toggleViewAction());
+  auto *memoryLabel = new QLabel;
+  statusBar()->addPermanentWidget(memoryLabel);
+  connect(memoryPanel, &MemoryPanel::summaryChanged, this, [memoryLabel](const QString &summary, bool overBudget) {
+    memoryLabel->setText(summary);
+    memoryLabel->setStyleSheet(overBudget ? "color: red" : "");
+  });
+
   m_window->setModel(m_graphModel);
   m_window->setTrackScene(trackWidget);
   auto *warp = QWidget::createWindowContainer(m_window);
@@ -56,9 +192,400 @@ void MainWindow::loadImages() {
   LoadProjectDialog lpd;
   lpd.exec();
   if(lpd.result() == QDialog::Accepted){
-    ColmapLoader loader;
-    loader.loadFromColmapSparseDir(lpd.getColmapPath().toStdString());
+    if (!lpd.getColmapPath().isEmpty()) {
+      const std::string sparseDir = lpd.getColmapPath().toStdString();
+      const std::string cachePath = ProjectCache::defaultPath(sparseDir);
+      const std::string source = ProjectCache::sourceFingerprint(sparseDir, lpd.getImagePath().toStdString());
+      /* the cache replaces the whole model, it is only used for the first project of a session */
+      if (!m_graphModel->imageInfos.empty() || !m_graphModel->loadProjectCache(cachePath, source)) {
+        const bool empty = m_graphModel->imageInfos.empty();
+        if (!m_graphModel->appendColmapSparseDir(lpd.getImagePath(), sparseDir)) {
+          QMessageBox::warning(this, "load", "can not read every colmap model in " + lpd.getColmapPath());
+        } else if (empty) {
+          m_graphModel->saveProjectCache(cachePath, source);
+        }
+      }
+      updateModelsMenu();
+      m_sparseDir = lpd.getColmapPath();
+      m_imageDir = lpd.getImagePath();
+    }
+    if (!lpd.getDatabasePath().isEmpty()) {
+      auto database = std::make_shared<ColmapDatabase>();
+      if (!database->open(lpd.getDatabasePath().toStdString())) {
+        QMessageBox::warning(this, "load", "can not read colmap database " + lpd.getDatabasePath());
+        return;
+      }
+      m_graphModel->appendColmapDatabase(lpd.getImagePath(), database);
+    }
+  }
+}
+
+void MainWindow::updateModelsMenu() {
+  m_modelsMenu->clear();
+  for (size_t i = 0; i < m_graphModel->origins.size(); i++) {
+    auto *action = m_modelsMenu->addAction(m_graphModel->origins[i]);
+    action->setCheckable(true);
+    action->setChecked(true);
+    connect(action, &QAction::toggled, this, &MainWindow::showModels);
+  }
+  showModels();
+}
+
+void MainWindow::showModels() {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  std::vector<uint16_t> hidden;
+  const auto actions = m_modelsMenu->actions();
+  for (int i = 0; i < actions.size(); i++) {
+    if (!actions[i]->isChecked()) {
+      hidden.push_back(i);
+    }
+  }
+  m_window->renderer()->setHiddenOrigins(hidden);
+}
+
+void MainWindow::saveProject() {
+  if (m_sparseDir.isEmpty()) {
+    QMessageBox::warning(this, "save project", "no colmap model loaded");
+    return;
+  }
+  const std::string sparseDir = m_sparseDir.toStdString();
+  const std::string cachePath = ProjectCache::defaultPath(sparseDir);
+  if (!m_graphModel->saveProjectCache(cachePath,
+                                      ProjectCache::sourceFingerprint(sparseDir, m_imageDir.toStdString()))) {
+    QMessageBox::warning(this, "save project", "can not write " + QString::fromStdString(cachePath));
+    return;
+  }
+  statusBar()->showMessage("saved project to " + QString::fromStdString(cachePath));
+}
+
+void MainWindow::saveColmapModel() {
+  const QString dir = QFileDialog::getExistingDirectory(this, "save colmap sparse model");
+  if (dir.isEmpty()) {
+    return;
+  }
+  ColmapWriter::Summary summary;
+  if (!ColmapWriter::writeBinary(*m_graphModel, dir.toStdString(), &summary)) {
+    QMessageBox::warning(this, "save colmap", "can not write the model to " + dir);
+    return;
+  }
+  statusBar()->showMessage(QString("wrote %1 images, %2 points, %3 observations to %4")
+                               .arg(summary.images).arg(summary.points3D).arg(summary.observations).arg(dir));
+}
+
+void MainWindow::exportMatches() {
+  const QString path = QFileDialog::getOpenFileName(this, "export matches into colmap database", QString(),
+                                                    "colmap database (*.db)");
+  if (path.isEmpty()) {
+    return;
+  }
+  ColmapDatabaseWriter::Summary summary;
+  if (!ColmapDatabaseWriter::exportTrackMatches(*m_graphModel, path.toStdString(), {}, &summary)) {
+    QMessageBox::warning(this, "export matches", "can not export matches to " + path);
+    return;
+  }
+  statusBar()->showMessage(QString("exported %1 matches of %2 pairs, %3 new, %4 keypoints appended")
+                               .arg(summary.matches).arg(summary.pairs).arg(summary.newMatches)
+                               .arg(summary.keypointsAppended));
+}
+
+void MainWindow::showTimings(bool visible) {
+  if (m_window->renderer()) {
+    m_window->renderer()->setProfilerOverlayVisible(visible);
+  }
+}
+
+void MainWindow::dumpTimings() {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  const QString path = QFileDialog::getSaveFileName(this, "dump timings", "timings.csv", "csv (*.csv)");
+  if (!path.isEmpty() && !m_window->renderer()->frameProfiler().dumpCsv(path)) {
+    QMessageBox::warning(this, "dump timings", "can not write " + path);
+  }
+}
+
+void MainWindow::recordTrace(bool record) {
+  if (record) {
+    Trace::clear();
+  }
+  Trace::setEnabled(record);
+}
+
+void MainWindow::saveTrace() {
+  const QString path = QFileDialog::getSaveFileName(this, "save trace", "trace.json", "chrome trace (*.json)");
+  if (!path.isEmpty() && !Trace::writeChromeJson(path.toStdString())) {
+    QMessageBox::warning(this, "save trace", "can not write " + path);
+  }
+}
 
-    m_graphModel->appendColmapData(lpd.getImagePath(), loader);
+void MainWindow::compareMatches(bool enable) {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  if (!enable) {
+    m_comparison = MatchComparison();
+    m_window->renderer()->setLines({});
+    m_window->renderer()->clearKeypointColors();
+    statusBar()->clearMessage();
+    return;
+  }
+  std::vector<Image_ID_T> shown;
+  for (const auto &it: m_graphModel->imageInfos) {
+    if (it.second.checkState == Qt::Checked) {
+      shown.push_back(it.first);
+    }
+  }
+  if (shown.size() != 2) {
+    QMessageBox::information(this, "compare matches", "show exactly two images to compare their matches");
+    m_compareAction->setChecked(false);
+    return;
+  }
+  if (!m_graphModel->hasMatchDatabase()) {
+    statusBar()->showMessage("no colmap database loaded, only reconstructed matches are shown");
+  }
+  m_comparison = MatchComparison::compute(*m_graphModel, shown[0], shown[1]);
+  showMatchComparison();
+}
+
+void MainWindow::showMatchComparison() {
+  TRACE_SCOPE("MainWindow::showMatchComparison");
+  const auto &c = m_comparison;
+  const auto &kps1 = m_graphModel->imageInfos.at(c.image_id1).keyPoints;
+  const auto &kps2 = m_graphModel->imageInfos.at(c.image_id2).keyPoints;
+  /* keypoints without any match are dimmed so the classes stand out */
+  std::vector<uint32_t> colors1(kps1.size(), 0x80808080u);
+  std::vector<uint32_t> colors2(kps2.size(), 0x80808080u);
+  std::vector<VulkanRenderer::LineSegment> segments;
+  segments.reserve((m_rejectedAction->isChecked() ? c.rejected.size() : 0) +
+                   (m_verifiedAction->isChecked() ? c.verifiedOnly.size() : 0) +
+                   (m_reconstructedAction->isChecked() ? c.reconstructed.size() : 0));
+  auto addClass = [&](const std::vector<MatchComparison::Match> &matches, QAction *action, uint32_t rgba,
+                      const Eigen::Vector3f &color) {
+    if (!action->isChecked()) {
+      return;
+    }
+    for (const auto &m: matches) {
+      colors1[m.first] = rgba;
+      colors2[m.second] = rgba;
+      segments.push_back({{c.image_id1, c.image_id2}, {kps1[m.first].pos, kps2[m.second].pos}, color});
+    }
+  };
+  addClass(c.rejected, m_rejectedAction, 0xFF0000FFu, Eigen::Vector3f(1.f, 0.f, 0.f));
+  addClass(c.verifiedOnly, m_verifiedAction, 0xFFFFFF00u, Eigen::Vector3f(0.f, 1.f, 1.f));
+  addClass(c.reconstructed, m_reconstructedAction, 0xFF00FF00u, Eigen::Vector3f(0.f, 1.f, 0.f));
+
+  auto *renderer = m_window->renderer();
+  renderer->setKeypointColors(c.image_id1, std::move(colors1));
+  renderer->setKeypointColors(c.image_id2, std::move(colors2));
+  renderer->setLines(std::move(segments));
+  statusBar()->showMessage(QString("raw %1, verified %2, reconstructed %3 | rejected %4, verified only %5, "
+                                   "reconstructed only %6")
+                               .arg(c.rawCount).arg(c.verifiedCount).arg(c.reconstructedCount)
+                               .arg(c.rejected.size()).arg(c.verifiedOnly.size()).arg(c.reconstructedOnly.size()));
+}
+
+void MainWindow::verifyPairs(bool enable) {
+  auto *renderer = m_window->renderer();
+  if (renderer == nullptr) {
+    return;
+  }
+  if (!enable) {
+    renderer->setLines({});
+    renderer->clearKeypointColors();
+    statusBar()->clearMessage();
+    return;
+  }
+  std::vector<Image_ID_T> shown;
+  for (const auto &it: m_graphModel->imageInfos) {
+    if (it.second.checkState == Qt::Checked) {
+      shown.push_back(it.first);
+    }
+  }
+  if (shown.size() < 2) {
+    QMessageBox::information(this, "verify pairs", "show at least two images to verify their matches");
+    m_verifyAction->setChecked(false);
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  const auto pairs = m_graphModel->hasMatchDatabase() ?
+                     GeometricVerification::databasePairs(*m_graphModel, shown, ColmapDatabase::RAW_MATCHES) :
+                     GeometricVerification::trackPairs(*m_graphModel, shown);
+  const auto readMs = timer.restart();
+  const auto results = GeometricVerification().verifyPairs(*m_graphModel, pairs);
+  const auto ms = timer.elapsed();
+
+  /* a keypoint stays green when any pair keeps it, matches of unverified pairs are all outliers */
+  std::map<Image_ID_T, std::vector<uint32_t>> colors;
+  for (const auto image_id: shown) {
+    colors[image_id].assign(m_graphModel->imageInfos.at(image_id).keyPoints.size(), 0x80808080u);
+  }
+  std::vector<VulkanRenderer::LineSegment> segments;
+  size_t verified = 0, essential = 0, matches = 0, inliers = 0;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    const auto &pair = pairs[i];
+    const auto &r = results[i];
+    verified += r.verified;
+    essential += r.verified && (r.geometry == GeometricVerification::ESSENTIAL);
+    matches += pair.matches.size();
+    auto &colors1 = colors[pair.image_id1];
+    auto &colors2 = colors[pair.image_id2];
+    const auto &kps1 = m_graphModel->imageInfos.at(pair.image_id1).keyPoints;
+    const auto &kps2 = m_graphModel->imageInfos.at(pair.image_id2).keyPoints;
+    for (size_t k = 0; k < pair.matches.size(); k++) {
+      const auto &m = pair.matches[k];
+      const bool inlier = r.verified && r.inliers[k];
+      inliers += inlier;
+      for (auto *c: {&colors1[m.first], &colors2[m.second]}) {
+        if (inlier || (*c != 0xFF00FF00u)) {
+          *c = inlier ? 0xFF00FF00u : 0xFF0000FFu;
+        }
+      }
+      /* lines only make sense side by side */
+      if (shown.size() == 2) {
+        segments.push_back({{pair.image_id1, pair.image_id2}, {kps1[m.first].pos, kps2[m.second].pos},
+                            inlier ? Eigen::Vector3f(0.f, 1.f, 0.f) : Eigen::Vector3f(1.f, 0.f, 0.f)});
+      }
+    }
+  }
+  for (auto &it: colors) {
+    renderer->setKeypointColors(it.first, std::move(it.second));
+  }
+  renderer->setLines(std::move(segments));
+  statusBar()->showMessage(QString("%1 pairs read in %2 ms, verified in %3 ms: %4 verified (%5 essential), "
+                                   "%6 of %7 matches inliers")
+                               .arg(pairs.size()).arg(readMs).arg(ms).arg(verified).arg(essential).arg(inliers)
+                               .arg(matches));
+}
+
+void MainWindow::diffModel(bool enable) {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  if (!enable) {
+    m_window->renderer()->clearKeypointColors();
+    statusBar()->clearMessage();
+    return;
+  }
+  if (m_sparseDir.isEmpty() || (m_graphModel->origins.size() > 1)) {
+    QMessageBox::information(this, "diff model", "load a single colmap model first");
+    m_diffAction->setChecked(false);
+    return;
+  }
+  const QString other = QFileDialog::getExistingDirectory(this, "colmap sparse model to compare with");
+  if (other.isEmpty()) {
+    m_diffAction->setChecked(false);
+    return;
+  }
+  const auto loaders = ColmapLoader::loadParallel({m_sparseDir.toStdString(), other.toStdString()});
+  if ((loaders[0] == nullptr) || (loaders[1] == nullptr)) {
+    QMessageBox::warning(this, "diff model", "can not read " + (loaders[0] == nullptr ? m_sparseDir : other));
+    m_diffAction->setChecked(false);
+    return;
+  }
+  const auto diff = ReconstructionDiff::compute(*loaders[0], *loaders[1]);
+
+  /* keypoint ids of colmap images are their point2D indices, hand added keypoints keep the default colors */
+  std::map<std::string, Image_ID_T> imageIds;
+  for (const auto &it: m_graphModel->imageInfos) {
+    if (!it.second.colmap.name.empty()) {
+      imageIds.emplace(it.second.colmap.name, it.first);
+    }
+  }
+  auto *renderer = m_window->renderer();
+  renderer->clearKeypointColors();
+  for (const auto &img: diff.images) {
+    auto it = imageIds.find(img.name);
+    if ((img.image_idA == ReconstructionDiff::kInvalidImageId) || (it == imageIds.end())) {
+      continue;
+    }
+    std::vector<uint32_t> colors(img.changes.size());
+    for (size_t i = 0; i < colors.size(); i++) {
+      colors[i] = ReconstructionDiff::changeColor(static_cast<ReconstructionDiff::Change>(img.changes[i]));
+    }
+    renderer->setKeypointColors(it->second, std::move(colors));
+  }
+  const auto &s = diff.summary;
+  statusBar()->showMessage(QString("unchanged %1, modified %2, split %3, merged %4, appeared %5, vanished %6 tracks")
+                               .arg(s.unchanged).arg(s.modified).arg(s.split).arg(s.merged).arg(s.appeared)
+                               .arg(s.vanished));
+}
+
+void MainWindow::showReprojectionErrors(bool enable) {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  m_window->renderer()->clearKeypointColors();
+  if (!enable) {
+    m_errors.clear();
+    statusBar()->clearMessage();
+    return;
+  }
+  m_errors.compute(*m_graphModel);
+  for (const auto &it: m_graphModel->imageInfos) {
+    setErrorColors(it.first);
+  }
+  const auto s = m_errors.summary();
+  statusBar()->showMessage(QString("reprojection error of %1 observations: mean %2, median %3, max %4 px, "
+                                   "%5 above %6 px")
+                               .arg(s.observations).arg(s.mean, 0, 'f', 2).arg(s.median, 0, 'f', 2)
+                               .arg(s.max, 0, 'f', 2).arg(s.above[2]).arg(kMaxShownError));
+}
+
+void MainWindow::updateTrackErrors(Track_ID_T track_id) {
+  if (m_errors.empty() || (m_window->renderer() == nullptr)) {
+    return;
+  }
+  m_errors.updateTrack(*m_graphModel, track_id);
+  for (const auto image_id: m_graphModel->tracks.at(track_id).images) {
+    setErrorColors(image_id);
+  }
+}
+
+void MainWindow::triangulateTracks() {
+  QElapsedTimer timer;
+  timer.start();
+  const size_t triangulated = m_triangulator->triangulateAll();
+  const auto ms = timer.elapsed();
+  if (m_errorsAction->isChecked()) {
+    showReprojectionErrors(true);
+  }
+  /* the full pass changes the points without signals */
+  if (m_reviewAction->isChecked() && m_window->renderer()) {
+    m_window->renderer()->setOutlierReviewEnabled(true);
+  }
+  statusBar()->showMessage(QString("triangulated %1 of %2 tracks in %3 ms")
+                               .arg(triangulated).arg(m_graphModel->tracks.size()).arg(ms));
+}
+
+void MainWindow::reviewOutliers(bool enable) {
+  if (m_window->renderer() == nullptr) {
+    return;
+  }
+  if (!enable) {
+    m_window->renderer()->setOutlierReviewEnabled(false);
+    statusBar()->clearMessage();
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  m_window->renderer()->setOutlierReviewEnabled(true, [this, timer](size_t suspicious) {
+    statusBar()->showMessage(QString("%1 suspicious observations in %2 ms, key N shows the next one")
+                                 .arg(suspicious).arg(timer.elapsed()));
+  });
+  statusBar()->showMessage("scoring the observations");
+}
+
+void MainWindow::setErrorColors(Image_ID_T image_id) {
+  const auto *errors = m_errors.imageErrors(image_id);
+  if (errors == nullptr) {
+    return;
+  }
+  std::vector<uint32_t> colors(errors->size());
+  for (size_t i = 0; i < colors.size(); i++) {
+    colors[i] = ReprojectionErrors::errorColor((*errors)[i], kMaxShownError);
   }
+  m_window->renderer()->setKeypointColors(image_id, std::move(colors));
 }
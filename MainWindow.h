@@ -6,11 +6,19 @@
 #define MATCH_MANUALLY_MAINWINDOW_H
 
 #include <QMainWindow>
+#include "MatchComparison.h"
+#include "ReprojectionErrors.h"
 
 class VulkanWindow;
 
 class ImageGraphModel;
 
+class QAction;
+
+class QMenu;
+
+class TrackTriangulator;
+
 class MainWindow : public QMainWindow {
 Q_OBJECT
 public:
@@ -20,9 +28,72 @@ public slots:
 
   void loadImages();
 
+  void saveColmapModel();
+
+  /* snapshot of the model with all edits next to the sparse model, reopened instead of parsing colmap */
+  void saveProject();
+
+  void exportMatches();
+
+  void showTimings(bool visible);
+
+  void dumpTimings();
+
+  void recordTrace(bool record);
+
+  void saveTrace();
+
+  /* pair mode, colors the raw, verified and reconstructed matches of the two shown images */
+  void compareMatches(bool enable);
+
+  /*
+   * ransac on the matches of every pair of the shown images, database matches when a database is attached,
+   * track correspondences otherwise. inliers green, outliers red
+   */
+  void verifyPairs(bool enable);
+
+  /* colors the keypoints by the changes of their tracks against another reconstruction of the same images */
+  void diffModel(bool enable);
+
+  /* colors every tracked keypoint by its reprojection error, kept up to date while tracks are edited */
+  void showReprojectionErrors(bool enable);
+
+  void updateTrackErrors(Track_ID_T track_id);
+
+  /* replaces the 3d point of every track by its triangulation from the current keypoints */
+  void triangulateTracks();
+
+  /* queue of suspicious track observations, stepped through with key N in the renderer */
+  void reviewOutliers(bool enable);
+
+  /* hides the tracks of the reconstructions unchecked in the models menu */
+  void showModels();
+
 private:
+  void showMatchComparison();
+
+  void updateModelsMenu();
+
+  void setErrorColors(Image_ID_T image_id);
+
+  static constexpr float kMaxShownError = 4.f;
+
   VulkanWindow *m_window;
   ImageGraphModel *m_graphModel;
+  QMenu *m_modelsMenu = nullptr;
+  QAction *m_compareAction = nullptr;
+  QAction *m_rejectedAction = nullptr;
+  QAction *m_verifiedAction = nullptr;
+  QAction *m_reconstructedAction = nullptr;
+  QAction *m_verifyAction = nullptr;
+  QAction *m_diffAction = nullptr;
+  QAction *m_errorsAction = nullptr;
+  QAction *m_reviewAction = nullptr;
+  ReprojectionErrors m_errors;
+  TrackTriangulator *m_triangulator;
+  MatchComparison m_comparison;
+  QString m_sparseDir;
+  QString m_imageDir;
 };
 
 
@@ -0,0 +1,139 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "MatchComparison.h"
+#include "Trace.h"
+
+namespace {
+uint64_t pack(KeyPoint_ID_T kp1, KeyPoint_ID_T kp2) {
+  return (static_cast<uint64_t>(kp1) << 32) | kp2;
+}
+
+MatchComparison::Match unpack(uint64_t m) {
+  return {static_cast<KeyPoint_ID_T>(m >> 32), static_cast<KeyPoint_ID_T>(m & 0xFFFFFFFFu)};
+}
+
+/* sorted and unique, the matcher may report a keypoint pair twice in mutual mode */
+template<typename It>
+std::vector<uint64_t> packSorted(It begin, It end) {
+  std::vector<uint64_t> packed;
+  packed.reserve(std::distance(begin, end));
+  for (auto it = begin; it != end; ++it) {
+    packed.push_back(pack(it->first, it->second));
+  }
+  std::sort(packed.begin(), packed.end());
+  packed.erase(std::unique(packed.begin(), packed.end()), packed.end());
+  return packed;
+}
+
+/* a \ b of two sorted lists */
+std::vector<MatchComparison::Match> difference(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b) {
+  std::vector<MatchComparison::Match> result;
+  size_t j = 0;
+  for (const auto m: a) {
+    while ((j < b.size()) && (b[j] < m)) {
+      j++;
+    }
+    if ((j == b.size()) || (b[j] != m)) {
+      result.push_back(unpack(m));
+    }
+  }
+  return result;
+}
+}
+
+std::vector<MatchComparison::Match>
+MatchComparison::trackMatches(const ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2) {
+  std::vector<Match> result;
+  const auto &kps = model.imageInfos.at(image_id1).keyPoints;
+  for (const auto &kp: kps) {
+    if (kp.track_id == std::numeric_limits<Track_ID_T>::max()) {
+      continue;
+    }
+    auto it = model.tracks.find(kp.track_id);
+    if (it == model.tracks.end()) {
+      continue;
+    }
+    const auto &tr = it->second;
+    for (size_t i = 0; i < tr.images.size(); i++) {
+      if (tr.images[i] == image_id2) {
+        result.emplace_back(kp.kp_id, tr.kps[i]);
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+MatchComparison MatchComparison::compute(ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2) {
+  TRACE_SCOPE("MatchComparison::compute");
+  MatchComparison result;
+  result.image_id1 = image_id1;
+  result.image_id2 = image_id2;
+
+  std::vector<uint64_t> raw, verified;
+  Eigen::Matrix3d F = Eigen::Matrix3d::Zero();
+  if (const auto *m = model.pairMatches(image_id1, image_id2, ColmapDatabase::RAW_MATCHES)) {
+    raw = packSorted(m->matches.begin(), m->matches.end());
+  }
+  if (const auto *m = model.pairMatches(image_id1, image_id2, ColmapDatabase::VERIFIED_MATCHES)) {
+    verified = packSorted(m->matches.begin(), m->matches.end());
+    F = m->F;
+  }
+  const auto tracked = trackMatches(model, image_id1, image_id2);
+  const auto reconstructed = packSorted(tracked.begin(), tracked.end());
+  result.rawCount = raw.size();
+  result.verifiedCount = verified.size();
+  result.reconstructedCount = reconstructed.size();
+
+  result.rejected = difference(raw, verified);
+  result.verifiedOnly = difference(verified, reconstructed);
+  result.reconstructedOnly = difference(reconstructed, verified);
+  result.reconstructed.reserve(reconstructed.size());
+  for (const auto m: reconstructed) {
+    result.reconstructed.push_back(unpack(m));
+  }
+
+  /* F works on colmap pixel coordinates, keypoints are stored normalized by the image size */
+  if (!F.isZero()) {
+    const auto &img1 = model.imageInfos.at(image_id1);
+    const auto &img2 = model.imageInfos.at(image_id2);
+    result.rejectedError.reserve(result.rejected.size());
+    for (const auto &m: result.rejected) {
+      const Eigen::Vector2f &p1 = img1.keyPoints[m.first].pos;
+      const Eigen::Vector2f &p2 = img2.keyPoints[m.second].pos;
+      const Eigen::Vector3d x1(p1.x() * img1.size.width(), p1.y() * img1.size.height(), 1.);
+      const Eigen::Vector3d x2(p2.x() * img2.size.width(), p2.y() * img2.size.height(), 1.);
+      const Eigen::Vector3d Fx1 = F * x1;
+      const Eigen::Vector3d Ftx2 = F.transpose() * x2;
+      const double d = x2.dot(Fx1);
+      const double norm = Fx1.head<2>().squaredNorm() + Ftx2.head<2>().squaredNorm();
+      result.rejectedError.push_back(norm > 0 ? static_cast<float>(std::abs(d) / std::sqrt(norm)) : INFINITY);
+    }
+  }
+  return result;
+}
+
+void MatchComparison::print(std::ostream &out) const {
+  out << "raw " << rawCount << ", verified " << verifiedCount << ", reconstructed " << reconstructedCount << std::endl;
+  out << "rejected by verification " << rejected.size() << ", verified but not reconstructed " << verifiedOnly.size()
+      << ", reconstructed without verified match " << reconstructedOnly.size() << std::endl;
+  if (rejectedError.empty()) {
+    return;
+  }
+  /* how far off the epipolar geometry the rejected matches are */
+  std::vector<float> errors = rejectedError;
+  std::sort(errors.begin(), errors.end());
+  const int bounds[] = {1, 2, 4, 8, 16};
+  out << "sampson error of rejected matches:";
+  size_t begin = 0;
+  for (const int bound: bounds) {
+    const size_t end = std::lower_bound(errors.begin(), errors.end(), static_cast<float>(bound)) - errors.begin();
+    out << " <" << bound << "px " << end - begin << ",";
+    begin = end;
+  }
+  out << " more " << errors.size() - begin << std::endl;
+}
@@ -0,0 +1,47 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_MATCHCOMPARISON_H
+#define MATCH_MANUALLY_MATCHCOMPARISON_H
+
+#include <ostream>
+#include <vector>
+#include "ImageGraphModel.h"
+
+/*
+ * raw, verified and reconstructed correspondences of one image pair and their set differences. every list is
+ * packed to (kp1 << 32 | kp2), sorted once and compared by linear merges, a 50k match pair takes a few ms
+ */
+class MatchComparison {
+public:
+  typedef std::pair<KeyPoint_ID_T, KeyPoint_ID_T> Match;
+
+  Image_ID_T image_id1 = 0;
+  Image_ID_T image_id2 = 0;
+  size_t rawCount = 0;
+  size_t verifiedCount = 0;
+  size_t reconstructedCount = 0;
+
+  /* raw matches the geometric verification threw away */
+  std::vector<Match> rejected;
+  /* sampson error of every rejected match under the verified F in pixels, empty when there is no F */
+  std::vector<float> rejectedError;
+  /* inliers of the verification that did not end up in a common track */
+  std::vector<Match> verifiedOnly;
+  /* keypoints of the two images sharing a track */
+  std::vector<Match> reconstructed;
+  /* tracks connecting keypoints the verification never saw together, usually merged through other images */
+  std::vector<Match> reconstructedOnly;
+
+  /* model matches come from the attached database, tracks from the model */
+  static MatchComparison compute(ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2);
+
+  /* correspondences through common tracks, sorted by the first keypoint */
+  static std::vector<Match> trackMatches(const ImageGraphModel &model, Image_ID_T image_id1, Image_ID_T image_id2);
+
+  void print(std::ostream &out) const;
+};
+
+
+#endif //MATCH_MANUALLY_MATCHCOMPARISON_H
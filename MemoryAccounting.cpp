@@ -0,0 +1,133 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <boost/log/trivial.hpp>
+#include "MemoryAccounting.h"
+
+MemoryAccounting &MemoryAccounting::instance() {
+  static MemoryAccounting accounting;
+  return accounting;
+}
+
+const char *MemoryAccounting::name(MemoryAccounting::Subsystem subsystem) {
+  static const char *names[SUBSYSTEM_COUNT] = {
+          "image_cache",
+          "track_patches",
+          "colmap_loader",
+          "model",
+          "renderer_buffers",
+          "renderer_textures",
+          "renderer_attachments"
+  };
+  return names[subsystem];
+}
+
+MemoryAccounting::MemoryAccounting() {
+  const char *env = std::getenv("MATCH_MEMORY_BUDGETS");
+  if (env == nullptr) {
+    return;
+  }
+  std::istringstream in(env);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    const auto dot = item.find('.');
+    const auto eq = item.find('=');
+    if ((dot == std::string::npos) || (eq == std::string::npos) || (eq < dot)) {
+      BOOST_LOG_TRIVIAL(warning) << "ignore memory budget " << item << ", expected <subsystem>.<host|device>=<MB>";
+      continue;
+    }
+    const std::string subsystemName = item.substr(0, dot);
+    const std::string domainName = item.substr(dot + 1, eq - dot - 1);
+    int subsystem = 0;
+    while ((subsystem < SUBSYSTEM_COUNT) && (subsystemName != name(static_cast<Subsystem>(subsystem)))) {
+      subsystem++;
+    }
+    if ((subsystem == SUBSYSTEM_COUNT) || ((domainName != "host") && (domainName != "device"))) {
+      BOOST_LOG_TRIVIAL(warning) << "ignore memory budget " << item << ", unknown subsystem or domain";
+      continue;
+    }
+    const uint64_t mb = std::strtoull(item.c_str() + eq + 1, nullptr, 10);
+    m_budgets[subsystem][domainName == "host" ? HOST : DEVICE] = mb << 20;
+  }
+}
+
+void MemoryAccounting::Gauge::set(uint64_t bytes) {
+  /* stored before add(), an eviction it starts may set the gauge again */
+  if (bytes != m_bytes) {
+    const uint64_t previous = m_bytes;
+    m_bytes = bytes;
+    MemoryAccounting::instance().add(m_subsystem, m_domain, static_cast<int64_t>(bytes - previous));
+  }
+}
+
+void MemoryAccounting::add(MemoryAccounting::Subsystem subsystem, MemoryAccounting::Domain domain, int64_t delta) {
+  const uint64_t now = m_counters[subsystem][domain].fetch_add(static_cast<uint64_t>(delta),
+                                                                std::memory_order_relaxed) + delta;
+  const uint64_t limit = budget(subsystem, domain);
+  if ((delta > 0) && (limit > 0) && (now > limit)) {
+    evict(subsystem, domain);
+  }
+}
+
+uint64_t MemoryAccounting::total(MemoryAccounting::Domain domain) const {
+  uint64_t sum = 0;
+  for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+    sum += bytes(static_cast<Subsystem>(i), domain);
+  }
+  return sum;
+}
+
+void MemoryAccounting::setBudget(MemoryAccounting::Subsystem subsystem, MemoryAccounting::Domain domain,
+                                 uint64_t bytes) {
+  m_budgets[subsystem][domain] = bytes;
+  if (overBudget(subsystem, domain)) {
+    evict(subsystem, domain);
+  }
+}
+
+bool MemoryAccounting::overBudget(MemoryAccounting::Subsystem subsystem, MemoryAccounting::Domain domain) const {
+  const uint64_t limit = budget(subsystem, domain);
+  return (limit > 0) && (bytes(subsystem, domain) > limit);
+}
+
+int MemoryAccounting::addEvictionCallback(MemoryAccounting::Subsystem subsystem,
+                                          const MemoryAccounting::EvictionCallback &callback) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_callbacks.push_back({m_nextCallbackId, subsystem, callback});
+  return m_nextCallbackId++;
+}
+
+void MemoryAccounting::removeEvictionCallback(int id) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(), [id](const CallbackEntry &entry) {
+    return entry.id == id;
+  }), m_callbacks.end());
+}
+
+void MemoryAccounting::evict(MemoryAccounting::Subsystem subsystem, MemoryAccounting::Domain domain) {
+  if (m_evicting[subsystem].exchange(true)) {
+    return;
+  }
+  std::vector<EvictionCallback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &entry: m_callbacks) {
+      if (entry.subsystem == subsystem) {
+        callbacks.push_back(entry.callback);
+      }
+    }
+  }
+  for (const auto &callback: callbacks) {
+    if (!overBudget(subsystem, domain)) {
+      break;
+    }
+    callback(bytes(subsystem, domain), budget(subsystem, domain));
+  }
+  m_evicting[subsystem] = false;
+}
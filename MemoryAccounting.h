@@ -0,0 +1,108 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_MEMORYACCOUNTING_H
+#define MATCH_MANUALLY_MEMORYACCOUNTING_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+ * process wide host and device byte counters per subsystem. every subsystem may get a soft budget per domain,
+ * crossing it calls the eviction callbacks registered for that subsystem, which are expected to give memory
+ * back through add() with a negative delta. only the image cache and the gray images of the track tools register
+ * callbacks, the budgets of the other subsystems are advisory and only shown as exceeded. budgets can be preset with
+ *   MATCH_MEMORY_BUDGETS=image_cache.host=2048,renderer_textures.device=1024   (MB)
+ */
+class MemoryAccounting {
+public:
+  enum Subsystem {
+    IMAGE_CACHE,
+    TRACK_PATCHES,
+    COLMAP_LOADER,
+    MODEL,
+    RENDERER_BUFFERS,
+    RENDERER_TEXTURES,
+    RENDERER_ATTACHMENTS,
+    SUBSYSTEM_COUNT
+  };
+
+  enum Domain {
+    HOST,
+    DEVICE,
+    DOMAIN_COUNT
+  };
+
+  /* bytes is the current usage, the callback runs in the thread that crossed the budget */
+  typedef std::function<void(uint64_t bytes, uint64_t budget)> EvictionCallback;
+
+  /* follows a value that is measured as a whole, like the capacity of a vector, copies start at zero */
+  class Gauge {
+  public:
+    Gauge(Subsystem subsystem, Domain domain) : m_subsystem(subsystem), m_domain(domain) {}
+
+    Gauge(const Gauge &other) : m_subsystem(other.m_subsystem), m_domain(other.m_domain) {}
+
+    Gauge &operator=(const Gauge &) { return *this; }
+
+    ~Gauge() { set(0); }
+
+    void set(uint64_t bytes);
+
+  private:
+    Subsystem m_subsystem;
+    Domain m_domain;
+    uint64_t m_bytes = 0;
+  };
+
+  static MemoryAccounting &instance();
+
+  static const char *name(Subsystem subsystem);
+
+  void add(Subsystem subsystem, Domain domain, int64_t delta);
+
+  uint64_t bytes(Subsystem subsystem, Domain domain) const {
+    return m_counters[subsystem][domain].load(std::memory_order_relaxed);
+  }
+
+  uint64_t total(Domain domain) const;
+
+  /* 0 disables the budget */
+  void setBudget(Subsystem subsystem, Domain domain, uint64_t bytes);
+
+  uint64_t budget(Subsystem subsystem, Domain domain) const {
+    return m_budgets[subsystem][domain].load(std::memory_order_relaxed);
+  }
+
+  bool overBudget(Subsystem subsystem, Domain domain) const;
+
+  int addEvictionCallback(Subsystem subsystem, const EvictionCallback &callback);
+
+  void removeEvictionCallback(int id);
+
+private:
+  struct CallbackEntry {
+    int id;
+    Subsystem subsystem;
+    EvictionCallback callback;
+  };
+
+  MemoryAccounting();
+
+  void evict(Subsystem subsystem, Domain domain);
+
+  std::atomic<uint64_t> m_counters[SUBSYSTEM_COUNT][DOMAIN_COUNT] = {};
+  std::atomic<uint64_t> m_budgets[SUBSYSTEM_COUNT][DOMAIN_COUNT] = {};
+  /* an eviction frees memory through add(), do not start another one from there */
+  std::atomic<bool> m_evicting[SUBSYSTEM_COUNT] = {};
+  mutable std::mutex m_mutex;
+  std::vector<CallbackEntry> m_callbacks;
+  int m_nextCallbackId = 1;
+};
+
+
+#endif //MATCH_MANUALLY_MEMORYACCOUNTING_H
@@ -0,0 +1,87 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <QHeaderView>
+#include <QTimer>
+#include "MemoryAccounting.h"
+#include "MemoryPanel.h"
+
+static QString formatMb(uint64_t bytes) {
+  return QString::number(bytes / double(1 << 20), 'f', 1);
+}
+
+MemoryPanel::MemoryPanel(QWidget *parent) : QTableWidget(MemoryAccounting::SUBSYSTEM_COUNT, COLUMN_COUNT, parent),
+                                            m_timer(new QTimer(this)) {
+  setHorizontalHeaderLabels({"host MB", "host budget", "device MB", "device budget"});
+  QStringList rows;
+  for (int i = 0; i < MemoryAccounting::SUBSYSTEM_COUNT; i++) {
+    rows << MemoryAccounting::name(static_cast<MemoryAccounting::Subsystem>(i));
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+      auto *item = new QTableWidgetItem;
+      item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+      if ((c == HOST_BYTES) || (c == DEVICE_BYTES)) {
+        item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+      }
+      setItem(i, c, item);
+    }
+  }
+  setVerticalHeaderLabels(rows);
+  horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+  connect(this, &QTableWidget::itemChanged, this, &MemoryPanel::budgetEdited);
+  connect(m_timer, &QTimer::timeout, this, &MemoryPanel::refresh);
+  m_timer->start(1000);
+  refresh();
+}
+
+void MemoryPanel::refresh() {
+  auto &accounting = MemoryAccounting::instance();
+  QStringList over;
+  m_refreshing = true;
+  for (int i = 0; i < MemoryAccounting::SUBSYSTEM_COUNT; i++) {
+    const auto subsystem = static_cast<MemoryAccounting::Subsystem>(i);
+    const std::pair<Column, MemoryAccounting::Domain> counters[] = {{HOST_BYTES,   MemoryAccounting::HOST},
+                                                                    {DEVICE_BYTES, MemoryAccounting::DEVICE}};
+    for (const auto &it: counters) {
+      auto *bytesItem = item(i, it.first);
+      bytesItem->setText(formatMb(accounting.bytes(subsystem, it.second)));
+      const bool isOver = accounting.overBudget(subsystem, it.second);
+      bytesItem->setForeground(isOver ? QColor(Qt::red) : palette().text().color());
+      if (isOver) {
+        over << MemoryAccounting::name(subsystem);
+      }
+      /* do not overwrite a budget while it is being typed */
+      auto *budgetItem = item(i, it.first + 1);
+      if (!(state() == QAbstractItemView::EditingState && currentItem() == budgetItem)) {
+        const uint64_t budget = accounting.budget(subsystem, it.second);
+        budgetItem->setText(budget ? formatMb(budget) : QString());
+      }
+    }
+  }
+  m_refreshing = false;
+
+  QString summary = QString("host %1 MB, device %2 MB").arg(formatMb(accounting.total(MemoryAccounting::HOST)),
+                                                            formatMb(accounting.total(MemoryAccounting::DEVICE)));
+  if (!over.isEmpty()) {
+    summary += ", over budget: " + over.join(", ");
+  }
+  emit summaryChanged(summary, !over.isEmpty());
+}
+
+void MemoryPanel::budgetEdited(QTableWidgetItem *item) {
+  if (m_refreshing || ((item->column() != HOST_BUDGET) && (item->column() != DEVICE_BUDGET))) {
+    return;
+  }
+  bool ok = true;
+  const double mb = item->text().trimmed().isEmpty() ? 0. : item->text().toDouble(&ok);
+  if (!ok || mb < 0) {
+    refresh();
+    return;
+  }
+  MemoryAccounting::instance().setBudget(static_cast<MemoryAccounting::Subsystem>(item->row()),
+                                         item->column() == HOST_BUDGET ? MemoryAccounting::HOST
+                                                                       : MemoryAccounting::DEVICE,
+                                         static_cast<uint64_t>(mb * (1 << 20)));
+  refresh();
+}
@@ -0,0 +1,43 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_MEMORYPANEL_H
+#define MATCH_MANUALLY_MEMORYPANEL_H
+
+#include <QTableWidget>
+
+class QTimer;
+
+/* MemoryAccounting counters per subsystem, the budget columns are editable in MB, empty or 0 means none */
+class MemoryPanel : public QTableWidget {
+Q_OBJECT
+public:
+  explicit MemoryPanel(QWidget *parent = nullptr);
+
+signals:
+
+  /* one line for the status bar, emitted on every refresh */
+  void summaryChanged(const QString &summary, bool overBudget);
+
+private slots:
+
+  void refresh();
+
+  void budgetEdited(QTableWidgetItem *item);
+
+private:
+  enum Column {
+    HOST_BYTES,
+    HOST_BUDGET,
+    DEVICE_BYTES,
+    DEVICE_BUDGET,
+    COLUMN_COUNT
+  };
+
+  QTimer *m_timer;
+  bool m_refreshing = false;
+};
+
+
+#endif //MATCH_MANUALLY_MEMORYPANEL_H
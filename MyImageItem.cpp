@@ -6,16 +6,25 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QtCore>
 #include "MyImageItem.h"
+#include "MemoryAccounting.h"
 
-MyImageItem::MyImageItem(const QImage &image, const QRectF &area) : QGraphicsItem(), m_image(image), m_area(area) {
+MyImageItem::MyImageItem(const QImage &image, const QRectF &area) : QGraphicsItem(), m_area(area) {
   setFlag(QGraphicsItem::ItemIsMovable, false);
   setFlag(QGraphicsItem::ItemIsSelectable, true);
-  m_visibleImage = QPixmap::fromImage(m_image.copy(m_area.toRect()));
+  const QRect pixels = m_area.toAlignedRect();
+  m_patch = image.copy(pixels);
+  m_patchOffset = m_area.topLeft() - pixels.topLeft();
+  MemoryAccounting::instance().add(MemoryAccounting::TRACK_PATCHES, MemoryAccounting::HOST, m_patch.sizeInBytes());
+}
+
+MyImageItem::~MyImageItem() {
+  MemoryAccounting::instance().add(MemoryAccounting::TRACK_PATCHES, MemoryAccounting::HOST,
+                                   -static_cast<int64_t>(m_patch.sizeInBytes()));
 }
 
 QRectF MyImageItem::boundingRect() const {
   auto size = (m_area.bottomRight() - m_area.topLeft());
-  if (m_image.isNull()) {
+  if (m_patch.isNull()) {
     return QRectF(0, 0, 0, 0);
   } else {
     return QRectF(0, 0, size.x(), size.y());
@@ -23,7 +32,7 @@ QRectF MyImageItem::boundingRect() const {
 }
 
 void MyImageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
-  painter->drawImage(QPointF(0, 0), m_image, m_area);
+  painter->drawImage(QPointF(0, 0), m_patch, QRectF(m_patchOffset, m_area.size()));
   auto size = (m_area.bottomRight() - m_area.topLeft());
   painter->setPen(QPen(Qt::yellow, 1, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
   painter->drawEllipse(size / 2, 2, 2);
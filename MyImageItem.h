@@ -11,6 +11,8 @@ class MyImageItem : public QGraphicsItem {
 public:
   explicit MyImageItem(const QImage &image, const QRectF &area);
 
+  ~MyImageItem() override;
+
   QRectF boundingRect() const override;
 
 protected:
@@ -22,8 +24,9 @@ protected:
 
 private:
   QRectF m_area;
-  QImage m_image;
-  QPixmap m_visibleImage;
+  /* only the patch around the keypoint, holding the whole image kept every decoded picture alive */
+  QImage m_patch;
+  QPointF m_patchOffset;
 };
 
 
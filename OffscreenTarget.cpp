@@ -0,0 +1,548 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <QVulkanFunctions>
+#include <QDebug>
+#include "OffscreenTarget.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof((arr)[0]))
+
+OffscreenTarget::OffscreenTarget(QVulkanInstance *inst, const QSize &size) : m_inst(inst), m_size(size) {
+  memset(&m_physDevProps, 0, sizeof(m_physDevProps));
+}
+
+OffscreenTarget::~OffscreenTarget() {
+  release();
+}
+
+bool OffscreenTarget::initialize(QVulkanWindowRenderer *renderer) {
+  m_renderer = renderer;
+  if (!pickPhysicalDevice()) {
+    return false;
+  }
+  m_renderer->preInitResources();
+  if (!createDevice()) {
+    return false;
+  }
+
+  VkFormat depthFormats[] = {
+          VK_FORMAT_D24_UNORM_S8_UINT,
+          VK_FORMAT_D32_SFLOAT_S8_UINT,
+          VK_FORMAT_D16_UNORM_S8_UINT
+  };
+  for (auto format: depthFormats) {
+    VkFormatProperties formatProps;
+    m_inst->functions()->vkGetPhysicalDeviceFormatProperties(m_physDev, format, &formatProps);
+    if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      m_depthFormat = format;
+      break;
+    }
+  }
+  if (m_depthFormat == VK_FORMAT_UNDEFINED) {
+    qWarning("can not find depth stencil format");
+    return false;
+  }
+
+  createRenderPass();
+  m_color = createAttachment(m_colorFormat, VK_SAMPLE_COUNT_1_BIT,
+                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                             VK_IMAGE_ASPECT_COLOR_BIT);
+  m_depth = createAttachment(m_depthFormat, m_sampleCount, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                             VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+  m_msaaColor = createAttachment(m_colorFormat, m_sampleCount,
+                                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                 VK_IMAGE_ASPECT_COLOR_BIT);
+  /* same attachment order as the default render pass of QVulkanWindow with msaa enabled */
+  VkImageView attachments[] = {m_color.imageView, m_depth.imageView, m_msaaColor.imageView};
+  VkFramebufferCreateInfo framebufferCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .renderPass = m_renderPass,
+          .attachmentCount = ARRAY_SIZE(attachments),
+          .pAttachments = attachments,
+          .width = static_cast<uint32_t>(m_size.width()),
+          .height = static_cast<uint32_t>(m_size.height()),
+          .layers = 1,
+  };
+  if (m_devFuncs->vkCreateFramebuffer(m_dev, &framebufferCreateInfo, nullptr, &m_framebuffer) != VK_SUCCESS) {
+    qFatal("can not create frame buffer");
+  }
+  createFrameResources();
+
+  m_renderer->initResources();
+  m_renderer->initSwapChainResources();
+  return true;
+}
+
+void OffscreenTarget::release() {
+  if (m_dev == VK_NULL_HANDLE) {
+    return;
+  }
+  finish();
+  m_devFuncs->vkDeviceWaitIdle(m_dev);
+  if (m_renderer) {
+    m_renderer->releaseSwapChainResources();
+    m_renderer->releaseResources();
+    m_renderer = nullptr;
+  }
+
+  for (auto &frame: m_frames) {
+    m_devFuncs->vkUnmapMemory(m_dev, frame.readbackMemory);
+    m_devFuncs->vkDestroyBuffer(m_dev, frame.readback, nullptr);
+    m_devFuncs->vkFreeMemory(m_dev, frame.readbackMemory, nullptr);
+    m_devFuncs->vkDestroyFence(m_dev, frame.fence, nullptr);
+    frame = FrameData();
+  }
+  m_devFuncs->vkDestroyCommandPool(m_dev, m_cmdPool, nullptr);
+  m_devFuncs->vkDestroyFramebuffer(m_dev, m_framebuffer, nullptr);
+  destroyAttachment(m_color);
+  destroyAttachment(m_depth);
+  destroyAttachment(m_msaaColor);
+  m_devFuncs->vkDestroyRenderPass(m_dev, m_renderPass, nullptr);
+  m_devFuncs->vkDestroyDevice(m_dev, nullptr);
+  m_inst->resetDeviceFunctions(m_dev);
+  m_dev = VK_NULL_HANDLE;
+}
+
+void OffscreenTarget::setFrameCallback(const FrameCallback &callback) {
+  m_frameCallback = callback;
+}
+
+void OffscreenTarget::renderFrame(const QString &tag) {
+  FrameData &frame = m_frames[m_currentFrame];
+  if (frame.pending) {
+    m_devFuncs->vkWaitForFences(m_dev, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+    deliverFrame(frame);
+  }
+  m_devFuncs->vkResetFences(m_dev, 1, &frame.fence);
+  m_devFuncs->vkResetCommandBuffer(frame.cb, 0);
+  VkCommandBufferBeginInfo commandBufferBeginInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+          .pNext = nullptr,
+          .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+          .pInheritanceInfo = nullptr
+  };
+  if (m_devFuncs->vkBeginCommandBuffer(frame.cb, &commandBufferBeginInfo) != VK_SUCCESS) {
+    qFatal("can not begin command buffer");
+  }
+  frame.tag = tag;
+  m_renderer->startNextFrame();
+}
+
+void OffscreenTarget::frameReady() {
+  FrameData &frame = m_frames[m_currentFrame];
+  VkBufferImageCopy bufferImageCopy = {
+          .bufferOffset = 0,
+          .bufferRowLength = 0,
+          .bufferImageHeight = 0,
+          .imageSubresource = {
+                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                  .mipLevel = 0,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1
+          },
+          .imageOffset = {0, 0, 0},
+          .imageExtent = {static_cast<uint32_t>(m_size.width()), static_cast<uint32_t>(m_size.height()), 1}
+  };
+  m_devFuncs->vkCmdCopyImageToBuffer(frame.cb, m_color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readback,
+                                     1, &bufferImageCopy);
+  VkBufferMemoryBarrier barrier = {
+          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer = frame.readback,
+          .offset = 0,
+          .size = VK_WHOLE_SIZE
+  };
+  m_devFuncs->vkCmdPipelineBarrier(frame.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                   0, nullptr, 1, &barrier, 0, nullptr);
+  m_devFuncs->vkEndCommandBuffer(frame.cb);
+
+  VkSubmitInfo submitInfo = {
+          .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+          .pNext = nullptr,
+          .waitSemaphoreCount = 0,
+          .pWaitSemaphores = nullptr,
+          .pWaitDstStageMask = nullptr,
+          .commandBufferCount = 1,
+          .pCommandBuffers = &frame.cb,
+          .signalSemaphoreCount = 0,
+          .pSignalSemaphores = nullptr
+  };
+  if (m_devFuncs->vkQueueSubmit(m_queue, 1, &submitInfo, frame.fence) != VK_SUCCESS) {
+    qFatal("can not submit command");
+  }
+  frame.pending = true;
+  m_currentFrame = (m_currentFrame + 1) % ARRAY_SIZE(m_frames);
+}
+
+void OffscreenTarget::finish() {
+  for (size_t i = 0; i < ARRAY_SIZE(m_frames); i++) {
+    /* oldest frame first */
+    FrameData &frame = m_frames[(m_currentFrame + i) % ARRAY_SIZE(m_frames)];
+    if (frame.pending) {
+      m_devFuncs->vkWaitForFences(m_dev, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+      deliverFrame(frame);
+    }
+  }
+}
+
+void OffscreenTarget::requestSampleCount(int sampleCount) {
+  const VkSampleCountFlags supported = m_physDevProps.limits.framebufferColorSampleCounts &
+                                       m_physDevProps.limits.framebufferDepthSampleCounts;
+  /* lavapipe only does 4x, take the largest supported count not above the request */
+  for (int count = sampleCount; count > 1; count >>= 1) {
+    if (supported & count) {
+      m_sampleCount = static_cast<VkSampleCountFlagBits>(count);
+      return;
+    }
+  }
+  qFatal("msaa is not supported");
+}
+
+bool OffscreenTarget::pickPhysicalDevice() {
+  QVulkanFunctions *f = m_inst->functions();
+  uint32_t count = 0;
+  f->vkEnumeratePhysicalDevices(m_inst->vkInstance(), &count, nullptr);
+  if (count == 0) {
+    qWarning("no vulkan physical device");
+    return false;
+  }
+  std::vector<VkPhysicalDevice> physDevs(count);
+  f->vkEnumeratePhysicalDevices(m_inst->vkInstance(), &count, physDevs.data());
+
+  /* same override as QVulkanWindow */
+  int index = qEnvironmentVariableIsSet("QT_VK_PHYSICAL_DEVICE_INDEX") ?
+              qEnvironmentVariableIntValue("QT_VK_PHYSICAL_DEVICE_INDEX") : -1;
+  for (uint32_t i = 0; i < count; i++) {
+    if ((index >= 0) && (static_cast<uint32_t>(index) != i)) {
+      continue;
+    }
+    uint32_t queueCount = 0;
+    f->vkGetPhysicalDeviceQueueFamilyProperties(physDevs[i], &queueCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueProps(queueCount);
+    f->vkGetPhysicalDeviceQueueFamilyProperties(physDevs[i], &queueCount, queueProps.data());
+    for (uint32_t j = 0; j < queueCount; j++) {
+      if (queueProps[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        m_physDev = physDevs[i];
+        m_queueFamilyIndex = j;
+        f->vkGetPhysicalDeviceProperties(m_physDev, &m_physDevProps);
+        qDebug() << "offscreen rendering on" << m_physDevProps.deviceName;
+        return true;
+      }
+    }
+  }
+  qWarning("no vulkan physical device with graphics queue");
+  return false;
+}
+
+bool OffscreenTarget::createDevice() {
+  QVulkanFunctions *f = m_inst->functions();
+  const float priority = 1.0f;
+  VkDeviceQueueCreateInfo queueCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .queueFamilyIndex = m_queueFamilyIndex,
+          .queueCount = 1,
+          .pQueuePriorities = &priority
+  };
+  VkPhysicalDeviceFeatures supportedFeatures;
+  f->vkGetPhysicalDeviceFeatures(m_physDev, &supportedFeatures);
+  VkPhysicalDeviceFeatures features;
+  memset(&features, 0, sizeof(features));
+  features.largePoints = supportedFeatures.largePoints;
+  features.wideLines = supportedFeatures.wideLines;
+  VkDeviceCreateInfo deviceCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .queueCreateInfoCount = 1,
+          .pQueueCreateInfos = &queueCreateInfo,
+          .enabledLayerCount = 0,
+          .ppEnabledLayerNames = nullptr,
+          .enabledExtensionCount = 0,
+          .ppEnabledExtensionNames = nullptr,
+          .pEnabledFeatures = &features
+  };
+  if (f->vkCreateDevice(m_physDev, &deviceCreateInfo, nullptr, &m_dev) != VK_SUCCESS) {
+    qWarning("can not create vulkan device");
+    return false;
+  }
+  m_devFuncs = m_inst->deviceFunctions(m_dev);
+  m_devFuncs->vkGetDeviceQueue(m_dev, m_queueFamilyIndex, 0, &m_queue);
+  return true;
+}
+
+uint32_t OffscreenTarget::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, bool fallback) {
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  m_inst->functions()->vkGetPhysicalDeviceMemoryProperties(m_physDev, &memoryProperties);
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeBits & (1u << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+      return i;
+    }
+  }
+  if (fallback) {
+    return UINT32_MAX;
+  }
+  qFatal("can not find proper memory type");
+}
+
+OffscreenTarget::Attachment
+OffscreenTarget::createAttachment(VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+                                  VkImageAspectFlags aspect) {
+  Attachment attachment;
+  VkImageCreateInfo imageCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .imageType = VK_IMAGE_TYPE_2D,
+          .format = format,
+          .extent = {static_cast<uint32_t>(m_size.width()), static_cast<uint32_t>(m_size.height()), 1},
+          .mipLevels = 1,
+          .arrayLayers = 1,
+          .samples = samples,
+          .tiling = VK_IMAGE_TILING_OPTIMAL,
+          .usage = usage,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+          .queueFamilyIndexCount = 0,
+          .pQueueFamilyIndices = nullptr,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+  };
+  if (m_devFuncs->vkCreateImage(m_dev, &imageCreateInfo, nullptr, &attachment.image) != VK_SUCCESS) {
+    qFatal("can not create image");
+  }
+  VkMemoryRequirements memoryRequirements;
+  m_devFuncs->vkGetImageMemoryRequirements(m_dev, attachment.image, &memoryRequirements);
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+          .pNext = nullptr,
+          .allocationSize = memoryRequirements.size,
+          .memoryTypeIndex = getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                           false)
+  };
+  if (m_devFuncs->vkAllocateMemory(m_dev, &memoryAllocateInfo, nullptr, &attachment.memory) != VK_SUCCESS) {
+    qFatal("can not allocate memory");
+  }
+  if (m_devFuncs->vkBindImageMemory(m_dev, attachment.image, attachment.memory, 0) != VK_SUCCESS) {
+    qFatal("can not bind image and memory");
+  }
+  VkImageViewCreateInfo imageViewCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .image = attachment.image,
+          .viewType = VK_IMAGE_VIEW_TYPE_2D,
+          .format = format,
+          .components = {
+                  .r = VK_COMPONENT_SWIZZLE_R,
+                  .g = VK_COMPONENT_SWIZZLE_G,
+                  .b = VK_COMPONENT_SWIZZLE_B,
+                  .a = VK_COMPONENT_SWIZZLE_A
+          },
+          .subresourceRange = {
+                  .aspectMask = aspect,
+                  .baseMipLevel = 0,
+                  .levelCount = 1,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1
+          }
+  };
+  if (m_devFuncs->vkCreateImageView(m_dev, &imageViewCreateInfo, nullptr, &attachment.imageView) != VK_SUCCESS) {
+    qFatal("can not create image view");
+  }
+  return attachment;
+}
+
+void OffscreenTarget::destroyAttachment(OffscreenTarget::Attachment &attachment) {
+  m_devFuncs->vkDestroyImageView(m_dev, attachment.imageView, nullptr);
+  m_devFuncs->vkDestroyImage(m_dev, attachment.image, nullptr);
+  m_devFuncs->vkFreeMemory(m_dev, attachment.memory, nullptr);
+  attachment = Attachment();
+}
+
+void OffscreenTarget::createRenderPass() {
+  VkAttachmentDescription attachmentDescriptions[] = {
+          { // resolve target, copied into the readback buffer
+                  .flags = 0,
+                  .format = m_colorFormat,
+                  .samples = VK_SAMPLE_COUNT_1_BIT,
+                  .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                  .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                  .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                  .stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                  .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                  .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+          },
+          {
+                  .flags = 0,
+                  .format = m_depthFormat,
+                  .samples = m_sampleCount,
+                  .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                  .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                  .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                  .stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                  .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                  .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+          },
+          {
+                  .flags = 0,
+                  .format = m_colorFormat,
+                  .samples = m_sampleCount,
+                  .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                  .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                  .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                  .stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                  .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                  .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+          }
+  };
+  VkAttachmentReference colorReference = {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference resolveReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthReference = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpassDescription = {
+          .flags = 0,
+          .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+          .inputAttachmentCount = 0,
+          .pInputAttachments = nullptr,
+          .colorAttachmentCount = 1,
+          .pColorAttachments = &colorReference,
+          .pResolveAttachments = &resolveReference,
+          .pDepthStencilAttachment = &depthReference,
+          .preserveAttachmentCount = 0,
+          .pPreserveAttachments = nullptr
+  };
+
+  VkSubpassDependency subpassDependency[] = {
+          { // the copy of the previous frame must be done before the resolve target is written again
+                  .srcSubpass = VK_SUBPASS_EXTERNAL,
+                  .dstSubpass = 0,
+                  .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                  .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                  .srcAccessMask = 0,
+                  .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                  .dependencyFlags = 0
+          },
+          {
+                  .srcSubpass = 0,
+                  .dstSubpass = VK_SUBPASS_EXTERNAL,
+                  .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                  .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                  .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                  .dependencyFlags = 0
+          }
+  };
+  VkRenderPassCreateInfo renderPassCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .attachmentCount = ARRAY_SIZE(attachmentDescriptions),
+          .pAttachments = attachmentDescriptions,
+          .subpassCount = 1,
+          .pSubpasses = &subpassDescription,
+          .dependencyCount = ARRAY_SIZE(subpassDependency),
+          .pDependencies = subpassDependency
+  };
+  if (m_devFuncs->vkCreateRenderPass(m_dev, &renderPassCreateInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+    qFatal("can not create render pass");
+  }
+}
+
+void OffscreenTarget::createFrameResources() {
+  VkCommandPoolCreateInfo commandPoolCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          .queueFamilyIndex = m_queueFamilyIndex
+  };
+  if (m_devFuncs->vkCreateCommandPool(m_dev, &commandPoolCreateInfo, nullptr, &m_cmdPool) != VK_SUCCESS) {
+    qFatal("can not create command pool");
+  }
+
+  const VkDeviceSize readbackSize = static_cast<VkDeviceSize>(m_size.width()) * m_size.height() * 4;
+  for (auto &frame: m_frames) {
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .commandPool = m_cmdPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+    };
+    if (m_devFuncs->vkAllocateCommandBuffers(m_dev, &commandBufferAllocateInfo, &frame.cb) != VK_SUCCESS) {
+      qFatal("can not allocate command buffer");
+    }
+
+    VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+    if (m_devFuncs->vkCreateFence(m_dev, &fenceCreateInfo, nullptr, &frame.fence) != VK_SUCCESS) {
+      qFatal("can not create fence");
+    }
+
+    VkBufferCreateInfo bufferCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = readbackSize,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+    };
+    if (m_devFuncs->vkCreateBuffer(m_dev, &bufferCreateInfo, nullptr, &frame.readback) != VK_SUCCESS) {
+      qFatal("can not create readback buffer");
+    }
+    VkMemoryRequirements memoryRequirements;
+    m_devFuncs->vkGetBufferMemoryRequirements(m_dev, frame.readback, &memoryRequirements);
+    /* cached memory makes the cpu side read several times faster when the driver offers it */
+    uint32_t memoryType = getMemoryType(memoryRequirements.memoryTypeBits,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_CACHED_BIT, true);
+    if (memoryType == UINT32_MAX) {
+      memoryType = getMemoryType(memoryRequirements.memoryTypeBits,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+    }
+    VkMemoryAllocateInfo memoryAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .allocationSize = memoryRequirements.size,
+            .memoryTypeIndex = memoryType
+    };
+    if (m_devFuncs->vkAllocateMemory(m_dev, &memoryAllocateInfo, nullptr, &frame.readbackMemory) != VK_SUCCESS) {
+      qFatal("can not allocate memory");
+    }
+    if (m_devFuncs->vkBindBufferMemory(m_dev, frame.readback, frame.readbackMemory, 0) != VK_SUCCESS) {
+      qFatal("can not bind buffer memory");
+    }
+    void *p;
+    if (m_devFuncs->vkMapMemory(m_dev, frame.readbackMemory, 0, readbackSize, 0, &p) != VK_SUCCESS) {
+      qFatal("can not map readback buffer");
+    }
+    frame.readbackPtr = static_cast<const uchar *>(p);
+  }
+}
+
+void OffscreenTarget::deliverFrame(OffscreenTarget::FrameData &frame) {
+  frame.pending = false;
+  if (!m_frameCallback) {
+    return;
+  }
+  QImage image(m_size, QImage::Format_RGBA8888);
+  const int rowBytes = m_size.width() * 4;
+  for (int y = 0; y < m_size.height(); y++) {
+    memcpy(image.scanLine(y), frame.readbackPtr + static_cast<size_t>(y) * rowBytes, rowBytes);
+  }
+  m_frameCallback(image, frame.tag);
+}
@@ -0,0 +1,129 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_OFFSCREENTARGET_H
+#define MATCH_MANUALLY_OFFSCREENTARGET_H
+
+#include <functional>
+#include <QImage>
+#include <QVulkanWindowRenderer>
+#include "RenderTarget.h"
+
+class QVulkanDeviceFunctions;
+
+/*
+ * render target without swapchain, frames are resolved into a color image and copied into one of two
+ * host visible readback buffers, so the cpu converts frame N while the gpu still works on frame N + 1
+ */
+class OffscreenTarget : public RenderTarget {
+public:
+  typedef std::function<void(const QImage &image, const QString &tag)> FrameCallback;
+
+  OffscreenTarget(QVulkanInstance *inst, const QSize &size);
+
+  ~OffscreenTarget() override;
+
+  bool initialize(QVulkanWindowRenderer *renderer);
+
+  void release();
+
+  void setFrameCallback(const FrameCallback &callback);
+
+  /* record a frame through the renderer, the result is handed to the frame callback with the given tag */
+  void renderFrame(const QString &tag);
+
+  /* wait for all frames in flight and deliver them */
+  void finish();
+
+  QVulkanInstance *vulkanInstance() const override { return m_inst; }
+
+  VkPhysicalDevice physicalDevice() const override { return m_physDev; }
+
+  const VkPhysicalDeviceProperties *physicalDeviceProperties() const override { return &m_physDevProps; }
+
+  VkDevice device() const override { return m_dev; }
+
+  VkQueue graphicsQueue() const override { return m_queue; }
+
+  uint32_t graphicsQueueFamilyIndex() const override { return m_queueFamilyIndex; }
+
+  VkRenderPass defaultRenderPass() const override { return m_renderPass; }
+
+  VkSampleCountFlagBits sampleCountFlagBits() const override { return m_sampleCount; }
+
+  QSize swapChainImageSize() const override { return m_size; }
+
+  VkCommandBuffer currentCommandBuffer() const override { return m_frames[m_currentFrame].cb; }
+
+  VkFramebuffer currentFramebuffer() const override { return m_framebuffer; }
+
+  void frameReady() override;
+
+  void requestUpdate() override {}
+
+  void requestSampleCount(int sampleCount) override;
+
+  void setCursorShape(Qt::CursorShape shape) override {}
+
+  qreal devicePixelRatio() const override { return 1.0; }
+
+private:
+  struct Attachment {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+  };
+
+  struct FrameData {
+    VkCommandBuffer cb = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkBuffer readback = VK_NULL_HANDLE;
+    VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+    const uchar *readbackPtr = nullptr;
+    QString tag;
+    bool pending = false;
+  };
+
+  QVulkanInstance *m_inst;
+  QVulkanDeviceFunctions *m_devFuncs = nullptr;
+  QVulkanWindowRenderer *m_renderer = nullptr;
+  FrameCallback m_frameCallback;
+  QSize m_size;
+
+  VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties m_physDevProps;
+  VkDevice m_dev = VK_NULL_HANDLE;
+  VkQueue m_queue = VK_NULL_HANDLE;
+  uint32_t m_queueFamilyIndex = 0;
+  VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+  const VkFormat m_colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  Attachment m_color, m_msaaColor, m_depth;
+  VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+  VkCommandPool m_cmdPool = VK_NULL_HANDLE;
+  FrameData m_frames[2];
+  int m_currentFrame = 0;
+
+  bool pickPhysicalDevice();
+
+  bool createDevice();
+
+  uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, bool fallback);
+
+  Attachment createAttachment(VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+                              VkImageAspectFlags aspect);
+
+  void destroyAttachment(Attachment &attachment);
+
+  void createRenderPass();
+
+  void createFrameResources();
+
+  void deliverFrame(FrameData &frame);
+};
+
+
+#endif //MATCH_MANUALLY_OFFSCREENTARGET_H
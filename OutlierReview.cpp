@@ -0,0 +1,271 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include "OutlierReview.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+
+uint64_t entryKey(Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  return (static_cast<uint64_t>(image_id) << 32) | kp_id;
+}
+
+/* px in the image of a, NaN when the two cameras share their center */
+float sampsonDistance(const Triangulation::View &a, const Triangulation::View &b) {
+  const Eigen::Matrix3d R = b.P.leftCols<3>() * a.P.leftCols<3>().transpose();
+  const Eigen::Vector3d t = b.P.col(3) - R * a.P.col(3);
+  Eigen::Matrix3d tx;
+  tx << 0, -t.z(), t.y(),
+          t.z(), 0, -t.x(),
+          -t.y(), t.x(), 0;
+  const Eigen::Matrix3d E = tx * R;
+  const Eigen::Vector3d xa = a.point.homogeneous();
+  const Eigen::Vector3d xb = b.point.homogeneous();
+  const Eigen::Vector3d Ex = E * xa;
+  const Eigen::Vector3d Etx = E.transpose() * xb;
+  const double denominator = Ex.head<2>().squaredNorm() + Etx.head<2>().squaredNorm();
+  if (!(denominator > 1e-24)) {
+    return kNaN;
+  }
+  return static_cast<float>(a.focal * std::abs(xb.dot(Ex)) / std::sqrt(denominator));
+}
+
+/* the lower one of an even count, so one bad partner out of two does not flag a good observation */
+float lowerMedian(std::vector<float> &values) {
+  const auto middle = values.begin() + static_cast<std::ptrdiff_t>((values.size() - 1) / 2);
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+}
+
+void OutlierReview::compute(const ImageGraphModel &model, const GrayPyramids *pyramids, size_t threads) {
+  TRACE_SCOPE("OutlierReview::compute");
+  clear();
+  m_reprojection.compute(model, threads);
+  uint64_t bytes = 0;
+  const auto images = Triangulation::imageViews(model, threads, &bytes);
+  MemoryAccounting::Gauge memory(MemoryAccounting::MODEL, MemoryAccounting::HOST);
+  memory.set(bytes);
+
+  std::vector<const Track *> tracks;
+  tracks.reserve(model.tracks.size());
+  for (const auto &it: model.tracks) {
+    tracks.push_back(&it.second);
+  }
+  /* few observations are suspicious, a lock per track that has some is cheap */
+  std::mutex mutex;
+  std::vector<Entry> entries;
+  parallelFor(tracks.size(), [&](size_t i) {
+    thread_local std::vector<Triangulation::View> views;
+    thread_local std::vector<size_t> observations;
+    thread_local std::vector<Entry> found;
+    Triangulation::trackViews(images, *tracks[i], views, &observations);
+    found.clear();
+    scoreTrack(model, pyramids, *tracks[i], views, observations, found);
+    if (!found.empty()) {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.insert(entries.end(), found.begin(), found.end());
+    }
+  }, threads);
+  for (const auto &entry: entries) {
+    insert(entry);
+  }
+  updateMemoryGauge();
+}
+
+void OutlierReview::updateTrack(const ImageGraphModel &model, const GrayPyramids *pyramids, Track_ID_T track_id) {
+  TRACE_SCOPE("OutlierReview::updateTrack");
+  eraseTrack(track_id);
+  auto tr = model.tracks.find(track_id);
+  if (tr != model.tracks.end()) {
+    /* keypoints still queued under another track were merged into this one, a track that is gone drops them all */
+    for (size_t i = 0; i < tr->second.images.size(); i++) {
+      auto entry = m_entries.find(entryKey(tr->second.images[i], tr->second.kps[i]));
+      if (entry == m_entries.end()) {
+        continue;
+      }
+      const Track_ID_T other = entry->second.track_id;
+      if (model.tracks.count(other) == 0) {
+        eraseTrack(other);
+      } else {
+        m_queue.erase({entry->second.suspicion, entry->first});
+        m_entries.erase(entry);
+      }
+    }
+    m_reprojection.updateTrack(model, track_id);
+    std::vector<Triangulation::View> views;
+    std::vector<size_t> observations;
+    std::vector<Entry> found;
+    Triangulation::trackViews(model, tr->second, views, &observations);
+    scoreTrack(model, pyramids, tr->second, views, observations, found);
+    for (const auto &entry: found) {
+      insert(entry);
+    }
+  }
+  updateMemoryGauge();
+}
+
+void OutlierReview::clear() {
+  m_reprojection.clear();
+  m_queue.clear();
+  m_entries.clear();
+  m_trackEntries.clear();
+  m_dismissed.clear();
+  updateMemoryGauge();
+}
+
+void OutlierReview::swap(OutlierReview &other) {
+  std::swap(options, other.options);
+  m_reprojection.swap(other.m_reprojection);
+  m_queue.swap(other.m_queue);
+  m_entries.swap(other.m_entries);
+  m_trackEntries.swap(other.m_trackEntries);
+  m_dismissed.swap(other.m_dismissed);
+  updateMemoryGauge();
+  other.updateMemoryGauge();
+}
+
+std::vector<OutlierReview::Entry> OutlierReview::top(size_t n) const {
+  std::vector<Entry> entries;
+  for (auto it = m_queue.begin(); (it != m_queue.end()) && (entries.size() < n); ++it) {
+    entries.push_back(m_entries.at(it->second));
+  }
+  return entries;
+}
+
+void OutlierReview::dismiss(Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  const uint64_t key = entryKey(image_id, kp_id);
+  m_dismissed.insert(key);
+  auto it = m_entries.find(key);
+  if (it != m_entries.end()) {
+    m_queue.erase({it->second.suspicion, key});
+    m_entries.erase(it);
+  }
+}
+
+void OutlierReview::print(std::ostream &out, size_t n) const {
+  out << "suspicious observations " << size() << '\n';
+  for (const auto &entry: top(n)) {
+    out << "image " << entry.image_id << " kp " << entry.kp_id << " track " << entry.track_id
+        << "    suspicion " << entry.suspicion << ", reprojection " << entry.reprojection << " px, epipolar "
+        << entry.epipolar << " px, dissimilarity " << entry.dissimilarity << '\n';
+  }
+}
+
+void OutlierReview::scoreTrack(const ImageGraphModel &model, const GrayPyramids *pyramids, const Track &track,
+                               const std::vector<Triangulation::View> &views, const std::vector<size_t> &observations,
+                               std::vector<Entry> &out) const {
+  const size_t n = track.images.size();
+  thread_local std::vector<float> epipolar;
+  thread_local std::vector<float> dissimilarity;
+  thread_local std::vector<float> values;
+  thread_local std::vector<std::vector<float>> patches;
+  thread_local std::vector<size_t> withPatch;
+
+  /* partners are the next views in track order, wrapping around. views holds only the images of the track's
+   * reconstruction, the relative pose to another one is unknown */
+  epipolar.assign(n, kNaN);
+  const size_t viewPartners = views.empty() ? 0 : std::min(views.size() - 1, options.maxPartners);
+  for (size_t a = 0; a < views.size(); a++) {
+    values.clear();
+    for (size_t k = 1; k <= viewPartners; k++) {
+      const float d = sampsonDistance(views[a], views[(a + k) % views.size()]);
+      if (std::isfinite(d)) {
+        values.push_back(d);
+      }
+    }
+    if (!values.empty()) {
+      epipolar[observations[a]] = lowerMedian(values);
+    }
+  }
+
+  dissimilarity.assign(n, kNaN);
+  if (pyramids != nullptr) {
+    patches.resize(std::max(patches.size(), n));
+    withPatch.clear();
+    for (size_t i = 0; i < n; i++) {
+      const auto &pos = model.imageInfos.at(track.images[i]).keyPoints[track.kps[i]].pos;
+      if (pyramids->patch(track.images[i], pos, options.patchRadius, patches[i])) {
+        withPatch.push_back(i);
+      }
+    }
+    const size_t patchPartners = withPatch.empty() ? 0 : std::min(withPatch.size() - 1, options.maxPartners);
+    for (size_t a = 0; a < withPatch.size(); a++) {
+      const auto &patch = patches[withPatch[a]];
+      values.clear();
+      for (size_t k = 1; k <= patchPartners; k++) {
+        const auto &other = patches[withPatch[(a + k) % withPatch.size()]];
+        values.push_back(1.f - std::inner_product(patch.begin(), patch.end(), other.begin(), 0.f));
+      }
+      if (!values.empty()) {
+        dissimilarity[withPatch[a]] = lowerMedian(values);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    Entry entry{
+            .image_id = track.images[i],
+            .kp_id = track.kps[i],
+            .track_id = track.track_id,
+            .reprojection = m_reprojection.error(track.images[i], track.kps[i]),
+            .epipolar = epipolar[i],
+            .dissimilarity = dissimilarity[i],
+            .suspicion = 0.f
+    };
+    /* fmax skips the cues that are NaN, no cue at all stays NaN and is not queued */
+    entry.suspicion = std::fmax(std::fmax(entry.reprojection / options.maxReprojection,
+                                          entry.epipolar / options.maxEpipolar),
+                                entry.dissimilarity / options.maxDissimilarity);
+    if (entry.suspicion >= 1.f) {
+      out.push_back(entry);
+    }
+  }
+}
+
+void OutlierReview::insert(const Entry &entry) {
+  const uint64_t key = entryKey(entry.image_id, entry.kp_id);
+  if (m_dismissed.count(key) != 0) {
+    return;
+  }
+  auto it = m_entries.find(key);
+  if (it != m_entries.end()) {
+    m_queue.erase({it->second.suspicion, key});
+    it->second = entry;
+  } else {
+    m_entries.emplace(key, entry);
+  }
+  m_queue.emplace(entry.suspicion, key);
+  m_trackEntries[entry.track_id].push_back(key);
+}
+
+void OutlierReview::eraseTrack(Track_ID_T track_id) {
+  auto it = m_trackEntries.find(track_id);
+  if (it == m_trackEntries.end()) {
+    return;
+  }
+  for (const auto key: it->second) {
+    auto entry = m_entries.find(key);
+    if ((entry != m_entries.end()) && (entry->second.track_id == track_id)) {
+      m_queue.erase({entry->second.suspicion, key});
+      m_entries.erase(entry);
+    }
+  }
+  m_trackEntries.erase(it);
+}
+
+void OutlierReview::updateMemoryGauge() {
+  /* node sizes estimated, the containers do not expose them */
+  size_t bytes = m_entries.size() * (sizeof(std::pair<const uint64_t, Entry>) + 2 * sizeof(void *));
+  bytes += m_queue.size() * (sizeof(std::pair<float, uint64_t>) + 4 * sizeof(void *));
+  bytes += m_trackEntries.size() * (sizeof(std::pair<const Track_ID_T, std::vector<uint64_t>>) + 2 * sizeof(void *));
+  bytes += (m_entries.size() + m_dismissed.size()) * 2 * sizeof(uint64_t);
+  m_memory.set(bytes);
+}
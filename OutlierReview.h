@@ -0,0 +1,103 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_OUTLIERREVIEW_H
+#define MATCH_MANUALLY_OUTLIERREVIEW_H
+
+#include <functional>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "GrayPyramids.h"
+#include "ReprojectionErrors.h"
+#include "Triangulation.h"
+
+/*
+ * queue of the track observations most likely to be wrong. every observation gets three cues against the rest of
+ * its track: the reprojection error of the track point, the median sampson distance to the other registered
+ * observations (relative pose from colmap, no 3d point needed) and the median patch dissimilarity (1 - ncc) with
+ * the other observations whose gray images are loaded. each cue is divided by its threshold, the largest is the
+ * suspicion and observations at 1 or above are queued, most suspicious first. the full pass scores the tracks in
+ * parallel, edits only rescore their track
+ */
+class OutlierReview {
+public:
+  struct Options {
+    /* px */
+    float maxReprojection = 4.f;
+    /* px, sampson distance in the image of the observation */
+    float maxEpipolar = 4.f;
+    /* 1 - ncc of the level 0 patches, views of wide baselines correlate less than matching ones */
+    float maxDissimilarity = 0.6f;
+    int patchRadius = 7;
+    /* other observations every observation is compared with, long tracks cost no more than this */
+    size_t maxPartners = 8;
+  };
+
+  /* the cues are NaN where they could not be computed */
+  struct Entry {
+    Image_ID_T image_id;
+    KeyPoint_ID_T kp_id;
+    Track_ID_T track_id;
+    float reprojection;
+    float epipolar;
+    float dissimilarity;
+    float suspicion;
+  };
+
+  Options options;
+
+  /* every track of the model, patches only where pyramids (may be nullptr) has both images. dismissals are reset */
+  void compute(const ImageGraphModel &model, const GrayPyramids *pyramids, size_t threads = 0);
+
+  /*
+   * after the track was created, edited, merged into or triangulated. ids of tracks that are gone drop theirs, so
+   * does a track merged into this one
+   */
+  void updateTrack(const ImageGraphModel &model, const GrayPyramids *pyramids, Track_ID_T track_id);
+
+  void clear();
+
+  /* takes over a full pass computed elsewhere, e.g. on another thread against a copy of the model */
+  void swap(OutlierReview &other);
+
+  bool empty() const { return m_queue.empty(); }
+
+  size_t size() const { return m_queue.size(); }
+
+  /* the n most suspicious observations, most suspicious first */
+  std::vector<Entry> top(size_t n) const;
+
+  /* takes the observation out of the queue, rescoring its track leaves it out until the next full pass */
+  void dismiss(Image_ID_T image_id, KeyPoint_ID_T kp_id);
+
+  /* summary and the n most suspicious observations */
+  void print(std::ostream &out, size_t n = 20) const;
+
+private:
+  ReprojectionErrors m_reprojection;
+  /* suspicion and key (image id << 32 | keypoint id), ties in key order */
+  std::set<std::pair<float, uint64_t>, std::greater<>> m_queue;
+  std::unordered_map<uint64_t, Entry> m_entries;
+  /* keys queued per track, keys taken over by another track since are skipped */
+  std::unordered_map<Track_ID_T, std::vector<uint64_t>> m_trackEntries;
+  std::unordered_set<uint64_t> m_dismissed;
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::MODEL, MemoryAccounting::HOST};
+
+  /* appends the suspicious observations of the track, views and observations as from Triangulation::trackViews */
+  void scoreTrack(const ImageGraphModel &model, const GrayPyramids *pyramids, const Track &track,
+                  const std::vector<Triangulation::View> &views, const std::vector<size_t> &observations,
+                  std::vector<Entry> &out) const;
+
+  void insert(const Entry &entry);
+
+  void eraseTrack(Track_ID_T track_id);
+
+  void updateMemoryGauge();
+};
+
+
+#endif //MATCH_MANUALLY_OUTLIERREVIEW_H
@@ -0,0 +1,57 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_PARALLEL_H
+#define MATCH_MANUALLY_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/* 0 means one thread per hardware thread */
+inline size_t parallelThreadCount(size_t threads = 0) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return threads;
+}
+
+/*
+ * calls f(i) for i in [0, n), indices are handed out in chunks from a shared counter so uneven items
+ * (images with many keypoints, long tracks) balance out. runs inline when one thread is enough
+ */
+template<typename F>
+void parallelFor(size_t n, F &&f, size_t threads = 0, size_t chunk = 0) {
+  threads = std::min(parallelThreadCount(threads), n);
+  if (threads <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      f(i);
+    }
+    return;
+  }
+  if (chunk == 0) {
+    chunk = std::max<size_t>(1, n / (threads * 8));
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t begin = next.fetch_add(chunk); begin < n; begin = next.fetch_add(chunk)) {
+      const size_t end = std::min(n, begin + chunk);
+      for (size_t i = begin; i < end; i++) {
+        f(i);
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (size_t t = 1; t < threads; t++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread: pool) {
+    thread.join();
+  }
+}
+
+#endif //MATCH_MANUALLY_PARALLEL_H
@@ -0,0 +1,529 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include "AtomicFile.h"
+#include "ImageGraphModel.h"
+#include "Parallel.h"
+#include "ProjectCache.h"
+#include "Trace.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+const uint32_t cacheMagic = 0x4A504D4Du; // "MMPJ"
+const uint64_t sectionAlignment = 64;
+
+enum Section : uint32_t {
+  META,
+  IMAGES,
+  CAMERAS,
+  CAMERA_PARAMS,
+  STRINGS,
+  KP_POS,
+  KP_TRACK,
+  TRACK_ID,
+  TRACK_POS,
+  TRACK_ERROR,
+  TRACK_COLOR,
+  TRACK_ORIGIN,
+  TRACK_OBS_OFFSET,
+  OBS_IMAGE,
+  OBS_KP,
+  ORIGINS,
+  SECTION_COUNT
+};
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sectionCount;
+  uint32_t reserved;
+  uint64_t fileSize;
+  /* of the section table */
+  uint64_t tableChecksum;
+};
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t elemSize;
+  uint64_t offset;
+  uint64_t count;
+  uint64_t checksum;
+};
+
+struct MetaRecord {
+  uint64_t imageIdMax;
+  uint64_t trackIdMax;
+  uint64_t sourceOffset;
+  uint64_t sourceLength;
+};
+
+/* images are written in row order */
+struct ImageRecord {
+  uint32_t image_id;
+  uint32_t checkState;
+  int32_t width;
+  int32_t height;
+  uint16_t registered;
+  uint16_t origin;
+  uint32_t camera_id;
+  uint32_t colmapImageId;
+  uint32_t reserved;
+  double qvec[4];
+  double tvec[3];
+  uint64_t kpOffset;
+  uint64_t kpCount;
+  uint64_t pathOffset;
+  uint64_t pathLength;
+  uint64_t nameOffset;
+  uint64_t nameLength;
+};
+static_assert(sizeof(ImageRecord) == 136, "image record layout");
+
+struct StringRef {
+  uint64_t offset;
+  uint64_t length;
+};
+
+/* camera_id is the key in the model, colmapCameraId the id the camera has in its reconstruction */
+struct CameraRecord {
+  uint32_t camera_id;
+  int32_t model_id;
+  uint32_t colmapCameraId;
+  uint32_t reserved;
+  uint64_t width;
+  uint64_t height;
+  uint64_t paramOffset;
+  uint64_t paramCount;
+};
+
+const uint32_t elemSizes[SECTION_COUNT] = {
+    sizeof(MetaRecord), sizeof(ImageRecord), sizeof(CameraRecord), sizeof(double), 1,
+    2 * sizeof(float), sizeof(Track_ID_T), sizeof(Track_ID_T), 3 * sizeof(float), sizeof(float), 4, sizeof(uint16_t),
+    sizeof(uint64_t), sizeof(Image_ID_T), sizeof(KeyPoint_ID_T), sizeof(StringRef)
+};
+
+/* xxhash style four lane hash, detects torn writes and bit rot, not tampering */
+uint64_t checksum64(const void *data, size_t len) {
+  const uint64_t P1 = 11400714785074694791ull;
+  const uint64_t P2 = 14029467366897019727ull;
+  const uint64_t P3 = 1609587929392839161ull;
+  auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+  auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; };
+  const auto *p = static_cast<const uint8_t *>(data);
+  const uint8_t *const end = p + len;
+  uint64_t lanes[4] = {P1 + P2, P2, 0, 0 - P1};
+  while (end - p >= 32) {
+    for (auto &lane: lanes) {
+      uint64_t w;
+      memcpy(&w, p, sizeof(w));
+      lane = round(lane, w);
+      p += sizeof(w);
+    }
+  }
+  uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + len;
+  while (end - p >= 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    h = rotl(h ^ round(0, w), 27) * P1 + P3;
+    p += sizeof(w);
+  }
+  while (p < end) {
+    h = rotl(h ^ (*p++ * P3), 11) * P1;
+  }
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  return h ^ (h >> 32);
+}
+
+uint64_t alignUp(uint64_t v) {
+  return (v + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+void appendString(std::vector<char> &strings, const std::string &s, uint64_t *offset, uint64_t *length) {
+  *offset = strings.size();
+  *length = s.size();
+  strings.insert(strings.end(), s.begin(), s.end());
+}
+
+template<typename T>
+std::pair<const void *, uint64_t> column(const std::vector<T> &v) {
+  return {v.data(), v.size() * sizeof(T)};
+}
+}
+
+std::string ProjectCache::defaultPath(const std::string &sparseDir) {
+  return sparseDir + "/match_manually.cache";
+}
+
+std::string ProjectCache::sourceFingerprint(const std::string &sparseDir, const std::string &imageDir) {
+  std::string fingerprint = "images " + imageDir;
+  for (const auto &dir: ColmapLoader::subModelDirs(sparseDir)) {
+    for (const char *file: {"/cameras.bin", "/images.bin", "/points3D.bin",
+                            "/cameras.bin.zst", "/images.bin.zst", "/points3D.bin.zst"}) {
+      struct stat st = {};
+      const std::string path = dir + file;
+      if (stat(path.c_str(), &st) == 0) {
+        fingerprint += "\n" + path + " " + std::to_string(st.st_size) + " " + std::to_string(st.st_mtim.tv_sec) +
+                       "." + std::to_string(st.st_mtim.tv_nsec);
+      }
+    }
+  }
+  return fingerprint;
+}
+
+bool ProjectCache::write(const ImageGraphModel &model, const std::string &path, const std::string &source) {
+  TRACE_SCOPE("ProjectCache::write");
+  std::vector<char> strings;
+  MetaRecord meta = {model.image_id_max, model.track_id_max, 0, 0};
+  appendString(strings, source, &meta.sourceOffset, &meta.sourceLength);
+
+  std::vector<CameraRecord> cameras;
+  std::vector<double> cameraParams;
+  for (const auto &it: model.cameras) {
+    const auto &c = it.second;
+    cameras.push_back({it.first, c.model_id, c.camera_id, 0, c.width, c.height, cameraParams.size(), c.params.size()});
+    cameraParams.insert(cameraParams.end(), c.params.begin(), c.params.end());
+  }
+
+  std::vector<StringRef> origins(model.origins.size());
+  for (size_t i = 0; i < origins.size(); i++) {
+    appendString(strings, model.origins[i].toStdString(), &origins[i].offset, &origins[i].length);
+  }
+
+  std::vector<ImageRecord> images;
+  std::vector<const ImageInfo *> imageInfos;
+  uint64_t keypoints = 0;
+  for (const auto image_id: model.imageIndex) {
+    const auto &info = model.imageInfos.at(image_id);
+    ImageRecord r = {
+        .image_id = image_id,
+        .checkState = static_cast<uint32_t>(info.checkState),
+        .width = info.size.width(),
+        .height = info.size.height(),
+        .registered = info.colmap.registered,
+        .origin = info.colmap.origin,
+        .camera_id = info.colmap.camera_id,
+        .colmapImageId = info.colmap.image_id,
+        .kpOffset = keypoints,
+        .kpCount = info.keyPoints.size()
+    };
+    memcpy(r.qvec, info.colmap.qvec.data(), sizeof(r.qvec));
+    memcpy(r.tvec, info.colmap.tvec.data(), sizeof(r.tvec));
+    appendString(strings, info.path.toStdString(), &r.pathOffset, &r.pathLength);
+    appendString(strings, info.colmap.name, &r.nameOffset, &r.nameLength);
+    images.push_back(r);
+    imageInfos.push_back(&info);
+    keypoints += info.keyPoints.size();
+  }
+  std::vector<float> kpPos(2 * keypoints);
+  std::vector<Track_ID_T> kpTrack(keypoints);
+  parallelFor(images.size(), [&](size_t i) {
+    const auto &kps = imageInfos[i]->keyPoints;
+    for (size_t k = 0; k < kps.size(); k++) {
+      kpPos[2 * (images[i].kpOffset + k)] = kps[k].pos.x();
+      kpPos[2 * (images[i].kpOffset + k) + 1] = kps[k].pos.y();
+      kpTrack[images[i].kpOffset + k] = kps[k].track_id;
+    }
+  });
+
+  const size_t trackCount = model.tracks.size();
+  std::vector<Track_ID_T> trackIds;
+  std::vector<float> trackPos, trackError;
+  std::vector<uint8_t> trackColor;
+  std::vector<uint16_t> trackOrigin;
+  std::vector<uint64_t> obsOffsets = {0};
+  trackIds.reserve(trackCount);
+  trackPos.reserve(3 * trackCount);
+  trackError.reserve(trackCount);
+  trackColor.reserve(4 * trackCount);
+  trackOrigin.reserve(trackCount);
+  obsOffsets.reserve(trackCount + 1);
+  for (const auto &it: model.tracks) {
+    const auto &tr = it.second;
+    trackIds.push_back(it.first);
+    trackPos.insert(trackPos.end(), {tr.pos.x(), tr.pos.y(), tr.pos.z()});
+    trackError.push_back(tr.error);
+    trackColor.insert(trackColor.end(), {tr.color.x(), tr.color.y(), tr.color.z(), 0});
+    trackOrigin.push_back(tr.origin);
+    obsOffsets.push_back(obsOffsets.back() + tr.images.size());
+  }
+  std::vector<Image_ID_T> obsImage(obsOffsets.back());
+  std::vector<KeyPoint_ID_T> obsKp(obsOffsets.back());
+  {
+    size_t i = 0;
+    for (const auto &it: model.tracks) {
+      std::copy(it.second.images.begin(), it.second.images.end(), obsImage.begin() + obsOffsets[i]);
+      std::copy(it.second.kps.begin(), it.second.kps.end(), obsKp.begin() + obsOffsets[i]);
+      i++;
+    }
+  }
+
+  const std::pair<const void *, uint64_t> payloads[SECTION_COUNT] = {
+      {&meta, sizeof(meta)}, column(images), column(cameras), column(cameraParams), column(strings),
+      column(kpPos), column(kpTrack), column(trackIds), column(trackPos), column(trackError), column(trackColor),
+      column(trackOrigin), column(obsOffsets), column(obsImage), column(obsKp), column(origins)
+  };
+  FileHeader header = {cacheMagic, version, SECTION_COUNT, 0, 0, 0};
+  SectionEntry table[SECTION_COUNT];
+  uint64_t offset = alignUp(sizeof(header) + sizeof(table));
+  for (uint32_t s = 0; s < SECTION_COUNT; s++) {
+    table[s] = {s, elemSizes[s], offset, payloads[s].second / elemSizes[s], 0};
+    offset = alignUp(offset + payloads[s].second);
+  }
+  parallelFor(SECTION_COUNT, [&](size_t s) {
+    table[s].checksum = checksum64(payloads[s].first, payloads[s].second);
+  });
+  header.fileSize = offset;
+  header.tableChecksum = checksum64(table, sizeof(table));
+
+  AtomicFile file(path);
+  if (!file.ok()) {
+    return false;
+  }
+  file.reserve(header.fileSize);
+  static const char zeros[sectionAlignment] = {};
+  std::vector<iovec> iov = {{&header, sizeof(header)}, {table, sizeof(table)}};
+  uint64_t written = sizeof(header) + sizeof(table);
+  for (const auto &p: payloads) {
+    if (alignUp(written) != written) {
+      iov.push_back({const_cast<char *>(zeros), alignUp(written) - written});
+      written = alignUp(written);
+    }
+    iov.push_back({const_cast<void *>(p.first), p.second});
+    written += p.second;
+  }
+  if (written != header.fileSize) {
+    iov.push_back({const_cast<char *>(zeros), header.fileSize - written});
+  }
+  if (!file.writev(0, iov) || !file.sync() || !file.commit()) {
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "project cache " << path << ": " << images.size() << " images, " << trackCount
+                          << " tracks, " << header.fileSize << " bytes";
+  return true;
+}
+
+bool ProjectCache::read(const std::string &path, const std::string &source, ImageGraphModel *model) {
+  TRACE_SCOPE("ProjectCache::read");
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st = {};
+  if ((fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) < sizeof(FileHeader))) {
+    close(fd);
+    return false;
+  }
+  const size_t fileSize = st.st_size;
+  void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    BOOST_LOG_TRIVIAL(warning) << "unable to map project cache " << path;
+    return false;
+  }
+  std::unique_ptr<void, std::function<void(void *)>> unmap(mapped, [fileSize](void *p) { munmap(p, fileSize); });
+  madvise(mapped, fileSize, MADV_WILLNEED);
+  const char *bytes = static_cast<const char *>(mapped);
+
+  FileHeader header;
+  memcpy(&header, bytes, sizeof(header));
+  if ((header.magic != cacheMagic) || (header.version != version) || (header.sectionCount != SECTION_COUNT) ||
+      (header.fileSize != fileSize) || (fileSize < sizeof(header) + sizeof(SectionEntry) * SECTION_COUNT)) {
+    BOOST_LOG_TRIVIAL(info) << "project cache " << path << " is of another version, ignored";
+    return false;
+  }
+  SectionEntry table[SECTION_COUNT];
+  memcpy(table, bytes + sizeof(header), sizeof(table));
+  if (checksum64(table, sizeof(table)) != header.tableChecksum) {
+    BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has a corrupt section table";
+    return false;
+  }
+  for (uint32_t s = 0; s < SECTION_COUNT; s++) {
+    const auto &e = table[s];
+    if ((e.id != s) || (e.elemSize != elemSizes[s]) || (e.offset % sectionAlignment != 0) ||
+        (e.count > fileSize / e.elemSize) || (e.offset > fileSize - e.count * e.elemSize)) {
+      BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has an invalid section " << s;
+      return false;
+    }
+  }
+  std::atomic<bool> intact(true);
+  parallelFor(SECTION_COUNT, [&](size_t s) {
+    if (checksum64(bytes + table[s].offset, table[s].count * table[s].elemSize) != table[s].checksum) {
+      intact = false;
+    }
+  });
+  if (!intact) {
+    BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " failed the checksum";
+    return false;
+  }
+
+  auto at = [&](Section s) { return bytes + table[s].offset; };
+  auto count = [&](Section s) { return table[s].count; };
+  MetaRecord meta;
+  if (count(META) != 1) {
+    return false;
+  }
+  memcpy(&meta, at(META), sizeof(meta));
+  const char *strings = at(STRINGS);
+  auto stringOk = [&](uint64_t offset, uint64_t length) {
+    return (offset <= count(STRINGS)) && (length <= count(STRINGS) - offset);
+  };
+  if (!stringOk(meta.sourceOffset, meta.sourceLength) ||
+      (std::string(strings + meta.sourceOffset, meta.sourceLength) != source)) {
+    BOOST_LOG_TRIVIAL(info) << "project cache " << path << " was built from other sources, ignored";
+    return false;
+  }
+
+  /* every index is checked before it is used, a cache that passed the checksum can still be from a buggy writer */
+  const auto *images = reinterpret_cast<const ImageRecord *>(at(IMAGES));
+  const auto *cameras = reinterpret_cast<const CameraRecord *>(at(CAMERAS));
+  const auto *cameraParams = reinterpret_cast<const double *>(at(CAMERA_PARAMS));
+  const auto *obsOffsets = reinterpret_cast<const uint64_t *>(at(TRACK_OBS_OFFSET));
+  for (uint64_t i = 0; i < count(IMAGES); i++) {
+    const auto &r = images[i];
+    if ((r.kpOffset > count(KP_TRACK)) || (r.kpCount > count(KP_TRACK) - r.kpOffset) ||
+        !stringOk(r.pathOffset, r.pathLength) || !stringOk(r.nameOffset, r.nameLength)) {
+      BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has an invalid image record";
+      return false;
+    }
+  }
+  for (uint64_t i = 0; i < count(CAMERAS); i++) {
+    if ((cameras[i].paramOffset > count(CAMERA_PARAMS)) ||
+        (cameras[i].paramCount > count(CAMERA_PARAMS) - cameras[i].paramOffset)) {
+      return false;
+    }
+  }
+  const uint64_t trackCount = count(TRACK_ID);
+  if ((count(KP_POS) != count(KP_TRACK)) || (count(TRACK_POS) != trackCount) ||
+      (count(TRACK_ERROR) != trackCount) || (count(TRACK_COLOR) != trackCount) ||
+      (count(TRACK_ORIGIN) != trackCount) ||
+      (count(TRACK_OBS_OFFSET) != trackCount + 1) || (count(OBS_IMAGE) != count(OBS_KP)) || (obsOffsets[0] != 0) ||
+      (obsOffsets[trackCount] != count(OBS_IMAGE))) {
+    BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has inconsistent columns";
+    return false;
+  }
+  /* ids in map order, the lookups below and the inserts at the end rely on it */
+  const auto *trackIds = reinterpret_cast<const Track_ID_T *>(at(TRACK_ID));
+  for (uint64_t i = 0; i < trackCount; i++) {
+    if ((obsOffsets[i] > obsOffsets[i + 1]) || ((i > 0) && (trackIds[i - 1] >= trackIds[i]))) {
+      BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has an invalid track column";
+      return false;
+    }
+  }
+  std::unordered_map<Image_ID_T, uint64_t> kpCounts;
+  kpCounts.reserve(count(IMAGES));
+  for (uint64_t i = 0; i < count(IMAGES); i++) {
+    if (!kpCounts.emplace(images[i].image_id, images[i].kpCount).second) {
+      BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " has image " << images[i].image_id << " twice";
+      return false;
+    }
+  }
+  const auto *kpTrack = reinterpret_cast<const Track_ID_T *>(at(KP_TRACK));
+  const auto *obsImage = reinterpret_cast<const Image_ID_T *>(at(OBS_IMAGE));
+  const auto *obsKp = reinterpret_cast<const KeyPoint_ID_T *>(at(OBS_KP));
+  std::atomic<bool> valid(true);
+  parallelFor(count(KP_TRACK), [&](size_t i) {
+    if ((kpTrack[i] != std::numeric_limits<Track_ID_T>::max()) &&
+        !std::binary_search(trackIds, trackIds + trackCount, kpTrack[i])) {
+      valid = false;
+    }
+  });
+  parallelFor(count(OBS_IMAGE), [&](size_t i) {
+    auto it = kpCounts.find(obsImage[i]);
+    if ((it == kpCounts.end()) || (obsKp[i] >= it->second)) {
+      valid = false;
+    }
+  });
+  if (!valid) {
+    BOOST_LOG_TRIVIAL(warning) << "project cache " << path << " references missing tracks, images or keypoints";
+    return false;
+  }
+
+  const auto *origins = reinterpret_cast<const StringRef *>(at(ORIGINS));
+  for (uint64_t i = 0; i < count(ORIGINS); i++) {
+    if (!stringOk(origins[i].offset, origins[i].length)) {
+      return false;
+    }
+  }
+
+  for (uint64_t i = 0; i < count(ORIGINS); i++) {
+    model->origins.push_back(QString::fromUtf8(strings + origins[i].offset, static_cast<int>(origins[i].length)));
+  }
+  for (uint64_t i = 0; i < count(CAMERAS); i++) {
+    const auto &c = cameras[i];
+    model->cameras[c.camera_id] = {c.colmapCameraId, c.model_id, c.width, c.height,
+                                   std::vector<double>(cameraParams + c.paramOffset,
+                                                       cameraParams + c.paramOffset + c.paramCount)};
+  }
+
+  const auto *kpPos = reinterpret_cast<const float *>(at(KP_POS));
+  std::vector<ImageInfo *> infos(count(IMAGES));
+  for (uint64_t i = 0; i < count(IMAGES); i++) {
+    const auto &r = images[i];
+    auto &info = model->imageInfos[r.image_id];
+    info.path = QString::fromUtf8(strings + r.pathOffset, static_cast<int>(r.pathLength));
+    info.checkState = static_cast<Qt::CheckState>(r.checkState);
+    info.size = QSize(r.width, r.height);
+    info.image_id = r.image_id;
+    info.colmap.registered = r.registered != 0;
+    info.colmap.origin = r.origin;
+    info.colmap.image_id = r.colmapImageId;
+    info.colmap.camera_id = r.camera_id;
+    memcpy(info.colmap.qvec.data(), r.qvec, sizeof(r.qvec));
+    memcpy(info.colmap.tvec.data(), r.tvec, sizeof(r.tvec));
+    info.colmap.name.assign(strings + r.nameOffset, r.nameLength);
+    model->imageIndex.push_back(r.image_id);
+    infos[i] = &info;
+  }
+  parallelFor(infos.size(), [&](size_t i) {
+    const auto &r = images[i];
+    auto &kps = infos[i]->keyPoints;
+    kps.resize(r.kpCount);
+    for (uint64_t k = 0; k < r.kpCount; k++) {
+      kps[k].pos = Eigen::Vector2f(kpPos[2 * (r.kpOffset + k)], kpPos[2 * (r.kpOffset + k) + 1]);
+      kps[k].track_id = kpTrack[r.kpOffset + k];
+      kps[k].image_id = r.image_id;
+      kps[k].kp_id = static_cast<KeyPoint_ID_T>(k);
+    }
+  });
+
+  /* ids were written in map order, every insert goes to the end */
+  const auto *trackPos = reinterpret_cast<const float *>(at(TRACK_POS));
+  const auto *trackError = reinterpret_cast<const float *>(at(TRACK_ERROR));
+  const auto *trackColor = reinterpret_cast<const uint8_t *>(at(TRACK_COLOR));
+  const auto *trackOrigin = reinterpret_cast<const uint16_t *>(at(TRACK_ORIGIN));
+  for (uint64_t i = 0; i < trackCount; i++) {
+    Track tr = {
+        .pos = Eigen::Vector3f(trackPos[3 * i], trackPos[3 * i + 1], trackPos[3 * i + 2]),
+        .images = std::vector<Image_ID_T>(obsImage + obsOffsets[i], obsImage + obsOffsets[i + 1]),
+        .kps = std::vector<KeyPoint_ID_T>(obsKp + obsOffsets[i], obsKp + obsOffsets[i + 1]),
+        .error = trackError[i],
+        .track_id = trackIds[i],
+        .color = Eigen::Matrix<uint8_t, 3, 1>(trackColor[4 * i], trackColor[4 * i + 1], trackColor[4 * i + 2]),
+        .origin = trackOrigin[i]
+    };
+    model->tracks.emplace_hint(model->tracks.end(), trackIds[i], std::move(tr));
+  }
+  model->image_id_max = static_cast<Image_ID_T>(meta.imageIdMax);
+  model->track_id_max = meta.trackIdMax;
+  BOOST_LOG_TRIVIAL(info) << "project cache " << path << ": " << count(IMAGES) << " images, " << trackCount
+                          << " tracks";
+  return true;
+}
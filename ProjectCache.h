@@ -0,0 +1,36 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_PROJECTCACHE_H
+#define MATCH_MANUALLY_PROJECTCACHE_H
+
+#include <cstdint>
+#include <string>
+
+class ImageGraphModel;
+
+/*
+ * snapshot of the model in its in-memory layout, keypoints already normalized and tracks as flat observation
+ * arrays, so a project reopens without parsing colmap files. the file is a section table followed by 64 byte
+ * aligned columns, each with its own checksum, and is mmapped on read. manual edits are part of the snapshot
+ */
+class ProjectCache {
+public:
+  static const uint32_t version = 3;
+
+  /* next to the sparse model, or in the directory holding the sub-models */
+  static std::string defaultPath(const std::string &sparseDir);
+
+  /* image directory plus sizes and modification times of the colmap files of every sub-model, a cache built from
+   * other sources is not used */
+  static std::string sourceFingerprint(const std::string &sparseDir, const std::string &imageDir);
+
+  static bool write(const ImageGraphModel &model, const std::string &path, const std::string &source);
+
+  /* fills an empty model, false when the file is missing, of another version or source, or corrupt */
+  static bool read(const std::string &path, const std::string &source, ImageGraphModel *model);
+};
+
+
+#endif //MATCH_MANUALLY_PROJECTCACHE_H
@@ -0,0 +1,286 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include "Parallel.h"
+#include "ReconstructionDiff.h"
+#include "Trace.h"
+
+const ColmapLoader::image_t ReconstructionDiff::kInvalidImageId = std::numeric_limits<ColmapLoader::image_t>::max();
+
+namespace {
+const uint32_t kNoTrack = std::numeric_limits<uint32_t>::max();
+const size_t kNoImage = std::numeric_limits<size_t>::max();
+
+/*
+ * point3D id to index into points3D. colmap numbers its points densely from 1, then a table indexed by the id is
+ * the cheapest hash there is, sparse ids (edited or merged models) go through a hash map
+ */
+class PointIndex {
+public:
+  explicit PointIndex(const std::vector<ColmapLoader::Point3D> &points) {
+    ColmapLoader::point3D_t maxId = 0;
+    for (const auto &p: points) {
+      maxId = std::max(maxId, p.point3D_id);
+    }
+    if (maxId < 4 * points.size() + 1024) {
+      m_table.assign(maxId + 1, kNoTrack);
+      for (size_t i = 0; i < points.size(); i++) {
+        m_table[points[i].point3D_id] = i;
+      }
+    } else {
+      m_map.reserve(points.size());
+      for (size_t i = 0; i < points.size(); i++) {
+        m_map.emplace(points[i].point3D_id, i);
+      }
+    }
+  }
+
+  uint32_t find(ColmapLoader::point3D_t id) const {
+    if (!m_table.empty()) {
+      return id < m_table.size() ? m_table[id] : kNoTrack;
+    }
+    auto it = m_map.find(id);
+    return it == m_map.end() ? kNoTrack : it->second;
+  }
+
+private:
+  std::vector<uint32_t> m_table;
+  std::unordered_map<ColmapLoader::point3D_t, uint32_t> m_map;
+};
+
+uint32_t trackAt(const PointIndex &index, const ColmapLoader::SceneImageInfo *img, size_t point2D_idx) {
+  if ((img == nullptr) || (point2D_idx >= img->point3D_ids.size()) ||
+      (img->point3D_ids[point2D_idx] == ColmapLoader::kInvalidPoint3DId)) {
+    return kNoTrack;
+  }
+  return index.find(img->point3D_ids[point2D_idx]);
+}
+}
+
+ReconstructionDiff ReconstructionDiff::compute(const ColmapLoader &a, const ColmapLoader &b, size_t threads) {
+  TRACE_SCOPE("ReconstructionDiff::compute");
+  ReconstructionDiff result;
+  auto &s = result.summary;
+  s.imagesA = a.imagesInfo.size();
+  s.imagesB = b.imagesInfo.size();
+  s.tracksA = a.points3D.size();
+  s.tracksB = b.points3D.size();
+
+  /* images of a first, then the ones only b registered */
+  std::unordered_map<std::string, size_t> namesB;
+  namesB.reserve(b.imagesInfo.size());
+  for (size_t j = 0; j < b.imagesInfo.size(); j++) {
+    namesB.emplace(b.imagesInfo[j].name, j);
+  }
+  std::vector<size_t> srcA, srcB;
+  std::vector<bool> pairedB(b.imagesInfo.size(), false);
+  for (size_t i = 0; i < a.imagesInfo.size(); i++) {
+    auto it = namesB.find(a.imagesInfo[i].name);
+    srcA.push_back(i);
+    srcB.push_back(it == namesB.end() ? kNoImage : it->second);
+    if (it != namesB.end()) {
+      pairedB[it->second] = true;
+      s.commonImages++;
+    }
+  }
+  for (size_t j = 0; j < b.imagesInfo.size(); j++) {
+    if (!pairedB[j]) {
+      srcA.push_back(kNoImage);
+      srcB.push_back(j);
+    }
+  }
+  result.images.resize(srcA.size());
+  for (size_t k = 0; k < srcA.size(); k++) {
+    auto &img = result.images[k];
+    img.name = srcA[k] != kNoImage ? a.imagesInfo[srcA[k]].name : b.imagesInfo[srcB[k]].name;
+    img.image_idA = srcA[k] != kNoImage ? a.imagesInfo[srcA[k]].image_id : kInvalidImageId;
+    img.image_idB = srcB[k] != kNoImage ? b.imagesInfo[srcB[k]].image_id : kInvalidImageId;
+  }
+  auto imageA = [&](size_t k) { return srcA[k] != kNoImage ? &a.imagesInfo[srcA[k]] : nullptr; };
+  auto imageB = [&](size_t k) { return srcB[k] != kNoImage ? &b.imagesInfo[srcB[k]] : nullptr; };
+
+  std::unique_ptr<PointIndex> indices[2];
+  parallelFor(2, [&](size_t i) { indices[i] = std::make_unique<PointIndex>(i == 0 ? a.points3D : b.points3D); },
+              threads, 1);
+  const auto &indexA = *indices[0];
+  const auto &indexB = *indices[1];
+
+  /* every observation tracked in both models links its a track to its b track */
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> links(result.images.size());
+  parallelFor(result.images.size(), [&](size_t k) {
+    const auto *ia = imageA(k);
+    const auto *ib = imageB(k);
+    if ((ia == nullptr) || (ib == nullptr)) {
+      return;
+    }
+    const size_t n = std::min(ia->point3D_ids.size(), ib->point3D_ids.size());
+    for (size_t p = 0; p < n; p++) {
+      const uint32_t ta = trackAt(indexA, ia, p);
+      const uint32_t tb = trackAt(indexB, ib, p);
+      if ((ta != kNoTrack) && (tb != kNoTrack)) {
+        links[k].emplace_back(ta, tb);
+      }
+    }
+  }, threads);
+
+  /* b tracks per a track in csr layout, each list sorted and made unique in parallel */
+  std::vector<uint64_t> offsets(a.points3D.size() + 1, 0);
+  for (const auto &imageLinks: links) {
+    for (const auto &l: imageLinks) {
+      offsets[l.first + 1]++;
+    }
+  }
+  for (size_t t = 0; t < a.points3D.size(); t++) {
+    offsets[t + 1] += offsets[t];
+  }
+  s.sharedObservations = offsets.back();
+  std::vector<uint32_t> targets(offsets.back());
+  {
+    std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    for (auto &imageLinks: links) {
+      for (const auto &l: imageLinks) {
+        targets[fill[l.first]++] = l.second;
+      }
+      std::vector<std::pair<uint32_t, uint32_t>>().swap(imageLinks);
+    }
+  }
+  std::vector<uint32_t> targetCount(a.points3D.size(), 0);
+  parallelFor(a.points3D.size(), [&](size_t t) {
+    auto begin = targets.begin() + offsets[t];
+    auto end = targets.begin() + offsets[t + 1];
+    std::sort(begin, end);
+    targetCount[t] = std::unique(begin, end) - begin;
+  }, threads);
+
+  std::vector<uint32_t> sourceCount(b.points3D.size(), 0);
+  for (size_t t = 0; t < a.points3D.size(); t++) {
+    for (uint32_t i = 0; i < targetCount[t]; i++) {
+      sourceCount[targets[offsets[t] + i]]++;
+    }
+  }
+  std::vector<uint8_t> unchangedA(a.points3D.size(), 0);
+  for (size_t t = 0; t < a.points3D.size(); t++) {
+    s.observationsA += a.points3D[t].track.size();
+    if (targetCount[t] == 0) {
+      s.vanished++;
+    } else if (targetCount[t] > 1) {
+      s.split++;
+    } else {
+      const uint32_t tb = targets[offsets[t]];
+      if (sourceCount[tb] > 1) {
+        continue;
+      }
+      const uint64_t shared = offsets[t + 1] - offsets[t];
+      unchangedA[t] = (shared == a.points3D[t].track.size()) && (shared == b.points3D[tb].track.size());
+      unchangedA[t] ? s.unchanged++ : s.modified++;
+    }
+  }
+  for (size_t t = 0; t < b.points3D.size(); t++) {
+    s.observationsB += b.points3D[t].track.size();
+    if (sourceCount[t] == 0) {
+      s.appeared++;
+    } else if (sourceCount[t] > 1) {
+      s.merged++;
+    }
+  }
+
+  parallelFor(result.images.size(), [&](size_t k) {
+    auto &img = result.images[k];
+    const auto *ia = imageA(k);
+    const auto *ib = imageB(k);
+    img.changes.resize(std::max(ia != nullptr ? ia->point3D_ids.size() : 0,
+                                ib != nullptr ? ib->point3D_ids.size() : 0), UNTRACKED);
+    for (size_t p = 0; p < img.changes.size(); p++) {
+      const uint32_t ta = trackAt(indexA, ia, p);
+      const uint32_t tb = trackAt(indexB, ib, p);
+      Change change = UNTRACKED;
+      if ((ta != kNoTrack) && (tb != kNoTrack)) {
+        change = targetCount[ta] > 1 ? SPLIT : sourceCount[tb] > 1 ? MERGED : unchangedA[ta] ? UNCHANGED : MODIFIED;
+      } else if (ta != kNoTrack) {
+        change = targetCount[ta] == 0 ? VANISHED : DROPPED;
+      } else if (tb != kNoTrack) {
+        change = sourceCount[tb] == 0 ? APPEARED : ADDED;
+      }
+      img.changes[p] = change;
+      img.counts[change]++;
+    }
+  }, threads);
+  return result;
+}
+
+const char *ReconstructionDiff::changeName(Change change) {
+  switch (change) {
+    case UNTRACKED:
+      return "untracked";
+    case UNCHANGED:
+      return "unchanged";
+    case MODIFIED:
+      return "modified";
+    case SPLIT:
+      return "split";
+    case MERGED:
+      return "merged";
+    case APPEARED:
+      return "appeared";
+    case VANISHED:
+      return "vanished";
+    case ADDED:
+      return "added";
+    case DROPPED:
+      return "dropped";
+    default:
+      return "unknown";
+  }
+}
+
+uint32_t ReconstructionDiff::changeColor(Change change) {
+  switch (change) {
+    case UNCHANGED:
+      return 0xFF00FF00u;
+    case MODIFIED:
+      return 0xFFFFFF00u;
+    case SPLIT:
+      return 0xFF0080FFu;
+    case MERGED:
+      return 0xFFFF0000u;
+    case APPEARED:
+      return 0xFFFFFFFFu;
+    case VANISHED:
+      return 0xFF0000FFu;
+    case ADDED:
+      return 0xFF80FF80u;
+    case DROPPED:
+      return 0xFF000080u;
+    default:
+      return 0x80808080u;
+  }
+}
+
+void ReconstructionDiff::print(std::ostream &out) const {
+  const auto &s = summary;
+  out << "images                a " << s.imagesA << ", b " << s.imagesB << ", common " << s.commonImages << '\n'
+      << "tracks                a " << s.tracksA << ", b " << s.tracksB << '\n'
+      << "observations          a " << s.observationsA << ", b " << s.observationsB << ", shared "
+      << s.sharedObservations << '\n'
+      << "unchanged tracks      " << s.unchanged << '\n'
+      << "modified tracks       " << s.modified << '\n'
+      << "split tracks          " << s.split << '\n'
+      << "merged tracks         " << s.merged << '\n'
+      << "appeared tracks       " << s.appeared << '\n'
+      << "vanished tracks       " << s.vanished << '\n'
+      << "observations by change\n";
+  uint64_t counts[CHANGE_COUNT] = {};
+  for (const auto &img: images) {
+    for (int c = 0; c < CHANGE_COUNT; c++) {
+      counts[c] += img.counts[c];
+    }
+  }
+  for (int c = UNCHANGED; c < CHANGE_COUNT; c++) {
+    out << "  " << changeName(static_cast<Change>(c)) << '\t' << counts[c] << '\n';
+  }
+}
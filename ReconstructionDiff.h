@@ -0,0 +1,91 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_RECONSTRUCTIONDIFF_H
+#define MATCH_MANUALLY_RECONSTRUCTIONDIFF_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "colampParser.h"
+
+/*
+ * what changed between two reconstructions of the same image set, e.g. before and after a matcher change. images
+ * are paired by name and observations by (image, point2D index), so both models have to come from the same
+ * feature database. tracks of a and b sharing an observation correspond, a track corresponding to several tracks
+ * of the other model was split or merged. lookups, correspondence and the per image lists run in parallel
+ */
+class ReconstructionDiff {
+public:
+  /* per observation, from the point of view of the track it belongs to */
+  enum Change : uint8_t {
+    /* in no track in either model */
+    UNTRACKED,
+    /* same track with the same observations */
+    UNCHANGED,
+    /* one to one track that gained or lost observations elsewhere */
+    MODIFIED,
+    /* the a track went into several b tracks */
+    SPLIT,
+    /* the b track took observations of several a tracks */
+    MERGED,
+    /* only tracked in b, by a track without counterpart in a */
+    APPEARED,
+    /* only tracked in a, by a track without counterpart in b */
+    VANISHED,
+    /* only tracked in b, the track existed in a without this observation */
+    ADDED,
+    /* only tracked in a, the track survived in b without this observation */
+    DROPPED,
+    CHANGE_COUNT
+  };
+
+  struct Summary {
+    uint64_t imagesA = 0;
+    uint64_t imagesB = 0;
+    uint64_t commonImages = 0;
+    uint64_t tracksA = 0;
+    uint64_t tracksB = 0;
+    uint64_t observationsA = 0;
+    uint64_t observationsB = 0;
+    /* observations in a track in both models */
+    uint64_t sharedObservations = 0;
+    /* track counts, a track can both split and take part in a merge */
+    uint64_t unchanged = 0;
+    uint64_t modified = 0;
+    uint64_t split = 0;
+    uint64_t merged = 0;
+    uint64_t appeared = 0;
+    uint64_t vanished = 0;
+  };
+
+  struct ImageChanges {
+    std::string name;
+    /* kInvalidImageId when the image is registered in one model only */
+    ColmapLoader::image_t image_idA;
+    ColmapLoader::image_t image_idB;
+    /* indexed by point2D index */
+    std::vector<uint8_t> changes;
+    uint64_t counts[CHANGE_COUNT] = {};
+  };
+
+  static const ColmapLoader::image_t kInvalidImageId;
+
+  Summary summary;
+  /* images of a in their order, then the images only b has */
+  std::vector<ImageChanges> images;
+
+  /* threads 0 uses every hardware thread */
+  static ReconstructionDiff compute(const ColmapLoader &a, const ColmapLoader &b, size_t threads = 0);
+
+  static const char *changeName(Change change);
+
+  /* keypoint color (0xAABBGGRR) the renderer shows a change with */
+  static uint32_t changeColor(Change change);
+
+  void print(std::ostream &out) const;
+};
+
+
+#endif //MATCH_MANUALLY_RECONSTRUCTIONDIFF_H
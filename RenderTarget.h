@@ -0,0 +1,54 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_RENDERTARGET_H
+#define MATCH_MANUALLY_RENDERTARGET_H
+
+#include <QSize>
+#include <QVulkanInstance>
+
+/*
+ * everything VulkanRenderer needs from the thing it draws into, VulkanWindow forwards to QVulkanWindow,
+ * OffscreenTarget owns its own device and framebuffer so the renderer can run without a display
+ */
+class RenderTarget {
+public:
+  virtual ~RenderTarget() = default;
+
+  virtual QVulkanInstance *vulkanInstance() const = 0;
+
+  virtual VkPhysicalDevice physicalDevice() const = 0;
+
+  virtual const VkPhysicalDeviceProperties *physicalDeviceProperties() const = 0;
+
+  virtual VkDevice device() const = 0;
+
+  virtual VkQueue graphicsQueue() const = 0;
+
+  virtual uint32_t graphicsQueueFamilyIndex() const = 0;
+
+  virtual VkRenderPass defaultRenderPass() const = 0;
+
+  virtual VkSampleCountFlagBits sampleCountFlagBits() const = 0;
+
+  virtual QSize swapChainImageSize() const = 0;
+
+  virtual VkCommandBuffer currentCommandBuffer() const = 0;
+
+  virtual VkFramebuffer currentFramebuffer() const = 0;
+
+  virtual void frameReady() = 0;
+
+  virtual void requestUpdate() = 0;
+
+  /* only valid in preInitResources, the target may fall back to a lower supported count */
+  virtual void requestSampleCount(int sampleCount) = 0;
+
+  virtual void setCursorShape(Qt::CursorShape shape) = 0;
+
+  virtual qreal devicePixelRatio() const = 0;
+};
+
+
+#endif //MATCH_MANUALLY_RENDERTARGET_H
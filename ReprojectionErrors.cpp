@@ -0,0 +1,162 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "CameraModels.h"
+#include "Parallel.h"
+#include "ReprojectionErrors.h"
+#include "Trace.h"
+
+namespace {
+const float kNoError = std::numeric_limits<float>::quiet_NaN();
+
+/* errors[kp] for the given keypoints of one image, untouched when the image can not be projected */
+void projectKeypoints(const ImageGraphModel &model, const ImageInfo &info, const std::vector<KeyPoint_ID_T> &kps,
+                      std::vector<float> &errors) {
+  if (!info.colmap.registered || kps.empty()) {
+    return;
+  }
+  auto camera = model.cameras.find(info.colmap.camera_id);
+  if (camera == model.cameras.end()) {
+    return;
+  }
+  const auto &q = info.colmap.qvec;
+  const Eigen::Matrix3d R = Eigen::Quaterniond(q(0), q(1), q(2), q(3)).normalized().toRotationMatrix();
+  std::vector<Eigen::Vector3d> points(kps.size());
+  for (size_t i = 0; i < kps.size(); i++) {
+    const auto &kp = info.keyPoints[kps[i]];
+    auto tr = model.tracks.find(kp.track_id);
+    /* untriangulated tracks (added by hand) sit at the origin and are not projected, neither are the points of
+     * another reconstruction */
+    if ((tr == model.tracks.end()) || tr->second.pos.isZero() || (tr->second.origin != info.colmap.origin)) {
+      points[i] = Eigen::Vector3d(0, 0, -1);
+      continue;
+    }
+    points[i] = R * tr->second.pos.cast<double>() + info.colmap.tvec;
+  }
+  std::vector<Eigen::Vector2d> pixels(kps.size());
+  if (!CameraModel::project(camera->second, points.data(), pixels.data(), kps.size())) {
+    return;
+  }
+  const double width = info.size.width();
+  const double height = info.size.height();
+  for (size_t i = 0; i < kps.size(); i++) {
+    const auto &pos = info.keyPoints[kps[i]].pos;
+    errors[kps[i]] = static_cast<float>((pixels[i] - Eigen::Vector2d(pos.x() * width, pos.y() * height)).norm());
+  }
+}
+}
+
+void ReprojectionErrors::compute(const ImageGraphModel &model, size_t threads) {
+  TRACE_SCOPE("ReprojectionErrors::compute");
+  m_errors.clear();
+  std::vector<const ImageInfo *> images;
+  images.reserve(model.imageInfos.size());
+  std::vector<std::vector<float> *> errors;
+  errors.reserve(model.imageInfos.size());
+  for (const auto &it: model.imageInfos) {
+    images.push_back(&it.second);
+    errors.push_back(&m_errors[it.first]);
+  }
+  parallelFor(images.size(), [&](size_t i) {
+    const auto &info = *images[i];
+    errors[i]->assign(info.keyPoints.size(), kNoError);
+    std::vector<KeyPoint_ID_T> tracked;
+    for (const auto &kp: info.keyPoints) {
+      if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+        tracked.push_back(kp.kp_id);
+      }
+    }
+    projectKeypoints(model, info, tracked, *errors[i]);
+  }, threads);
+  updateMemoryGauge();
+}
+
+void ReprojectionErrors::updateTrack(const ImageGraphModel &model, Track_ID_T track_id) {
+  auto tr = model.tracks.find(track_id);
+  if (tr == model.tracks.end()) {
+    return;
+  }
+  for (size_t i = 0; i < tr->second.images.size(); i++) {
+    const auto &info = model.imageInfos.at(tr->second.images[i]);
+    auto &errors = m_errors[info.image_id];
+    errors.resize(info.keyPoints.size(), kNoError);
+    projectKeypoints(model, info, {tr->second.kps[i]}, errors);
+  }
+}
+
+void ReprojectionErrors::clear() {
+  m_errors.clear();
+  updateMemoryGauge();
+}
+
+void ReprojectionErrors::swap(ReprojectionErrors &other) {
+  m_errors.swap(other.m_errors);
+  updateMemoryGauge();
+  other.updateMemoryGauge();
+}
+
+float ReprojectionErrors::error(Image_ID_T image_id, KeyPoint_ID_T kp_id) const {
+  auto it = m_errors.find(image_id);
+  return (it != m_errors.end()) && (kp_id < it->second.size()) ? it->second[kp_id] : kNoError;
+}
+
+const std::vector<float> *ReprojectionErrors::imageErrors(Image_ID_T image_id) const {
+  auto it = m_errors.find(image_id);
+  return it == m_errors.end() ? nullptr : &it->second;
+}
+
+ReprojectionErrors::Summary ReprojectionErrors::summary() const {
+  Summary s;
+  std::vector<float> all;
+  for (const auto &it: m_errors) {
+    for (const auto e: it.second) {
+      if (std::isfinite(e)) {
+        all.push_back(e);
+      }
+    }
+  }
+  s.observations = all.size();
+  if (all.empty()) {
+    return s;
+  }
+  double sum = 0;
+  for (const auto e: all) {
+    sum += e;
+    s.max = std::max<double>(s.max, e);
+    s.above[0] += e > 1.f;
+    s.above[1] += e > 2.f;
+    s.above[2] += e > 4.f;
+  }
+  s.mean = sum / all.size();
+  std::nth_element(all.begin(), all.begin() + all.size() / 2, all.end());
+  s.median = all[all.size() / 2];
+  return s;
+}
+
+void ReprojectionErrors::print(std::ostream &out) const {
+  const auto s = summary();
+  out << "observations          " << s.observations << '\n'
+      << "reprojection error    mean " << s.mean << ", median " << s.median << ", max " << s.max << " px\n"
+      << "above 1 / 2 / 4 px    " << s.above[0] << " / " << s.above[1] << " / " << s.above[2] << '\n';
+}
+
+uint32_t ReprojectionErrors::errorColor(float error, float maxError) {
+  if (!std::isfinite(error)) {
+    return 0x80808080u;
+  }
+  const float t = std::min(std::max(error / maxError, 0.f), 1.f);
+  const auto r = static_cast<uint32_t>(std::min(1.f, 2 * t) * 255);
+  const auto g = static_cast<uint32_t>(std::min(1.f, 2 * (1 - t)) * 255);
+  return 0xFF000000u | (g << 8) | r;
+}
+
+void ReprojectionErrors::updateMemoryGauge() {
+  size_t bytes = 0;
+  for (const auto &it: m_errors) {
+    bytes += sizeof(it) + it.second.capacity() * sizeof(float);
+  }
+  m_memory.set(bytes);
+}
@@ -0,0 +1,64 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_REPROJECTIONERRORS_H
+#define MATCH_MANUALLY_REPROJECTIONERRORS_H
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "ImageGraphModel.h"
+#include "MemoryAccounting.h"
+
+/*
+ * pixel distance between every tracked keypoint and its track point projected with the colmap pose and camera
+ * of the image. one float per keypoint, NaN where there is nothing to project: untracked keypoints, images
+ * without pose, unknown cameras, points behind the camera and tracks that were never triangulated (pos zero).
+ * the full pass runs per image in parallel with one camera dispatch per image, edits only redo their track
+ */
+class ReprojectionErrors {
+public:
+  struct Summary {
+    uint64_t observations = 0;
+    double mean = 0;
+    double median = 0;
+    double max = 0;
+    /* observations above 1, 2 and 4 px */
+    uint64_t above[3] = {};
+  };
+
+  void compute(const ImageGraphModel &model, size_t threads = 0);
+
+  /* after the track was created, grown or merged into, only its observations are projected again */
+  void updateTrack(const ImageGraphModel &model, Track_ID_T track_id);
+
+  void clear();
+
+  /* exchanges the errors, the memory gauges follow */
+  void swap(ReprojectionErrors &other);
+
+  bool empty() const { return m_errors.empty(); }
+
+  /* NaN for keypoints without error, also for keypoints appended after the last update */
+  float error(Image_ID_T image_id, KeyPoint_ID_T kp_id) const;
+
+  /* indexed by keypoint id, nullptr for images never computed */
+  const std::vector<float> *imageErrors(Image_ID_T image_id) const;
+
+  Summary summary() const;
+
+  void print(std::ostream &out) const;
+
+  /* keypoint color (0xAABBGGRR) from green at 0 over yellow to red at maxError, gray without error */
+  static uint32_t errorColor(float error, float maxError);
+
+private:
+  std::unordered_map<Image_ID_T, std::vector<float>> m_errors;
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::MODEL, MemoryAccounting::HOST};
+
+  void updateMemoryGauge();
+};
+
+
+#endif //MATCH_MANUALLY_REPROJECTIONERRORS_H
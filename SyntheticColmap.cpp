@@ -0,0 +1,286 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+#include <sqlite3.h>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include "SyntheticColmap.h"
+#include "Trace.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+const uint64_t invalidPoint3DId = std::numeric_limits<uint64_t>::max();
+
+class BinaryFile {
+public:
+  explicit BinaryFile(const std::string &path) : m_out(path, std::ios::binary | std::ios::trunc) {}
+
+  bool good() const { return m_out.good(); }
+
+  template<typename T>
+  void put(const T &v) {
+    const char *p = reinterpret_cast<const char *>(&v);
+    m_buf.insert(m_buf.end(), p, p + sizeof(T));
+  }
+
+  void putString(const std::string &s) {
+    m_buf.insert(m_buf.end(), s.c_str(), s.c_str() + s.size() + 1);
+  }
+
+  /* keep the buffer at a few MB for 50k image sets */
+  void flush(bool force = false) {
+    if (force || (m_buf.size() > (4u << 20))) {
+      m_out.write(m_buf.data(), m_buf.size());
+      m_bytes += m_buf.size();
+      m_buf.clear();
+    }
+  }
+
+  uint64_t close() {
+    flush(true);
+    m_out.close();
+    return m_out.good() ? m_bytes : 0;
+  }
+
+private:
+  std::ofstream m_out;
+  std::vector<char> m_buf;
+  uint64_t m_bytes = 0;
+};
+}
+
+bool writeSyntheticColmap(const std::string &dir, const SyntheticColmapOptions &options,
+                          SyntheticColmapSummary *summary) {
+  TRACE_SCOPE("writeSyntheticColmap");
+  if ((options.images == 0) || (options.trackLengthMin < 2) || (options.trackLengthMax < options.trackLengthMin)) {
+    BOOST_LOG_TRIVIAL(error) << "invalid synthetic model options";
+    return false;
+  }
+  boost::system::error_code ec;
+  fs::create_directories(dir, ec);
+
+  std::mt19937_64 rng(options.seed);
+  std::vector<double> lengthWeights;
+  for (uint32_t len = options.trackLengthMin; len <= options.trackLengthMax; len++) {
+    lengthWeights.push_back(std::pow(options.trackLengthDecay, len - options.trackLengthMin));
+  }
+  std::discrete_distribution<uint32_t> lengthDist(lengthWeights.begin(), lengthWeights.end());
+
+  /* tracked keypoints take the first slots of every image, tracks pick distinct images with free slots */
+  const auto trackedPerImage = static_cast<uint32_t>(
+          std::min(1.0, std::max(0.0, options.trackedFraction)) * options.keypointsPerImage);
+  std::vector<std::vector<uint64_t>> point3DIds(options.images);
+  std::vector<uint32_t> freeSlot(options.images, 0);
+  std::vector<uint32_t> open;
+  if (trackedPerImage > 0) {
+    open.resize(options.images);
+    for (uint32_t i = 0; i < options.images; i++) {
+      open[i] = i;
+    }
+  }
+  for (auto &ids: point3DIds) {
+    ids.assign(options.keypointsPerImage, invalidPoint3DId);
+  }
+
+  std::vector<uint64_t> trackOffsets = {0};
+  std::vector<std::pair<uint32_t, uint32_t>> trackObservations;
+  std::vector<uint32_t> picked;
+  while (open.size() >= 2) {
+    const uint32_t len = std::min<uint32_t>(options.trackLengthMin + lengthDist(rng), open.size());
+    picked.clear();
+    while (picked.size() < len) {
+      const uint32_t slot = std::uniform_int_distribution<uint32_t>(0, open.size() - 1)(rng);
+      if (std::find(picked.begin(), picked.end(), slot) == picked.end()) {
+        picked.push_back(slot);
+      }
+    }
+    const uint64_t point3D_id = trackOffsets.size();
+    for (auto slot: picked) {
+      const uint32_t image = open[slot];
+      const uint32_t kp = freeSlot[image]++;
+      point3DIds[image][kp] = point3D_id;
+      trackObservations.emplace_back(image + 1, kp);
+    }
+    trackOffsets.push_back(trackObservations.size());
+    /* drop full images, highest slot first so the swaps do not move another picked slot */
+    std::sort(picked.begin(), picked.end(), std::greater<>());
+    for (auto slot: picked) {
+      if (freeSlot[open[slot]] == trackedPerImage) {
+        open[slot] = open.back();
+        open.pop_back();
+      }
+    }
+  }
+
+  std::uniform_real_distribution<double> unit(0., 1.);
+  uint64_t bytes = 0;
+
+  BinaryFile cameras(dir + "/cameras.bin");
+  cameras.put<uint64_t>(1);
+  cameras.put<uint32_t>(1);
+  cameras.put<int>(1); // PINHOLE
+  cameras.put<uint64_t>(options.width);
+  cameras.put<uint64_t>(options.height);
+  const double focal = 1.2 * std::max(options.width, options.height);
+  for (double param: {focal, focal, options.width / 2., options.height / 2.}) {
+    cameras.put(param);
+  }
+  bytes += cameras.close();
+
+  BinaryFile images(dir + "/images.bin");
+  images.put<uint64_t>(options.images);
+  char name[32];
+  for (uint32_t i = 0; i < options.images; i++) {
+    images.put<uint32_t>(i + 1);
+    for (double q: {1., 0., 0., 0.}) {
+      images.put(q);
+    }
+    for (int k = 0; k < 3; k++) {
+      images.put(unit(rng) * 10.);
+    }
+    images.put<uint32_t>(1);
+    snprintf(name, sizeof(name), "img%06u.jpg", i + 1);
+    images.putString(name);
+    images.put<uint64_t>(options.keypointsPerImage);
+    for (uint32_t kp = 0; kp < options.keypointsPerImage; kp++) {
+      images.put(unit(rng) * options.width);
+      images.put(unit(rng) * options.height);
+      images.put(point3DIds[i][kp]);
+    }
+    images.flush();
+    std::vector<uint64_t>().swap(point3DIds[i]);
+  }
+  bytes += images.close();
+
+  BinaryFile points(dir + "/points3D.bin");
+  const uint64_t numPoints = trackOffsets.size() - 1;
+  points.put(numPoints);
+  for (uint64_t p = 0; p < numPoints; p++) {
+    points.put<uint64_t>(p + 1);
+    for (int k = 0; k < 3; k++) {
+      points.put(unit(rng) * 100. - 50.);
+    }
+    for (int k = 0; k < 3; k++) {
+      points.put(static_cast<uint8_t>(rng()));
+    }
+    points.put(unit(rng) * 2.);
+    points.put<uint64_t>(trackOffsets[p + 1] - trackOffsets[p]);
+    for (uint64_t o = trackOffsets[p]; o < trackOffsets[p + 1]; o++) {
+      points.put(trackObservations[o].first);
+      points.put(trackObservations[o].second);
+    }
+    points.flush();
+  }
+  bytes += points.close();
+
+  if (!cameras.good() || !images.good() || !points.good() || (bytes == 0)) {
+    BOOST_LOG_TRIVIAL(error) << "unable to write synthetic model to " << dir;
+    return false;
+  }
+  if (summary) {
+    summary->points3D = numPoints;
+    summary->observations = trackObservations.size();
+    summary->bytes = bytes;
+  }
+  return true;
+}
+
+bool writeSyntheticDatabase(const std::string &path, const ColmapLoader &model,
+                            const std::vector<ColmapDatabase::PairMatches> &matches) {
+  TRACE_SCOPE("writeSyntheticDatabase");
+  sqlite3 *db = nullptr;
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "unable to create " << path;
+    sqlite3_close(db);
+    return false;
+  }
+  std::unique_ptr<sqlite3, int (*)(sqlite3 *)> dbGuard(db, sqlite3_close);
+  const char *schema =
+      "CREATE TABLE cameras(camera_id INTEGER PRIMARY KEY, model INTEGER, width INTEGER, height INTEGER, "
+      "params BLOB, prior_focal_length INTEGER);"
+      "CREATE TABLE images(image_id INTEGER PRIMARY KEY, name TEXT UNIQUE, camera_id INTEGER);"
+      "CREATE TABLE keypoints(image_id INTEGER PRIMARY KEY, rows INTEGER, cols INTEGER, data BLOB);"
+      "CREATE TABLE descriptors(image_id INTEGER PRIMARY KEY, rows INTEGER, cols INTEGER, data BLOB);"
+      "CREATE TABLE matches(pair_id INTEGER PRIMARY KEY, rows INTEGER, cols INTEGER, data BLOB);"
+      "CREATE TABLE two_view_geometries(pair_id INTEGER PRIMARY KEY, rows INTEGER, cols INTEGER, data BLOB, "
+      "config INTEGER, F BLOB, E BLOB, H BLOB, qvec BLOB, tvec BLOB);";
+  if (sqlite3_exec(db, schema, nullptr, nullptr, nullptr) != SQLITE_OK) {
+    BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db);
+    return false;
+  }
+  bool ok = true;
+  auto insert = [&](const char *sql, const std::function<void(sqlite3_stmt *)> &bind) {
+    sqlite3_stmt *stmt = nullptr;
+    ok = ok && (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK);
+    if (ok) {
+      bind(stmt);
+      ok = sqlite3_step(stmt) == SQLITE_DONE;
+    }
+    sqlite3_finalize(stmt);
+  };
+  sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+  for (const auto &camera: model.camerasInfo) {
+    insert("INSERT INTO cameras VALUES(?, ?, ?, ?, ?, 0)", [&](sqlite3_stmt *stmt) {
+      sqlite3_bind_int64(stmt, 1, camera.camera_id);
+      sqlite3_bind_int(stmt, 2, camera.model_id);
+      sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(camera.width));
+      sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(camera.height));
+      sqlite3_bind_blob(stmt, 5, camera.params.data(), static_cast<int>(camera.params.size() * sizeof(double)),
+                        SQLITE_TRANSIENT);
+    });
+  }
+  for (const auto &image: model.imagesInfo) {
+    std::vector<float> keypoints;
+    for (const auto &point: image.points2D) {
+      keypoints.insert(keypoints.end(), {static_cast<float>(point.x()), static_cast<float>(point.y()), 1, 0, 0, 1});
+    }
+    const std::vector<uint8_t> descriptors(image.points2D.size() * 128, 0);
+    const auto rows = static_cast<int>(image.points2D.size());
+    insert("INSERT INTO images VALUES(?, ?, ?)", [&](sqlite3_stmt *stmt) {
+      sqlite3_bind_int64(stmt, 1, image.image_id);
+      sqlite3_bind_text(stmt, 2, image.name.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int64(stmt, 3, image.camera_id);
+    });
+    insert("INSERT INTO keypoints VALUES(?, ?, 6, ?)", [&](sqlite3_stmt *stmt) {
+      sqlite3_bind_int64(stmt, 1, image.image_id);
+      sqlite3_bind_int(stmt, 2, rows);
+      sqlite3_bind_blob(stmt, 3, keypoints.data(), static_cast<int>(keypoints.size() * sizeof(float)),
+                        SQLITE_TRANSIENT);
+    });
+    insert("INSERT INTO descriptors VALUES(?, ?, 128, ?)", [&](sqlite3_stmt *stmt) {
+      sqlite3_bind_int64(stmt, 1, image.image_id);
+      sqlite3_bind_int(stmt, 2, rows);
+      sqlite3_bind_blob(stmt, 3, descriptors.data(), static_cast<int>(descriptors.size()), SQLITE_TRANSIENT);
+    });
+  }
+  std::vector<uint32_t> data;
+  for (const auto &pair: matches) {
+    /* colmap keeps the columns in ascending image id order */
+    const bool swapped = pair.image_id1 > pair.image_id2;
+    data.clear();
+    for (const auto &m: pair.matches) {
+      data.insert(data.end(), {swapped ? m.second : m.first, swapped ? m.first : m.second});
+    }
+    insert("INSERT INTO matches VALUES(?, ?, 2, ?)", [&](sqlite3_stmt *stmt) {
+      const auto pairId = ColmapDatabase::pairId(pair.image_id1, pair.image_id2);
+      sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(pairId));
+      sqlite3_bind_int(stmt, 2, static_cast<int>(pair.matches.size()));
+      sqlite3_bind_blob(stmt, 3, data.data(), static_cast<int>(data.size() * sizeof(uint32_t)), SQLITE_TRANSIENT);
+    });
+  }
+  if (!ok || (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK)) {
+    BOOST_LOG_TRIVIAL(error) << "database: " << sqlite3_errmsg(db);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,47 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_SYNTHETICCOLMAP_H
+#define MATCH_MANUALLY_SYNTHETICCOLMAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ColmapDatabase.h"
+#include "colampParser.h"
+
+/*
+ * writes cameras.bin, images.bin and points3D.bin of a random but consistent reconstruction, used by the
+ * benchmarks. track lengths follow P(len) ~ trackLengthDecay^(len - trackLengthMin) in [min, max]
+ */
+struct SyntheticColmapOptions {
+  uint32_t images = 1000;
+  uint32_t keypointsPerImage = 2000;
+  /* share of the keypoints that observe a 3d point */
+  double trackedFraction = 0.5;
+  uint32_t trackLengthMin = 2;
+  uint32_t trackLengthMax = 20;
+  double trackLengthDecay = 0.7;
+  uint32_t width = 4000;
+  uint32_t height = 3000;
+  uint64_t seed = 1;
+};
+
+struct SyntheticColmapSummary {
+  uint64_t points3D = 0;
+  uint64_t observations = 0;
+  uint64_t bytes = 0;
+};
+
+bool writeSyntheticColmap(const std::string &dir, const SyntheticColmapOptions &options,
+                          SyntheticColmapSummary *summary = nullptr);
+
+/*
+ * new database.db with the cameras and images of the model, its points2D as keypoints with zero descriptors and
+ * matches as raw matches, keypoint ids are point2D indices. the schema is the part of colmap's the reader uses
+ */
+bool writeSyntheticDatabase(const std::string &path, const ColmapLoader &model,
+                            const std::vector<ColmapDatabase::PairMatches> &matches = {});
+
+#endif //MATCH_MANUALLY_SYNTHETICCOLMAP_H
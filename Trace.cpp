@@ -0,0 +1,153 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+#include "Trace.h"
+
+std::atomic<bool> Trace::s_enabled(false);
+
+namespace {
+/* keeps a forgotten trace from eating all memory, about 24MB per thread */
+const size_t maxEventsPerThread = 1u << 20;
+
+struct TraceEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t duration;
+};
+
+struct ThreadBuffer {
+  uint32_t tid;
+  std::mutex mutex; /* only contended while a dump runs */
+  std::vector<TraceEvent> events;
+  size_t dropped = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry() {
+  static Registry r;
+  return r;
+}
+
+const std::chrono::steady_clock::time_point &epoch() {
+  static const auto start = std::chrono::steady_clock::now();
+  return start;
+}
+
+ThreadBuffer &threadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    buffer->tid = static_cast<uint32_t>(r.buffers.size() + 1);
+    r.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void writeJsonString(std::ostream &out, const char *s) {
+  out << '"';
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      out << '\\';
+    }
+    out << *s;
+  }
+  out << '"';
+}
+
+/* MATCH_TRACE=<file> records the whole session */
+struct EnvTrace {
+  std::string path;
+
+  EnvTrace() {
+    registry();
+    epoch();
+    const char *env = std::getenv("MATCH_TRACE");
+    if (env && *env) {
+      path = env;
+      Trace::setEnabled(true);
+    }
+  }
+
+  ~EnvTrace() {
+    if (!path.empty()) {
+      Trace::writeChromeJson(path);
+    }
+  }
+} envTrace;
+}
+
+void Trace::setEnabled(bool enable) {
+  s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Trace::clear() {
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto &buffer: r.buffers) {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    buffer->events.clear();
+    buffer->dropped = 0;
+  }
+}
+
+uint64_t Trace::now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch()).count();
+}
+
+void Trace::record(const char *name, uint64_t begin, uint64_t end) {
+  auto &buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.size() < maxEventsPerThread) {
+    buffer.events.push_back({name, begin, end - begin});
+  } else {
+    buffer.dropped++;
+  }
+}
+
+bool Trace::writeChromeJson(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    BOOST_LOG_TRIVIAL(warning) << "unable to write trace file " << path;
+    return false;
+  }
+  const auto pid = getpid();
+  size_t count = 0;
+  size_t dropped = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto &buffer: r.buffers) {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    for (const auto &event: buffer->events) {
+      out << (count++ ? ",\n" : "\n") << "{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"cat\":\"match\",\"ph\":\"X\",\"ts\":" << event.begin << ",\"dur\":" << event.duration
+          << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid << '}';
+    }
+    dropped += buffer->dropped;
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out) {
+    BOOST_LOG_TRIVIAL(warning) << "unable to write trace file " << path;
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "wrote " << count << " trace events to " << path
+                          << (dropped ? ", buffers were full, some events dropped" : "");
+  return true;
+}
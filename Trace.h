@@ -0,0 +1,65 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_TRACE_H
+#define MATCH_MANUALLY_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * session tracing in chrome trace format (chrome://tracing, ui.perfetto.dev). every thread appends
+ * complete events into its own buffer, a disabled scope costs one relaxed atomic load.
+ * set MATCH_TRACE=<file> to record from startup and write the file at exit
+ */
+class Trace {
+public:
+  class Scope {
+  public:
+    explicit Scope(const char *name) : m_name(enabled() ? name : nullptr) {
+      if (m_name) {
+        m_start = now();
+      }
+    }
+
+    ~Scope() {
+      if (m_name) {
+        record(m_name, m_start, now());
+      }
+    }
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *m_name;
+    uint64_t m_start = 0;
+  };
+
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  static void setEnabled(bool enable);
+
+  /* drop all recorded events */
+  static void clear();
+
+  static bool writeChromeJson(const std::string &path);
+
+  /* microseconds since process start */
+  static uint64_t now();
+
+  /* name must outlive the trace, string literals only */
+  static void record(const char *name, uint64_t begin, uint64_t end);
+
+private:
+  static std::atomic<bool> s_enabled;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif //MATCH_MANUALLY_TRACE_H
@@ -0,0 +1,92 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include "TrackStatistics.h"
+#include "Trace.h"
+
+TrackStatistics TrackStatistics::compute(const ImageGraphModel &model, size_t maxHistogramLength) {
+  TRACE_SCOPE("TrackStatistics::compute");
+  TrackStatistics stats;
+  stats.imageCount = model.imageInfos.size();
+  stats.trackCount = model.tracks.size();
+  stats.trackLengthHistogram.assign(maxHistogramLength + 1, 0);
+
+  std::unordered_map<Image_ID_T, size_t> imageObservations;
+  for (const auto &it: model.imageInfos) {
+    stats.keypointCount += it.second.keyPoints.size();
+    for (const auto &kp: it.second.keyPoints) {
+      if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+        stats.trackedKeypointCount++;
+      }
+    }
+    imageObservations[it.first] = 0;
+  }
+
+  std::vector<float> errors;
+  errors.reserve(model.tracks.size());
+  std::vector<Image_ID_T> images;
+  for (const auto &it: model.tracks) {
+    const auto &tr = it.second;
+    stats.observationCount += tr.images.size();
+    stats.trackLengthHistogram[std::min(tr.images.size(), maxHistogramLength)]++;
+    errors.push_back(tr.error);
+
+    for (size_t i = 0; i < tr.images.size(); i++) {
+      auto imgIt = model.imageInfos.find(tr.images[i]);
+      if ((imgIt == model.imageInfos.end()) || (tr.kps[i] >= imgIt->second.keyPoints.size()) ||
+          (imgIt->second.keyPoints[tr.kps[i]].track_id != tr.track_id)) {
+        stats.brokenObservationCount++;
+        continue;
+      }
+      imageObservations[tr.images[i]]++;
+    }
+
+    images = tr.images;
+    std::sort(images.begin(), images.end());
+    if (std::adjacent_find(images.begin(), images.end()) != images.end()) {
+      stats.duplicateImageTrackCount++;
+    }
+  }
+
+  if (stats.trackCount > 0) {
+    stats.meanTrackLength = static_cast<double>(stats.observationCount) / stats.trackCount;
+    double errorSum = 0;
+    for (auto e: errors) {
+      errorSum += e;
+    }
+    stats.meanTrackError = errorSum / errors.size();
+    std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+    stats.medianTrackError = errors[errors.size() / 2];
+  }
+  if (!imageObservations.empty()) {
+    auto minmax = std::minmax_element(imageObservations.begin(), imageObservations.end(),
+                                      [](const auto &a, const auto &b) { return a.second < b.second; });
+    stats.minImageObservations = minmax.first->second;
+    stats.maxImageObservations = minmax.second->second;
+  }
+  return stats;
+}
+
+void TrackStatistics::print(std::ostream &out) const {
+  out << "images                " << imageCount << '\n'
+      << "keypoints             " << keypointCount << " (" << trackedKeypointCount << " in tracks)\n"
+      << "tracks                " << trackCount << '\n'
+      << "observations          " << observationCount << '\n'
+      << "mean track length     " << meanTrackLength << '\n'
+      << "track error mean      " << meanTrackError << ", median " << medianTrackError << '\n'
+      << "observations / image  " << minImageObservations << " .. " << maxImageObservations << '\n'
+      << "broken observations   " << brokenObservationCount << '\n'
+      << "duplicate image track " << duplicateImageTrackCount << '\n'
+      << "track length histogram\n";
+  for (size_t len = 0; len < trackLengthHistogram.size(); len++) {
+    if (trackLengthHistogram[len] == 0) {
+      continue;
+    }
+    out << "  " << (len + 1 == trackLengthHistogram.size() ? ">=" : "") << len << '\t' << trackLengthHistogram[len]
+        << '\n';
+  }
+}
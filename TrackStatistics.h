@@ -0,0 +1,36 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_TRACKSTATISTICS_H
+#define MATCH_MANUALLY_TRACKSTATISTICS_H
+
+#include <ostream>
+#include <vector>
+#include "ImageGraphModel.h"
+
+struct TrackStatistics {
+  size_t imageCount = 0;
+  size_t keypointCount = 0;
+  size_t trackedKeypointCount = 0;
+  size_t trackCount = 0;
+  size_t observationCount = 0;
+  /* observations whose keypoint does not exist or points to another track */
+  size_t brokenObservationCount = 0;
+  /* tracks seeing the same image more than once */
+  size_t duplicateImageTrackCount = 0;
+  double meanTrackLength = 0;
+  double meanTrackError = 0;
+  double medianTrackError = 0;
+  size_t minImageObservations = 0;
+  size_t maxImageObservations = 0;
+  /* index is the track length, the last bucket collects longer tracks */
+  std::vector<size_t> trackLengthHistogram;
+
+  static TrackStatistics compute(const ImageGraphModel &model, size_t maxHistogramLength = 16);
+
+  void print(std::ostream &out) const;
+};
+
+
+#endif //MATCH_MANUALLY_TRACKSTATISTICS_H
@@ -0,0 +1,164 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "Parallel.h"
+#include "Trace.h"
+#include "TrackSuggestions.h"
+
+namespace {
+/* px distance from p to a polyline, all in pixels */
+float polylineDistance(const std::vector<Eigen::Vector2f> &polyline, const Eigen::Vector2f &p) {
+  float best = std::numeric_limits<float>::max();
+  for (size_t i = 0; i + 1 < polyline.size(); i++) {
+    const Eigen::Vector2f d = polyline[i + 1] - polyline[i];
+    const Eigen::Vector2f q = p - polyline[i];
+    const float len2 = d.squaredNorm();
+    const float t = len2 > 0.f ? std::min(std::max(q.dot(d) / len2, 0.f), 1.f) : 0.f;
+    best = std::min(best, (q - t * d).squaredNorm());
+  }
+  return std::sqrt(best);
+}
+}
+
+void TrackSuggestions::keypointsChanged(Image_ID_T image_id) {
+  m_indices.erase(image_id);
+}
+
+void TrackSuggestions::clear() {
+  m_indices.clear();
+  m_epipolar.clear();
+}
+
+std::vector<TrackSuggestions::Suggestion> TrackSuggestions::suggest(const ImageGraphModel &model,
+                                                                    const GrayPyramids &pyramids,
+                                                                    Track_ID_T track_id,
+                                                                    const std::vector<Image_ID_T> &images,
+                                                                    size_t threads) {
+  TRACE_SCOPE("TrackSuggestions::suggest");
+  std::vector<Suggestion> result;
+  auto tr = model.tracks.find(track_id);
+  if (tr == model.tracks.end()) {
+    return result;
+  }
+  const auto &track = tr->second;
+  std::vector<Image_ID_T> trackImages = track.images;
+  std::sort(trackImages.begin(), trackImages.end());
+  auto observes = [&](Image_ID_T image_id) {
+    return std::binary_search(trackImages.begin(), trackImages.end(), image_id);
+  };
+
+  std::vector<std::vector<float>> references;
+  std::vector<float> buffer;
+  for (size_t i = 0; i < track.images.size(); i++) {
+    if (pyramids.patch(track.images[i], model.imageInfos.at(track.images[i]).keyPoints[track.kps[i]].pos,
+                       options.patchRadius, buffer)) {
+      references.push_back(buffer);
+    }
+  }
+
+  /* the epipolar cache and the index map are not thread safe, curves and stale indices are done up front */
+  struct Target {
+    Image_ID_T image_id;
+    std::vector<std::vector<Eigen::Vector2f>> curves;
+    bool rebuild = false;
+  };
+  std::vector<Target> targets;
+  std::vector<Eigen::Vector2f> polyline;
+  for (const auto image_id: images) {
+    if (observes(image_id) || (model.imageInfos.count(image_id) == 0)) {
+      continue;
+    }
+    Target target{.image_id = image_id, .curves = {}};
+    for (size_t i = 0; i < track.images.size(); i++) {
+      const auto &pos = model.imageInfos.at(track.images[i]).keyPoints[track.kps[i]].pos;
+      if (m_epipolar.line(model, track.images[i], pos, image_id, &polyline)) {
+        target.curves.push_back(polyline);
+      }
+    }
+    if (target.curves.empty()) {
+      continue;
+    }
+    target.rebuild = m_indices.count(image_id) == 0;
+    m_indices[image_id];
+    targets.push_back(std::move(target));
+  }
+
+  std::vector<std::vector<Suggestion>> perTarget(targets.size());
+  parallelFor(targets.size(), [&](size_t t) {
+    auto &target = targets[t];
+    const auto &info = model.imageInfos.at(target.image_id);
+    auto &index = m_indices.at(target.image_id);
+    if (target.rebuild) {
+      index.build(info.keyPoints);
+    }
+    const Eigen::Vector2f size(info.size.width(), info.size.height());
+    if (size.minCoeff() <= 0.f) {
+      return;
+    }
+    /* the index works in normalized coordinates, the radius covers maxDistance along the shorter side */
+    const float radius = options.maxDistance / size.minCoeff();
+    std::vector<KeyPoint_ID_T> candidates, found;
+    const auto &first = target.curves.front();
+    for (size_t i = 0; i + 1 < first.size(); i++) {
+      index.segmentSearch(first[i], first[i + 1], radius, found);
+      candidates.insert(candidates.end(), found.begin(), found.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (auto &curve: target.curves) {
+      for (auto &p: curve) {
+        p = p.cwiseProduct(size);
+      }
+    }
+    auto &out = perTarget[t];
+    std::vector<float> candidatePatch;
+    for (const auto kp_id: candidates) {
+      const auto &kp = info.keyPoints[kp_id];
+      /* merging a track that shares an image with this one is refused by the model */
+      if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+        auto other = model.tracks.find(kp.track_id);
+        if ((other != model.tracks.end()) &&
+            std::any_of(other->second.images.begin(), other->second.images.end(), observes)) {
+          continue;
+        }
+      }
+      const Eigen::Vector2f pixel = kp.pos.cwiseProduct(size);
+      float distance = 0.f;
+      for (const auto &curve: target.curves) {
+        distance = std::max(distance, polylineDistance(curve, pixel));
+      }
+      if (distance > options.maxDistance) {
+        continue;
+      }
+      float ncc = 0.f;
+      if (!references.empty() && pyramids.patch(target.image_id, kp.pos, options.patchRadius, candidatePatch)) {
+        ncc = -1.f;
+        for (const auto &reference: references) {
+          float dot = 0.f;
+          for (size_t i = 0; i < reference.size(); i++) {
+            dot += reference[i] * candidatePatch[i];
+          }
+          ncc = std::max(ncc, dot);
+        }
+      }
+      out.push_back({.image_id = target.image_id, .kp_id = kp_id, .rank = 0, .distance = distance, .ncc = ncc,
+                     .score = ncc - distance / options.maxDistance});
+    }
+    std::sort(out.begin(), out.end(), [](const Suggestion &a, const Suggestion &b) { return a.score > b.score; });
+    if (out.size() > options.perImage) {
+      out.resize(options.perImage);
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+      out[i].rank = i;
+    }
+  }, threads);
+
+  for (const auto &out: perTarget) {
+    result.insert(result.end(), out.begin(), out.end());
+  }
+  return result;
+}
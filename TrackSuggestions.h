@@ -0,0 +1,63 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_TRACKSUGGESTIONS_H
+#define MATCH_MANUALLY_TRACKSUGGESTIONS_H
+
+#include <unordered_map>
+#include <vector>
+#include "EpipolarGeometry.h"
+#include "GrayPyramids.h"
+#include "ImageGraphModel.h"
+#include "KeypointIndex.h"
+
+/*
+ * keypoints that may extend a track. in every image the track does not observe yet, the keypoints near the
+ * epipolar curve of its first observation are gathered from a KeypointIndex of the image, kept when they are
+ * close to the curves of all observations and ranked by that distance and by the normalized cross correlation
+ * of their level 0 patch with the patches of the observations. images are scored in parallel, indices are
+ * built once per image
+ */
+class TrackSuggestions {
+public:
+  struct Options {
+    /* px from the epipolar curve of every observation */
+    float maxDistance = 3.f;
+    /* patches are (2 r + 1)^2 pixels around the keypoint */
+    int patchRadius = 7;
+    size_t perImage = 3;
+  };
+
+  struct Suggestion {
+    Image_ID_T image_id;
+    KeyPoint_ID_T kp_id;
+    /* 0 for the best candidate of its image */
+    uint32_t rank;
+    /* largest px distance to the epipolar curves of the observations */
+    float distance;
+    /* best correlation with an observation patch, 0 when there are no pixels to compare */
+    float ncc;
+    float score;
+  };
+
+  Options options;
+
+  /* keypoints were appended to the image or moved, its index is rebuilt on the next suggest */
+  void keypointsChanged(Image_ID_T image_id);
+
+  /* poses, keypoints or images changed */
+  void clear();
+
+  /* grouped by image in the order of images, best first within an image. images without pixels are only
+   * ranked by the epipolar distance */
+  std::vector<Suggestion> suggest(const ImageGraphModel &model, const GrayPyramids &pyramids, Track_ID_T track_id,
+                                  const std::vector<Image_ID_T> &images, size_t threads = 0);
+
+private:
+  std::unordered_map<Image_ID_T, KeypointIndex> m_indices;
+  EpipolarGeometry m_epipolar;
+};
+
+
+#endif //MATCH_MANUALLY_TRACKSUGGESTIONS_H
@@ -0,0 +1,55 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include "Trace.h"
+#include "TrackTriangulator.h"
+
+TrackTriangulator::TrackTriangulator(ImageGraphModel *model, QObject *parent) : QObject(parent), m_model(model) {
+  connect(m_model, &ImageGraphModel::trackChanged, this, &TrackTriangulator::trackChanged);
+  connect(m_model, &ImageGraphModel::modelReset, this, [this]() { m_pending.clear(); });
+}
+
+TrackTriangulator::~TrackTriangulator() {
+  /* queued results posted to this object are discarded with it */
+  m_pool.waitForDone();
+}
+
+void TrackTriangulator::trackChanged(Track_ID_T track_id) {
+  TRACE_SCOPE("TrackTriangulator::trackChanged");
+  if (!m_enabled) {
+    return;
+  }
+  auto tr = m_model->tracks.find(track_id);
+  if (tr == m_model->tracks.end()) {
+    return;
+  }
+  std::vector<Triangulation::View> views;
+  Triangulation::trackViews(*m_model, tr->second, views);
+  const uint64_t generation = ++m_generation;
+  m_pending[track_id] = generation;
+  const Triangulation solver = triangulation;
+  m_pool.start([this, solver, views = std::move(views), track_id, generation]() {
+    const auto result = solver.triangulate(views);
+    QMetaObject::invokeMethod(this, [this, track_id, generation, result]() { apply(track_id, generation, result); },
+                              Qt::QueuedConnection);
+  });
+}
+
+void TrackTriangulator::apply(Track_ID_T track_id, uint64_t generation, const Triangulation::Result &result) {
+  auto it = m_pending.find(track_id);
+  if ((it == m_pending.end()) || (it->second != generation)) {
+    return;
+  }
+  m_pending.erase(it);
+  if (m_model->tracks.count(track_id) == 0) {
+    return;
+  }
+  m_model->setTrackPoint(track_id, result.pos.cast<float>(), result.error);
+}
+
+size_t TrackTriangulator::triangulateAll(size_t threads) {
+  m_pool.waitForDone();
+  m_pending.clear();
+  return triangulation.triangulateAll(*m_model, threads);
+}
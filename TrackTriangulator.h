@@ -0,0 +1,53 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_TRACKTRIANGULATOR_H
+#define MATCH_MANUALLY_TRACKTRIANGULATOR_H
+
+#include <unordered_map>
+#include <QObject>
+#include <QThreadPool>
+#include "Triangulation.h"
+
+/*
+ * keeps the 3d points of edited tracks up to date. every trackChanged gathers the views of the track on the gui
+ * thread (a few undistorted points), solves them on an own thread pool and writes pos and error back on the gui
+ * thread through ImageGraphModel::setTrackPoint. results of a track that changed again in the meantime, or that
+ * was merged away or reset, are dropped
+ */
+class TrackTriangulator : public QObject {
+Q_OBJECT
+public:
+  explicit TrackTriangulator(ImageGraphModel *model, QObject *parent = nullptr);
+
+  ~TrackTriangulator() override;
+
+  Triangulation triangulation;
+
+  /* off leaves edited tracks where they are, as before */
+  void setEnabled(bool enable) { m_enabled = enable; }
+
+  /* blocks, every track in parallel, pending single track results are dropped. returns the triangulated count */
+  size_t triangulateAll(size_t threads = 0);
+
+  /* waits for the queued tracks, their results still arrive through the event loop */
+  void waitForDone() { m_pool.waitForDone(); }
+
+public slots:
+
+  void trackChanged(Track_ID_T track_id);
+
+private:
+  ImageGraphModel *m_model;
+  bool m_enabled = true;
+  QThreadPool m_pool;
+  /* generation of the newest job per track, older results are stale */
+  std::unordered_map<Track_ID_T, uint64_t> m_pending;
+  uint64_t m_generation = 0;
+
+  void apply(Track_ID_T track_id, uint64_t generation, const Triangulation::Result &result);
+};
+
+
+#endif //MATCH_MANUALLY_TRACKTRIANGULATOR_H
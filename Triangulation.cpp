@@ -0,0 +1,256 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#include <atomic>
+#include <cmath>
+#include "CameraModels.h"
+#include "MemoryAccounting.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include "Triangulation.h"
+
+namespace {
+/* pose and camera of a registered image, false without pose or with an unknown camera */
+bool imageView(const ImageGraphModel &model, const ImageInfo &info, Triangulation::View *view,
+               const ColmapLoader::SceneCameraInfo **camera) {
+  if (!info.colmap.registered) {
+    return false;
+  }
+  auto it = model.cameras.find(info.colmap.camera_id);
+  if (it == model.cameras.end()) {
+    return false;
+  }
+  double focal = 0;
+  if (!CameraModel::visit(it->second, [&](const auto &cameraModel) {
+    focal = (cameraModel.fx + cameraModel.fy) / 2;
+  })) {
+    return false;
+  }
+  const auto &q = info.colmap.qvec;
+  const Eigen::Matrix3d R = Eigen::Quaterniond(q(0), q(1), q(2), q(3)).normalized().toRotationMatrix();
+  view->P.leftCols<3>() = R;
+  view->P.col(3) = info.colmap.tvec;
+  view->center = -R.transpose() * info.colmap.tvec;
+  view->focal = focal;
+  *camera = &it->second;
+  return true;
+}
+
+Eigen::Vector2d keypointPixel(const ImageInfo &info, KeyPoint_ID_T kp_id) {
+  const auto &pos = info.keyPoints[kp_id].pos;
+  return Eigen::Vector2d(pos.x() * info.size.width(), pos.y() * info.size.height());
+}
+
+/* sum of squared px residuals, infinite when the point is behind one of the cameras */
+double squaredError(const std::vector<Triangulation::View> &views, const Eigen::Vector3d &X) {
+  double sum = 0;
+  for (const auto &v: views) {
+    const Eigen::Vector3d p = v.P * X.homogeneous();
+    if (p.z() <= 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+    sum += (v.focal * (p.head<2>() / p.z() - v.point)).squaredNorm();
+  }
+  return sum;
+}
+}
+
+void Triangulation::trackViews(const ImageGraphModel &model, const Track &track, std::vector<View> &views,
+                               std::vector<size_t> *observations) {
+  views.clear();
+  if (observations != nullptr) {
+    observations->clear();
+  }
+  for (size_t i = 0; i < track.images.size(); i++) {
+    const auto &info = model.imageInfos.at(track.images[i]);
+    View view;
+    const ColmapLoader::SceneCameraInfo *camera = nullptr;
+    if ((info.colmap.origin != track.origin) || !imageView(model, info, &view, &camera)) {
+      continue;
+    }
+    const Eigen::Vector2d pixel = keypointPixel(info, track.kps[i]);
+    CameraModel::undistort(*camera, &pixel, &view.point, 1);
+    views.push_back(view);
+    if (observations != nullptr) {
+      observations->push_back(i);
+    }
+  }
+}
+
+std::vector<Triangulation::ImageViews> Triangulation::imageViews(const ImageGraphModel &model, size_t threads,
+                                                                 uint64_t *bytes) {
+  TRACE_SCOPE("Triangulation::imageViews");
+  if (model.imageInfos.empty()) {
+    return {};
+  }
+  std::vector<ImageViews> images(model.imageInfos.rbegin()->first + 1);
+  std::vector<const ImageInfo *> infos;
+  infos.reserve(model.imageInfos.size());
+  for (const auto &it: model.imageInfos) {
+    infos.push_back(&it.second);
+  }
+  parallelFor(infos.size(), [&](size_t i) {
+    const auto &info = *infos[i];
+    auto &image = images[info.image_id];
+    image.origin = info.colmap.origin;
+    const ColmapLoader::SceneCameraInfo *camera = nullptr;
+    if (!imageView(model, info, &image.view, &camera)) {
+      return;
+    }
+    std::vector<KeyPoint_ID_T> tracked;
+    std::vector<Eigen::Vector2d> pixels;
+    for (const auto &kp: info.keyPoints) {
+      if (kp.track_id != std::numeric_limits<Track_ID_T>::max()) {
+        tracked.push_back(kp.kp_id);
+        pixels.push_back(keypointPixel(info, kp.kp_id));
+      }
+    }
+    std::vector<Eigen::Vector2d> normalized(pixels.size());
+    if (!CameraModel::undistort(*camera, pixels.data(), normalized.data(), pixels.size())) {
+      return;
+    }
+    image.points.assign(info.keyPoints.size(), Eigen::Vector2f::Constant(std::numeric_limits<float>::quiet_NaN()));
+    for (size_t k = 0; k < tracked.size(); k++) {
+      image.points[tracked[k]] = normalized[k].cast<float>();
+    }
+    image.valid = true;
+  }, threads);
+  if (bytes != nullptr) {
+    *bytes = images.size() * sizeof(ImageViews);
+    for (const auto &image: images) {
+      *bytes += image.points.capacity() * sizeof(Eigen::Vector2f);
+    }
+  }
+  return images;
+}
+
+void Triangulation::trackViews(const std::vector<ImageViews> &images, const Track &track, std::vector<View> &views,
+                               std::vector<size_t> *observations) {
+  views.clear();
+  if (observations != nullptr) {
+    observations->clear();
+  }
+  for (size_t i = 0; i < track.images.size(); i++) {
+    if ((track.images[i] >= images.size()) || !images[track.images[i]].valid ||
+        (images[track.images[i]].origin != track.origin)) {
+      continue;
+    }
+    const auto &image = images[track.images[i]];
+    views.push_back(image.view);
+    views.back().point = image.points[track.kps[i]].cast<double>();
+    if (observations != nullptr) {
+      observations->push_back(i);
+    }
+  }
+}
+
+Triangulation::Result Triangulation::triangulate(const std::vector<View> &views) const {
+  Result result;
+  if (views.size() < std::max<size_t>(options.minViews, 2)) {
+    return result;
+  }
+
+  /* rows x P3 - P1 and y P3 - P2 of every view scaled to unit length, their normal matrix is all the DLT needs */
+  Eigen::Matrix4d A = Eigen::Matrix4d::Zero();
+  for (const auto &v: views) {
+    const Eigen::RowVector4d r1 = v.point.x() * v.P.row(2) - v.P.row(0);
+    const Eigen::RowVector4d r2 = v.point.y() * v.P.row(2) - v.P.row(1);
+    A.noalias() += r1.transpose() * r1 / r1.squaredNorm();
+    A.noalias() += r2.transpose() * r2 / r2.squaredNorm();
+  }
+  /* minimum of [X 1] A [X 1]^T, a 3x3 solve instead of the eigen decomposition, points at infinity fail below */
+  const Eigen::LDLT<Eigen::Matrix3d> ldlt(A.topLeftCorner<3, 3>());
+  if (ldlt.info() != Eigen::Success) {
+    return result;
+  }
+  Eigen::Vector3d X = ldlt.solve(-A.topRightCorner<3, 1>());
+  double cost = squaredError(views, X);
+  if (!std::isfinite(cost)) {
+    return result;
+  }
+
+  /* residuals in px so cameras with different focal lengths weigh alike, steps that do not help end the loop */
+  for (int iteration = 0; iteration < options.iterations; iteration++) {
+    Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d g = Eigen::Vector3d::Zero();
+    for (const auto &v: views) {
+      const Eigen::Vector3d p = v.P * X.homogeneous();
+      const double iz = 1 / p.z();
+      const Eigen::Vector2d r = v.focal * (p.head<2>() * iz - v.point);
+      Eigen::Matrix<double, 2, 3> dp;
+      dp << iz, 0, -p.x() * iz * iz,
+              0, iz, -p.y() * iz * iz;
+      const Eigen::Matrix<double, 2, 3> J = v.focal * dp * v.P.leftCols<3>();
+      H.noalias() += J.transpose() * J;
+      g.noalias() += J.transpose() * r;
+    }
+    const Eigen::Vector3d step = H.ldlt().solve(-g);
+    const Eigen::Vector3d next = X + step;
+    const double nextCost = squaredError(views, next);
+    if (!(nextCost < cost)) {
+      break;
+    }
+    X = next;
+    cost = nextCost;
+    if (step.squaredNorm() < 1e-12 * X.squaredNorm()) {
+      break;
+    }
+  }
+
+  const double minCos = std::cos(options.minAngle * EIGEN_PI / 180);
+  bool wide = false;
+  for (size_t i = 0; (i < views.size()) && !wide; i++) {
+    const Eigen::Vector3d ri = (X - views[i].center).normalized();
+    for (size_t j = i + 1; j < views.size(); j++) {
+      if (ri.dot((X - views[j].center).normalized()) < minCos) {
+        wide = true;
+        break;
+      }
+    }
+  }
+  if (!wide) {
+    return result;
+  }
+
+  double error = 0;
+  for (const auto &v: views) {
+    const Eigen::Vector3d p = v.P * X.homogeneous();
+    error += v.focal * (p.head<2>() / p.z() - v.point).norm();
+  }
+  result.valid = true;
+  result.pos = X;
+  result.error = static_cast<float>(error / views.size());
+  return result;
+}
+
+size_t Triangulation::triangulateAll(ImageGraphModel &model, size_t threads) const {
+  TRACE_SCOPE("Triangulation::triangulateAll");
+  if (model.imageInfos.empty()) {
+    return 0;
+  }
+
+  uint64_t bytes = 0;
+  const auto images = imageViews(model, threads, &bytes);
+  MemoryAccounting::Gauge memory(MemoryAccounting::MODEL, MemoryAccounting::HOST);
+  memory.set(bytes);
+
+  std::vector<Track *> tracks;
+  tracks.reserve(model.tracks.size());
+  for (auto &it: model.tracks) {
+    tracks.push_back(&it.second);
+  }
+  std::atomic<size_t> triangulated(0);
+  parallelFor(tracks.size(), [&](size_t i) {
+    auto &track = *tracks[i];
+    thread_local std::vector<View> views;
+    trackViews(images, track, views);
+    const auto result = triangulate(views);
+    track.pos = result.pos.cast<float>();
+    track.error = result.error;
+    if (result.valid) {
+      triangulated.fetch_add(1, std::memory_order_relaxed);
+    }
+  }, threads);
+  return triangulated;
+}
@@ -0,0 +1,79 @@
+//
+// Created by lucius on 10/19/26.
+//
+
+#ifndef MATCH_MANUALLY_TRIANGULATION_H
+#define MATCH_MANUALLY_TRIANGULATION_H
+
+#include <vector>
+#include "ImageGraphModel.h"
+
+/*
+ * 3d point of a track from the colmap poses and cameras of its registered observations: linear multi-view DLT on
+ * the undistorted normalized coordinates, then a few Gauss-Newton iterations on the reprojection error in pixels.
+ * the DLT accumulates its 4x4 normal matrix so long tracks cost no more memory than short ones. the full pass
+ * undistorts the keypoints image by image with one camera dispatch each, then solves the tracks in parallel
+ */
+class Triangulation {
+public:
+  struct Options {
+    /* registered observations needed */
+    size_t minViews = 2;
+    /* degrees, the largest angle between two viewing rays, below it the depth is unreliable */
+    double minAngle = 1.0;
+    int iterations = 5;
+  };
+
+  /* one observation: world to camera projection, undistorted normalized point and px per normalized unit */
+  struct View {
+    Eigen::Matrix<double, 3, 4> P;
+    Eigen::Vector3d center;
+    Eigen::Vector2d point;
+    double focal;
+  };
+
+  struct Result {
+    bool valid = false;
+    Eigen::Vector3d pos = Eigen::Vector3d::Zero();
+    /* mean reprojection error in px of the undistorted images, as Track::error */
+    float error = 0.f;
+  };
+
+  /* normalized coordinates of the tracked keypoints of a registered image by keypoint id, NaN for the others */
+  struct ImageViews {
+    bool valid = false;
+    /* ImageInfo::colmap.origin */
+    uint16_t origin = 0;
+    View view;
+    std::vector<Eigen::Vector2f> points;
+  };
+
+  Options options;
+
+  /*
+   * the registered observations of the track with a known camera, in track order. images of another reconstruction
+   * than the track are skipped, their poses are in an unrelated frame. observations gets the index in the track of
+   * every view
+   */
+  static void trackViews(const ImageGraphModel &model, const Track &track, std::vector<View> &views,
+                         std::vector<size_t> *observations = nullptr);
+
+  /* indexed by image id, one camera dispatch per image and the images in parallel. bytes gets their host memory */
+  static std::vector<ImageViews> imageViews(const ImageGraphModel &model, size_t threads = 0,
+                                            uint64_t *bytes = nullptr);
+
+  /* as above from the images of imageViews */
+  static void trackViews(const std::vector<ImageViews> &images, const Track &track, std::vector<View> &views,
+                         std::vector<size_t> *observations = nullptr);
+
+  Result triangulate(const std::vector<View> &views) const;
+
+  /*
+   * every track of the model, tracks that can not be triangulated are reset to pos zero as tracks added by hand.
+   * returns the number of triangulated tracks
+   */
+  size_t triangulateAll(ImageGraphModel &model, size_t threads = 0) const;
+};
+
+
+#endif //MATCH_MANUALLY_TRIANGULATION_H
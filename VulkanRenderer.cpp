@@ -2,14 +2,25 @@
 // Created by lucius on 1/24/21.
 //
 
+#include <future>
 #include <QVulkanFunctions>
 #include <QWheelEvent>
 #include <QMouseEvent>
+#include <QKeyEvent>
 #include <QMenu>
 #include <QGraphicsPixmapItem>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QPainter>
+#include <QFontDatabase>
 #include "graphwidget.h"
 #include "VulkanRenderer.h"
 #include "ImageGraphModel.h"
+#include "Trace.h"
 
 static const float quadVert[] = {
         0, 0,
@@ -20,30 +31,78 @@ static const float quadVert[] = {
 
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof((arr)[0]))
 
-VulkanRenderer::VulkanRenderer(VulkanWindow *vulkanWindow, ImageGraphModel *graphModel, GraphWidget *graphicsScene) :
-        m_window(vulkanWindow), m_graphModel(graphModel), m_trackScene(graphicsScene) {
+static const uint32_t pipelineCacheMagic = 0x4D4D5043u; // "CPMM"
+static const uint32_t pipelineCacheVersion = 1;
+
+/* written in front of the vkGetPipelineCacheData blob, the driver validates its own header as well,
+ * but we do not want to hand data of a different driver version to it at all */
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+} __attribute__((packed));
+
+VulkanRenderer::VulkanRenderer(RenderTarget *target, ImageGraphModel *graphModel, GraphWidget *graphicsScene) :
+        m_target(target), m_graphModel(graphModel), m_trackScene(graphicsScene) {
   sceneInfo.proj.setIdentity();
   sceneInfo.pointSize = 10.f;
+  /* runs in the gui thread, the only one that sets gray images */
+  grayEvictionCallback = MemoryAccounting::instance().addEvictionCallback(
+          MemoryAccounting::TRACK_PATCHES, [this](uint64_t, uint64_t) {
+            for (const auto image_id: grayImages.images()) {
+              if (!MemoryAccounting::instance().overBudget(MemoryAccounting::TRACK_PATCHES, MemoryAccounting::HOST)) {
+                break;
+              }
+              if (texIdMap.count(image_id) == 0) {
+                grayImages.removeImage(image_id);
+              }
+            }
+          });
 
   actionMenu = new QMenu;
   auto *addTrackAction = actionMenu->addAction("add track");
   connect(addTrackAction, &QAction::triggered, this, &VulkanRenderer::addTrackForKeypoint);
 
   if (m_graphModel) {
-    connect(m_graphModel, &ImageGraphModel::dataChanged, this, &VulkanRenderer::dataChanged);
-    connect(m_graphModel, &ImageGraphModel::keyPointsInserted, this, &VulkanRenderer::updateImageKeypoints);
+    connectModel();
   }
 }
 
-//VulkanRenderer::~VulkanRenderer()
-//{
-//}
+void VulkanRenderer::connectModel() {
+  connect(m_graphModel, &ImageGraphModel::dataChanged, this, &VulkanRenderer::dataChanged);
+  connect(m_graphModel, &ImageGraphModel::keyPointsInserted, this, &VulkanRenderer::updateImageKeypoints);
+  connect(m_graphModel, &ImageGraphModel::trackChanged, this, &VulkanRenderer::trackChanged);
+  connect(m_graphModel, &ImageGraphModel::trackPointChanged, this, &VulkanRenderer::updateOutliers);
+  connect(m_graphModel, &ImageGraphModel::modelReset, this, [this]() {
+    epipolar.clear();
+    suggestions.clear();
+    grayImages.clear();
+    suggestionColors.clear();
+    suggested.clear();
+    outlierReview.clear();
+    reviewedKeypoint = std::numeric_limits<uint64_t>::max();
+    prefetchedImages.clear();
+    reviewPrefetchGeneration++;
+    reviewScoringGeneration++;
+    reviewScoring = false;
+    reviewStaleTracks.clear();
+  });
+}
+
+VulkanRenderer::~VulkanRenderer() {
+  /* queued results posted to this object are discarded with it */
+  reviewPool.waitForDone();
+  MemoryAccounting::instance().removeEvictionCallback(grayEvictionCallback);
+}
 
 void VulkanRenderer::preInitResources() {
-  Q_ASSERT(m_window->supportedSampleCounts().contains(8));
-  m_window->setSampleCount(8);
+  m_target->requestSampleCount(8);
   VkFormatProperties formatProperties;
-  m_window->vulkanInstance()->functions()->vkGetPhysicalDeviceFormatProperties(m_window->physicalDevice(), VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+  m_target->vulkanInstance()->functions()->vkGetPhysicalDeviceFormatProperties(m_target->physicalDevice(), VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
   qDebug() << formatProperties.bufferFeatures;
   assert(formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT);
 }
@@ -51,23 +110,39 @@ void VulkanRenderer::preInitResources() {
 void VulkanRenderer::initResources() {
   qDebug("initResources");
 
-  dev = m_window->device();
-  m_devFuncs = m_window->vulkanInstance()->deviceFunctions(dev);
+  dev = m_target->device();
+  m_devFuncs = m_target->vulkanInstance()->deviceFunctions(dev);
 
   createStageCommandBuffer();
   createBuffers();
   createSampler();
   createDescriptorSets();
+  createPipelineCache();
   createPipelineLayouts();
 
   createSelRenderPass();
 
   createPipelines();
+
+  createQueryPool();
 }
 
 void VulkanRenderer::releaseResources() {
   qDebug("releaseResources");
 
+  m_devFuncs->vkDeviceWaitIdle(dev);
+  if (overlayTex.image != VK_NULL_HANDLE) {
+    m_devFuncs->vkDestroyImageView(dev, overlayTex.imageView, nullptr);
+    m_devFuncs->vkDestroyImage(dev, overlayTex.image, nullptr);
+    freeMemory(overlayTex.memory);
+    overlayTex = {-1, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+  }
+  if (queryPool != VK_NULL_HANDLE) {
+    m_devFuncs->vkDestroyQueryPool(dev, queryPool, nullptr);
+    queryPool = VK_NULL_HANDLE;
+  }
+
+  savePipelineCache();
   m_devFuncs->vkDestroyPipelineCache(dev, pipelineCache, nullptr);
   pipelineCache = VK_NULL_HANDLE;
   m_devFuncs->vkDestroyDescriptorPool(dev, descriptorPool, nullptr);
@@ -75,8 +150,8 @@ void VulkanRenderer::releaseResources() {
 }
 
 void VulkanRenderer::initSwapChainResources() {
-  sceneInfo.windowSize.x() = m_window->swapChainImageSize().width();
-  sceneInfo.windowSize.y() = m_window->swapChainImageSize().height();
+  sceneInfo.windowSize.x() = m_target->swapChainImageSize().width();
+  sceneInfo.windowSize.y() = m_target->swapChainImageSize().height();
   createSelAttachment();
 }
 
@@ -85,8 +160,10 @@ void VulkanRenderer::releaseSwapChainResources() {
 }
 
 void VulkanRenderer::startNextFrame() {
-  const QSize sz = m_window->swapChainImageSize();
-  assert(m_window->sampleCountFlagBits() > VK_SAMPLE_COUNT_1_BIT);
+  profiler.nextFrame();
+  FrameProfiler::ScopedTimer frameTimer(profiler, FrameProfiler::CPU_FRAME);
+  const QSize sz = m_target->swapChainImageSize();
+  assert(m_target->sampleCountFlagBits() > VK_SAMPLE_COUNT_1_BIT);
   VkClearValue clearValues[] = {
           {
                   .color = {.float32 = {1., 1., 1., 1.}}
@@ -98,12 +175,22 @@ void VulkanRenderer::startNextFrame() {
                   .color = {.float32 = {1., 1., 1., 1.}}
           }
   };
-  VkCommandBuffer cb = m_window->currentCommandBuffer();
+  VkCommandBuffer cb = m_target->currentCommandBuffer();
+  const uint32_t querySlot = profiler.frame() % frameQuerySlots;
+  const uint32_t firstQuery = stageQueryCount + querySlot * frameQueryCount;
+  if (queryPool != VK_NULL_HANDLE) {
+    collectFrameTimestamps(querySlot);
+    m_devFuncs->vkCmdResetQueryPool(cb, queryPool, firstQuery, frameQueryCount);
+  }
+  if (profilerOverlayVisible && (profiler.frame() >= overlayFrame + 30 || overlayTex.image == VK_NULL_HANDLE)) {
+    updateOverlay();
+  }
+
   VkRenderPassBeginInfo renderPassBeginInfo = {
           .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
           .pNext = nullptr,
-          .renderPass = m_window->defaultRenderPass(),
-          .framebuffer = m_window->currentFramebuffer(),
+          .renderPass = m_target->defaultRenderPass(),
+          .framebuffer = m_target->currentFramebuffer(),
           .renderArea = {
                   .offset = {
                           .x = 0,
@@ -133,6 +220,7 @@ void VulkanRenderer::startNextFrame() {
   scissor.extent.height = viewport.height;
   m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
 
+  writeTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, firstQuery);
   if (!texIdMap.empty()) {
     updateResources();
 
@@ -146,34 +234,50 @@ void VulkanRenderer::startNextFrame() {
     m_devFuncs->vkCmdPushConstants(cb, imageMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(sceneInfo),
                                    &sceneInfo);
     m_devFuncs->vkCmdDraw(cb, 4, texIdMap.size(), 0, 0);
+    writeTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 1);
 
-    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, kpMaterial.pipeline);
-    /* share inst buf, do not update, here we only change binding 0*/
-    VkDeviceSize kpVertOffsets = 0;
+    if (keypointsVisible) {
+      m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, kpMaterial.pipeline);
+      /* share inst buf, do not update, here we only change binding 0*/
+      VkDeviceSize kpVertOffsets = 0;
 //    imageVertBuffs[0] = kpMaterial.vert.buffer;
-    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &kpMaterial.vert.buffer, &kpVertOffsets);
+      m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &kpMaterial.vert.buffer, &kpVertOffsets);
 //    m_devFuncs->vkCmdPushConstants(cb, kpMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(sceneInfo), &sceneInfo);
-    m_devFuncs->vkCmdDrawIndirect(cb, kpMaterial.indirectDrawBuf.buffer, 0, texDatas.size(),
-                                  sizeof(VkDrawIndirectCommand));
+      m_devFuncs->vkCmdDrawIndirect(cb, kpMaterial.indirectDrawBuf.buffer, 0, texDatas.size(),
+                                    sizeof(VkDrawIndirectCommand));
+    }
+    writeTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 2);
+
+    if (lineVertexCount > 0) {
+      m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, lineMaterial.pipeline);
+      VkDeviceSize lineVertOffset = 0;
+      m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &lineMaterial.vert.buffer, &lineVertOffset);
+      m_devFuncs->vkCmdPushConstants(cb, lineMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                     sizeof(sceneInfo), &sceneInfo);
+      m_devFuncs->vkCmdDraw(cb, lineVertexCount, 1, 0, 0);
+    }
+  } else {
+    writeTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 1);
+    writeTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 2);
+  }
+  writeTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 3);
+  if (queryPool != VK_NULL_HANDLE) {
+    frameQueryWritten[querySlot] = true;
   }
 
-  if (!lines.empty()) {
-    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, lineMaterial.pipeline);
-    VkDeviceSize lineVertOffset = 0;
-    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &lineMaterial.vert.buffer, &lineVertOffset);
-    m_devFuncs->vkCmdPushConstants(cb, kpMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(sceneInfo),
-                                   &sceneInfo);
-    m_devFuncs->vkCmdDraw(cb, 0, 0, 0, 0);
+  if (profilerOverlayVisible && overlayTex.image != VK_NULL_HANDLE) {
+    drawOverlay(cb);
   }
 
   m_devFuncs->vkCmdEndRenderPass(cb);
-  m_window->frameReady();
+  m_target->frameReady();
 }
 
 void VulkanRenderer::updateResources() {
-  memcpy(instBufPtr, texExtraInfos.data(), sizeof(texExtraInfos[0]) * texExtraInfos.size());
-
+  TRACE_SCOPE("VulkanRenderer::updateResources");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_UPDATE_RESOURCES);
   if (imageChange) {
+    releaseRemovedImages();
     std::vector<VkDescriptorImageInfo> descriptorImageInfos;
     descriptorImageInfos.reserve(texIdMap.size());
     for (const auto &it : texIdMap) {
@@ -199,6 +303,18 @@ void VulkanRenderer::updateResources() {
     imageChange = false;
   }
 
+  memcpy(instBufPtr, texExtraInfos.data(), sizeof(texExtraInfos[0]) * texExtraInfos.size());
+
+  if (lineChange) {
+    updateLineVertices();
+    if (lineVertexCount > 0) {
+      beginStageCommandBuffer();
+      copyBuffer(lineMaterial.vert.buffer, lineMaterial.vertStage.buffer, lineVertexCount * sizeof(LineInfo));
+      flushStageCommandBuffer();
+    }
+    lineChange = false;
+  }
+
   if (vertexChange) {
     beginStageCommandBuffer();
     VkDeviceSize total_vertex = 0;
@@ -213,6 +329,54 @@ void VulkanRenderer::updateResources() {
   }
 }
 
+void VulkanRenderer::updateLineVertices() {
+  lineVertexCount = 0;
+  /* segments come in long runs of the same image pair, only look the textures up when the pair changes */
+  Image_ID_T lastImages[2] = {std::numeric_limits<Image_ID_T>::max(), std::numeric_limits<Image_ID_T>::max()};
+  const textureExtraInfo *extraInfos[2] = {nullptr, nullptr};
+  /* epipolar lines go last, they are the first to be cut when the vertex buffer is full */
+  for (const auto *segments: {&lines, &epipolarLines}) {
+    for (const auto &seg: *segments) {
+      for (int i = 0; i < 2; i++) {
+        if (seg.image_ids[i] != lastImages[i]) {
+          lastImages[i] = seg.image_ids[i];
+          auto it = texIdMap.find(seg.image_ids[i]);
+          extraInfos[i] = it == texIdMap.end() ? nullptr : &texExtraInfos[it->second];
+        }
+      }
+      if ((extraInfos[0] == nullptr) || (extraInfos[1] == nullptr)) {
+        continue;
+      }
+      if (lineVertexCount + 2 > MAX_LINE_VERTEX_NUM) {
+        qWarning("too many lines, only %d vertices are drawn", MAX_LINE_VERTEX_NUM);
+        return;
+      }
+      for (int i = 0; i < 2; i++) {
+        const auto &extraInfo = *extraInfos[i];
+        LineInfo &li = lineMaterial.vertStagePtr[lineVertexCount++];
+        li.mat = extraInfo.mat;
+        li.color = seg.color;
+        li.depth = extraInfo.depth;
+        li.pos = seg.pos[i];
+        li.width = extraInfo.width;
+        li.height = extraInfo.height;
+      }
+    }
+  }
+}
+
+/* the descriptor set and removed textures may still be used by frames in flight, image changes are rare
+ * enough that waiting for the device here is cheaper than tracking per frame ownership */
+void VulkanRenderer::releaseRemovedImages() {
+  m_devFuncs->vkDeviceWaitIdle(dev);
+  for (const auto &tex: tex2remove) {
+    m_devFuncs->vkDestroyImageView(dev, tex.imageView, nullptr);
+    m_devFuncs->vkDestroyImage(dev, tex.image, nullptr);
+    freeMemory(tex.memory);
+  }
+  tex2remove.clear();
+}
+
 VkShaderModule VulkanRenderer::loadShader(const QString &filename) {
   QFile file(filename);
   if (!file.open(QIODevice::ReadOnly)) {
@@ -238,7 +402,7 @@ VkShaderModule VulkanRenderer::loadShader(const QString &filename) {
 
 uint32_t VulkanRenderer::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) {
   VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-  m_window->vulkanInstance()->functions()->vkGetPhysicalDeviceMemoryProperties(m_window->physicalDevice(),
+  m_target->vulkanInstance()->functions()->vkGetPhysicalDeviceMemoryProperties(m_target->physicalDevice(),
                                                                                &physicalDeviceMemoryProperties);
   for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++) {
     if ((typeBits & 1) == 1) {
@@ -251,6 +415,36 @@ uint32_t VulkanRenderer::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags
   qFatal("can not find proper memory type");
 }
 
+VkResult VulkanRenderer::allocateMemory(const VkMemoryAllocateInfo *info, VkDeviceMemory *memory,
+                                        MemoryAccounting::Subsystem subsystem) {
+  VkResult res = m_devFuncs->vkAllocateMemory(dev, info, nullptr, memory);
+  if (res == VK_SUCCESS) {
+    deviceAllocations[*memory] = {subsystem, info->allocationSize};
+    MemoryAccounting::instance().add(subsystem, MemoryAccounting::DEVICE, info->allocationSize);
+  }
+  return res;
+}
+
+void VulkanRenderer::freeMemory(VkDeviceMemory memory) {
+  auto it = deviceAllocations.find(memory);
+  if (it != deviceAllocations.end()) {
+    MemoryAccounting::instance().add(it->second.first, MemoryAccounting::DEVICE,
+                                     -static_cast<int64_t>(it->second.second));
+    deviceAllocations.erase(it);
+  }
+  m_devFuncs->vkFreeMemory(dev, memory, nullptr);
+}
+
+void VulkanRenderer::updateHostMirrorGauge() {
+  uint64_t colorBytes = 0;
+  for (const auto &it: keypointColors) {
+    colorBytes += it.second.capacity() * sizeof(uint32_t);
+  }
+  hostMirrorMemory.set(vas.capacity() * sizeof(VertexAttribute) +
+                       indirectDrawCmds.capacity() * sizeof(VkDrawIndirectCommand) +
+                       (lines.capacity() + epipolarLines.capacity()) * sizeof(LineSegment) + colorBytes);
+}
+
 VkFormat VulkanRenderer::getSupportedDepthFormat() {
   // Since all depth formats may be optional, we need to find a suitable depth format to use
   // Start with the highest precision packed format
@@ -264,7 +458,7 @@ VkFormat VulkanRenderer::getSupportedDepthFormat() {
 
   for (auto &format : depthFormats) {
     VkFormatProperties formatProps;
-    m_window->vulkanInstance()->functions()->vkGetPhysicalDeviceFormatProperties(m_window->physicalDevice(), format,
+    m_target->vulkanInstance()->functions()->vkGetPhysicalDeviceFormatProperties(m_target->physicalDevice(), format,
                                                                                  &formatProps);
     // Format must support depth stencil attachment for optimal tiling
     if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
@@ -303,7 +497,7 @@ VulkanRenderer::BufferData VulkanRenderer::createBuffer(uint32_t len, VkBufferUs
           .memoryTypeIndex = getMemoryType(memoryRequirements.memoryTypeBits, memProp)
   };
   VkDeviceMemory memory;
-  if (m_devFuncs->vkAllocateMemory(dev, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS) {
+  if (allocateMemory(&memoryAllocateInfo, &memory, MemoryAccounting::RENDERER_BUFFERS) != VK_SUCCESS) {
     qFatal("can not allocate memory");
   }
   if (m_devFuncs->vkBindBufferMemory(dev, buffer, memory, 0) != VK_SUCCESS) {
@@ -369,7 +563,9 @@ VulkanRenderer::createImage(const QSize &sz, VkFormat format, VkImageTiling tili
   memoryAllocateInfo.memoryTypeIndex = getMemoryType(memoryRequirements.memoryTypeBits, memProp);
   memoryAllocateInfo.allocationSize = memoryRequirements.size;
   VkDeviceMemory memory;
-  if (m_devFuncs->vkAllocateMemory(dev, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS) {
+  const auto subsystem = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+                         ? MemoryAccounting::RENDERER_ATTACHMENTS : MemoryAccounting::RENDERER_TEXTURES;
+  if (allocateMemory(&memoryAllocateInfo, &memory, subsystem) != VK_SUCCESS) {
     qFatal("can not allocate memory");
   }
   if (m_devFuncs->vkBindImageMemory(dev, image, memory, 0) != VK_SUCCESS) {
@@ -465,8 +661,8 @@ void VulkanRenderer::uploadImage(VkCommandBuffer cb, VkImage dstImage, VkImage s
           .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
           .oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED,
           .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-          .srcQueueFamilyIndex = m_window->graphicsQueueFamilyIndex(),
-          .dstQueueFamilyIndex = m_window->graphicsQueueFamilyIndex(),
+          .srcQueueFamilyIndex = m_target->graphicsQueueFamilyIndex(),
+          .dstQueueFamilyIndex = m_target->graphicsQueueFamilyIndex(),
           .image = srcImage,
           .subresourceRange = {
                   .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -546,8 +742,8 @@ void VulkanRenderer::downloadImage(VkCommandBuffer cb, VkImage dstImage, VkImage
           .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
           .oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED,
           .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-          .srcQueueFamilyIndex = m_window->graphicsQueueFamilyIndex(),
-          .dstQueueFamilyIndex = m_window->graphicsQueueFamilyIndex(),
+          .srcQueueFamilyIndex = m_target->graphicsQueueFamilyIndex(),
+          .dstQueueFamilyIndex = m_target->graphicsQueueFamilyIndex(),
           .image = srcImage,
           .subresourceRange = {
                   .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -631,9 +827,15 @@ void VulkanRenderer::beginStageCommandBuffer() {
   if (m_devFuncs->vkBeginCommandBuffer(stageCB, &commandBufferBeginInfo) != VK_SUCCESS) {
     qFatal("can not begine command buffer");
   }
+  if (queryPool != VK_NULL_HANDLE) {
+    m_devFuncs->vkCmdResetQueryPool(stageCB, queryPool, 0, stageQueryCount);
+    writeTimestamp(stageCB, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+  }
 }
 
 void VulkanRenderer::flushStageCommandBuffer() {
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_STAGE_FLUSH);
+  writeTimestamp(stageCB, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
   m_devFuncs->vkEndCommandBuffer(stageCB);
 
   VkSubmitInfo submitInfo = {
@@ -647,7 +849,7 @@ void VulkanRenderer::flushStageCommandBuffer() {
           .signalSemaphoreCount = 0,
           .pSignalSemaphores = nullptr
   };
-  if (m_devFuncs->vkQueueSubmit(m_window->graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
+  if (m_devFuncs->vkQueueSubmit(m_target->graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
     qFatal("can not submit command");
   }
   VkResult res = m_devFuncs->vkWaitForFences(dev, 1, &fence, false, UINT64_MAX);
@@ -655,10 +857,18 @@ void VulkanRenderer::flushStageCommandBuffer() {
     qDebug() << "wait for fence failed" << res;
     qFatal("wait for fence failed");
   }
+
+  uint64_t timestamps[stageQueryCount];
+  if ((queryPool != VK_NULL_HANDLE) &&
+      (m_devFuncs->vkGetQueryPoolResults(dev, queryPool, 0, stageQueryCount, sizeof(timestamps), timestamps,
+                                         sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)) {
+    profiler.record(stageGpuPhase, timestampDelta(timestamps[0], timestamps[1]));
+  }
+  stageGpuPhase = FrameProfiler::GPU_STAGE_COPY;
 }
 
 void VulkanRenderer::createSelAttachment() {
-  const QSize sz = m_window->swapChainImageSize();
+  const QSize sz = m_target->swapChainImageSize();
 
   objSelectPass.pixeBuf = createBuffer(4 * sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true);
   objSelectPass.color = createImage(sz, select_image_format, VK_IMAGE_TILING_OPTIMAL,
@@ -717,8 +927,10 @@ void VulkanRenderer::modifySelKpColor()
     if(texIdMap.count(tr.images[i])){
       uint32_t tex_id = texIdMap.at(tr.images[i]);
       VkDeviceSize kp_offset = indirectDrawCmds[tex_id].firstVertex;
-      vas[kp_offset + tr.kps[i]].rgba = 0xFF0000FFu;
-      kpMaterial.vertStagePtr[kp_offset + tr.kps[i]].rgba = 0xFF0000FFu;
+      /* the observation under review stays blue among the red ones of its track */
+      const bool reviewed = ((static_cast<uint64_t>(tr.images[i]) << 32) | tr.kps[i]) == reviewedKeypoint;
+      vas[kp_offset + tr.kps[i]].rgba = reviewed ? 0xFFFF0000u : 0xFF0000FFu;
+      kpMaterial.vertStagePtr[kp_offset + tr.kps[i]].rgba = vas[kp_offset + tr.kps[i]].rgba;
     }
   }
 }
@@ -737,7 +949,7 @@ void VulkanRenderer::createStageCommandBuffer() {
           .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
           .pNext = nullptr,
           .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-          .queueFamilyIndex = m_window->graphicsQueueFamilyIndex()
+          .queueFamilyIndex = m_target->graphicsQueueFamilyIndex()
   };
   if (m_devFuncs->vkCreateCommandPool(dev, &commandPoolCreateInfo, nullptr, &stagePool) != VK_SUCCESS) {
     qFatal("can not create command pool");
@@ -770,7 +982,7 @@ void VulkanRenderer::createBuffers() {
   copyBuffer(bd.buffer, stageBd.buffer, sizeof(quadVert));
   flushStageCommandBuffer();
   m_devFuncs->vkDestroyBuffer(dev, stageBd.buffer, nullptr);
-  m_devFuncs->vkFreeMemory(dev, stageBd.memory, nullptr);
+  freeMemory(stageBd.memory);
   imageMaterial.vert = bd;
 
   kpMaterial.vert = createBuffer(MAX_KEYPOINT_NUM * sizeof(VertexAttribute),
@@ -786,9 +998,13 @@ void VulkanRenderer::createBuffers() {
     qFatal("can not map memory");
   }
 
-  lineMaterial.vertStage = createBuffer(500 * sizeof(LineInfo), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true);
-  lineMaterial.vert = createBuffer(500 * sizeof(LineInfo),
-                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false);
+  lineMaterial.vertStage = createBuffer(MAX_LINE_VERTEX_NUM * sizeof(LineInfo), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
+  lineMaterial.vert = createBuffer(MAX_LINE_VERTEX_NUM * sizeof(LineInfo),
+                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+  if (m_devFuncs->vkMapMemory(dev, lineMaterial.vertStage.memory, 0, MAX_LINE_VERTEX_NUM * sizeof(LineInfo), 0,
+                              reinterpret_cast<void **>(&lineMaterial.vertStagePtr)) != VK_SUCCESS) {
+    qFatal("can not map memory");
+  }
 
 }
 
@@ -870,18 +1086,92 @@ void VulkanRenderer::createDescriptorSets() {
   }
 }
 
-void VulkanRenderer::createPipelineLayouts() {
+QString VulkanRenderer::pipelineCachePath() const {
+  const auto &props = *m_target->physicalDeviceProperties();
+  QString uuid;
+  for (auto c: props.pipelineCacheUUID) {
+    uuid += QString::asprintf("%02x", c);
+  }
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         QString("/pipeline_cache_%1_%2.bin").arg(uuid).arg(props.driverVersion, 8, 16, QChar('0'));
+}
+
+void VulkanRenderer::createPipelineCache() {
+  const auto &props = *m_target->physicalDeviceProperties();
+  QByteArray cacheData;
+  QFile file(pipelineCachePath());
+  if (file.open(QIODevice::ReadOnly)) {
+    QByteArray blob = file.readAll();
+    const auto *header = reinterpret_cast<const PipelineCacheFileHeader *>(blob.constData());
+    if ((blob.size() >= static_cast<int>(sizeof(PipelineCacheFileHeader))) &&
+        (header->magic == pipelineCacheMagic) &&
+        (header->version == pipelineCacheVersion) &&
+        (header->vendorID == props.vendorID) &&
+        (header->deviceID == props.deviceID) &&
+        (header->driverVersion == props.driverVersion) &&
+        (memcmp(header->pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0) &&
+        (header->dataSize == blob.size() - sizeof(PipelineCacheFileHeader))) {
+      cacheData = blob.mid(sizeof(PipelineCacheFileHeader));
+      qDebug() << "load pipeline cache" << file.fileName() << cacheData.size() << "bytes";
+    } else {
+      qWarning("ignore stale pipeline cache %s", qPrintable(file.fileName()));
+    }
+  }
+
   VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
           .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
           .pNext = nullptr,
           .flags = 0,
-          .initialDataSize = 0,
-          .pInitialData = nullptr
+          .initialDataSize = static_cast<size_t>(cacheData.size()),
+          .pInitialData = cacheData.isEmpty() ? nullptr : cacheData.constData()
   };
   if (m_devFuncs->vkCreatePipelineCache(dev, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
-    qFatal("can not create pipeline cache");
+    qWarning("can not create pipeline cache from saved data, start with an empty one");
+    pipelineCacheCreateInfo.initialDataSize = 0;
+    pipelineCacheCreateInfo.pInitialData = nullptr;
+    if (m_devFuncs->vkCreatePipelineCache(dev, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+      qFatal("can not create pipeline cache");
+    }
   }
+}
 
+void VulkanRenderer::savePipelineCache() {
+  if (pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+  size_t dataSize = 0;
+  if (m_devFuncs->vkGetPipelineCacheData(dev, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+    return;
+  }
+  QByteArray blob(sizeof(PipelineCacheFileHeader) + dataSize, Qt::Uninitialized);
+  if (m_devFuncs->vkGetPipelineCacheData(dev, pipelineCache, &dataSize,
+                                         blob.data() + sizeof(PipelineCacheFileHeader)) != VK_SUCCESS) {
+    qWarning("can not get pipeline cache data");
+    return;
+  }
+  blob.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+  const auto &props = *m_target->physicalDeviceProperties();
+  auto *header = reinterpret_cast<PipelineCacheFileHeader *>(blob.data());
+  header->magic = pipelineCacheMagic;
+  header->version = pipelineCacheVersion;
+  header->vendorID = props.vendorID;
+  header->deviceID = props.deviceID;
+  header->driverVersion = props.driverVersion;
+  memcpy(header->pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+  header->dataSize = dataSize;
+
+  const QString path = pipelineCachePath();
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || (file.write(blob) != blob.size()) || !file.commit()) {
+    qWarning("can not write pipeline cache %s", qPrintable(path));
+    return;
+  }
+  qDebug() << "save pipeline cache" << path << dataSize << "bytes";
+}
+
+void VulkanRenderer::createPipelineLayouts() {
   VkPushConstantRange imagePushConstantRanges[] = {
           {
                   .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -1075,7 +1365,7 @@ void VulkanRenderer::createPipelines() {
   multisampleState.sampleShadingEnable = VK_FALSE;
   multisampleState.minSampleShading = VK_NULL_HANDLE;
   multisampleState.pSampleMask = nullptr;
-  multisampleState.rasterizationSamples = m_window->sampleCountFlagBits();
+  multisampleState.rasterizationSamples = m_target->sampleCountFlagBits();
 
   VkDynamicState dynamicStateEnables[] = {
           VK_DYNAMIC_STATE_VIEWPORT,
@@ -1103,18 +1393,41 @@ void VulkanRenderer::createPipelines() {
   graphicsPipelineCreateInfo.pColorBlendState = &colorBlendState;
   graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
   graphicsPipelineCreateInfo.layout = imageMaterial.pipelineLayout;
-  graphicsPipelineCreateInfo.renderPass = m_window->defaultRenderPass();
+  graphicsPipelineCreateInfo.renderPass = m_target->defaultRenderPass();
   graphicsPipelineCreateInfo.subpass = VK_NULL_HANDLE;
   graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
   graphicsPipelineCreateInfo.basePipelineIndex = 0;
 
-  if (m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
-                                            &imageMaterial.pipeline) != VK_SUCCESS) {
-    qFatal("can not create image pipeline");
-  }
+  /* every pipeline below is only described here, the state is snapshot into a job and all jobs are
+   * compiled concurrently at the end, the pipeline cache is internally synchronized */
+  struct PipelineJob {
+    VkPipelineShaderStageCreateInfo stages[ARRAY_SIZE(shaderStages)];
+    VkPipelineVertexInputStateCreateInfo vertexInputState;
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+    VkPipelineMultisampleStateCreateInfo multisampleState;
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    VkPipelineColorBlendStateCreateInfo colorBlendState;
+    VkGraphicsPipelineCreateInfo createInfo;
+    VkPipeline *pipeline;
+    const char *name;
+  };
+  std::vector<PipelineJob> pipelineJobs;
+  std::vector<VkShaderModule> shaderModules = {vertexShader, fragmentShader};
+  auto addPipelineJob = [&](VkPipeline *pipeline, const char *name) {
+    assert(pipelineColorBlendAttachmentStates.size() == 1);
+    PipelineJob &job = pipelineJobs.emplace_back();
+    memcpy(job.stages, shaderStages, sizeof(shaderStages));
+    job.vertexInputState = pipelineVertexInputStateCreateInfo;
+    job.inputAssemblyState = inputAssemblyState;
+    job.multisampleState = multisampleState;
+    job.colorBlendAttachmentState = pipelineColorBlendAttachmentStates[0];
+    job.colorBlendState = colorBlendState;
+    job.createInfo = graphicsPipelineCreateInfo;
+    job.pipeline = pipeline;
+    job.name = name;
+  };
 
-  m_devFuncs->vkDestroyShaderModule(dev, vertexShader, nullptr);
-  m_devFuncs->vkDestroyShaderModule(dev, fragmentShader, nullptr);
+  addPipelineJob(&imageMaterial.pipeline, "image");
 
   auto vertexShader_sel = loadShader(":/glsl/images_sel.vert.spv");
   auto fragmentShader_sel = loadShader(":/glsl/images_sel.frag.spv");
@@ -1123,12 +1436,9 @@ void VulkanRenderer::createPipelines() {
   shaderStages[1].module = fragmentShader_sel;
   multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
   graphicsPipelineCreateInfo.renderPass = objSelectPass.renderPass;
-  if (m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
-                                            &imageMaterial.pipeline_sel) != VK_SUCCESS) {
-    qFatal("can not create image pipeline");
-  }
-  m_devFuncs->vkDestroyShaderModule(dev, vertexShader_sel, nullptr);
-  m_devFuncs->vkDestroyShaderModule(dev, fragmentShader_sel, nullptr);
+  addPipelineJob(&imageMaterial.pipeline_sel, "image select");
+  shaderModules.push_back(vertexShader_sel);
+  shaderModules.push_back(fragmentShader_sel);
 
   auto keyPointVertexShader = loadShader(":/glsl/imageKeypoints.vert.spv");
   auto keyPointFragmentShader = loadShader(":/glsl/imageKeypoints.frag.spv");
@@ -1206,16 +1516,12 @@ void VulkanRenderer::createPipelines() {
   pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = kpVertexInputAttributeDescription;
 
   inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-  multisampleState.rasterizationSamples = m_window->sampleCountFlagBits();
-  graphicsPipelineCreateInfo.renderPass = m_window->defaultRenderPass();
+  multisampleState.rasterizationSamples = m_target->sampleCountFlagBits();
+  graphicsPipelineCreateInfo.renderPass = m_target->defaultRenderPass();
   graphicsPipelineCreateInfo.layout = kpMaterial.pipelineLayout;
-  if (m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
-                                            &kpMaterial.pipeline) != VK_SUCCESS) {
-    qFatal("can not create keypoint pipeline");
-  }
-
-  m_devFuncs->vkDestroyShaderModule(dev, keyPointVertexShader, nullptr);
-  m_devFuncs->vkDestroyShaderModule(dev, keyPointFragmentShader, nullptr);
+  addPipelineJob(&kpMaterial.pipeline, "keypoint");
+  shaderModules.push_back(keyPointVertexShader);
+  shaderModules.push_back(keyPointFragmentShader);
 
   auto keyPointVertexShader_sel = loadShader(":/glsl/imageKeypoints_sel.vert.spv");
   auto keyPointFragmentShader_sel = loadShader(":/glsl/imageKeypoints_sel.frag.spv");
@@ -1226,12 +1532,9 @@ void VulkanRenderer::createPipelines() {
   pipelineColorBlendAttachmentStates[0].colorWriteMask = VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
   multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
   graphicsPipelineCreateInfo.renderPass = objSelectPass.renderPass;
-  if (m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
-                                            &kpMaterial.pipeline_sel) != VK_SUCCESS) {
-    qFatal("can not create keypoint pipeline");
-  }
-  m_devFuncs->vkDestroyShaderModule(dev, keyPointVertexShader_sel, nullptr);
-  m_devFuncs->vkDestroyShaderModule(dev, keyPointFragmentShader_sel, nullptr);
+  addPipelineJob(&kpMaterial.pipeline_sel, "keypoint select");
+  shaderModules.push_back(keyPointVertexShader_sel);
+  shaderModules.push_back(keyPointFragmentShader_sel);
 
   auto lineVertexShader = loadShader(":/glsl/line.vert.spv");
   auto lineFragmentShader = loadShader(":/glsl/line.frag.spv");
@@ -1304,16 +1607,40 @@ void VulkanRenderer::createPipelines() {
   pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = lineVertexInputAttributeDescription;
 
   inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-  multisampleState.rasterizationSamples = m_window->sampleCountFlagBits();
-  graphicsPipelineCreateInfo.renderPass = m_window->defaultRenderPass();
+  pipelineColorBlendAttachmentStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  multisampleState.rasterizationSamples = m_target->sampleCountFlagBits();
+  graphicsPipelineCreateInfo.renderPass = m_target->defaultRenderPass();
   graphicsPipelineCreateInfo.layout = lineMaterial.pipelineLayout;
-  if (m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
-                                            &lineMaterial.pipeline) != VK_SUCCESS) {
-    qFatal("can not create keypoint pipeline");
+  addPipelineJob(&lineMaterial.pipeline, "line");
+  shaderModules.push_back(lineVertexShader);
+  shaderModules.push_back(lineFragmentShader);
+
+  QElapsedTimer timer;
+  timer.start();
+  std::vector<std::future<VkResult>> results;
+  results.reserve(pipelineJobs.size());
+  for (auto &job: pipelineJobs) {
+    job.createInfo.pStages = job.stages;
+    job.createInfo.pVertexInputState = &job.vertexInputState;
+    job.createInfo.pInputAssemblyState = &job.inputAssemblyState;
+    job.createInfo.pMultisampleState = &job.multisampleState;
+    job.colorBlendState.pAttachments = &job.colorBlendAttachmentState;
+    job.createInfo.pColorBlendState = &job.colorBlendState;
+    results.emplace_back(std::async(std::launch::async, [this, &job]() {
+      return m_devFuncs->vkCreateGraphicsPipelines(dev, pipelineCache, 1, &job.createInfo, nullptr, job.pipeline);
+    }));
+  }
+  for (size_t i = 0; i < pipelineJobs.size(); i++) {
+    if (results[i].get() != VK_SUCCESS) {
+      qFatal("can not create %s pipeline", pipelineJobs[i].name);
+    }
   }
+  qDebug() << "create" << pipelineJobs.size() << "pipelines in" << timer.elapsed() << "ms";
 
-  m_devFuncs->vkDestroyShaderModule(dev, lineVertexShader, nullptr);
-  m_devFuncs->vkDestroyShaderModule(dev, lineFragmentShader, nullptr);
+  for (auto shaderModule: shaderModules) {
+    m_devFuncs->vkDestroyShaderModule(dev, shaderModule, nullptr);
+  }
 }
 
 void VulkanRenderer::createSelRenderPass() {
@@ -1396,7 +1723,8 @@ void VulkanRenderer::createSelRenderPass() {
 }
 
 void VulkanRenderer::selectObject(const QPoint &pos) {
-  const QSize sz = m_window->swapChainImageSize();
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_SELECT_OBJECT);
+  const QSize sz = m_target->swapChainImageSize();
 
   const union {
     uint32_t i;
@@ -1471,6 +1799,7 @@ void VulkanRenderer::selectObject(const QPoint &pos) {
 
   m_devFuncs->vkCmdEndRenderPass(stageCB);
   readPixel(stageCB, objSelectPass.pixeBuf.buffer, objSelectPass.color.image, pos);
+  stageGpuPhase = FrameProfiler::GPU_PICK_PASS;
   flushStageCommandBuffer();
 
   uint8_t *p;
@@ -1497,8 +1826,163 @@ void VulkanRenderer::selectObject(const QPoint &pos) {
   selectInfo.image_kp_id = image_kp_id;
 }
 
+void VulkanRenderer::createQueryPool() {
+  QVulkanFunctions *f = m_target->vulkanInstance()->functions();
+  uint32_t queueFamilyCount = 0;
+  f->vkGetPhysicalDeviceQueueFamilyProperties(m_target->physicalDevice(), &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+  f->vkGetPhysicalDeviceQueueFamilyProperties(m_target->physicalDevice(), &queueFamilyCount,
+                                              queueFamilyProperties.data());
+  const uint32_t validBits = queueFamilyProperties[m_target->graphicsQueueFamilyIndex()].timestampValidBits;
+  if (validBits == 0) {
+    qWarning("graphics queue does not support timestamps, gpu timings disabled");
+    return;
+  }
+  timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+  timestampPeriodMs = m_target->physicalDeviceProperties()->limits.timestampPeriod / 1e6;
+
+  VkQueryPoolCreateInfo queryPoolCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .queryType = VK_QUERY_TYPE_TIMESTAMP,
+          .queryCount = stageQueryCount + frameQuerySlots * frameQueryCount,
+          .pipelineStatistics = 0
+  };
+  if (m_devFuncs->vkCreateQueryPool(dev, &queryPoolCreateInfo, nullptr, &queryPool) != VK_SUCCESS) {
+    qWarning("can not create timestamp query pool");
+    queryPool = VK_NULL_HANDLE;
+  }
+  std::fill(std::begin(frameQueryWritten), std::end(frameQueryWritten), false);
+}
+
+void VulkanRenderer::writeTimestamp(VkCommandBuffer cb, VkPipelineStageFlagBits stage, uint32_t query) {
+  if (queryPool != VK_NULL_HANDLE) {
+    m_devFuncs->vkCmdWriteTimestamp(cb, stage, queryPool, query);
+  }
+}
+
+double VulkanRenderer::timestampDelta(uint64_t begin, uint64_t end) const {
+  return static_cast<double>((end - begin) & timestampMask) * timestampPeriodMs;
+}
+
+void VulkanRenderer::collectFrameTimestamps(uint32_t slot) {
+  if (!frameQueryWritten[slot]) {
+    return;
+  }
+  /* the slot is reused only after the frame that wrote it has retired, so no wait here, a not ready
+   * result just drops the sample */
+  uint64_t timestamps[frameQueryCount];
+  if (m_devFuncs->vkGetQueryPoolResults(dev, queryPool, stageQueryCount + slot * frameQueryCount, frameQueryCount,
+                                        sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+    profiler.record(FrameProfiler::GPU_IMAGE_DRAW, timestampDelta(timestamps[0], timestamps[1]));
+    profiler.record(FrameProfiler::GPU_KEYPOINT_DRAW, timestampDelta(timestamps[1], timestamps[2]));
+    profiler.record(FrameProfiler::GPU_LINE_DRAW, timestampDelta(timestamps[2], timestamps[3]));
+  }
+  frameQueryWritten[slot] = false;
+}
+
+void VulkanRenderer::setProfilerOverlayVisible(bool visible) {
+  profilerOverlayVisible = visible;
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::updateOverlay() {
+  overlayFrame = profiler.frame();
+
+  QStringList rows;
+  rows << QString("%1 %2 %3 %4 %5").arg("phase", -22).arg("p50", 8).arg("p95", 8).arg("p99", 8).arg("max", 8);
+  for (int i = 0; i < FrameProfiler::PHASE_COUNT; i++) {
+    const auto phase = static_cast<FrameProfiler::Phase>(i);
+    const auto summary = profiler.summary(phase);
+    if (summary.count == 0) {
+      continue;
+    }
+    rows << QString("%1 %2 %3 %4 %5").arg(FrameProfiler::phaseName(phase), -22)
+            .arg(summary.p50, 8, 'f', 3).arg(summary.p95, 8, 'f', 3)
+            .arg(summary.p99, 8, 'f', 3).arg(summary.max, 8, 'f', 3);
+  }
+
+  QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+  const QFontMetrics metrics(font);
+  int textWidth = 0;
+  for (const auto &row : rows) {
+    textWidth = std::max(textWidth, metrics.horizontalAdvance(row));
+  }
+  const int padding = 4;
+  QImage img(textWidth + 2 * padding, metrics.lineSpacing() * rows.size() + 2 * padding,
+             QImage::Format_RGBA8888_Premultiplied);
+  img.fill(QColor(0, 0, 0, 200));
+  {
+    QPainter painter(&img);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    for (int i = 0; i < rows.size(); i++) {
+      painter.drawText(padding, padding + metrics.ascent() + i * metrics.lineSpacing(), rows[i]);
+    }
+  }
+
+  if (overlayTex.image != VK_NULL_HANDLE) {
+    m_devFuncs->vkDeviceWaitIdle(dev);
+    m_devFuncs->vkDestroyImageView(dev, overlayTex.imageView, nullptr);
+    m_devFuncs->vkDestroyImage(dev, overlayTex.image, nullptr);
+    freeMemory(overlayTex.memory);
+  }
+  overlayTex = createImage(img.size(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+                           VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                           VK_IMAGE_LAYOUT_UNDEFINED, false);
+  TextureData &&stageTex = createImage(img.size(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_LINEAR,
+                                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_LAYOUT_PREINITIALIZED, true);
+  writeLinearImage(img, stageTex.image, stageTex.memory);
+  beginStageCommandBuffer();
+  uploadImage(stageCB, overlayTex.image, stageTex.image, img.size());
+  flushStageCommandBuffer();
+  m_devFuncs->vkDestroyImage(dev, stageTex.image, nullptr);
+  freeMemory(stageTex.memory);
+  overlaySize = img.size();
+
+  VkDescriptorImageInfo descriptorImageInfo = {sampler, overlayTex.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkWriteDescriptorSet writeDescriptorSet = {
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .pNext = nullptr,
+          .dstSet = imageMaterial.descSet,
+          .dstBinding = 0,
+          .dstArrayElement = OVERLAY_TEX_ID,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .pImageInfo = &descriptorImageInfo,
+          .pBufferInfo = nullptr,
+          .pTexelBufferView = nullptr
+  };
+  m_devFuncs->vkUpdateDescriptorSets(dev, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+void VulkanRenderer::drawOverlay(VkCommandBuffer cb) {
+  /* identity projection, one unit is half a pixel, pin the overlay to the top left corner */
+  const QSize sz = m_target->swapChainImageSize();
+  const float margin = 8;
+  textureExtraInfo overlayInfo = {Eigen::Matrix4f::Identity(), 2.f * overlaySize.width(),
+                                  2.f * overlaySize.height(), 0.f};
+  overlayInfo.mat(0, 3) = 2 * margin + overlaySize.width() - sz.width();
+  overlayInfo.mat(1, 3) = 2 * margin + overlaySize.height() - sz.height();
+  memcpy(instBufPtr + OVERLAY_TEX_ID * sizeof(textureExtraInfo), &overlayInfo, sizeof(overlayInfo));
+
+  SceneInfo overlayScene = sceneInfo;
+  overlayScene.proj.setIdentity();
+  m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, imageMaterial.pipeline);
+  VkBuffer imageVertBuffs[] = {imageMaterial.vert.buffer, instBuf.buffer};
+  VkDeviceSize imageVertOffsets[] = {0, 0};
+  m_devFuncs->vkCmdBindVertexBuffers(cb, 0, ARRAY_SIZE(imageVertBuffs), imageVertBuffs, imageVertOffsets);
+  m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, imageMaterial.pipelineLayout, 0, 1,
+                                      &imageMaterial.descSet, 0, nullptr);
+  m_devFuncs->vkCmdPushConstants(cb, imageMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                 sizeof(overlayScene), &overlayScene);
+  m_devFuncs->vkCmdDraw(cb, 4, 1, 0, OVERLAY_TEX_ID);
+}
+
 void VulkanRenderer::mousePressEvent(QMouseEvent *e) {
-  assert(m_window->devicePixelRatio() == 1.0f);
+  assert(m_target->devicePixelRatio() == 1.0f);
   ulong timeDelta = e->timestamp() - mouseLastTime;
   mouseLastTime = e->timestamp();
   mouseLastPos.x() = e->localPos().x();
@@ -1516,39 +2000,60 @@ void VulkanRenderer::mousePressEvent(QMouseEvent *e) {
     if (selectInfo.kp_id != UINT32_MAX) {
       if (myMode == RENDER_MODE_TRACK) {
         if (m_graphModel->addKeypoint2Track(curr_track_id, selectInfo.image_id, selectInfo.image_kp_id)) {
-          const auto &imgInfo = m_graphModel->imageInfos.at(selectInfo.image_id);
-          const auto &kp = imgInfo.keyPoints.at(selectInfo.image_kp_id);
-          const auto &img = imgInfo.data;
-          m_trackScene->addKeyPointImage(img, QPointF(kp.pos.x() * img.width() - 0.5, kp.pos.y() * img.height() - 0.5));
+          showTrackKeypoint(selectInfo.image_id, selectInfo.image_kp_id);
         }
       }
     } else if (selectInfo.tex_id != UINT32_MAX) {
       image_min_depth = image_min_depth - image_depth_internal;
       texExtraInfos[selectInfo.tex_id].depth = image_min_depth;
+      lineChange = hasLines();
     }
   } else if (e->buttons() & Qt::RightButton) {
     selectObject(e->pos());
     if (selectInfo.kp_id != UINT32_MAX) {
       image_min_depth = image_min_depth - image_depth_internal;
       texExtraInfos[selectInfo.tex_id].depth = image_min_depth;
+      lineChange = hasLines();
       actionMenu->exec(e->globalPos());
     } else {
       if (myMode == RENDER_MODE_TRACK) {
-        m_window->setCursor(Qt::ArrowCursor);
+        m_target->setCursorShape(Qt::ArrowCursor);
         myMode = RENDER_MODE_NORMAL;
+        updateSuggestions();
       }
     }
   }
   e->accept();
-  m_window->requestUpdate();
+  m_target->requestUpdate();
 }
 
 void VulkanRenderer::mouseReleaseEvent(QMouseEvent *e) {
 
 }
 
+void VulkanRenderer::keyPressEvent(QKeyEvent *e) {
+  if ((myMode == RENDER_MODE_TRACK) && ((e->key() == Qt::Key_Return) || (e->key() == Qt::Key_Enter))) {
+    acceptSuggestions();
+    e->accept();
+    return;
+  }
+  if ((myMode == RENDER_MODE_TRACK) && (e->key() == Qt::Key_R)) {
+    refineCurrentTrack();
+    e->accept();
+    return;
+  }
+  if (outlierReviewEnabled && (e->key() == Qt::Key_N)) {
+    reviewNextOutlier();
+    e->accept();
+    return;
+  }
+  e->ignore();
+}
+
 void VulkanRenderer::mouseMoveEvent(QMouseEvent *e) {
-  if (e->buttons() & Qt::LeftButton) {
+  if (e->buttons() == Qt::NoButton) {
+    updateEpipolarLines(e->localPos());
+  } else if (e->buttons() & Qt::LeftButton) {
     if (selectInfo.kp_id != UINT32_MAX) {
 
     } else if (selectInfo.tex_id != UINT32_MAX) {
@@ -1556,12 +2061,415 @@ void VulkanRenderer::mouseMoveEvent(QMouseEvent *e) {
       auto dy = 2 * (e->localPos().y() - mouseLastPos.y());
       Eigen::Vector3f d = sceneInfo.proj.inverse().block(0, 0, 3, 3) * Eigen::Vector3f(dx, dy, 0);
       texExtraInfos[selectInfo.tex_id].mat.block(0, 3, 3, 1) += d;
+      lineChange = hasLines();
       mouseLastPos.x() = e->localPos().x();
       mouseLastPos.y() = e->localPos().y();
       e->accept();
-      m_window->requestUpdate();
+      m_target->requestUpdate();
+    }
+  }
+}
+
+bool VulkanRenderer::hoveredImage(const QPointF &pos, Image_ID_T *image_id, Eigen::Vector2f *uv) const {
+  /* the image shaders map (uv - 0.5) * size through proj * model and divide by the window size, both are affine */
+  const Eigen::Vector2f target(2 * pos.x() - sceneInfo.windowSize.x(), 2 * pos.y() - sceneInfo.windowSize.y());
+  float nearest = std::numeric_limits<float>::max();
+  for (size_t tex_id = 0; tex_id < texDatas.size(); tex_id++) {
+    const auto &extraInfo = texExtraInfos[tex_id];
+    const Eigen::Matrix4f m = sceneInfo.proj * extraInfo.mat;
+    const Eigen::Matrix2f A = m.block<2, 2>(0, 0);
+    if (std::abs(A.determinant()) < 1e-12f) {
+      continue;
+    }
+    const Eigen::Vector2f local = A.inverse() * (target - m.block<2, 1>(0, 2) * extraInfo.depth -
+                                                 m.block<2, 1>(0, 3));
+    const Eigen::Vector2f p(local.x() / extraInfo.width + 0.5f, local.y() / extraInfo.height + 0.5f);
+    /* smaller depth is drawn on top */
+    if ((p.minCoeff() >= 0.f) && (p.maxCoeff() <= 1.f) && (extraInfo.depth < nearest)) {
+      nearest = extraInfo.depth;
+      *image_id = texDatas[tex_id].image_id;
+      *uv = p;
     }
   }
+  return nearest != std::numeric_limits<float>::max();
+}
+
+void VulkanRenderer::updateEpipolarLines(const QPointF &pos) {
+  Image_ID_T image_id = 0;
+  Eigen::Vector2f uv;
+  const bool show = epipolarLinesVisible && (myMode == RENDER_MODE_TRACK) && hoveredImage(pos, &image_id, &uv);
+  if (!show) {
+    if (!epipolarLines.empty()) {
+      epipolarLines.clear();
+      lineChange = true;
+      m_target->requestUpdate();
+    }
+    return;
+  }
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_EPIPOLAR_LINES);
+  epipolarLines.clear();
+  std::vector<Eigen::Vector2f> polyline;
+  for (const auto &it: texIdMap) {
+    if ((it.first == image_id) || !epipolar.line(*m_graphModel, image_id, uv, it.first, &polyline)) {
+      continue;
+    }
+    /* the sampled curve may leave the image near the corners of distorted cameras */
+    auto inside = [](const Eigen::Vector2f &p) { return (p.minCoeff() >= -1e-3f) && (p.maxCoeff() <= 1.001f); };
+    for (size_t i = 0; i + 1 < polyline.size(); i++) {
+      if (inside(polyline[i]) && inside(polyline[i + 1])) {
+        epipolarLines.push_back({{it.first, it.first}, {polyline[i], polyline[i + 1]},
+                                 Eigen::Vector3f(1.f, 0.5f, 0.f)});
+      }
+    }
+  }
+  lineChange = true;
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::setEpipolarLinesVisible(bool visible) {
+  epipolarLinesVisible = visible;
+  if (!visible && !epipolarLines.empty()) {
+    epipolarLines.clear();
+    lineChange = true;
+    m_target->requestUpdate();
+  }
+}
+
+void VulkanRenderer::trackChanged(Track_ID_T track_id) {
+  updateOutliers(track_id);
+  if ((track_id == curr_track_id) && (myMode == RENDER_MODE_TRACK) && !editingTrack) {
+    updateSuggestions();
+  }
+}
+
+void VulkanRenderer::updateSuggestions() {
+  const auto previous = std::move(suggested);
+  suggested.clear();
+  suggestionColors.clear();
+  if (suggestionsVisible && (myMode == RENDER_MODE_TRACK) && m_graphModel->tracks.count(curr_track_id)) {
+    FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_SUGGESTIONS);
+    std::vector<Image_ID_T> images;
+    for (const auto &it: texIdMap) {
+      images.push_back(it.first);
+      loadGrayImage(it.first);
+    }
+    suggested = suggestions.suggest(*m_graphModel, grayImages, curr_track_id, images);
+    for (const auto &suggestion: suggested) {
+      suggestionColors[(static_cast<uint64_t>(suggestion.image_id) << 32) | suggestion.kp_id] =
+              suggestion.rank == 0 ? 0xFF00FF00u : 0xFF008000u;
+    }
+  }
+  if (previous.empty() && suggested.empty()) {
+    return;
+  }
+  for (const auto *list: {&previous, &suggested}) {
+    for (const auto &suggestion: *list) {
+      rewriteKeypoint(suggestion.image_id, suggestion.kp_id);
+    }
+  }
+  modifySelKpColor();
+  vertexChange = true;
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::acceptSuggestions() {
+  if ((myMode != RENDER_MODE_TRACK) || suggested.empty()) {
+    return;
+  }
+  const auto accepted = suggested;
+  editingTrack = true;
+  for (const auto &suggestion: accepted) {
+    if ((suggestion.rank == 0) &&
+        m_graphModel->addKeypoint2Track(curr_track_id, suggestion.image_id, suggestion.kp_id)) {
+      showTrackKeypoint(suggestion.image_id, suggestion.kp_id);
+    }
+  }
+  editingTrack = false;
+  updateSuggestions();
+}
+
+size_t VulkanRenderer::refineCurrentTrack() {
+  if ((myMode != RENDER_MODE_TRACK) || (m_graphModel->tracks.count(curr_track_id) == 0)) {
+    return 0;
+  }
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REFINE);
+  const auto track = m_graphModel->tracks.at(curr_track_id);
+  for (const auto image_id: track.images) {
+    loadGrayImage(image_id);
+  }
+  const auto results = refinement.refineTrack(*m_graphModel, grayImages, curr_track_id);
+  size_t moved = 0;
+  editingTrack = true;
+  for (size_t i = 0; i < results.size(); i++) {
+    if (results[i].valid) {
+      m_graphModel->setKeyPointPosition(track.images[i], track.kps[i], results[i].pos);
+      moved++;
+    }
+  }
+  editingTrack = false;
+  m_trackScene->clear();
+  for (size_t i = 0; i < track.images.size(); i++) {
+    showTrackKeypoint(track.images[i], track.kps[i]);
+  }
+  updateSuggestions();
+  return moved;
+}
+
+/* patches are compared in gray, converted once per image on first use */
+void VulkanRenderer::loadGrayImage(Image_ID_T image_id) {
+  if (grayImages.hasImage(image_id)) {
+    return;
+  }
+  const QImage gray = imageCache.image(m_graphModel->imageInfos.at(image_id))
+          .convertToFormat(QImage::Format_Grayscale8);
+  if (!gray.isNull()) {
+    grayImages.setImage(image_id, gray.constBits(), gray.width(), gray.height(), gray.bytesPerLine());
+  }
+}
+
+void VulkanRenderer::setSuggestionsVisible(bool visible) {
+  suggestionsVisible = visible;
+  updateSuggestions();
+}
+
+void VulkanRenderer::setOutlierReviewEnabled(bool enable, const ReviewCallback &done) {
+  outlierReviewEnabled = enable;
+  const auto previous = reviewedKeypoint;
+  reviewedKeypoint = std::numeric_limits<uint64_t>::max();
+  if (previous != reviewedKeypoint) {
+    rewriteKeypoint(static_cast<Image_ID_T>(previous >> 32), static_cast<KeyPoint_ID_T>(previous));
+    vertexChange = true;
+    m_target->requestUpdate();
+  }
+  /* a pass still running and the prefetch of the old queue are dropped */
+  reviewScoringGeneration++;
+  reviewPrefetchGeneration++;
+  reviewStaleTracks.clear();
+  outlierReview.clear();
+  reviewScoring = enable;
+  if (!enable) {
+    return;
+  }
+  /*
+   * the pass scores a copy of what it reads, the gui thread keeps editing the model meanwhile. copying the
+   * keypoints is a fraction of projecting and undistorting them all. the gray images stay here, the image cache
+   * is not shared with the pool either
+   */
+  auto snapshot = std::make_shared<ImageGraphModel>();
+  {
+    TRACE_SCOPE("VulkanRenderer::setOutlierReviewEnabled");
+    FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+    snapshot->imageInfos = m_graphModel->imageInfos;
+    snapshot->tracks = m_graphModel->tracks;
+    snapshot->cameras = m_graphModel->cameras;
+  }
+  auto review = std::make_shared<OutlierReview>();
+  review->options = outlierReview.options;
+  const uint64_t generation = reviewScoringGeneration;
+  reviewPool.start([this, generation, snapshot = std::move(snapshot), review, done]() mutable {
+    review->compute(*snapshot, nullptr);
+    /* the copy is released on the gui thread that created it */
+    QMetaObject::invokeMethod(this, [this, generation, snapshot = std::move(snapshot), review, done]() {
+      reviewScored(generation, review, done);
+    }, Qt::QueuedConnection);
+  });
+}
+
+void VulkanRenderer::reviewScored(uint64_t generation, const std::shared_ptr<OutlierReview> &review,
+                                  const ReviewCallback &done) {
+  if (!outlierReviewEnabled || (generation != reviewScoringGeneration)) {
+    return;
+  }
+  TRACE_SCOPE("VulkanRenderer::reviewScored");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+  reviewScoring = false;
+  outlierReview.swap(*review);
+  /* the patch cue of the pass is missing, tracks with two observations in loaded gray images get it here */
+  std::unordered_map<Track_ID_T, int> grayViews;
+  for (const auto image_id: grayImages.images()) {
+    auto info = m_graphModel->imageInfos.find(image_id);
+    if (info == m_graphModel->imageInfos.end()) {
+      continue;
+    }
+    for (const auto &kp: info->second.keyPoints) {
+      if ((kp.track_id != std::numeric_limits<Track_ID_T>::max()) && (++grayViews[kp.track_id] == 2)) {
+        reviewStaleTracks.insert(kp.track_id);
+      }
+    }
+  }
+  /* updateTrack drops the tracks that are gone and picks up the merges */
+  for (const auto track_id: reviewStaleTracks) {
+    outlierReview.updateTrack(*m_graphModel, &grayImages, track_id);
+  }
+  reviewStaleTracks.clear();
+  QTimer::singleShot(0, this, &VulkanRenderer::prefetchReview);
+  if (done) {
+    done(outlierReview.size());
+  }
+}
+
+bool VulkanRenderer::reviewNextOutlier() {
+  if (!outlierReviewEnabled || outlierReview.empty()) {
+    return false;
+  }
+  TRACE_SCOPE("VulkanRenderer::reviewNextOutlier");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+  const auto entry = outlierReview.top(1).front();
+  outlierReview.dismiss(entry.image_id, entry.kp_id);
+  /* the entry names the track it was scored in, which may have been merged into another one since */
+  const auto track_id = m_graphModel->imageInfos.at(entry.image_id).keyPoints.at(entry.kp_id).track_id;
+  const auto &track = m_graphModel->tracks.at(track_id);
+  std::vector<Image_ID_T> images{entry.image_id};
+  for (size_t i = 0; (i < track.images.size()) && (images.size() < kMaxReviewImages); i++) {
+    if (track.images[i] != entry.image_id) {
+      images.push_back(track.images[i]);
+    }
+  }
+
+  /* out of track mode while the images change, so they do not update the suggestions of the last track */
+  myMode = RENDER_MODE_NORMAL;
+  curr_track_id = std::numeric_limits<Track_ID_T>::max();
+  reviewedKeypoint = (static_cast<uint64_t>(entry.image_id) << 32) | entry.kp_id;
+  std::vector<Image_ID_T> kept;
+  std::vector<Image_ID_T> hidden;
+  for (const auto &it: texIdMap) {
+    (std::find(images.begin(), images.end(), it.first) == images.end() ? hidden : kept).push_back(it.first);
+  }
+  for (const auto image_id: hidden) {
+    setImageShown(image_id, false);
+  }
+  for (const auto image_id: kept) {
+    writeKeypointColors(image_id);
+  }
+  for (const auto image_id: images) {
+    if (texIdMap.count(image_id) == 0) {
+      setImageShown(image_id, true);
+    }
+  }
+  std::vector<Image_ID_T> shown;
+  for (const auto image_id: images) {
+    if (texIdMap.count(image_id) != 0) {
+      shown.push_back(image_id);
+    }
+  }
+  placeImages(shown);
+  editTrack(track_id);
+  QTimer::singleShot(0, this, &VulkanRenderer::prefetchReview);
+  return true;
+}
+
+void VulkanRenderer::updateOutliers(Track_ID_T track_id) {
+  if (reviewScoring) {
+    reviewStaleTracks.insert(track_id);
+  } else if (outlierReviewEnabled) {
+    FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+    outlierReview.updateTrack(*m_graphModel, &grayImages, track_id);
+  }
+}
+
+void VulkanRenderer::setImageShown(Image_ID_T image_id, bool shown) {
+  const auto &rows = m_graphModel->imageIndex;
+  const auto row = std::find(rows.begin(), rows.end(), image_id) - rows.begin();
+  if (row < static_cast<std::ptrdiff_t>(rows.size())) {
+    m_graphModel->setData(m_graphModel->index(static_cast<int>(row), 0, QModelIndex()),
+                          shown ? Qt::Checked : Qt::Unchecked, Qt::CheckStateRole);
+  }
+}
+
+/*
+ * runs from the event loop after a step. the images are decoded on reviewPool, the image cache can not be shared
+ * with it. back on the gui thread they land in the image cache for the texture upload of the next steps, the gray
+ * images let their tracks be rescored with patches before they are shown
+ */
+void VulkanRenderer::prefetchReview() {
+  if (!outlierReviewEnabled) {
+    return;
+  }
+  TRACE_SCOPE("VulkanRenderer::prefetchReview");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+  std::vector<Image_ID_T> ahead;
+  std::vector<Track_ID_T> rescore;
+  for (const auto &entry: outlierReview.top(kReviewPrefetch)) {
+    const auto track_id = m_graphModel->imageInfos.at(entry.image_id).keyPoints.at(entry.kp_id).track_id;
+    const auto &track = m_graphModel->tracks.at(track_id);
+    ahead.push_back(entry.image_id);
+    for (size_t i = 0, n = 1; (i < track.images.size()) && (n < kMaxReviewImages); i++) {
+      if (track.images[i] != entry.image_id) {
+        ahead.push_back(track.images[i]);
+        n++;
+      }
+    }
+    if (std::find(rescore.begin(), rescore.end(), track_id) == rescore.end()) {
+      rescore.push_back(track_id);
+    }
+  }
+  for (const auto image_id: prefetchedImages) {
+    if ((texIdMap.count(image_id) == 0) && (std::find(ahead.begin(), ahead.end(), image_id) == ahead.end())) {
+      grayImages.removeImage(image_id);
+    }
+  }
+  prefetchedImages.clear();
+  std::vector<Image_ID_T> ids;
+  std::vector<QString> paths;
+  for (const auto image_id: ahead) {
+    if (texIdMap.count(image_id) == 0) {
+      prefetchedImages.push_back(image_id);
+    }
+    if (!grayImages.hasImage(image_id) && (std::find(ids.begin(), ids.end(), image_id) == ids.end())) {
+      ids.push_back(image_id);
+      paths.push_back(m_graphModel->imageInfos.at(image_id).path);
+    }
+  }
+  const uint64_t generation = ++reviewPrefetchGeneration;
+  if (ids.empty()) {
+    reviewPrefetched(generation, ids, {}, rescore);
+    return;
+  }
+  reviewPool.start([this, generation, ids = std::move(ids), paths = std::move(paths), rescore = std::move(rescore)]() {
+    std::vector<std::pair<QImage, QImage>> images;
+    for (const auto &path: paths) {
+      QImage color(path);
+      QImage gray = color.convertToFormat(QImage::Format_Grayscale8);
+      images.emplace_back(std::move(color), std::move(gray));
+    }
+    QMetaObject::invokeMethod(this, [this, generation, ids, images = std::move(images), rescore]() {
+      reviewPrefetched(generation, ids, images, rescore);
+    }, Qt::QueuedConnection);
+  });
+}
+
+void VulkanRenderer::reviewPrefetched(uint64_t generation, const std::vector<Image_ID_T> &ids,
+                                      const std::vector<std::pair<QImage, QImage>> &images,
+                                      const std::vector<Track_ID_T> &rescore) {
+  if (!outlierReviewEnabled || (generation != reviewPrefetchGeneration)) {
+    return;
+  }
+  TRACE_SCOPE("VulkanRenderer::reviewPrefetched");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_REVIEW);
+  for (size_t i = 0; i < images.size(); i++) {
+    const auto &info = m_graphModel->imageInfos.at(ids[i]);
+    const auto &color = images[i].first;
+    const auto &gray = images[i].second;
+    if (color.isNull()) {
+      qWarning() << "can not decode" << info.path;
+      continue;
+    }
+    imageCache.insert(info, color);
+    if (!grayImages.hasImage(ids[i])) {
+      grayImages.setImage(ids[i], gray.constBits(), gray.width(), gray.height(), gray.bytesPerLine());
+    }
+  }
+  /* tracks edited away since are skipped by updateTrack */
+  for (const auto track_id: rescore) {
+    outlierReview.updateTrack(*m_graphModel, &grayImages, track_id);
+  }
+}
+
+void VulkanRenderer::showTrackKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  const auto &imgInfo = m_graphModel->imageInfos.at(image_id);
+  const auto &kp = imgInfo.keyPoints.at(kp_id);
+  m_trackScene->addKeyPointImage(imageCache.image(imgInfo), QPointF(kp.pos.x() * imgInfo.size.width() - 0.5,
+                                                                   kp.pos.y() * imgInfo.size.height() - 0.5));
 }
 
 void VulkanRenderer::wheelEvent(QWheelEvent *e) {
@@ -1575,7 +2483,7 @@ void VulkanRenderer::wheelEvent(QWheelEvent *e) {
   sceneInfo.proj = scaleMat * sceneInfo.proj;
   e->accept();
 
-  m_window->requestUpdate();
+  m_target->requestUpdate();
 }
 
 void VulkanRenderer::setModel(ImageGraphModel *model) {
@@ -1584,8 +2492,7 @@ void VulkanRenderer::setModel(ImageGraphModel *model) {
   } else {
     Q_ASSERT(m_graphModel == nullptr);
     m_graphModel = model;
-    connect(m_graphModel, &ImageGraphModel::dataChanged, this, &VulkanRenderer::dataChanged);
-    connect(m_graphModel, &ImageGraphModel::keyPointsInserted, this, &VulkanRenderer::updateImageKeypoints);
+    connectModel();
   }
 }
 
@@ -1613,7 +2520,17 @@ VulkanRenderer::dataChanged(const QModelIndex &topLeft, const QModelIndex &botto
 }
 
 void VulkanRenderer::addImage(int image_id) {
-  const auto img_rgba = m_graphModel->imageInfos.at(image_id).data.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+  if (texDatas.size() >= OVERLAY_TEX_ID) {
+    qWarning("at most %d images can be shown", OVERLAY_TEX_ID);
+    return;
+  }
+  TRACE_SCOPE("VulkanRenderer::addImage");
+  FrameProfiler::ScopedTimer timer(profiler, FrameProfiler::CPU_ADD_IMAGE);
+  const QImage img = imageCache.image(m_graphModel->imageInfos.at(image_id));
+  if (img.isNull()) {
+    return;
+  }
+  const auto img_rgba = img.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
 
   TextureData &&tex = createImage(img_rgba.size(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
                                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
@@ -1627,7 +2544,7 @@ void VulkanRenderer::addImage(int image_id) {
   flushStageCommandBuffer();
 
   m_devFuncs->vkDestroyImage(dev, stageTex.image, nullptr);
-  m_devFuncs->vkFreeMemory(dev, stageTex.memory, nullptr);
+  freeMemory(stageTex.memory);
 
   const auto &imgInfo = m_graphModel->imageInfos.at(image_id);
   const auto image_vert_count = imgInfo.keyPoints.size();
@@ -1635,14 +2552,7 @@ void VulkanRenderer::addImage(int image_id) {
   uint32_t image_vert_offset = vas.size();
   vas.reserve(vas.size() + image_vert_count);
   for (const auto &it:imgInfo.keyPoints) {
-    auto &va = vas.emplace_back();
-    va.x = it.pos.x();
-    va.y = it.pos.y();
-    if(it.track_id == std::numeric_limits<Track_ID_T>::max()){
-      va.rgba = 0xFFFF00FFu;
-    } else {
-      va.rgba = 0xFF00FFFFu;
-    }
+    writeKeypointVertex(vas.emplace_back(), image_id, it);
   }
 
   memcpy(kpMaterial.vertStagePtr + image_vert_offset, vas.data() + image_vert_offset, image_vert_count * sizeof(VertexAttribute));
@@ -1665,10 +2575,20 @@ void VulkanRenderer::addImage(int image_id) {
 
   vertexChange = true;
   imageChange = true;
-  m_window->requestUpdate();
+  lineChange = hasLines();
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+  if (myMode == RENDER_MODE_TRACK) {
+    updateSuggestions();
+  }
 }
 
 void VulkanRenderer::removeImage(int image_id) {
+  TRACE_SCOPE("VulkanRenderer::removeImage");
+  /* addImage refuses images it can not decode */
+  if (texIdMap.count(image_id) == 0) {
+    return;
+  }
   int tex_id = texIdMap.at(image_id);
   uint32_t image_vert_offset = indirectDrawCmds[tex_id].firstVertex;
   vas.erase(vas.begin() + image_vert_offset, vas.begin() + image_vert_offset + indirectDrawCmds[tex_id].vertexCount);
@@ -1695,13 +2615,177 @@ void VulkanRenderer::removeImage(int image_id) {
       it.second = it.second - 1;
     }
   }
+  grayImages.removeImage(image_id);
 
   vertexChange = true;
   imageChange = true;
-  m_window->requestUpdate();
+  lineChange = hasLines();
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+  if (myMode == RENDER_MODE_TRACK) {
+    updateSuggestions();
+  }
+}
+
+void VulkanRenderer::setImageTransform(Image_ID_T image_id, const Eigen::Matrix4f &mat) {
+  auto it = texIdMap.find(image_id);
+  if (it == texIdMap.end()) {
+    return;
+  }
+  texExtraInfos[it->second].mat = mat;
+  lineChange = hasLines();
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::setProjection(const Eigen::Matrix4f &proj) {
+  sceneInfo.proj = proj;
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::placeImages(const std::vector<Image_ID_T> &images) {
+  const QSize sz = m_target->swapChainImageSize();
+  float totalWidth = 0;
+  float maxHeight = 0;
+  for (auto image_id: images) {
+    const auto &img = m_graphModel->imageInfos.at(image_id).size;
+    totalWidth += img.width();
+    maxHeight = std::max(maxHeight, static_cast<float>(img.height()));
+  }
+  const float gap = images.empty() ? 0.f : 0.02f * totalWidth / images.size();
+  totalWidth += gap * (images.size() - 1);
+
+  float left = -totalWidth / 2;
+  for (auto image_id: images) {
+    const auto &img = m_graphModel->imageInfos.at(image_id).size;
+    Eigen::Matrix4f mat = Eigen::Matrix4f::Identity();
+    mat(0, 3) = left + img.width() / 2.f;
+    setImageTransform(image_id, mat);
+    left += img.width() + gap;
+  }
+
+  /* the vertex shaders divide by the window size, a scale of s maps 2 / s model units onto one pixel */
+  const float scale = 0.98f * std::min(2.f * sz.width() / std::max(totalWidth, 1.f),
+                                       2.f * sz.height() / std::max(maxHeight, 1.f));
+  Eigen::DiagonalMatrix<float, 4> proj;
+  proj.diagonal() << scale, scale, 1., 1.;
+  setProjection(proj.toDenseMatrix());
+}
+
+void VulkanRenderer::setLines(std::vector<LineSegment> segments) {
+  lines = std::move(segments);
+  lineChange = true;
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+}
+
+uint32_t VulkanRenderer::keypointColor(Image_ID_T image_id, const KeyPoint &kp) const {
+  if (((static_cast<uint64_t>(image_id) << 32) | kp.kp_id) == reviewedKeypoint) {
+    return 0xFFFF0000u;
+  }
+  if (!suggestionColors.empty()) {
+    auto suggestion = suggestionColors.find((static_cast<uint64_t>(image_id) << 32) | kp.kp_id);
+    if (suggestion != suggestionColors.end()) {
+      return suggestion->second;
+    }
+  }
+  auto it = keypointColors.find(image_id);
+  if ((it != keypointColors.end()) && (kp.kp_id < it->second.size())) {
+    return it->second[kp.kp_id];
+  }
+  return kp.track_id == std::numeric_limits<Track_ID_T>::max() ? 0xFFFF00FFu : 0xFF00FFFFu;
+}
+
+bool VulkanRenderer::keypointHidden(const KeyPoint &kp) const {
+  if (hiddenOrigins.empty() || (kp.track_id == std::numeric_limits<Track_ID_T>::max())) {
+    return false;
+  }
+  auto it = m_graphModel->tracks.find(kp.track_id);
+  return (it != m_graphModel->tracks.end()) && (it->second.origin < hiddenOrigins.size()) &&
+         hiddenOrigins[it->second.origin];
+}
+
+/* the keypoint pipeline does not blend, hidden keypoints are moved out of the clip volume instead */
+void VulkanRenderer::writeKeypointVertex(VertexAttribute &va, Image_ID_T image_id, const KeyPoint &kp) const {
+  const bool hidden = keypointHidden(kp);
+  va.x = hidden ? -1e6f : kp.pos.x();
+  va.y = hidden ? -1e6f : kp.pos.y();
+  va.rgba = keypointColor(image_id, kp);
+}
+
+void VulkanRenderer::rewriteKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id) {
+  auto tex = texIdMap.find(image_id);
+  if (tex == texIdMap.end()) {
+    return;
+  }
+  const auto &keyPoints = m_graphModel->imageInfos.at(image_id).keyPoints;
+  if (kp_id >= std::min<size_t>(indirectDrawCmds[tex->second].vertexCount, keyPoints.size())) {
+    return;
+  }
+  const uint32_t vertex = indirectDrawCmds[tex->second].firstVertex + kp_id;
+  writeKeypointVertex(vas[vertex], image_id, keyPoints[kp_id]);
+  kpMaterial.vertStagePtr[vertex] = vas[vertex];
+}
+
+/* rewrites the vertices of a shown image in place, the draw commands stay as they are */
+void VulkanRenderer::writeKeypointColors(Image_ID_T image_id) {
+  auto tex = texIdMap.find(image_id);
+  if (tex == texIdMap.end()) {
+    return;
+  }
+  const auto &keyPoints = m_graphModel->imageInfos.at(image_id).keyPoints;
+  const uint32_t offset = indirectDrawCmds[tex->second].firstVertex;
+  const uint32_t count = std::min<uint32_t>(indirectDrawCmds[tex->second].vertexCount, keyPoints.size());
+  for (uint32_t i = 0; i < count; i++) {
+    writeKeypointVertex(vas[offset + i], image_id, keyPoints[i]);
+  }
+  memcpy(kpMaterial.vertStagePtr + offset, vas.data() + offset, count * sizeof(VertexAttribute));
+  vertexChange = true;
+}
+
+void VulkanRenderer::setKeypointColors(Image_ID_T image_id, std::vector<uint32_t> rgba) {
+  if (rgba.empty()) {
+    keypointColors.erase(image_id);
+  } else {
+    keypointColors[image_id] = std::move(rgba);
+  }
+  writeKeypointColors(image_id);
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::clearKeypointColors() {
+  auto colored = std::move(keypointColors);
+  keypointColors.clear();
+  for (const auto &it: colored) {
+    writeKeypointColors(it.first);
+  }
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::setHiddenOrigins(const std::vector<uint16_t> &origins) {
+  hiddenOrigins.clear();
+  for (const auto origin: origins) {
+    hiddenOrigins.resize(std::max<size_t>(hiddenOrigins.size(), origin + 1), false);
+    hiddenOrigins[origin] = true;
+  }
+  for (const auto &it: texIdMap) {
+    writeKeypointColors(it.first);
+  }
+  m_target->requestUpdate();
+}
+
+void VulkanRenderer::setKeypointsVisible(bool visible) {
+  keypointsVisible = visible;
+  m_target->requestUpdate();
 }
 
 void VulkanRenderer::updateImageKeypoints(int image_id) {
+  suggestions.keypointsChanged(image_id);
+  /* refinement also moves keypoints of tracked images that are not shown */
+  if (texIdMap.count(image_id) == 0) {
+    return;
+  }
   uint32_t tex_id = texIdMap.at(image_id);
   const auto &imgInfo = m_graphModel->imageInfos.at(image_id);
   uint32_t lastKpStart = indirectDrawCmds[tex_id].firstVertex;
@@ -1726,38 +2810,41 @@ void VulkanRenderer::updateImageKeypoints(int image_id) {
 
   uint32_t currKpOffset = lastKpStart;
   for (const auto &it: imgInfo.keyPoints) {
-    auto &va = vas[currKpOffset];
+    writeKeypointVertex(vas[currKpOffset], image_id, it);
     currKpOffset++;
-    va.x = it.pos.x();
-    va.y = it.pos.y();
-    if(it.track_id == std::numeric_limits<Track_ID_T>::max()){
-      va.rgba = 0xFFFF00FFu;
-    } else {
-      va.rgba = 0xFF00FFFFu;
-    }
   }
   memcpy(kpMaterial.vertStagePtr + lastKpStart, vas.data() + lastKpStart, (vas.size() - lastKpStart) * sizeof(VertexAttribute));
   writeBuffer(kpMaterial.indirectDrawBufStage.buffer, kpMaterial.indirectDrawBufStage.memory, indirectDrawCmds.data() + tex_id,
               tex_id * sizeof(VkDrawIndirectCommand), (indirectDrawCmds.size() - tex_id) * sizeof(VkDrawIndirectCommand));
 
   vertexChange = true;
-  m_window->requestUpdate();
+  updateHostMirrorGauge();
+  m_target->requestUpdate();
+  if ((myMode == RENDER_MODE_TRACK) && !editingTrack) {
+    updateSuggestions();
+  }
 }
 
 void VulkanRenderer::addTrackForKeypoint() {
 //  curr_track_id = m_graphModel->imageInfos.at(selectInfo.image_id).keyPoints.at(selectInfo.image_kp_id).track_id;
-  curr_track_id = m_graphModel->getOrCreateTrackForKeypoint(selectInfo.image_id, selectInfo.image_kp_id);
+  editTrack(m_graphModel->getOrCreateTrackForKeypoint(selectInfo.image_id, selectInfo.image_kp_id));
+}
+
+void VulkanRenderer::editTrack(Track_ID_T track_id) {
+  curr_track_id = track_id;
   m_trackScene->clear();
   const auto &track = m_graphModel->tracks.at(curr_track_id);
   for (int i = 0; i < track.images.size(); i++) {
     const auto &imgInfo = m_graphModel->imageInfos.at(track.images[i]);
     const auto &kp = imgInfo.keyPoints.at(track.kps[i]);
-    m_trackScene->addKeyPointImage(imgInfo.data, QPointF(kp.pos.x() * imgInfo.data.width() - 0.5, kp.pos.y() * imgInfo.data.height() - 0.5));
+    m_trackScene->addKeyPointImage(imageCache.image(imgInfo), QPointF(kp.pos.x() * imgInfo.size.width() - 0.5,
+                                                                     kp.pos.y() * imgInfo.size.height() - 0.5));
   }
   modifySelKpColor();
   vertexChange = true;
-  m_window->requestUpdate();
+  m_target->requestUpdate();
 
-  m_window->setCursor(Qt::PointingHandCursor);
+  m_target->setCursorShape(Qt::PointingHandCursor);
   myMode = RENDER_MODE_TRACK;
+  updateSuggestions();
 }
\ No newline at end of file
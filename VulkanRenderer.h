@@ -5,20 +5,42 @@
 #ifndef MATCH_MANUALLY_VULKANRENDERER_H
 #define MATCH_MANUALLY_VULKANRENDERER_H
 
+#include <functional>
+#include <memory>
+#include <unordered_set>
 #include <QMutex>
-#include "VulkanWindow.h"
+#include <QThreadPool>
+#include <QVulkanWindow>
+#include "RenderTarget.h"
 #include "ImageGraphModel.h"
+#include "EpipolarGeometry.h"
+#include "FrameProfiler.h"
+#include "ImageCache.h"
+#include "KeypointRefinement.h"
+#include "OutlierReview.h"
+#include "TrackSuggestions.h"
+#include "MemoryAccounting.h"
 class QMenu;
+class GraphWidget;
 
 #define MAX_IMAGE_NUM 256
+/* last texture slot is reserved for the timing overlay */
+#define OVERLAY_TEX_ID (MAX_IMAGE_NUM - 1)
 #define MAX_KEYPOINT_NUM 10000*MAX_IMAGE_NUM
+#define MAX_LINE_VERTEX_NUM 200000
 
 class VulkanRenderer : public QObject, public QVulkanWindowRenderer {
 Q_OBJECT
 public:
-  explicit VulkanRenderer(VulkanWindow *vulkanWindow, ImageGraphModel *graphModel, GraphWidget *graphicsScene);
+  struct LineSegment {
+    Image_ID_T image_ids[2];
+    Eigen::Vector2f pos[2];
+    Eigen::Vector3f color;
+  };
 
-//  ~VulkanRenderer();
+  explicit VulkanRenderer(RenderTarget *target, ImageGraphModel *graphModel, GraphWidget *graphicsScene);
+
+  ~VulkanRenderer() override;
   void preInitResources() override;
 
   void initResources() override;
@@ -39,12 +61,72 @@ public:
 
   void removeImage(int image_id);
 
+  void setImageTransform(Image_ID_T image_id, const Eigen::Matrix4f &mat);
+
+  void setProjection(const Eigen::Matrix4f &proj);
+
+  /* shown images left to right in this order, scaled to fit the window together */
+  void placeImages(const std::vector<Image_ID_T> &images);
+
+  /* segments between two keypoint positions (normalized image coordinate), segments whose images are
+   * not shown are skipped, they come back once the image is added again */
+  void setLines(std::vector<LineSegment> segments);
+
+  /* per keypoint colors (0xAABBGGRR) of one image replacing the track coloring, an empty list restores it */
+  void setKeypointColors(Image_ID_T image_id, std::vector<uint32_t> rgba);
+
+  void clearKeypointColors();
+
+  /* keypoints in tracks of these reconstructions (ImageGraphModel::origins) are not drawn */
+  void setHiddenOrigins(const std::vector<uint16_t> &origins);
+
+  void setKeypointsVisible(bool visible);
+
+  /* while a track is edited, the epipolar lines of the hovered point are drawn in every other shown image */
+  void setEpipolarLinesVisible(bool visible);
+
+  /* while a track is edited, the best candidates to extend it are highlighted in every shown image, return
+   * adds the best one of every image to the track */
+  void setSuggestionsVisible(bool visible);
+
+  /* track mode, moves every observation of the current track to the sub-pixel position where its patch matches
+   * the first observation best (key R), returns the number of moved keypoints */
+  size_t refineCurrentTrack();
+
+  /* number of suspicious observations */
+  typedef std::function<void(size_t suspicious)> ReviewCallback;
+
+  /*
+   * scores every track observation (OutlierReview) and keeps the queue up to date while tracks are edited and
+   * triangulated, off drops it. the full pass runs on reviewPool, done is called on the gui thread once its queue
+   * is in place and not at all when the review was turned off or the model reset in the meantime
+   */
+  void setOutlierReviewEnabled(bool enable, const ReviewCallback &done = {});
+
+  /* the full pass is still running, the queue is empty until it is done */
+  bool outlierReviewScoring() const { return reviewScoring; }
+
+  /*
+   * shows the images of the track of the most suspicious observation side by side, edits that track and highlights
+   * the observation (key N). the images and patches of the next steps are loaded in the background of the event
+   * loop. false when the queue is empty
+   */
+  bool reviewNextOutlier();
+
+  size_t outlierCount() const { return outlierReview.size(); }
+
+  FrameProfiler &frameProfiler() { return profiler; }
+
+  void setProfilerOverlayVisible(bool visible);
+
   void mousePressEvent(QMouseEvent *e);
 
   void mouseReleaseEvent(QMouseEvent *e);
 
   void mouseMoveEvent(QMouseEvent *e);
 
+  void keyPressEvent(QKeyEvent *e);
+
   void wheelEvent(QWheelEvent *e);
 
 public slots:
@@ -55,9 +137,11 @@ public slots:
 
   void addTrackForKeypoint();
 
+  void trackChanged(Track_ID_T track_id);
+
 private:
   const VkFormat select_image_format = VK_FORMAT_R32G32B32A32_SFLOAT;
-  VulkanWindow *m_window;
+  RenderTarget *m_target;
   QMenu *actionMenu;
   enum {
     RENDER_MODE_NORMAL,
@@ -66,6 +150,10 @@ private:
   Track_ID_T curr_track_id = std::numeric_limits<Track_ID_T>::max();
   ImageGraphModel *m_graphModel;
   GraphWidget *m_trackScene;
+  ImageCache imageCache;
+  /* device memory per allocation so frees can be attributed, and the cpu side copies of the vertex data */
+  std::map<VkDeviceMemory, std::pair<MemoryAccounting::Subsystem, VkDeviceSize>> deviceAllocations;
+  MemoryAccounting::Gauge hostMirrorMemory{MemoryAccounting::RENDERER_BUFFERS, MemoryAccounting::HOST};
 
   VkDevice dev = VK_NULL_HANDLE;
   QVulkanDeviceFunctions *m_devFuncs = nullptr;
@@ -118,7 +206,41 @@ private:
     float height;
   };
   static_assert(sizeof(LineInfo[2]) == (16 + 3 + 1 + 2 + 2) * sizeof(float) * 2, "aa");
-  std::vector<LineInfo> lines;
+  std::vector<LineSegment> lines;
+  std::vector<LineSegment> epipolarLines;
+  EpipolarGeometry epipolar;
+  bool epipolarLinesVisible = true;
+  TrackSuggestions suggestions;
+  std::vector<TrackSuggestions::Suggestion> suggested;
+  /* highlight per suggested keypoint, keyed by image_id << 32 | kp_id */
+  std::unordered_map<uint64_t, uint32_t> suggestionColors;
+  bool suggestionsVisible = true;
+  /* a batch edit of the current track runs, suggestions are updated once at its end */
+  bool editingTrack = false;
+  GrayPyramids grayImages;
+  /* over the track patch budget the gray images of images that are not shown are dropped, prefetched ones too */
+  int grayEvictionCallback;
+  KeypointRefinement refinement;
+  OutlierReview outlierReview;
+  bool outlierReviewEnabled = false;
+  /* observation shown by the last review step, image_id << 32 | kp_id */
+  uint64_t reviewedKeypoint = std::numeric_limits<uint64_t>::max();
+  /* images of a review step, the first steps after it fill the rest of the image cache */
+  static constexpr size_t kMaxReviewImages = 8;
+  static constexpr size_t kReviewPrefetch = 3;
+  /* gray images loaded ahead, dropped again once they are no longer ahead unless they are shown */
+  std::vector<Image_ID_T> prefetchedImages;
+  /* decodes the images loaded ahead and runs the full pass, results of an older prefetch, pass or model are dropped */
+  QThreadPool reviewPool;
+  uint64_t reviewPrefetchGeneration = 0;
+  uint64_t reviewScoringGeneration = 0;
+  bool reviewScoring = false;
+  /* tracks edited while the full pass runs on the copy of the model, rescored once it is done */
+  std::unordered_set<Track_ID_T> reviewStaleTracks;
+  std::map<Image_ID_T, std::vector<uint32_t>> keypointColors;
+  std::vector<bool> hiddenOrigins;
+  uint32_t lineVertexCount = 0;
+  bool keypointsVisible = true;
 
   struct VertexAttribute {
     float x;
@@ -128,6 +250,22 @@ private:
   std::vector<VertexAttribute> vas;
   std::vector<VkDrawIndirectCommand> indirectDrawCmds;
 
+  /* query 0 and 1 time the stage command buffer, then frameQuerySlots groups of frameQueryCount
+   * timestamps for the frames in flight */
+  static constexpr uint32_t stageQueryCount = 2;
+  static constexpr uint32_t frameQueryCount = 4;
+  static constexpr uint32_t frameQuerySlots = 4;
+  FrameProfiler profiler;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  uint64_t timestampMask = 0;
+  double timestampPeriodMs = 0;
+  bool frameQueryWritten[frameQuerySlots] = {};
+  FrameProfiler::Phase stageGpuPhase = FrameProfiler::GPU_STAGE_COPY;
+  bool profilerOverlayVisible = false;
+  TextureData overlayTex = {-1, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+  QSize overlaySize;
+  uint64_t overlayFrame = 0;
+
   VkFence fence = VK_NULL_HANDLE;
   VkCommandBuffer stageCB = VK_NULL_HANDLE;
   VkCommandPool stagePool = VK_NULL_HANDLE;
@@ -155,6 +293,7 @@ private:
   } kpMaterial;
 
   struct {
+    LineInfo *vertStagePtr;
     BufferData vertStage;
     BufferData vert;
     VkPipelineLayout pipelineLayout;
@@ -185,6 +324,13 @@ private:
 
   uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
 
+  VkResult allocateMemory(const VkMemoryAllocateInfo *info, VkDeviceMemory *memory,
+                          MemoryAccounting::Subsystem subsystem);
+
+  void freeMemory(VkDeviceMemory memory);
+
+  void updateHostMirrorGauge();
+
   VkFormat getSupportedDepthFormat();
 
   BufferData createBuffer(uint32_t len, VkBufferUsageFlags usage, bool hostAccessEnable);
@@ -216,6 +362,56 @@ private:
 
   void updateResources();
 
+  void updateLineVertices();
+
+  bool hasLines() const { return !lines.empty() || !epipolarLines.empty(); }
+
+  /* image under the cursor and the normalized position on it, cpu side so hovering does not stall on a pick pass */
+  bool hoveredImage(const QPointF &pos, Image_ID_T *image_id, Eigen::Vector2f *uv) const;
+
+  void updateEpipolarLines(const QPointF &pos);
+
+  void connectModel();
+
+  void updateSuggestions();
+
+  void acceptSuggestions();
+
+  void loadGrayImage(Image_ID_T image_id);
+
+  /* track mode on the track, its patches in the track view */
+  void editTrack(Track_ID_T track_id);
+
+  void updateOutliers(Track_ID_T track_id);
+
+  void setImageShown(Image_ID_T image_id, bool shown);
+
+  /* decodes the images of the next review steps on reviewPool, reviewPrefetched rescores their tracks */
+  void prefetchReview();
+
+  /* on the gui thread, swaps in the full pass and rescores what it could not see */
+  void reviewScored(uint64_t generation, const std::shared_ptr<OutlierReview> &review, const ReviewCallback &done);
+
+  /* on the gui thread, the color and gray images decoded for ids */
+  void reviewPrefetched(uint64_t generation, const std::vector<Image_ID_T> &ids,
+                        const std::vector<std::pair<QImage, QImage>> &images, const std::vector<Track_ID_T> &rescore);
+
+  /* adds the patch of a keypoint that just joined the current track to the track view */
+  void showTrackKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id);
+
+  /* one vertex of a shown image, after its color or visibility changed */
+  void rewriteKeypoint(Image_ID_T image_id, KeyPoint_ID_T kp_id);
+
+  uint32_t keypointColor(Image_ID_T image_id, const KeyPoint &kp) const;
+
+  bool keypointHidden(const KeyPoint &kp) const;
+
+  void writeKeypointVertex(VertexAttribute &va, Image_ID_T image_id, const KeyPoint &kp) const;
+
+  void writeKeypointColors(Image_ID_T image_id);
+
+  void releaseRemovedImages();
+
   void createStageCommandBuffer();
 
   void createBuffers();
@@ -224,6 +420,12 @@ private:
 
   void createDescriptorSets();
 
+  QString pipelineCachePath() const;
+
+  void createPipelineCache();
+
+  void savePipelineCache();
+
   void createPipelineLayouts();
 
   void createSelRenderPass();
@@ -231,6 +433,18 @@ private:
   void createPipelines();
 
   void selectObject(const QPoint &pos);
+
+  void createQueryPool();
+
+  void writeTimestamp(VkCommandBuffer cb, VkPipelineStageFlagBits stage, uint32_t query);
+
+  double timestampDelta(uint64_t begin, uint64_t end) const;
+
+  void collectFrameTimestamps(uint32_t slot);
+
+  void updateOverlay();
+
+  void drawOverlay(VkCommandBuffer cb);
 };
 
 
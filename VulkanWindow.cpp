@@ -28,6 +28,11 @@ void VulkanWindow::setTrackScene(GraphWidget *trackScene) {
   }
 }
 
+void VulkanWindow::requestSampleCount(int sampleCount) {
+  Q_ASSERT(supportedSampleCounts().contains(sampleCount));
+  setSampleCount(sampleCount);
+}
+
 void VulkanWindow::mousePressEvent(QMouseEvent *e) {
   m_renderer->mousePressEvent(e);
 }
@@ -40,6 +45,10 @@ void VulkanWindow::mouseMoveEvent(QMouseEvent *e) {
   m_renderer->mouseMoveEvent(e);
 }
 
+void VulkanWindow::keyPressEvent(QKeyEvent *e) {
+  m_renderer->keyPressEvent(e);
+}
+
 void VulkanWindow::wheelEvent(QWheelEvent *e) {
   m_renderer->wheelEvent(e);
 }
@@ -7,6 +7,7 @@
 
 #include <Eigen/Eigen>
 #include <QVulkanWindow>
+#include "RenderTarget.h"
 
 class GraphWidget;
 
@@ -14,7 +15,7 @@ class VulkanRenderer;
 
 class ImageGraphModel;
 
-class VulkanWindow : public QVulkanWindow {
+class VulkanWindow : public QVulkanWindow, public RenderTarget {
   Q_OBJECT
 public:
   QVulkanWindowRenderer *createRenderer() override;
@@ -22,10 +23,33 @@ public:
   void setModel(ImageGraphModel *model);
   void setTrackScene(GraphWidget *trackScene);
 
+  /* null until the window is exposed for the first time */
+  VulkanRenderer *renderer() const { return m_renderer; }
+
+  QVulkanInstance *vulkanInstance() const override { return QVulkanWindow::vulkanInstance(); }
+  VkPhysicalDevice physicalDevice() const override { return QVulkanWindow::physicalDevice(); }
+  const VkPhysicalDeviceProperties *physicalDeviceProperties() const override {
+    return QVulkanWindow::physicalDeviceProperties();
+  }
+  VkDevice device() const override { return QVulkanWindow::device(); }
+  VkQueue graphicsQueue() const override { return QVulkanWindow::graphicsQueue(); }
+  uint32_t graphicsQueueFamilyIndex() const override { return QVulkanWindow::graphicsQueueFamilyIndex(); }
+  VkRenderPass defaultRenderPass() const override { return QVulkanWindow::defaultRenderPass(); }
+  VkSampleCountFlagBits sampleCountFlagBits() const override { return QVulkanWindow::sampleCountFlagBits(); }
+  QSize swapChainImageSize() const override { return QVulkanWindow::swapChainImageSize(); }
+  VkCommandBuffer currentCommandBuffer() const override { return QVulkanWindow::currentCommandBuffer(); }
+  VkFramebuffer currentFramebuffer() const override { return QVulkanWindow::currentFramebuffer(); }
+  void frameReady() override { QVulkanWindow::frameReady(); }
+  void requestUpdate() override { QVulkanWindow::requestUpdate(); }
+  void requestSampleCount(int sampleCount) override;
+  void setCursorShape(Qt::CursorShape shape) override { setCursor(shape); }
+  qreal devicePixelRatio() const override { return QVulkanWindow::devicePixelRatio(); }
+
 private:
   void mousePressEvent(QMouseEvent * e) override;
   void mouseReleaseEvent(QMouseEvent *e) override;
   void mouseMoveEvent(QMouseEvent *e) override;
+  void keyPressEvent(QKeyEvent *e) override;
   void wheelEvent(QWheelEvent * e) override;
 
   VulkanRenderer *m_renderer = nullptr;
@@ -0,0 +1,633 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include "BenchBaseline.h"
+#include "CameraModels.h"
+#include "GeometricVerification.h"
+#include "GrayPyramids.h"
+#include "ImageGraphModel.h"
+#include "KeypointIndex.h"
+#include "KeypointRefinement.h"
+#include "OutlierReview.h"
+#include "ProjectCache.h"
+#include "ReconstructionDiff.h"
+#include "ReprojectionErrors.h"
+#include "SyntheticColmap.h"
+#include "TrackSuggestions.h"
+#include "Triangulation.h"
+#include "colampParser.h"
+
+namespace fs = boost::filesystem;
+
+/*
+ * parser and model benchmarks on a synthetic colmap model, every case reports the median of --repeat runs,
+ * throughput in items (images, observations, keypoints, merges) per second and the peak rss growth of the case.
+ * with --baseline the results are checked against the stored expectations, ctest runs it that way
+ */
+namespace {
+long startRssKb = 0;
+
+/* keeps the optimizer from dropping benchmark loops */
+volatile size_t benchSink;
+
+/* the model warns on every track merge, keep stderr out of the measurement */
+void quietMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &msg) {
+  if ((type == QtCriticalMsg) || (type == QtFatalMsg)) {
+    fprintf(stderr, "%s\n", qPrintable(msg));
+  }
+}
+
+long peakRssKb() {
+  struct rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/* a field of /proc/self/status in kB, -1 when it is missing */
+long statusKb(const char *field) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  const size_t length = strlen(field);
+  while (std::getline(status, line)) {
+    if (line.compare(0, length, field) == 0) {
+      return std::atol(line.c_str() + length);
+    }
+  }
+  return -1;
+}
+
+/* lowers VmHWM to the current rss so a case does not inherit the peaks of the cases before it */
+bool resetPeakRss() {
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5";
+  clearRefs.close();
+  return clearRefs.good() && (statusKb("VmHWM:") >= 0);
+}
+
+double timeIt(const std::function<void()> &f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * setup runs untimed before every repetition. the peak rss is counted from the rss at the start of the case,
+ * kernels without clear_refs fall back to the growth of the process peak since startup
+ */
+BenchResult runCase(const std::string &name, int repeat, uint64_t items, uint64_t bytes,
+                    const std::function<void()> &setup, const std::function<void()> &body) {
+  const long startKb = resetPeakRss() ? statusKb("VmRSS:") : -1;
+  std::vector<double> times;
+  for (int i = 0; i < repeat; i++) {
+    setup();
+    times.push_back(timeIt(body));
+  }
+  std::sort(times.begin(), times.end());
+  const long peakKb = startKb >= 0 ? statusKb("VmHWM:") - startKb : peakRssKb() - startRssKb;
+  return {name, times[times.size() / 2], items, bytes, std::max(peakKb, 0L)};
+}
+
+/* drops the cached pages of a file so the next read goes to the disk, files must be written back first */
+void evictPageCache(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd != -1) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+/* b side of the diff case: every 10th track split in halves, every 7th dropped */
+void perturbReconstruction(ColmapLoader *loader) {
+  std::unordered_map<ColmapLoader::image_t, size_t> imageIndex;
+  for (size_t i = 0; i < loader->imagesInfo.size(); i++) {
+    imageIndex[loader->imagesInfo[i].image_id] = i;
+  }
+  ColmapLoader::point3D_t nextId = 0;
+  for (const auto &p: loader->points3D) {
+    nextId = std::max(nextId, p.point3D_id + 1);
+  }
+  std::vector<ColmapLoader::Point3D> points;
+  points.reserve(loader->points3D.size() * 11 / 10);
+  for (size_t t = 0; t < loader->points3D.size(); t++) {
+    auto &p = loader->points3D[t];
+    if (t % 7 == 0) {
+      for (const auto &obs: p.track) {
+        loader->imagesInfo[imageIndex.at(obs.first)].point3D_ids[obs.second] = ColmapLoader::kInvalidPoint3DId;
+      }
+      continue;
+    }
+    if ((t % 10 == 0) && (p.track.size() >= 4)) {
+      auto half = p;
+      half.point3D_id = nextId++;
+      half.track.assign(p.track.begin() + p.track.size() / 2, p.track.end());
+      p.track.resize(p.track.size() / 2);
+      for (const auto &obs: half.track) {
+        loader->imagesInfo[imageIndex.at(obs.first)].point3D_ids[obs.second] = half.point3D_id;
+      }
+      points.push_back(std::move(half));
+    }
+    points.push_back(std::move(p));
+  }
+  loader->points3D = std::move(points);
+}
+
+void printResult(const BenchResult &r) {
+  printf("%-16s %10.2f ms %14.0f items/s %10.1f MB/s %10.1f MB peak rss\n", r.name.c_str(), r.seconds * 1e3,
+         r.itemsPerSecond(), r.bytes / std::max(r.seconds, 1e-9) / (1 << 20), r.peakRssKb / 1024.);
+}
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("match_bench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("benchmark colmap loading and model edits on a synthetic reconstruction");
+  parser.addHelpOption();
+  QCommandLineOption imagesOption("images", "number of images", "n", "1000");
+  QCommandLineOption keypointsOption("keypoints", "keypoints per image", "n", "2000");
+  QCommandLineOption trackedOption("tracked", "share of keypoints in tracks", "f", "0.5");
+  QCommandLineOption trackMinOption("track-min", "shortest track", "n", "2");
+  QCommandLineOption trackMaxOption("track-max", "longest track", "n", "20");
+  QCommandLineOption trackDecayOption("track-decay", "P(len) ~ decay^(len - min)", "f", "0.7");
+  QCommandLineOption seedOption("seed", "random seed", "n", "1");
+  QCommandLineOption dirOption("dir", "keep the model in this directory, reused when it exists", "dir");
+  QCommandLineOption repeatOption("repeat", "runs per case, the median is reported", "n", "3");
+  QCommandLineOption appendsOption("appends", "keypoints appended in the append case", "n", "100000");
+  QCommandLineOption mergesOption("merges", "track merges in the merge case", "n", "10000");
+  QCommandLineOption coldOption("cold", "evict the model from the page cache before every load run");
+  QCommandLineOption casesOption("cases", "comma separated cases to report, all by default", "list");
+  QCommandLineOption baselineOption("baseline", "fail when a case regressed against this baseline", "file");
+  QCommandLineOption updateBaselineOption("update-baseline", "write the results as new baseline", "file");
+  parser.addOptions({imagesOption, keypointsOption, trackedOption, trackMinOption, trackMaxOption,
+                     trackDecayOption, seedOption, dirOption, repeatOption, appendsOption, mergesOption,
+                     coldOption, casesOption, baselineOption, updateBaselineOption});
+  parser.process(app);
+  startRssKb = peakRssKb();
+
+  const int repeat = std::max(1, parser.value(repeatOption).toInt());
+  const QStringList cases = parser.value(casesOption).split(',', Qt::SkipEmptyParts);
+  auto selected = [&](const std::string &name) {
+    return cases.isEmpty() || cases.contains(QString::fromStdString(name));
+  };
+  auto anySelected = [&](std::initializer_list<const char *> names) {
+    return std::any_of(names.begin(), names.end(), [&](const char *name) { return selected(name); });
+  };
+  std::vector<BenchResult> results;
+  /* cases that are not selected do not run, cases with expensive preparation check selected() around it */
+  auto bench = [&](const std::string &name, uint64_t items, uint64_t bytes, const std::function<void()> &setup,
+                   const std::function<void()> &body) {
+    if (selected(name)) {
+      results.push_back(runCase(name, repeat, items, bytes, setup, body));
+      printResult(results.back());
+    }
+  };
+
+  qInstallMessageHandler(quietMessageHandler);
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+
+  SyntheticColmapOptions options;
+  options.images = parser.value(imagesOption).toUInt();
+  options.keypointsPerImage = parser.value(keypointsOption).toUInt();
+  options.trackedFraction = parser.value(trackedOption).toDouble();
+  options.trackLengthMin = parser.value(trackMinOption).toUInt();
+  options.trackLengthMax = parser.value(trackMaxOption).toUInt();
+  options.trackLengthDecay = parser.value(trackDecayOption).toDouble();
+  options.seed = parser.value(seedOption).toULongLong();
+
+  const bool keep = parser.isSet(dirOption);
+  const std::string dir = keep ? parser.value(dirOption).toStdString() :
+                          (fs::temp_directory_path() / fs::unique_path("match_bench_%%%%%%%%")).string();
+  if (!keep || !fs::exists(dir + "/points3D.bin")) {
+    SyntheticColmapSummary summary;
+    const double seconds = timeIt([&]() { writeSyntheticColmap(dir, options, &summary); });
+    if (summary.bytes == 0) {
+      return 1;
+    }
+    printf("generated %u images, %lu points, %lu observations, %.1f MB in %.2f s at %s\n", options.images,
+           summary.points3D, summary.observations, summary.bytes / double(1 << 20), seconds, dir.c_str());
+  }
+  uint64_t modelBytes = 0;
+  for (const char *file: {"/cameras.bin", "/images.bin", "/points3D.bin"}) {
+    modelBytes += fs::file_size(dir + file);
+  }
+
+  /* cases that check their results clear it */
+  bool checksOk = true;
+
+  /* removes the model unless kept and checks or updates the baseline, the exit code of the run */
+  auto finish = [&]() {
+    if (!keep) {
+      fs::remove_all(dir);
+    }
+
+    /* numbers are only comparable on the same synthetic model */
+    char dataset[256];
+    snprintf(dataset, sizeof(dataset), "images=%u keypoints=%u tracked=%g track=%u-%u decay=%g seed=%lu",
+             options.images, options.keypointsPerImage, options.trackedFraction, options.trackLengthMin,
+             options.trackLengthMax, options.trackLengthDecay, options.seed);
+    bool ok = true;
+    if (parser.isSet(baselineOption)) {
+      BenchBaseline baseline;
+      if (!baseline.read(parser.value(baselineOption).toStdString())) {
+        return 1;
+      }
+      if (baseline.dataset != dataset) {
+        fprintf(stderr, "baseline is for \"%s\", this run used \"%s\"\n", baseline.dataset.c_str(), dataset);
+        return 1;
+      }
+      ok = baseline.compare(results);
+    }
+    if (parser.isSet(updateBaselineOption)) {
+      BenchBaseline baseline;
+      if (fs::exists(parser.value(updateBaselineOption).toStdString())) {
+        baseline.read(parser.value(updateBaselineOption).toStdString());
+      }
+      if (baseline.dataset != dataset) {
+        baseline.entries.clear();
+      }
+      baseline.dataset = dataset;
+      if (!baseline.write(parser.value(updateBaselineOption).toStdString(), results)) {
+        return 1;
+      }
+    }
+    return ok && checksOk ? 0 : 1;
+  };
+
+  const bool cold = parser.isSet(coldOption);
+  auto loadSetup = [&](std::unique_ptr<ColmapLoader> &loader) {
+    loader.reset();
+    loader = std::make_unique<ColmapLoader>();
+    if (cold) {
+      for (const char *file: {"/cameras.bin", "/images.bin", "/points3D.bin"}) {
+        evictPageCache(dir + file);
+      }
+    }
+  };
+  /* load_<io> compare the reader backends, run once warm and once with --cold */
+  for (const auto io: {BinaryReader::MMAP, BinaryReader::PREAD}) {
+    std::unique_ptr<ColmapLoader> ioLoader;
+    bench(std::string("load_") + BinaryReader::strategyName(io), options.images, modelBytes,
+          [&]() { loadSetup(ioLoader); },
+          [&]() { ioLoader->loadFromColmapSparseDir(dir, io); });
+  }
+
+  /* the cases after load work on the loaded model, after append on the ImageGraphModel built from it */
+  const auto modelCases = {"append", "reprojection", "cache_write", "cache_open", "picking_index", "picking_query",
+                           "suggestions", "refine", "verify_read", "verify", "triangulate", "outliers",
+                           "keypoint_append", "track_merge"};
+  std::unique_ptr<ColmapLoader> loader;
+  bench("load", options.images, modelBytes,
+        [&]() { loadSetup(loader); },
+        [&]() { loader->loadFromColmapSparseDir(dir); });
+  if (!anySelected({"diff", "camera_undistort"}) && !anySelected(modelCases)) {
+    return finish();
+  }
+  if (!loader) {
+    loadSetup(loader);
+    loader->loadFromColmapSparseDir(dir);
+  }
+  uint64_t observations = 0;
+  for (const auto &p: loader->points3D) {
+    observations += p.track.size();
+  }
+
+  /* items are the observations of a */
+  if (selected("diff")) {
+    ColmapLoader other;
+    other.imagesInfo = loader->imagesInfo;
+    other.camerasInfo = loader->camerasInfo;
+    other.points3D = loader->points3D;
+    perturbReconstruction(&other);
+    bench("diff", observations, 0, []() {},
+          [&]() { benchSink = ReconstructionDiff::compute(*loader, other).summary.split; });
+  }
+
+  /* every keypoint through the newton undistortion, the synthetic pinhole camera gets opencv distortion */
+  if (selected("camera_undistort")) {
+    std::vector<Eigen::Vector2d> pixels, normalized;
+    for (const auto &img: loader->imagesInfo) {
+      pixels.insert(pixels.end(), img.points2D.begin(), img.points2D.end());
+    }
+    normalized.resize(pixels.size());
+    auto camera = loader->camerasInfo.front();
+    camera.model_id = OpenCVCameraModel::kModelId;
+    camera.params.insert(camera.params.end(), {0.05, -0.01, 0.001, -0.002});
+    bench("camera_undistort", pixels.size(), 0, []() {}, [&]() {
+      benchSink = CameraModel::undistort(camera, pixels.data(), normalized.data(), pixels.size());
+    });
+  }
+
+  if (!anySelected(modelCases)) {
+    return finish();
+  }
+  std::unique_ptr<ImageGraphModel> model;
+  bench("append", observations, 0,
+        [&]() {
+          model.reset();
+          model = std::make_unique<ImageGraphModel>();
+        },
+        [&]() { model->appendColmapData(QString(), *loader); });
+  if (!model) {
+    model = std::make_unique<ImageGraphModel>();
+    model->appendColmapData(QString(), *loader);
+  }
+  loader.reset();
+
+  /* every observation projected with its image pose and camera, items are observations */
+  ReprojectionErrors errors;
+  bench("reprojection", observations, 0, []() {}, [&]() { errors.compute(*model); });
+  errors.clear();
+
+  /* reopen through the project cache, items are observations as for append */
+  const std::string cachePath = ProjectCache::defaultPath(dir);
+  bench("cache_write", observations, 0, []() {}, [&]() { model->saveProjectCache(cachePath, "match_bench"); });
+  if (selected("cache_open")) {
+    if (!fs::exists(cachePath)) {
+      model->saveProjectCache(cachePath, "match_bench");
+    }
+    std::unique_ptr<ImageGraphModel> cached;
+    bench("cache_open", observations, fs::file_size(cachePath),
+          [&]() {
+            cached.reset();
+            cached = std::make_unique<ImageGraphModel>();
+          },
+          [&]() { cached->loadProjectCache(cachePath, "match_bench"); });
+  }
+
+  uint64_t keypoints = 0;
+  for (const auto &it: model->imageInfos) {
+    keypoints += it.second.keyPoints.size();
+  }
+  std::vector<KeypointIndex> indices(model->imageInfos.size());
+  auto buildIndices = [&]() {
+    size_t i = 0;
+    for (const auto &it: model->imageInfos) {
+      indices[i++].build(it.second.keyPoints);
+    }
+  };
+  bench("picking_index", keypoints, 0, []() {}, buildIndices);
+
+  std::mt19937_64 rng(options.seed);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::vector<Eigen::Vector2f> queries(100000);
+  for (auto &q: queries) {
+    q = Eigen::Vector2f(unit(rng), unit(rng));
+  }
+  if (selected("picking_query")) {
+    if (!selected("picking_index")) {
+      buildIndices();
+    }
+    bench("picking_query", queries.size(), 0, []() {}, [&]() {
+      size_t hits = 0;
+      for (size_t i = 0; i < queries.size(); i++) {
+        hits += indices[i % indices.size()].nearest(queries[i], 0.01f) != KeypointIndex::npos;
+      }
+      benchSink = hits;
+    });
+  }
+  std::vector<KeypointIndex>().swap(indices);
+
+  /* the first tracks extended into 32 shown images, the patches are cut from one noise image */
+  if (selected("suggestions")) {
+    TrackSuggestions suggestions;
+    GrayPyramids pyramids;
+    std::vector<uint8_t> noise(640 * 480);
+    for (auto &v: noise) {
+      v = static_cast<uint8_t>(rng());
+    }
+    std::vector<Image_ID_T> shown;
+    for (auto it = model->imageInfos.begin(); (it != model->imageInfos.end()) && (shown.size() < 32); ++it) {
+      shown.push_back(it->first);
+      pyramids.setImage(it->first, noise.data(), 640, 480, 640);
+    }
+    std::vector<Track_ID_T> suggestTracks;
+    for (auto it = model->tracks.begin(); (it != model->tracks.end()) && (suggestTracks.size() < 100); ++it) {
+      suggestTracks.push_back(it->first);
+    }
+    bench("suggestions", suggestTracks.size() * shown.size(), 0, []() {}, [&]() {
+      size_t found = 0;
+      for (const auto track_id: suggestTracks) {
+        found += suggestions.suggest(*model, pyramids, track_id, shown).size();
+      }
+      benchSink = found;
+    });
+  }
+
+  /* 1000 keypoint refinements between a smooth pattern and a shifted copy, each starting up to 8 px off */
+  if (selected("refine")) {
+    const int width = 1024;
+    const int height = 768;
+    auto pattern = [](double x, double y) {
+      return 128 + 40 * std::sin(0.11 * x + 0.07 * y) + 40 * std::sin(0.05 * x - 0.13 * y + 1);
+    };
+    const Eigen::Vector2d shift(3.3, -2.6);
+    GrayPyramids pyramids;
+    std::vector<uint8_t> gray(width * height);
+    for (int i = 0; i < 2; i++) {
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          gray[y * width + x] = static_cast<uint8_t>(std::lround(pattern(x - i * shift.x(), y - i * shift.y())));
+        }
+      }
+      pyramids.setImage(i, gray.data(), width, height, width);
+    }
+    std::vector<std::pair<Eigen::Vector2f, Eigen::Vector2f>> starts(1000);
+    for (auto &s: starts) {
+      const Eigen::Vector2d ref(100 + (width - 200) * unit(rng), 100 + (height - 200) * unit(rng));
+      const Eigen::Vector2d start = ref + shift + Eigen::Vector2d(16 * unit(rng) - 8, 16 * unit(rng) - 8);
+      s.first = Eigen::Vector2f((ref.x() + 0.5) / width, (ref.y() + 0.5) / height);
+      s.second = Eigen::Vector2f((start.x() + 0.5) / width, (start.y() + 0.5) / height);
+    }
+    KeypointRefinement refinement;
+    bench("refine", starts.size(), 0, []() {}, [&]() {
+      size_t valid = 0;
+      for (const auto &s: starts) {
+        valid += refinement.refine(pyramids, 0, s.first, 1, s.second).valid;
+      }
+      benchSink = valid;
+    });
+  }
+
+  /*
+   * every pair of 200 images (19,900 pairs) read from a feature database and verified as the verify pairs action
+   * does it. the images look at one scene from a grid of positions, every keypoint of a pair is matched and 30% of
+   * the matches go to a wrong keypoint. unregistered images so every pair estimates F, items are pairs. the split
+   * is checked against the ground truth, keypoint k of one image only matches keypoint k of another
+   */
+  if (anySelected({"verify_read", "verify"})) {
+    const uint32_t imageCount = 200, pointCount = 100, width = 4000, height = 3000;
+    const double focal = 3000;
+    std::vector<Eigen::Vector3d> points(pointCount);
+    for (auto &X: points) {
+      X = Eigen::Vector3d(4 * unit(rng) - 2, 4 * unit(rng) - 2, 4 * unit(rng) - 2);
+    }
+    ColmapLoader scene;
+    scene.camerasInfo.push_back({1, PinholeCameraModel::kModelId, width, height,
+                                 {focal, focal, width / 2., height / 2.}});
+    for (uint32_t i = 0; i < imageCount; i++) {
+      /* 20 x 10 positions 0.4 apart at distance 12, far enough apart for every pair to have parallax */
+      const Eigen::Vector3d c(0.4 * (i % 20) - 3.8 + 0.1 * unit(rng), 0.4 * (i / 20) - 1.8 + 0.1 * unit(rng), -12);
+      const Eigen::Vector3d z = -c.normalized();
+      const Eigen::Vector3d x = Eigen::Vector3d::UnitY().cross(z).normalized();
+      Eigen::Matrix3d R;
+      R << x.transpose(), z.cross(x).transpose(), z.transpose();
+      ColmapLoader::SceneImageInfo image{};
+      image.image_id = i + 1;
+      image.camera_id = 1;
+      image.name = "verify_" + std::to_string(i) + ".jpg";
+      for (const auto &X: points) {
+        const Eigen::Vector3d p = R * (X - c);
+        image.points2D.emplace_back(focal * p.x() / p.z() + width / 2., focal * p.y() / p.z() + height / 2.);
+      }
+      scene.imagesInfo.push_back(std::move(image));
+    }
+    std::vector<ColmapDatabase::PairMatches> sceneMatches;
+    for (uint32_t a = 1; a <= imageCount; a++) {
+      for (uint32_t b = a + 1; b <= imageCount; b++) {
+        ColmapDatabase::PairMatches pair{a, b, {}};
+        for (uint32_t k = 0; k < pointCount; k++) {
+          const auto wrong = (k + 1 + static_cast<uint32_t>(unit(rng) * (pointCount - 1))) % pointCount;
+          pair.matches.emplace_back(k, unit(rng) < 0.3f ? wrong : k);
+        }
+        sceneMatches.push_back(std::move(pair));
+      }
+    }
+    const std::string databasePath = dir + "/verify.db";
+    fs::remove(databasePath);
+    auto database = std::make_shared<ColmapDatabase>();
+    ImageGraphModel matchModel;
+    if (!writeSyntheticDatabase(databasePath, scene, sceneMatches) || !database->open(databasePath) ||
+        !matchModel.appendColmapDatabase(QString(), database)) {
+      fprintf(stderr, "can not create the verify database %s\n", databasePath.c_str());
+      checksOk = false;
+      return finish();
+    }
+    const std::vector<Image_ID_T> images = matchModel.imageIndex;
+    const uint64_t pairCount = sceneMatches.size();
+    std::vector<GeometricVerification::Pair> pairs;
+    bench("verify_read", pairCount, 0, []() {}, [&]() {
+      pairs = GeometricVerification::databasePairs(matchModel, images, ColmapDatabase::RAW_MATCHES);
+      benchSink = pairs.size();
+    });
+    if (pairs.empty()) {
+      pairs = GeometricVerification::databasePairs(matchModel, images, ColmapDatabase::RAW_MATCHES);
+    }
+    GeometricVerification verification;
+    std::vector<GeometricVerification::Result> results;
+    bench("verify", pairCount, 0, []() {}, [&]() {
+      results = verification.verifyPairs(matchModel, pairs);
+      benchSink = results.size();
+    });
+    if (selected("verify")) {
+      uint64_t verified = 0, inliers = 0, kept = 0, outliers = 0, accepted = 0;
+      for (size_t i = 0; i < results.size(); i++) {
+        verified += results[i].verified;
+        for (size_t k = 0; k < pairs[i].matches.size(); k++) {
+          const bool inlier = pairs[i].matches[k].first == pairs[i].matches[k].second;
+          const bool found = results[i].verified && results[i].inliers[k];
+          inliers += inlier;
+          kept += inlier && found;
+          outliers += !inlier;
+          accepted += !inlier && found;
+        }
+      }
+      /* a wrong keypoint can lie on the epipolar line by chance, a few are accepted */
+      if ((pairs.size() != pairCount) || (verified != pairCount) || (kept < inliers * 0.99) ||
+          (accepted > outliers * 0.02)) {
+        fprintf(stderr, "verify: %lu of %lu pairs read, %lu verified, %lu of %lu inliers kept, %lu of %lu outliers "
+                        "accepted\n", pairs.size(), pairCount, verified, kept, inliers, accepted, outliers);
+        checksOk = false;
+      }
+    }
+  }
+
+  /* every track of the model from its keypoints, items are tracks */
+  Triangulation triangulation;
+  bench("triangulate", model->tracks.size(), 0, []() {},
+        [&]() { benchSink = triangulation.triangulateAll(*model); });
+
+  /*
+   * every observation scored without patches, items are observations. the synthetic geometry is not consistent
+   * so most of them are queued, the worst case for the queue
+   */
+  if (selected("outliers")) {
+    uint64_t observations = 0;
+    for (const auto &it: model->tracks) {
+      observations += it.second.images.size();
+    }
+    OutlierReview review;
+    bench("outliers", observations, 0, []() {}, [&]() {
+      review.compute(*model, nullptr);
+      benchSink = review.size();
+    });
+  }
+
+  /* every repetition appends to the same model, the cost per append does not depend on the count */
+  const uint64_t appends = parser.value(appendsOption).toULongLong();
+  std::vector<Image_ID_T> imageIds;
+  for (const auto &it: model->imageInfos) {
+    imageIds.push_back(it.first);
+  }
+  bench("keypoint_append", appends, 0, []() {}, [&]() {
+    for (uint64_t i = 0; i < appends; i++) {
+      model->appendImageKeyPoint(imageIds[i % imageIds.size()], queries[i % queries.size()]);
+    }
+  });
+
+  /* merge disjoint pairs of neighbouring tracks, each track takes part at most once over all repetitions */
+  const uint64_t merges = parser.value(mergesOption).toULongLong();
+  std::vector<std::pair<Track_ID_T, Track_ID_T>> mergePairs;
+  if (selected("track_merge")) {
+    std::vector<Image_ID_T> a, b;
+    auto it = model->tracks.begin();
+    while ((mergePairs.size() < merges * repeat) && (it != model->tracks.end())) {
+      auto next = std::next(it);
+      if (next == model->tracks.end()) {
+        break;
+      }
+      a = it->second.images;
+      b = next->second.images;
+      std::sort(a.begin(), a.end());
+      std::sort(b.begin(), b.end());
+      std::vector<Image_ID_T> common;
+      std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+      if (common.empty()) {
+        mergePairs.emplace_back(it->first, next->first);
+        it = std::next(next);
+      } else {
+        it = next;
+      }
+    }
+  }
+  const uint64_t mergesPerRun = mergePairs.size() / repeat;
+  size_t mergeRun = 0;
+  bench("track_merge", mergesPerRun, 0, []() {}, [&]() {
+    for (uint64_t i = mergeRun * mergesPerRun; i < (mergeRun + 1) * mergesPerRun; i++) {
+      const auto &from = model->tracks.at(mergePairs[i].second);
+      model->addKeypoint2Track(mergePairs[i].first, from.images[0], from.kps[0]);
+    }
+    mergeRun++;
+  });
+
+  return finish();
+}
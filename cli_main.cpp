@@ -0,0 +1,218 @@
+#include <iostream>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include "ColmapDatabase.h"
+#include "ColmapWriter.h"
+#include "ColmapDatabaseWriter.h"
+#include "ImageGraphModel.h"
+#include "MatchComparison.h"
+#include "ReconstructionDiff.h"
+#include "OutlierReview.h"
+#include "ReprojectionErrors.h"
+#include "TrackStatistics.h"
+#include "colampParser.h"
+
+/*
+ * command line front end of match_core, runs loads and track analyses on machines without a display
+ *   match_cli stats --sparse <colmap sparse dir> [--images <image dir>]
+ *   match_cli matches --database <database.db> [--sparse <colmap sparse dir>] [--pair a.jpg,b.jpg]
+ *   match_cli export --sparse <colmap sparse dir> [--output <dir>] [--database <database.db>]
+ *   match_cli diff --sparse <colmap sparse dir> --other <colmap sparse dir>
+ *   match_cli outliers --sparse <colmap sparse dir>
+ */
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("match_cli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("load colmap reconstructions and analyse their tracks");
+  parser.addHelpOption();
+  parser.addPositionalArgument("command", "stats, matches, export, diff or outliers");
+  QCommandLineOption sparseOption("sparse", "colmap sparse model directory", "dir");
+  QCommandLineOption imagesOption("images", "image directory, only used for image paths", "dir", ".");
+  QCommandLineOption databaseOption("database", "colmap feature database", "file");
+  QCommandLineOption pairOption("pair", "image names of one pair, comma separated", "a,b");
+  QCommandLineOption outputOption("output", "output directory", "dir");
+  QCommandLineOption otherOption("other", "second colmap sparse model to compare with", "dir");
+  parser.addOptions({sparseOption, imagesOption, databaseOption, pairOption, outputOption, otherOption});
+  parser.process(app);
+
+  const QStringList args = parser.positionalArguments();
+  if (args.size() != 1) {
+    parser.showHelp(1);
+  }
+
+  if (args.first() == "stats") {
+    if (!parser.isSet(sparseOption)) {
+      parser.showHelp(1);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    ColmapLoader loader;
+    if (!loader.loadFromColmapSparseDir(parser.value(sparseOption).toStdString())) {
+      return 1;
+    }
+    const auto readMs = timer.restart();
+    ImageGraphModel graphModel;
+    if (!graphModel.appendColmapData(parser.value(imagesOption), loader)) {
+      return 1;
+    }
+    const auto appendMs = timer.restart();
+    const auto stats = TrackStatistics::compute(graphModel);
+    const auto statsMs = timer.restart();
+    ReprojectionErrors errors;
+    errors.compute(graphModel);
+    const auto errorsMs = timer.elapsed();
+
+    stats.print(std::cout);
+    errors.print(std::cout);
+    std::cout << "read " << readMs << " ms, append " << appendMs << " ms, analyse " << statsMs << " ms, reproject "
+              << errorsMs << " ms" << std::endl;
+    return 0;
+  }
+
+  if (args.first() == "matches") {
+    if (!parser.isSet(databaseOption)) {
+      parser.showHelp(1);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    ImageGraphModel graphModel;
+    if (parser.isSet(sparseOption) &&
+        !graphModel.appendColmapSparseDir(parser.value(imagesOption), parser.value(sparseOption).toStdString())) {
+      return 1;
+    }
+    auto database = std::make_shared<ColmapDatabase>();
+    if (!database->open(parser.value(databaseOption).toStdString()) ||
+        !graphModel.appendColmapDatabase(parser.value(imagesOption), database)) {
+      return 1;
+    }
+    const auto readMs = timer.restart();
+    uint64_t keypoints = 0;
+    for (const auto &kps: database->keypoints) {
+      keypoints += kps.size();
+    }
+    std::cout << database->images.size() << " images, " << keypoints << " keypoints, read in " << readMs << " ms"
+              << std::endl;
+
+    if (!parser.isSet(pairOption)) {
+      const auto rawPairs = database->listPairs(ColmapDatabase::RAW_MATCHES).size();
+      const auto verifiedPairs = database->listPairs(ColmapDatabase::VERIFIED_MATCHES).size();
+      std::cout << rawPairs << " matched pairs, " << verifiedPairs << " verified pairs" << std::endl;
+      return 0;
+    }
+
+    const QStringList names = parser.value(pairOption).split(',');
+    std::vector<Image_ID_T> pair;
+    for (const auto &name: names) {
+      const QString path = parser.value(imagesOption) + "/" + name;
+      for (const auto &it: graphModel.imageInfos) {
+        if (it.second.path == path) {
+          pair.push_back(it.first);
+          break;
+        }
+      }
+    }
+    if ((names.size() != 2) || (pair.size() != 2)) {
+      std::cerr << "unknown pair " << parser.value(pairOption).toStdString() << std::endl;
+      return 1;
+    }
+    for (const auto kind: {ColmapDatabase::RAW_MATCHES, ColmapDatabase::VERIFIED_MATCHES}) {
+      const auto *matches = graphModel.pairMatches(pair[0], pair[1], kind);
+      std::cout << (kind == ColmapDatabase::RAW_MATCHES ? "raw: " : "verified: ");
+      if (matches == nullptr) {
+        std::cout << "none" << std::endl;
+        continue;
+      }
+      std::cout << matches->matches.size() << " matches";
+      if (kind == ColmapDatabase::VERIFIED_MATCHES) {
+        std::cout << ", config " << matches->config << ", F" << std::endl << matches->F;
+      }
+      std::cout << std::endl;
+    }
+    MatchComparison::compute(graphModel, pair[0], pair[1]).print(std::cout);
+    return 0;
+  }
+
+  /* load and write back as sparse model and/or as database matches, also measures the writers */
+  if (args.first() == "export") {
+    if (!parser.isSet(sparseOption) || (!parser.isSet(outputOption) && !parser.isSet(databaseOption))) {
+      parser.showHelp(1);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    ImageGraphModel graphModel;
+    if (!graphModel.appendColmapSparseDir(parser.value(imagesOption), parser.value(sparseOption).toStdString())) {
+      return 1;
+    }
+    std::cout << "read " << timer.restart() << " ms" << std::endl;
+    if (parser.isSet(outputOption)) {
+      ColmapWriter::Summary summary;
+      if (!ColmapWriter::writeBinary(graphModel, parser.value(outputOption).toStdString(), &summary)) {
+        return 1;
+      }
+      std::cout << summary.images << " images, " << summary.points3D << " points, " << summary.observations
+                << " observations, " << summary.bytes / double(1 << 20) << " MB written in " << timer.restart()
+                << " ms" << std::endl;
+    }
+    if (parser.isSet(databaseOption)) {
+      ColmapDatabaseWriter::Summary summary;
+      if (!ColmapDatabaseWriter::exportTrackMatches(graphModel, parser.value(databaseOption).toStdString(), {},
+                                                    &summary)) {
+        return 1;
+      }
+      std::cout << summary.matches << " matches of " << summary.pairs << " pairs, " << summary.newMatches
+                << " new, " << summary.keypointsAppended << " keypoints appended, exported in " << timer.restart()
+                << " ms" << std::endl;
+    }
+    return 0;
+  }
+
+  /* tracks split, merged, appeared or vanished between two reconstructions of the same database */
+  if (args.first() == "diff") {
+    if (!parser.isSet(sparseOption) || !parser.isSet(otherOption)) {
+      parser.showHelp(1);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const auto loaders = ColmapLoader::loadParallel({parser.value(sparseOption).toStdString(),
+                                                     parser.value(otherOption).toStdString()});
+    if ((loaders[0] == nullptr) || (loaders[1] == nullptr)) {
+      return 1;
+    }
+    const auto readMs = timer.restart();
+    const auto diff = ReconstructionDiff::compute(*loaders[0], *loaders[1]);
+    const auto diffMs = timer.elapsed();
+
+    diff.print(std::cout);
+    std::cout << "read " << readMs << " ms, diff " << diffMs << " ms" << std::endl;
+    return 0;
+  }
+
+  /* the most suspicious track observations, without the patch cue since no images are decoded here */
+  if (args.first() == "outliers") {
+    if (!parser.isSet(sparseOption)) {
+      parser.showHelp(1);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    ColmapLoader loader;
+    ImageGraphModel graphModel;
+    if (!loader.loadFromColmapSparseDir(parser.value(sparseOption).toStdString()) ||
+        !graphModel.appendColmapData(parser.value(imagesOption), loader)) {
+      return 1;
+    }
+    const auto loadMs = timer.restart();
+    OutlierReview review;
+    review.compute(graphModel, nullptr);
+    const auto reviewMs = timer.elapsed();
+
+    review.print(std::cout);
+    std::cout << "load " << loadMs << " ms, score " << reviewMs << " ms" << std::endl;
+    return 0;
+  }
+
+  std::cerr << "unknown command " << args.first().toStdString() << std::endl;
+  parser.showHelp(1);
+}
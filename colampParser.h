@@ -5,7 +5,12 @@
 #ifndef MATCH_MANUALLY_SCENE_H
 #define MATCH_MANUALLY_SCENE_H
 
+#include <memory>
+#include <string>
+#include <vector>
 #include <Eigen/Eigen>
+#include "BinaryReader.h"
+#include "MemoryAccounting.h"
 
 class ColmapLoader {
 public:
@@ -42,44 +47,51 @@ public:
   };
 
 public:
-  bool loadFromColmapSparseDir(const std::string &path);
+  /* io picks how the binary files are read, see BinaryReader */
+  bool loadFromColmapSparseDir(const std::string &path,
+                               BinaryReader::Strategy io = BinaryReader::defaultStrategy());
+
+  /* path itself when it holds a model, otherwise the numbered sub-models colmap writes (sparse/0, sparse/1, ...) */
+  static std::vector<std::string> subModelDirs(const std::string &path);
+
+  /* one loader per directory, parsed concurrently. nullptr for directories that could not be read */
+  static std::vector<std::unique_ptr<ColmapLoader>> loadParallel(
+      const std::vector<std::string> &dirs, BinaryReader::Strategy io = BinaryReader::defaultStrategy());
 
   std::vector<SceneImageInfo> imagesInfo;
   std::vector<SceneCameraInfo> camerasInfo;
   std::vector<Point3D> points3D;
 
 private:
+  MemoryAccounting::Gauge m_memory{MemoryAccounting::COLMAP_LOADER, MemoryAccounting::HOST};
+
+  void updateMemoryGauge();
+
   bool ReadText(const std::string &path);
 
-  bool ReadBinary(const std::string &path);
+  bool ReadBinary(const std::string &path, BinaryReader::Strategy io);
 
 //  void WriteText(const std::string &path) const;
 //
-//  void WriteBinary(const std::string &path) const;
-//
 //  void ReadCamerasText(const std::string &path);
 //
 //  void ReadImagesText(const std::string &path);
 //
 //  void ReadPoints3DText(const std::string &path);
 //
-  bool ReadCamerasBinary(const std::string &path);
+  bool ReadCamerasBinary(const std::string &path, BinaryReader::Strategy io);
 
-  bool ReadImagesBinary(const std::string &path);
+  bool ReadImagesBinary(const std::string &path, BinaryReader::Strategy io);
 
-  bool ReadPoints3DBinary(const std::string &path);
+  bool ReadPoints3DBinary(const std::string &path, BinaryReader::Strategy io);
 //
 //  void WriteCamerasText(const std::string &path) const;
 //
 //  void WriteImagesText(const std::string &path) const;
 //
 //  void WritePoints3DText(const std::string &path) const;
-//
-//  void WriteCamerasBinary(const std::string &path) const;
-//
-//  void WriteImagesBinary(const std::string &path) const;
-//
-//  void WritePoints3DBinary(const std::string &path) const;
+
+  /* binary output is written from the edited model by ColmapWriter */
 };
 
 
@@ -2,21 +2,30 @@
 // Created by lucius on 1/15/21.
 //
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-
+#include <cstring>
 #include <boost/log/trivial.hpp>
 #include <boost/filesystem.hpp>
 #include "colampParser.h"
+#include "CameraModels.h"
+#include "Parallel.h"
+#include "Trace.h"
 
 namespace fs = boost::filesystem;
 
-bool ColmapLoader::loadFromColmapSparseDir(const std::string &path) {
-  if (fs::is_regular_file(path + "/cameras.bin") &&
-      fs::is_regular_file(path + "/images.bin") &&
-      fs::is_regular_file(path + "/points3D.bin")) {
-    return ReadBinary(path);
+const ColmapLoader::point3D_t ColmapLoader::kInvalidPoint3DId = std::numeric_limits<ColmapLoader::point3D_t>::max();
+
+/* archived models keep <name>.zst, the plain file wins when both exist */
+static std::string binaryFile(const std::string &path, const std::string &name) {
+  const std::string plain = path + "/" + name;
+  return fs::is_regular_file(plain) || !fs::is_regular_file(plain + ".zst") ? plain : plain + ".zst";
+}
+
+bool ColmapLoader::loadFromColmapSparseDir(const std::string &path, BinaryReader::Strategy io) {
+  TRACE_SCOPE("ColmapLoader::loadFromColmapSparseDir");
+  if (fs::is_regular_file(binaryFile(path, "cameras.bin")) &&
+      fs::is_regular_file(binaryFile(path, "images.bin")) &&
+      fs::is_regular_file(binaryFile(path, "points3D.bin"))) {
+    return ReadBinary(path, io);
   } else if (fs::is_regular_file(path + "/cameras.txt") &&
              fs::is_regular_file(path + "/images.txt") &&
              fs::is_regular_file(path + "/points3D.txt")) {
@@ -26,14 +35,82 @@ bool ColmapLoader::loadFromColmapSparseDir(const std::string &path) {
   return false;
 }
 
+static bool hasModel(const std::string &path) {
+  for (const char *ext: {".bin", ".txt"}) {
+    bool all = true;
+    for (const char *name: {"cameras", "images", "points3D"}) {
+      const std::string file = std::string(name) + ext;
+      all = all && (fs::is_regular_file(path + "/" + file) || fs::is_regular_file(path + "/" + file + ".zst"));
+    }
+    if (all) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> ColmapLoader::subModelDirs(const std::string &path) {
+  if (hasModel(path)) {
+    return {path};
+  }
+  std::vector<std::pair<unsigned long, std::string>> numbered;
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(path, ec), end; !ec && (it != end); it.increment(ec)) {
+    const std::string name = it->path().filename().string();
+    if (!name.empty() && (name.size() < 10) && (name.find_first_not_of("0123456789") == std::string::npos) &&
+        hasModel(it->path().string())) {
+      numbered.emplace_back(std::stoul(name), it->path().string());
+    }
+  }
+  std::sort(numbered.begin(), numbered.end());
+  std::vector<std::string> dirs;
+  for (const auto &it: numbered) {
+    dirs.push_back(it.second);
+  }
+  return dirs;
+}
+
+std::vector<std::unique_ptr<ColmapLoader>> ColmapLoader::loadParallel(const std::vector<std::string> &dirs,
+                                                                      BinaryReader::Strategy io) {
+  TRACE_SCOPE("ColmapLoader::loadParallel");
+  std::vector<std::unique_ptr<ColmapLoader>> loaders(dirs.size());
+  /* one thread per model, the readers add their own io threads */
+  parallelFor(dirs.size(), [&](size_t i) {
+    auto loader = std::make_unique<ColmapLoader>();
+    if (loader->loadFromColmapSparseDir(dirs[i], io)) {
+      loaders[i] = std::move(loader);
+    }
+  }, dirs.size(), 1);
+  return loaders;
+}
+
 bool ColmapLoader::ReadText(const std::string &path) {
   return false;
 }
 
-bool ColmapLoader::ReadBinary(const std::string &path) {
-  return ReadCamerasBinary(path + "/cameras.bin") &&
-         ReadImagesBinary(path + "/images.bin") &&
-         ReadPoints3DBinary(path + "/points3D.bin");
+bool ColmapLoader::ReadBinary(const std::string &path, BinaryReader::Strategy io) {
+  const bool ok = ReadCamerasBinary(binaryFile(path, "cameras.bin"), io) &&
+                  ReadImagesBinary(binaryFile(path, "images.bin"), io) &&
+                  ReadPoints3DBinary(binaryFile(path, "points3D.bin"), io);
+  updateMemoryGauge();
+  return ok;
+}
+
+void ColmapLoader::updateMemoryGauge() {
+  uint64_t bytes = camerasInfo.capacity() * sizeof(SceneCameraInfo) +
+                   imagesInfo.capacity() * sizeof(SceneImageInfo) +
+                   points3D.capacity() * sizeof(Point3D);
+  for (const auto &camera: camerasInfo) {
+    bytes += camera.params.capacity() * sizeof(camera.params[0]);
+  }
+  for (const auto &img: imagesInfo) {
+    bytes += img.points2D.capacity() * sizeof(img.points2D[0]) +
+             img.point3D_ids.capacity() * sizeof(img.point3D_ids[0]) + img.name.capacity();
+  }
+  for (const auto &p3: points3D) {
+    bytes += p3.track.capacity() * sizeof(p3.track[0]);
+  }
+  m_memory.set(bytes);
 }
 
 struct BinaryImageInfoReadHelper1 {
@@ -49,60 +126,75 @@ struct BinaryImageInfoReadHelper2 {
   ColmapLoader::point3D_t point3D_id;
 } __attribute__((packed));
 
-bool ColmapLoader::ReadImagesBinary(const std::string &path) {
-  const size_t fileSize = fs::file_size(path);
-  int fd = open(path.c_str(), O_RDONLY, 0);
-  if (fd == -1) {
+/* io error or a file that ends inside a record */
+static bool readError(const BinaryReader &reader, const std::string &path) {
+  BOOST_LOG_TRIVIAL(error) << (reader.failed() ? "read error in " : "truncated file ") << path << " at byte "
+                           << reader.position();
+  return false;
+}
+
+static bool readDone(BinaryReader &reader, const std::string &path) {
+  if (!reader.atEnd()) {
+    BOOST_LOG_TRIVIAL(warning) << "ignored trailing data in " << path << " after byte " << reader.position();
+  }
+  return !reader.failed() || readError(reader, path);
+}
+
+/* a record count larger than the file can hold is corruption, not a reason to allocate */
+static bool readCount(BinaryReader &reader, size_t minRecordSize, uint64_t *count) {
+  return reader.read(count) && (*count <= reader.remaining() / minRecordSize);
+}
+
+bool ColmapLoader::ReadImagesBinary(const std::string &path, BinaryReader::Strategy io) {
+  TRACE_SCOPE("ColmapLoader::ReadImagesBinary");
+  BinaryReader reader;
+  if (!reader.open(path, io)) {
     BOOST_LOG_TRIVIAL(warning) << "unable to open binary image data file " << path;
     return false;
   }
-  void *mmappedData = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
-  char *bytes = static_cast<char *>(mmappedData);
-  size_t pos = 0;
-  imagesInfo.resize(*reinterpret_cast<uint64_t *>(bytes + pos));
-  pos = pos + sizeof(uint64_t);
+  uint64_t count = 0;
+  if (!readCount(reader, sizeof(BinaryImageInfoReadHelper1) + 1 + sizeof(uint64_t), &count)) {
+    return readError(reader, path);
+  }
+  imagesInfo.resize(count);
 
   BOOST_LOG_TRIVIAL(info) << "total " << imagesInfo.size() << "imags";
   for (auto &img :imagesInfo) {
-    const BinaryImageInfoReadHelper1 *const helper1 = reinterpret_cast<BinaryImageInfoReadHelper1 *>(bytes + pos);
+    const auto *const helper1 = reinterpret_cast<const BinaryImageInfoReadHelper1 *>(
+        reader.view(sizeof(BinaryImageInfoReadHelper1)));
+    if (helper1 == nullptr) {
+      return readError(reader, path);
+    }
+    /* a view is only valid until the next read */
     img.image_id = helper1->image_id;
     memcpy(img.Qvec.data(), &helper1->QVec[0], sizeof(helper1->QVec));
     memcpy(img.Tvec.data(), &helper1->TVec[0], sizeof(helper1->TVec));
     img.camera_id = helper1->camera_id;
-    pos = pos + sizeof(BinaryImageInfoReadHelper1);
-
-    img.name = bytes + pos;
-    pos = pos + img.name.size() + 1;
+    if (!reader.readString(&img.name)) {
+      return readError(reader, path);
+    }
 
     BOOST_LOG_TRIVIAL(debug) << img.name;
-    img.points2D.resize(*reinterpret_cast<uint64_t *>(bytes + pos));
-    pos = pos + sizeof(uint64_t);
-
-    img.point3D_ids.resize(img.points2D.size());
-    const BinaryImageInfoReadHelper2 *const helper2 = reinterpret_cast<BinaryImageInfoReadHelper2 *>(bytes + pos);
-    for (int i = 0; i < img.points2D.size(); i++) {
+    uint64_t points2D = 0;
+    if (!readCount(reader, sizeof(BinaryImageInfoReadHelper2), &points2D)) {
+      return readError(reader, path);
+    }
+    const auto *const helper2 = reinterpret_cast<const BinaryImageInfoReadHelper2 *>(
+        reader.view(sizeof(BinaryImageInfoReadHelper2) * points2D));
+    if (helper2 == nullptr) {
+      return readError(reader, path);
+    }
+    img.points2D.resize(points2D);
+    img.point3D_ids.resize(points2D);
+    for (size_t i = 0; i < img.points2D.size(); i++) {
       img.points2D[i].x() = helper2[i].x;
       img.points2D[i].y() = helper2[i].y;
       img.point3D_ids[i] = helper2[i].point3D_id;
     }
-    pos = pos + sizeof(BinaryImageInfoReadHelper2) * img.points2D.size();
   }
-  munmap(mmappedData, fileSize);
-  close(fd);
-  assert(fileSize == pos);
-  return true;
+  return readDone(reader, path);
 }
 
-const std::vector<std::pair<std::string, int>> CAMERA_INFOS = {
-        {"SIMPLE_PINHOLE", 3},  // 0
-        {"PINHOLE",        4},         // 1
-        {"SIMPLE_RADIAL",  4},   // 2
-        {"RADIAL",         5},          // 3
-        {"OPENCV",         8},          // 4
-        {"OPENCV_FISHEYE", 8},  // 5
-        {"FULL_OPENCV",    12}     //6
-};
-
 struct BinaryCameraInfoReadHelper {
   ColmapLoader::camera_t camera_id;
   int model_id;
@@ -110,36 +202,40 @@ struct BinaryCameraInfoReadHelper {
   uint64_t height;
 } __attribute__((packed));
 
-bool ColmapLoader::ReadCamerasBinary(const std::string &path) {
-  const size_t fileSize = fs::file_size(path);
-  int fd = open(path.c_str(), O_RDONLY, 0);
-  if (fd == -1) {
+bool ColmapLoader::ReadCamerasBinary(const std::string &path, BinaryReader::Strategy io) {
+  TRACE_SCOPE("ColmapLoader::ReadCamerasBinary");
+  BinaryReader reader;
+  if (!reader.open(path, io)) {
     BOOST_LOG_TRIVIAL(warning) << "unable to open binary camera data file " << path;
     return false;
   }
-  void *mmappedData = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
-  char *bytes = static_cast<char *>(mmappedData);
-  size_t pos = 0;
-  camerasInfo.resize(*reinterpret_cast<uint64_t *>(bytes + pos));
-  pos = pos + sizeof(uint64_t);
+  uint64_t count = 0;
+  if (!readCount(reader, sizeof(BinaryCameraInfoReadHelper), &count)) {
+    return readError(reader, path);
+  }
+  camerasInfo.resize(count);
 
   BOOST_LOG_TRIVIAL(info) << "total " << camerasInfo.size() << " cameras";
   for (auto &camera :camerasInfo) {
-    const BinaryCameraInfoReadHelper *const helper = reinterpret_cast<BinaryCameraInfoReadHelper *>(bytes + pos);
+    const auto *const helper = reinterpret_cast<const BinaryCameraInfoReadHelper *>(
+        reader.view(sizeof(BinaryCameraInfoReadHelper)));
+    if (helper == nullptr) {
+      return readError(reader, path);
+    }
+    if (!CameraModel::supported(helper->model_id)) {
+      BOOST_LOG_TRIVIAL(error) << "unsupported camera model " << helper->model_id << " in " << path;
+      return false;
+    }
     camera.camera_id = helper->camera_id;
     camera.model_id = helper->model_id;
     camera.width = helper->width;
     camera.height = helper->height;
-    pos = pos + sizeof(BinaryCameraInfoReadHelper);
-    camera.params.resize(CAMERA_INFOS.at(camera.model_id).second);
-    const size_t params_mem_size = camera.params.size() * sizeof(camera.params[0]);
-    memcpy(camera.params.data(), bytes + pos, params_mem_size);
-    pos = pos + params_mem_size;
-  }
-  munmap(mmappedData, fileSize);
-  close(fd);
-  assert(fileSize == pos);
-  return true;
+    camera.params.resize(CameraModel::numParams(camera.model_id));
+    if (!reader.read(camera.params.data(), camera.params.size() * sizeof(camera.params[0]))) {
+      return readError(reader, path);
+    }
+  }
+  return readDone(reader, path);
 }
 
 struct BinaryPoints3DInfoReadHelper {
@@ -148,28 +244,33 @@ struct BinaryPoints3DInfoReadHelper {
   uint8_t Color[3];
   double error;
   uint64_t track_length;
-  struct {
-    ColmapLoader::image_t image_id;
-    ColmapLoader::point2D_t point2D_idx;
-  } __attribute__((packed)) tracks[];
 } __attribute__((packed));
 
-bool ColmapLoader::ReadPoints3DBinary(const std::string &path) {
-  const size_t fileSize = fs::file_size(path);
-  int fd = open(path.c_str(), O_RDONLY, 0);
-  if (fd == -1) {
+struct BinaryTrackElementReadHelper {
+  ColmapLoader::image_t image_id;
+  ColmapLoader::point2D_t point2D_idx;
+} __attribute__((packed));
+
+bool ColmapLoader::ReadPoints3DBinary(const std::string &path, BinaryReader::Strategy io) {
+  TRACE_SCOPE("ColmapLoader::ReadPoints3DBinary");
+  BinaryReader reader;
+  if (!reader.open(path, io)) {
     BOOST_LOG_TRIVIAL(warning) << "unable to open binary camera data file " << path;
     return false;
   }
-  void *mmappedData = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
-  char *bytes = static_cast<char *>(mmappedData);
-  size_t pos = 0;
-  points3D.resize(*reinterpret_cast<uint64_t *>(bytes + pos));
-  pos = pos + sizeof(uint64_t);
+  uint64_t count = 0;
+  if (!readCount(reader, sizeof(BinaryPoints3DInfoReadHelper), &count)) {
+    return readError(reader, path);
+  }
+  points3D.resize(count);
 
   BOOST_LOG_TRIVIAL(info) << "total " << points3D.size() << " 3d point, loading ...";
   for (auto &p3: points3D) {
-    const BinaryPoints3DInfoReadHelper *const helper = reinterpret_cast<BinaryPoints3DInfoReadHelper *>(bytes + pos);
+    const auto *const helper = reinterpret_cast<const BinaryPoints3DInfoReadHelper *>(
+        reader.view(sizeof(BinaryPoints3DInfoReadHelper)));
+    if ((helper == nullptr) || (helper->track_length > reader.remaining() / sizeof(BinaryTrackElementReadHelper))) {
+      return readError(reader, path);
+    }
     p3.point3D_id = helper->point3D_id;
     p3.XYZ.x() = helper->XYZ[0];
     p3.XYZ.y() = helper->XYZ[1];
@@ -179,15 +280,19 @@ bool ColmapLoader::ReadPoints3DBinary(const std::string &path) {
     p3.Color.z() = helper->Color[2];
     p3.error = helper->error;
     p3.track.resize(helper->track_length);
-    for (int i = 0; i < p3.track.size(); i++) {
-      p3.track[i].first = helper->tracks[i].image_id;
-      p3.track[i].second = helper->tracks[i].point2D_idx;
+    const auto *const tracks = reinterpret_cast<const BinaryTrackElementReadHelper *>(
+        reader.view(sizeof(BinaryTrackElementReadHelper) * p3.track.size()));
+    if (tracks == nullptr) {
+      return readError(reader, path);
     }
-    pos = pos + sizeof(BinaryPoints3DInfoReadHelper) + sizeof(helper->tracks[0]) * p3.track.size();
+    for (size_t i = 0; i < p3.track.size(); i++) {
+      p3.track[i].first = tracks[i].image_id;
+      p3.track[i].second = tracks[i].point2D_idx;
+    }
+  }
+  if (!readDone(reader, path)) {
+    return false;
   }
-  munmap(mmappedData, fileSize);
-  close(fd);
-  assert(fileSize == pos);
   BOOST_LOG_TRIVIAL(info) << "3d point loading done";
   return true;
 }
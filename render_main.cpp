@@ -0,0 +1,114 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include "BatchRenderer.h"
+#include "ImageGraphModel.h"
+#include "colampParser.h"
+
+/*
+ * headless batch renderer for match inspection images, the pair list has one job per line with image names
+ * as stored in images.bin, "a.jpg b.jpg" for the pair layout or a single "a.jpg" for the keypoint layout
+ */
+int main(int argc, char *argv[]) {
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app(argc, argv);
+  QApplication::setApplicationName("match_render");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("render match visualizations of a colmap reconstruction without a display");
+  parser.addHelpOption();
+  QCommandLineOption imagesOption("images", "image directory", "dir");
+  QCommandLineOption sparseOption("sparse", "colmap sparse model directory", "dir");
+  QCommandLineOption pairsOption("pairs", "job list, one image pair or image per line", "file");
+  QCommandLineOption outputOption("output", "output directory of the png files", "dir");
+  QCommandLineOption layoutOption("layout", "pair or keypoints", "layout", "pair");
+  QCommandLineOption sizeOption("size", "output size", "WxH", "1600x800");
+  QCommandLineOption keypointsOption("keypoints", "also draw keypoints in the pair layout");
+  parser.addOptions({imagesOption, sparseOption, pairsOption, outputOption, layoutOption, sizeOption,
+                     keypointsOption});
+  parser.process(app);
+  if (!parser.isSet(imagesOption) || !parser.isSet(sparseOption) || !parser.isSet(pairsOption) ||
+      !parser.isSet(outputOption)) {
+    parser.showHelp(1);
+  }
+
+  const QStringList sizeParts = parser.value(sizeOption).split('x');
+  const QSize size(sizeParts.value(0).toInt(), sizeParts.value(1).toInt());
+  if (size.isEmpty()) {
+    qCritical("invalid size %s", qPrintable(parser.value(sizeOption)));
+    return 1;
+  }
+  BatchRenderer::Layout layout;
+  if (parser.value(layoutOption) == "pair") {
+    layout = BatchRenderer::LAYOUT_PAIR;
+  } else if (parser.value(layoutOption) == "keypoints") {
+    layout = BatchRenderer::LAYOUT_KEYPOINTS;
+  } else {
+    qCritical("unknown layout %s", qPrintable(parser.value(layoutOption)));
+    return 1;
+  }
+
+  QVulkanInstance inst;
+  if (!inst.create()) {
+    qCritical("Failed to create Vulkan instance: %d", inst.errorCode());
+    return 1;
+  }
+
+  ColmapLoader loader;
+  if (!loader.loadFromColmapSparseDir(parser.value(sparseOption).toStdString())) {
+    return 1;
+  }
+  std::map<QString, Image_ID_T> nameMap;
+  for (const auto &img: loader.imagesInfo) {
+    nameMap[QString::fromStdString(img.name)] = img.image_id;
+  }
+  ImageGraphModel graphModel;
+  graphModel.appendColmapData(parser.value(imagesOption), loader);
+
+  QFile pairsFile(parser.value(pairsOption));
+  if (!pairsFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    qCritical("can not open %s", qPrintable(pairsFile.fileName()));
+    return 1;
+  }
+  const QDir outputDir(parser.value(outputOption));
+  QDir().mkpath(outputDir.absolutePath());
+  std::vector<BatchRenderer::Job> jobs;
+  QTextStream in(&pairsFile);
+  while (!in.atEnd()) {
+    const QStringList names = in.readLine().split(' ', Qt::SkipEmptyParts);
+    if (names.isEmpty() || names.first().startsWith('#')) {
+      continue;
+    }
+    BatchRenderer::Job job;
+    QStringList baseNames;
+    for (const auto &name: names) {
+      auto it = nameMap.find(name);
+      if (it == nameMap.end()) {
+        qWarning("skip unknown image %s", qPrintable(name));
+        job.images.clear();
+        break;
+      }
+      job.images.push_back(it->second);
+      baseNames << QString(name).replace('/', '_');
+    }
+    if (job.images.empty() || (job.images.size() > MAX_IMAGE_NUM)) {
+      continue;
+    }
+    job.output = outputDir.filePath(baseNames.join("__") + ".png");
+    jobs.push_back(std::move(job));
+  }
+
+  BatchRenderer batchRenderer(&inst, &graphModel, size);
+  if (!batchRenderer.initialize()) {
+    return 1;
+  }
+  batchRenderer.setLayout(layout, parser.isSet(keypointsOption));
+  const size_t written = batchRenderer.render(jobs);
+  qInfo() << "wrote" << written << "of" << jobs.size() << "images to" << outputDir.absolutePath();
+  return written == jobs.size() ? 0 : 1;
+}
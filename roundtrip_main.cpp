@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#ifdef MATCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "BinaryReader.h"
+#include "CameraModels.h"
+#include "ColmapDatabase.h"
+#include "ColmapDatabaseWriter.h"
+#include "ColmapWriter.h"
+#include "ImageGraphModel.h"
+#include "ProjectCache.h"
+#include "SyntheticColmap.h"
+#include "Triangulation.h"
+#include "colampParser.h"
+
+namespace fs = boost::filesystem;
+
+/*
+ * writes a synthetic reconstruction, loads it, writes it back with ColmapWriter and loads that again, also as two
+ * sub-models of a model that holds it twice, then saves the models to a project cache and reopens them. both round
+ * trips have to give back what went in, keypoints up to the float precision of the normalized positions. --zstd
+ * loads a compressed model instead
+ */
+namespace {
+bool failed = false;
+
+/* reports the first few mismatches, the rest only count */
+bool check(bool ok, const std::string &what) {
+  static int reported = 0;
+  if (!ok) {
+    failed = true;
+    if (reported++ < 20) {
+      fprintf(stderr, "mismatch: %s\n", what.c_str());
+    }
+  }
+  return ok;
+}
+
+/* point ids move when a later reconstruction is appended, points are matched by their observations */
+typedef std::vector<std::pair<ColmapLoader::image_t, ColmapLoader::point2D_t>> Observations;
+
+Observations sorted(Observations track) {
+  std::sort(track.begin(), track.end());
+  return track;
+}
+
+bool near(double a, double b, double tolerance) {
+  return std::abs(a - b) <= tolerance * std::max(1., std::abs(a));
+}
+
+void compareLoaders(const ColmapLoader &a, const ColmapLoader &b) {
+  check(!a.imagesInfo.empty() && !a.points3D.empty(), "empty synthetic model");
+  std::map<ColmapLoader::camera_t, const ColmapLoader::SceneCameraInfo *> cameras;
+  for (const auto &camera: b.camerasInfo) {
+    cameras[camera.camera_id] = &camera;
+  }
+  check(a.camerasInfo.size() == b.camerasInfo.size(), "camera count");
+  for (const auto &camera: a.camerasInfo) {
+    const std::string what = "camera " + std::to_string(camera.camera_id);
+    auto it = cameras.find(camera.camera_id);
+    if (check(it != cameras.end(), what + " missing")) {
+      const auto &other = *it->second;
+      check((camera.model_id == other.model_id) && (camera.width == other.width) &&
+            (camera.height == other.height) && (camera.params == other.params), what);
+    }
+  }
+
+  std::map<ColmapLoader::image_t, const ColmapLoader::SceneImageInfo *> images;
+  for (const auto &image: b.imagesInfo) {
+    images[image.image_id] = &image;
+  }
+  check(a.imagesInfo.size() == b.imagesInfo.size(), "image count");
+  for (const auto &image: a.imagesInfo) {
+    const std::string what = "image " + std::to_string(image.image_id);
+    auto it = images.find(image.image_id);
+    if (!check(it != images.end(), what + " missing")) {
+      continue;
+    }
+    const auto &other = *it->second;
+    check((image.camera_id == other.camera_id) && (image.name == other.name) && (image.Qvec == other.Qvec) &&
+          (image.Tvec == other.Tvec), what + " pose");
+    if (!check(image.points2D.size() == other.points2D.size(), what + " point count")) {
+      continue;
+    }
+    for (size_t i = 0; i < image.points2D.size(); i++) {
+      check(((image.points2D[i] - other.points2D[i]).norm() < 1e-2) &&
+            ((image.point3D_ids[i] == ColmapLoader::kInvalidPoint3DId) ==
+             (other.point3D_ids[i] == ColmapLoader::kInvalidPoint3DId)), what + " point " + std::to_string(i));
+    }
+  }
+
+  std::map<Observations, const ColmapLoader::Point3D *> points;
+  for (const auto &point: b.points3D) {
+    points[sorted(point.track)] = &point;
+  }
+  check(a.points3D.size() == b.points3D.size(), "point count");
+  for (const auto &point: a.points3D) {
+    const std::string what = "point " + std::to_string(point.point3D_id);
+    auto it = points.find(sorted(point.track));
+    if (!check(it != points.end(), what + " track")) {
+      continue;
+    }
+    const auto &other = *it->second;
+    check(near(point.XYZ.x(), other.XYZ.x(), 1e-6) && near(point.XYZ.y(), other.XYZ.y(), 1e-6) &&
+          near(point.XYZ.z(), other.XYZ.z(), 1e-6) && (point.Color == other.Color) &&
+          near(point.error, other.error, 1e-6), what);
+  }
+}
+
+/* the cache holds the in-memory layout, everything comes back bit for bit */
+void compareModels(const ImageGraphModel &a, const ImageGraphModel &b) {
+  check(a.origins == b.origins, "origins");
+  check(a.imageIndex == b.imageIndex, "image order");
+  check((a.image_id_max == b.image_id_max) && (a.track_id_max == b.track_id_max), "id counters");
+  check(a.cameras.size() == b.cameras.size(), "camera count");
+  for (const auto &it: a.cameras) {
+    auto other = b.cameras.find(it.first);
+    check((other != b.cameras.end()) && (it.second.camera_id == other->second.camera_id) &&
+          (it.second.model_id == other->second.model_id) && (it.second.width == other->second.width) &&
+          (it.second.height == other->second.height) && (it.second.params == other->second.params),
+          "camera " + std::to_string(it.first));
+  }
+
+  check(a.imageInfos.size() == b.imageInfos.size(), "image count");
+  for (const auto &it: a.imageInfos) {
+    const std::string what = "image " + std::to_string(it.first);
+    auto other = b.imageInfos.find(it.first);
+    if (!check(other != b.imageInfos.end(), what + " missing")) {
+      continue;
+    }
+    const auto &x = it.second;
+    const auto &y = other->second;
+    check((x.path == y.path) && (x.checkState == y.checkState) && (x.size == y.size) && (x.image_id == y.image_id),
+          what);
+    check((x.colmap.registered == y.colmap.registered) && (x.colmap.image_id == y.colmap.image_id) &&
+          (x.colmap.origin == y.colmap.origin) && (x.colmap.camera_id == y.colmap.camera_id) &&
+          (x.colmap.qvec == y.colmap.qvec) && (x.colmap.tvec == y.colmap.tvec) && (x.colmap.name == y.colmap.name),
+          what + " colmap meta");
+    if (!check(x.keyPoints.size() == y.keyPoints.size(), what + " keypoint count")) {
+      continue;
+    }
+    for (size_t i = 0; i < x.keyPoints.size(); i++) {
+      const auto &p = x.keyPoints[i];
+      const auto &q = y.keyPoints[i];
+      check((p.pos == q.pos) && (p.track_id == q.track_id) && (p.image_id == q.image_id) && (p.kp_id == q.kp_id),
+            what + " keypoint " + std::to_string(i));
+    }
+  }
+
+  check(a.tracks.size() == b.tracks.size(), "track count");
+  for (const auto &it: a.tracks) {
+    const std::string what = "track " + std::to_string(it.first);
+    auto other = b.tracks.find(it.first);
+    if (!check(other != b.tracks.end(), what + " missing")) {
+      continue;
+    }
+    const auto &x = it.second;
+    const auto &y = other->second;
+    check((x.pos == y.pos) && (x.images == y.images) && (x.kps == y.kps) && (x.error == y.error) &&
+          (x.track_id == y.track_id) && (x.color == y.color) && (x.origin == y.origin), what);
+  }
+}
+
+/* every observation of the track as a match of the exported database, found by the keypoint positions */
+void checkExportedTrack(const ImageGraphModel &model, const ColmapDatabase &database, const Track &track,
+                        const std::string &what) {
+  std::map<std::string, size_t> rows;
+  for (size_t i = 0; i < database.images.size(); i++) {
+    rows[database.images[i].name] = i;
+  }
+  for (size_t a = 0; a < track.images.size(); a++) {
+    for (size_t b = a + 1; b < track.images.size(); b++) {
+      const auto &info1 = model.imageInfos.at(track.images[a]);
+      const auto &info2 = model.imageInfos.at(track.images[b]);
+      const size_t row1 = rows.at(info1.colmap.name);
+      const size_t row2 = rows.at(info2.colmap.name);
+      ColmapDatabase::PairMatches pair;
+      if (!check(database.readMatches(database.images[row1].image_id, database.images[row2].image_id,
+                                      ColmapDatabase::VERIFIED_MATCHES, &pair), what + " pair")) {
+        continue;
+      }
+      const Eigen::Vector2f pixel1 = info1.keyPoints[track.kps[a]].pos.cwiseProduct(
+          Eigen::Vector2f(info1.size.width(), info1.size.height()));
+      const Eigen::Vector2f pixel2 = info2.keyPoints[track.kps[b]].pos.cwiseProduct(
+          Eigen::Vector2f(info2.size.width(), info2.size.height()));
+      check(std::any_of(pair.matches.begin(), pair.matches.end(), [&](const std::pair<uint32_t, uint32_t> &m) {
+        return ((database.keypoints[row1].at(m.first) - pixel1).norm() < 1e-2f) &&
+               ((database.keypoints[row2].at(m.second) - pixel2).norm() < 1e-2f);
+      }), what + " match");
+    }
+  }
+}
+
+#ifdef MATCH_HAVE_ZSTD
+/* a single frame, with the content size in its header unless streamed */
+bool compressFile(const std::string &from, const std::string &to, bool streamed) {
+  std::ifstream in(from, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  const std::vector<char> plain((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::vector<char> packed(ZSTD_compressBound(plain.size()));
+  size_t size = 0;
+  if (streamed) {
+    ZSTD_CCtx *context = ZSTD_createCCtx();
+    ZSTD_inBuffer input = {plain.data(), plain.size(), 0};
+    ZSTD_outBuffer output = {packed.data(), packed.size(), 0};
+    const size_t left = ZSTD_compressStream2(context, &output, &input, ZSTD_e_end);
+    ZSTD_freeCCtx(context);
+    if (left != 0) {
+      return false;
+    }
+    size = output.pos;
+  } else {
+    size = ZSTD_compress(packed.data(), packed.size(), plain.data(), plain.size(), 3);
+    if (ZSTD_isError(size)) {
+      return false;
+    }
+  }
+  std::ofstream out(to, std::ios::binary);
+  out.write(packed.data(), static_cast<std::streamsize>(size));
+  return out.good();
+}
+#endif
+
+/*
+ * compresses the files of a synthetic model with images.bin larger than a decompressed chunk, loads them with mmap
+ * and pread io and compares with the plain model. a frame cut short has to fail the load
+ */
+int zstdRoundTrip(const std::string &dir) {
+#ifndef MATCH_HAVE_ZSTD
+  printf("built without zstd, skipped\n");
+  return 77;
+#else
+  const std::string plainDir = dir + "/plain";
+  const std::string packedDir = dir + "/packed";
+  fs::create_directories(plainDir);
+  fs::create_directories(packedDir);
+  SyntheticColmapOptions options;
+  options.images = 200;
+  options.keypointsPerImage = 1000;
+  options.seed = 11;
+  ColmapLoader plain;
+  if (!writeSyntheticColmap(plainDir, options) || !plain.loadFromColmapSparseDir(plainDir)) {
+    fprintf(stderr, "can not load the synthetic model in %s\n", plainDir.c_str());
+    return 1;
+  }
+  /* images.bin without its size, the reader has to bound it */
+  for (const char *name: {"cameras.bin", "images.bin", "points3D.bin"}) {
+    if (!compressFile(plainDir + "/" + name, packedDir + "/" + name + ".zst", std::string(name) == "images.bin")) {
+      fprintf(stderr, "can not compress %s\n", name);
+      return 1;
+    }
+  }
+  for (const auto io: {BinaryReader::MMAP, BinaryReader::PREAD}) {
+    ColmapLoader packed;
+    if (!check(packed.loadFromColmapSparseDir(packedDir, io),
+               std::string("compressed model with ") + BinaryReader::strategyName(io))) {
+      continue;
+    }
+    compareLoaders(plain, packed);
+  }
+
+  const std::string cutDir = dir + "/cut";
+  fs::create_directories(cutDir);
+  for (const char *name: {"cameras.bin.zst", "images.bin.zst", "points3D.bin.zst"}) {
+    fs::copy_file(packedDir + "/" + name, cutDir + "/" + name);
+  }
+  fs::resize_file(cutDir + "/images.bin.zst", fs::file_size(cutDir + "/images.bin.zst") / 2);
+  ColmapLoader cut;
+  check(!cut.loadFromColmapSparseDir(cutDir), "cut off compressed model loaded");
+
+  printf("%s\n", failed ? "zstd round trip failed" : "zstd round trip ok");
+  return failed ? 1 : 0;
+#endif
+}
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+  QCommandLineParser parser;
+  parser.setApplicationDescription("write and reload models and project caches, check nothing changed");
+  parser.addHelpOption();
+  QCommandLineOption zstdOption("zstd", "load a zstd compressed model instead, exit code 77 when built without zstd");
+  parser.addOption(zstdOption);
+  parser.process(app);
+
+  const std::string dir = (fs::temp_directory_path() / fs::unique_path("match_roundtrip_%%%%%%%%")).string();
+  const std::string syntheticDir = dir + "/synthetic";
+  const std::string writtenDir = dir + "/written";
+  fs::create_directories(syntheticDir);
+  fs::create_directories(writtenDir);
+  struct RemoveDir {
+    std::string dir;
+
+    ~RemoveDir() { fs::remove_all(dir); }
+  } removeDir{dir};
+  if (parser.isSet(zstdOption)) {
+    return zstdRoundTrip(dir);
+  }
+
+  SyntheticColmapOptions options;
+  options.images = 40;
+  options.keypointsPerImage = 300;
+  options.seed = 7;
+  ColmapLoader synthetic;
+  ImageGraphModel model;
+  if (!writeSyntheticColmap(syntheticDir, options) || !synthetic.loadFromColmapSparseDir(syntheticDir) ||
+      !model.appendColmapData(QString(), synthetic)) {
+    fprintf(stderr, "can not load the synthetic model in %s\n", syntheticDir.c_str());
+    return 1;
+  }
+
+  ColmapLoader written;
+  if (!ColmapWriter::writeBinary(model, writtenDir) || !written.loadFromColmapSparseDir(writtenDir)) {
+    fprintf(stderr, "can not write and reload the model in %s\n", writtenDir.c_str());
+    return 1;
+  }
+  compareLoaders(synthetic, written);
+
+  /* the same reconstruction twice with other intrinsics, as sub-models of one database refine them. every camera
+   * and image id of the second one collides with the first */
+  ColmapLoader refined(synthetic);
+  for (auto &camera: refined.camerasInfo) {
+    camera.params[0] *= 1.05;
+  }
+  ImageGraphModel twice;
+  const std::string splitDir = dir + "/split";
+  if (!twice.appendColmapData(QString(), synthetic, "a") || !twice.appendColmapData(QString(), refined, "b") ||
+      !ColmapWriter::writeBinary(twice, splitDir)) {
+    fprintf(stderr, "can not write the model of two reconstructions to %s\n", splitDir.c_str());
+    return 1;
+  }
+  for (const auto *expected: {&synthetic, &refined}) {
+    const std::string partDir = splitDir + (expected == &synthetic ? "/a" : "/b");
+    ColmapLoader part;
+    if (!part.loadFromColmapSparseDir(partDir)) {
+      fprintf(stderr, "can not reload %s\n", partDir.c_str());
+      return 1;
+    }
+    compareLoaders(*expected, part);
+  }
+
+  /*
+   * a track made by hand in the second reconstruction is triangulated from its poses and goes to its sub-model,
+   * keypoints of the first can not join. the synthetic cameras look down +z from within 10 units of the origin, the
+   * point is clicked in the first image and in the one farthest from it
+   */
+  std::vector<Image_ID_T> handImages;
+  double baseline = 0;
+  for (const auto &it: twice.imageInfos) {
+    const auto &colmap = it.second.colmap;
+    if (!colmap.registered || (colmap.origin != 1)) {
+      continue;
+    }
+    if (handImages.empty()) {
+      handImages.push_back(it.first);
+      continue;
+    }
+    const double distance = (colmap.tvec - twice.imageInfos.at(handImages[0]).colmap.tvec).norm();
+    if (distance > baseline) {
+      baseline = distance;
+      handImages.resize(1);
+      handImages.push_back(it.first);
+    }
+  }
+  const Eigen::Vector3d handPoint(0, 0, 30);
+  Observations handObservations;
+  std::vector<KeyPoint_ID_T> handKps;
+  for (const auto image_id: handImages) {
+    const auto &info = twice.imageInfos.at(image_id);
+    const Eigen::Vector3d local = handPoint + info.colmap.tvec;
+    Eigen::Vector2d pixel;
+    CameraModel::project(twice.cameras.at(info.colmap.camera_id), &local, &pixel, 1);
+    handKps.push_back(twice.appendImageKeyPoint(image_id, Eigen::Vector2f(pixel.x() / info.size.width(),
+                                                                          pixel.y() / info.size.height())));
+    handObservations.emplace_back(info.colmap.image_id, handKps.back());
+  }
+  const Track_ID_T handTrack = twice.getOrCreateTrackForKeypoint(handImages[0], handKps[0]);
+  check(twice.addKeypoint2Track(handTrack, handImages[1], handKps[1]), "hand made track");
+  std::vector<Triangulation::View> views;
+  Triangulation::trackViews(twice, twice.tracks.at(handTrack), views);
+  const auto handResult = Triangulation().triangulate(views);
+  check(handResult.valid && ((handResult.pos - handPoint).norm() < 1e-3) && (handResult.error < 0.05f),
+        "hand made track triangulation");
+  Triangulation::trackViews(Triangulation::imageViews(twice), twice.tracks.at(handTrack), views);
+  const auto imagesResult = Triangulation().triangulate(views);
+  check(imagesResult.valid && ((imagesResult.pos - handPoint).norm() < 1e-3), "hand made track image views");
+  twice.setTrackPoint(handTrack, handResult.pos.cast<float>(), handResult.error);
+  const Image_ID_T firstImage = twice.imageInfos.begin()->first;
+  check(!twice.addKeypoint2Track(handTrack, firstImage,
+                                 twice.appendImageKeyPoint(firstImage, Eigen::Vector2f(0.5f, 0.5f))),
+        "track across reconstructions");
+  const std::string handDir = dir + "/hand";
+  ColmapLoader handPart;
+  if (!ColmapWriter::writeBinary(twice, handDir) || !handPart.loadFromColmapSparseDir(handDir + "/b")) {
+    fprintf(stderr, "can not write and reload the hand made track in %s\n", handDir.c_str());
+    return 1;
+  }
+  check(handPart.points3D.size() == refined.points3D.size() + 1, "hand made track count");
+  check(std::any_of(handPart.points3D.begin(), handPart.points3D.end(), [&](const ColmapLoader::Point3D &point) {
+    return (sorted(point.track) == sorted(handObservations)) && ((point.XYZ - handPoint).norm() < 1e-3);
+  }), "hand made track not written");
+
+  /*
+   * the copy of the hand made track's first image in the first reconstruction gets other hand made keypoints, both
+   * copies share one database row. their keypoints must not take each other's ids, also when exported again
+   */
+  Image_ID_T sharedCopy = firstImage;
+  Image_ID_T otherCopy = firstImage;
+  for (const auto &it: twice.imageInfos) {
+    if (it.second.colmap.origin == 0) {
+      if (it.second.colmap.name == twice.imageInfos.at(handImages[0]).colmap.name) {
+        sharedCopy = it.first;
+      } else if (it.second.colmap.name != twice.imageInfos.at(handImages[1]).colmap.name) {
+        otherCopy = it.first;
+      }
+    }
+  }
+  const Track_ID_T firstTrack = twice.getOrCreateTrackForKeypoint(
+      sharedCopy, twice.appendImageKeyPoint(sharedCopy, Eigen::Vector2f(0.25f, 0.25f)));
+  const KeyPoint_ID_T otherKp = twice.appendImageKeyPoint(otherCopy, Eigen::Vector2f(0.3f, 0.3f));
+  check(twice.addKeypoint2Track(firstTrack, otherCopy, otherKp), "hand made track of the first reconstruction");
+  const std::string databasePath = dir + "/database.db";
+  if (!writeSyntheticDatabase(databasePath, synthetic)) {
+    fprintf(stderr, "can not create the database %s\n", databasePath.c_str());
+    return 1;
+  }
+  const std::string sharedName = twice.imageInfos.at(sharedCopy).colmap.name;
+  for (int pass = 0; pass < 2; pass++) {
+    ColmapDatabaseWriter::Summary exported;
+    ColmapDatabase database;
+    if (!ColmapDatabaseWriter::exportTrackMatches(twice, databasePath, {}, &exported) ||
+        !database.open(databasePath)) {
+      fprintf(stderr, "can not export the tracks to %s\n", databasePath.c_str());
+      return 1;
+    }
+    const std::string what = pass == 0 ? "exported " : "exported again ";
+    /* every hand made keypoint is at a position of its own */
+    size_t added = 0;
+    for (const auto &it: twice.imageInfos) {
+      added += it.second.keyPoints.size() - options.keypointsPerImage;
+    }
+    check(exported.keypointsAppended == (pass == 0 ? added : 0), what + "keypoint count");
+    const size_t shared = twice.imageInfos.at(sharedCopy).keyPoints.size() +
+                          twice.imageInfos.at(handImages[0]).keyPoints.size() - options.keypointsPerImage;
+    for (size_t i = 0; i < database.images.size(); i++) {
+      if (database.images[i].name == sharedName) {
+        check(database.keypoints[i].size() == shared, what + "keypoints of the shared image");
+      }
+    }
+    checkExportedTrack(twice, database, twice.tracks.at(handTrack), what + "hand made track");
+    checkExportedTrack(twice, database, twice.tracks.at(firstTrack), what + "hand made track of the first copy");
+  }
+
+  const std::string cachePath = dir + "/match_manually.cache";
+  ImageGraphModel cached;
+  if (!ProjectCache::write(model, cachePath, "match_roundtrip") ||
+      !ProjectCache::read(cachePath, "match_roundtrip", &cached)) {
+    fprintf(stderr, "can not write and reopen the project cache %s\n", cachePath.c_str());
+    return 1;
+  }
+  compareModels(model, cached);
+  ImageGraphModel twiceCached;
+  if (!ProjectCache::write(twice, cachePath, "match_roundtrip") ||
+      !ProjectCache::read(cachePath, "match_roundtrip", &twiceCached)) {
+    fprintf(stderr, "can not write and reopen the project cache %s\n", cachePath.c_str());
+    return 1;
+  }
+  compareModels(twice, twiceCached);
+
+  printf("%s\n", failed ? "round trip failed" : "round trip ok");
+  return failed ? 1 : 0;
+}